@@ -14,4 +14,5 @@ public class DcAgentSettings
     public string[] GossipPeers { get; set; } = Array.Empty<string>();
     public string FailoverMode { get; set; } = "FailOpen";
     public string CacheDbPath { get; set; } = "dcagent_cache.db";
+    public bool LocalEvaluation { get; set; } // evaluate policies on the DC; only MFA goes to the server
 }
@@ -14,22 +14,26 @@ namespace MfaSrv.DcAgent.GrpcServices;
 public class GossipGrpcService : Protocol.Gossip.GossipService.GossipServiceBase
 {
     private readonly SessionCacheService _sessionCache;
+    private readonly SessionPartitioner _partitioner;
     private readonly DcAgentSettings _settings;
     private readonly ILogger<GossipGrpcService> _logger;
 
     public GossipGrpcService(
         SessionCacheService sessionCache,
+        SessionPartitioner partitioner,
         IOptions<DcAgentSettings> settings,
         ILogger<GossipGrpcService> logger)
     {
         _sessionCache = sessionCache;
+        _partitioner = partitioner;
         _settings = settings.Value;
         _logger = logger;
     }
 
     /// <summary>
     /// Handles a full session sync exchange. Merges incoming sessions from the
-    /// requesting peer and returns our local sessions.
+    /// requesting peer and returns our local sessions (only those the peer owns when
+    /// sessions are partitioned).
     /// </summary>
     public override Task<SyncSessionsResponse> SyncSessions(
         SyncSessionsRequest request, ServerCallContext context)
@@ -52,6 +56,9 @@ public class GossipGrpcService : Protocol.Gossip.GossipService.GossipServiceBase
 
         foreach (var session in _sessionCache.GetAllSessions())
         {
+            if (!_partitioner.IsOwnedBy(request.SenderUrl, session.UserName))
+                continue;
+
             response.Sessions.Add(new SessionEntry
             {
                 SessionId = session.SessionId,
@@ -110,13 +117,40 @@ public class GossipGrpcService : Protocol.Gossip.GossipService.GossipServiceBase
         });
     }
 
+    /// <summary>
+    /// Answers a session lookup from a peer that does not own the user (partitioned mode).
+    /// </summary>
+    public override Task<FindSessionResponse> FindSession(FindSessionRequest request, ServerCallContext context)
+    {
+        var session = _sessionCache.FindSession(request.UserName, request.AnySourceIp ? null : request.SourceIp);
+
+        _logger.LogDebug("FindSession from peer {PeerId} for {User}: {Found}",
+            request.SenderAgentId, request.UserName, session != null);
+
+        var response = new FindSessionResponse();
+        if (session != null)
+        {
+            response.Session = new SessionEntry
+            {
+                SessionId = session.SessionId,
+                UserId = session.UserId,
+                UserName = session.UserName,
+                SourceIp = session.SourceIp,
+                VerifiedMethod = session.VerifiedMethod,
+                ExpiresAt = Timestamp.FromDateTimeOffset(session.ExpiresAt)
+            };
+        }
+
+        return Task.FromResult(response);
+    }
+
     private void MergeSessionEntry(SessionEntry entry)
     {
         if (entry.Revoked)
         {
             _sessionCache.RevokeSession(entry.SessionId);
         }
-        else
+        else if (_partitioner.IsLocalOwner(entry.UserName))
         {
             var existing = _sessionCache.FindSession(entry.UserName, entry.SourceIp);
             if (existing == null || existing.SessionId != entry.SessionId)
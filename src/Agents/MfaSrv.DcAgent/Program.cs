@@ -14,6 +14,8 @@ builder.Services.AddGrpc();
 
 // Configuration
 builder.Services.Configure<DcAgentSettings>(builder.Configuration.GetSection("DcAgent"));
+builder.Services.Configure<SprayDetectionSettings>(builder.Configuration.GetSection("SprayDetection"));
+builder.Services.Configure<SessionPartitioningSettings>(builder.Configuration.GetSection("SessionPartitioning"));
 
 // SQLite persistent cache store (singleton, shared by policy and session caches)
 builder.Services.AddSingleton<SqliteCacheStore>(sp =>
@@ -25,10 +27,17 @@ builder.Services.AddSingleton<SqliteCacheStore>(sp =>
 
 // Core services
 builder.Services.AddSingleton<PolicyCacheService>();
+builder.Services.AddSingleton<DirectoryCacheService>();
 builder.Services.AddSingleton<SessionCacheService>();
+builder.Services.AddSingleton<SessionPartitioner>();
+builder.Services.AddSingleton<SprayDetectionService>();
 builder.Services.AddSingleton<AuthDecisionService>();
 builder.Services.AddSingleton<FailoverManager>();
 
+// Long-lived bidirectional channel to the central server (evaluations, heartbeats, session pushes)
+builder.Services.AddSingleton<AgentChannelClient>();
+builder.Services.AddHostedService(sp => sp.GetRequiredService<AgentChannelClient>());
+
 // Background services
 builder.Services.AddHostedService<NamedPipeServer>();
 builder.Services.AddHostedService<CentralServerClient>();
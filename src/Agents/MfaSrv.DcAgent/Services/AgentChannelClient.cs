@@ -0,0 +1,387 @@
+using System.Collections.Concurrent;
+using System.Threading.Channels;
+using Google.Protobuf.WellKnownTypes;
+using Grpc.Core;
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.ValueObjects;
+using MfaSrv.Protocol;
+
+namespace MfaSrv.DcAgent.Services;
+
+/// <summary>
+/// Keeps one long-lived bidirectional <c>AgentChannel</c> stream open to the central server.
+///
+/// Evaluations are multiplexed over the stream and correlated by request ID, limited to the
+/// in-flight window the server grants when it accepts the channel. Session created/revoked
+/// events pushed by the server are applied to the local session cache (created sessions
+/// only on their owners when sessions are partitioned). Heartbeats travel on
+/// the stream too: when no server message arrives for two heartbeat intervals the stream is
+/// torn down and the server is marked unavailable, so stream health drives failover instead
+/// of the separate unary heartbeat.
+///
+/// Allow/Deny decisions the agent makes from its synced policies are reported over the
+/// stream in batches, so they reach the server's audit log. They queue while the channel is
+/// down; once <see cref="LocalDecisionQueueCapacity"/> are waiting, new ones are dropped and
+/// the count is logged when the channel is back.
+/// Reconnects after a jittered, exponentially growing delay whenever the stream ends, even
+/// gracefully; the delay returns to <see cref="InitialRetryDelay"/> only after a stream the
+/// server sent a message on.
+/// </summary>
+public class AgentChannelClient : BackgroundService
+{
+    private static readonly TimeSpan InitialRetryDelay = TimeSpan.FromSeconds(5);
+    private static readonly TimeSpan MaxRetryDelay = TimeSpan.FromMinutes(2);
+    private static readonly TimeSpan EvaluationTimeout = TimeSpan.FromSeconds(10);
+    public const int LocalDecisionQueueCapacity = 10_000;
+    private const int LocalDecisionBatchSize = 500;
+
+    private readonly FailoverManager _failoverManager;
+    private readonly SessionCacheService _sessionCache;
+    private readonly SessionPartitioner _partitioner;
+    private readonly DcAgentSettings _settings;
+    private readonly ILogger<AgentChannelClient> _logger;
+
+    private readonly ConcurrentDictionary<ulong, TaskCompletionSource<AgentEvaluationResult>> _pending = new();
+    private readonly SemaphoreSlim _writeLock = new(1, 1);
+    private readonly Channel<AgentLocalDecision> _localDecisions = Channel.CreateBounded<AgentLocalDecision>(
+        new BoundedChannelOptions(LocalDecisionQueueCapacity)
+        {
+            FullMode = BoundedChannelFullMode.Wait,
+            SingleReader = true,
+            SingleWriter = false
+        });
+    private long _droppedLocalDecisions;
+    private IClientStreamWriter<AgentMessage>? _requestStream;
+    private SemaphoreSlim _window = new(0);
+    private long _nextRequestId;
+    private long _lastServerMessageTicks;
+    private bool _heardFromServer; // On the current or last stream
+    private volatile bool _isConnected;
+
+    public AgentChannelClient(
+        FailoverManager failoverManager,
+        SessionCacheService sessionCache,
+        SessionPartitioner partitioner,
+        IOptions<DcAgentSettings> settings,
+        ILogger<AgentChannelClient> logger)
+    {
+        _failoverManager = failoverManager;
+        _sessionCache = sessionCache;
+        _partitioner = partitioner;
+        _settings = settings.Value;
+        _logger = logger;
+    }
+
+    /// <summary>
+    /// True while the channel is open and has been accepted by the server.
+    /// </summary>
+    public bool IsConnected => _isConnected;
+
+    /// <summary>
+    /// Sends an evaluation over the channel and waits for its result. Returns null when the
+    /// channel is down, the in-flight window stays full, or the server did not evaluate the
+    /// request; callers then fall back to the unary call.
+    /// </summary>
+    public async Task<AuthResponseMessage?> EvaluateAsync(AuthQueryMessage query, CancellationToken ct)
+    {
+        var stream = _requestStream;
+        var window = _window;
+        if (!_isConnected || stream == null)
+            return null;
+
+        if (!await window.WaitAsync(EvaluationTimeout, ct))
+        {
+            _logger.LogWarning("Agent channel in-flight window full, evaluating {User} with a unary call", query.UserName);
+            return null;
+        }
+
+        var requestId = (ulong)Interlocked.Increment(ref _nextRequestId);
+        var completion = new TaskCompletionSource<AgentEvaluationResult>(TaskCreationOptions.RunContinuationsAsynchronously);
+        _pending[requestId] = completion;
+
+        try
+        {
+            await WriteAsync(stream, new AgentMessage
+            {
+                Evaluate = new AgentEvaluation
+                {
+                    RequestId = requestId,
+                    Request = FailoverManager.ToRequest(query, _settings.AgentId)
+                }
+            }, ct);
+
+            var result = await completion.Task.WaitAsync(EvaluationTimeout, ct);
+            if (!string.IsNullOrEmpty(result.Error) || result.Response == null)
+            {
+                _logger.LogWarning("Agent channel evaluation {RequestId} rejected: {Error}", requestId, result.Error);
+                return null;
+            }
+
+            return FailoverManager.FromResponse(result.Response);
+        }
+        catch (Exception ex) when (!ct.IsCancellationRequested)
+        {
+            _logger.LogWarning(ex, "Agent channel evaluation {RequestId} failed", requestId);
+            return null;
+        }
+        finally
+        {
+            _pending.TryRemove(requestId, out _);
+            window.Release();
+        }
+    }
+
+    /// <summary>
+    /// Number of local decisions waiting to be reported.
+    /// </summary>
+    public int PendingLocalDecisions => _localDecisions.Reader.Count;
+
+    /// <summary>
+    /// Queues a decision made by local policy evaluation for the server's audit log. Never
+    /// blocks; returns false, counting the drop, if the queue is full.
+    /// </summary>
+    public bool ReportLocalDecision(AuthQueryMessage query, PolicyEvaluationResult result, DateTimeOffset decidedAt)
+    {
+        var queued = _localDecisions.Writer.TryWrite(new AgentLocalDecision
+        {
+            Request = FailoverManager.ToRequest(query, _settings.AgentId),
+            Decision = FailoverManager.ToProto(result.Decision),
+            PolicyName = result.MatchedPolicyName ?? string.Empty,
+            DecidedAt = Timestamp.FromDateTimeOffset(decidedAt)
+        });
+
+        if (!queued)
+            Interlocked.Increment(ref _droppedLocalDecisions);
+        return queued;
+    }
+
+    /// <summary>
+    /// Applies a session event pushed by the server to the local session cache.
+    /// </summary>
+    public void ApplySessionEvent(SessionEvent sessionEvent)
+    {
+        if (sessionEvent.Revoked)
+        {
+            _sessionCache.RevokeSession(sessionEvent.SessionId);
+            return;
+        }
+
+        // Every agent receives every push; with partitioning only the owners keep it
+        if (!_partitioner.IsLocalOwner(sessionEvent.UserName))
+            return;
+
+        _sessionCache.AddOrUpdateSession(new CachedSession
+        {
+            SessionId = sessionEvent.SessionId,
+            UserId = sessionEvent.UserName,
+            UserName = sessionEvent.UserName,
+            SourceIp = sessionEvent.SourceIp,
+            ExpiresAt = sessionEvent.ExpiresAt?.ToDateTimeOffset()
+                ?? DateTimeOffset.UtcNow.AddMinutes(_settings.SessionTtlMinutes),
+            VerifiedMethod = sessionEvent.VerifiedMethod,
+            Revoked = false
+        });
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        _logger.LogInformation("Agent channel client starting for agent {AgentId}", _settings.AgentId);
+
+        var retryDelay = InitialRetryDelay;
+
+        while (!stoppingToken.IsCancellationRequested)
+        {
+            Exception? failure = null;
+            try
+            {
+                await RunChannelAsync(stoppingToken);
+            }
+            catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+            {
+                _logger.LogInformation("Agent channel client shutting down");
+                break;
+            }
+            catch (Exception ex)
+            {
+                failure = ex;
+                _failoverManager.MarkServerUnavailable();
+            }
+
+            // A server that accepts and at once closes or breaks the stream keeps backing off
+            if (_heardFromServer)
+                retryDelay = InitialRetryDelay;
+
+            var delay = ReconnectDelay(retryDelay);
+            if (failure != null)
+                _logger.LogError(failure, "Agent channel disconnected, retrying in {RetryDelay}s", delay.TotalSeconds);
+            else
+                _logger.LogInformation("Agent channel closed by the server, reconnecting in {RetryDelay}s", delay.TotalSeconds);
+
+            try
+            {
+                await Task.Delay(delay, stoppingToken);
+            }
+            catch (OperationCanceledException)
+            {
+                break;
+            }
+
+            retryDelay = TimeSpan.FromTicks(Math.Min(
+                retryDelay.Ticks * 2,
+                MaxRetryDelay.Ticks));
+        }
+    }
+
+    /// <summary>
+    /// Delay before reconnecting: <paramref name="backoff"/> scaled by a random factor in
+    /// [1, 1.5), so agents dropped together by a server restart do not reconnect in lockstep.
+    /// </summary>
+    public static TimeSpan ReconnectDelay(TimeSpan backoff)
+        => TimeSpan.FromTicks((long)(backoff.Ticks * (1 + 0.5 * Random.Shared.NextDouble())));
+
+    private async Task RunChannelAsync(CancellationToken ct)
+    {
+        using var channel = Grpc.Net.Client.GrpcChannel.ForAddress(_settings.CentralServerUrl);
+        var client = new MfaService.MfaServiceClient(channel);
+
+        using var callCts = CancellationTokenSource.CreateLinkedTokenSource(ct);
+        using var call = client.AgentChannel(cancellationToken: callCts.Token);
+
+        await call.RequestStream.WriteAsync(new AgentMessage
+        {
+            Open = new AgentChannelOpen { AgentId = _settings.AgentId }
+        });
+
+        _heardFromServer = false;
+        Interlocked.Exchange(ref _lastServerMessageTicks, DateTimeOffset.UtcNow.UtcTicks);
+        var heartbeat = HeartbeatLoopAsync(call.RequestStream, callCts);
+        var reports = ReportLocalDecisionsAsync(call.RequestStream, callCts.Token);
+
+        try
+        {
+            await foreach (var message in call.ResponseStream.ReadAllAsync(callCts.Token))
+            {
+                Interlocked.Exchange(ref _lastServerMessageTicks, DateTimeOffset.UtcNow.UtcTicks);
+                _heardFromServer = true;
+
+                switch (message.PayloadCase)
+                {
+                    case ServerMessage.PayloadOneofCase.Accepted:
+                        _window = new SemaphoreSlim(Math.Max(1, message.Accepted.MaxInFlight));
+                        _requestStream = call.RequestStream;
+                        _isConnected = true;
+                        _failoverManager.MarkServerAvailable();
+                        _logger.LogInformation(
+                            "Agent channel open to {ServerUrl} (max in flight {MaxInFlight})",
+                            _settings.CentralServerUrl, message.Accepted.MaxInFlight);
+                        break;
+
+                    case ServerMessage.PayloadOneofCase.Result:
+                        if (_pending.TryGetValue(message.Result.RequestId, out var completion))
+                            completion.TrySetResult(message.Result);
+                        break;
+
+                    case ServerMessage.PayloadOneofCase.Heartbeat:
+                        _failoverManager.MarkServerAvailable();
+                        break;
+
+                    case ServerMessage.PayloadOneofCase.Session:
+                        ApplySessionEvent(message.Session);
+                        break;
+                }
+            }
+        }
+        finally
+        {
+            _isConnected = false;
+            _requestStream = null;
+            callCts.Cancel();
+
+            // Requests still waiting on this stream fall back to the unary call
+            foreach (var completion in _pending.Values)
+                completion.TrySetCanceled();
+
+            try
+            {
+                await Task.WhenAll(heartbeat, reports);
+            }
+            catch (Exception)
+            {
+                // Cancelled with the call, or the stream broke mid-write
+            }
+        }
+    }
+
+    private async Task HeartbeatLoopAsync(IClientStreamWriter<AgentMessage> stream, CancellationTokenSource callCts)
+    {
+        var interval = TimeSpan.FromSeconds(_settings.HeartbeatIntervalSeconds);
+
+        while (!callCts.IsCancellationRequested)
+        {
+            await Task.Delay(interval, callCts.Token);
+
+            // Two intervals without any server message: treat the stream as dead even if the
+            // connection has not reported an error yet
+            var silence = DateTimeOffset.UtcNow.UtcTicks - Interlocked.Read(ref _lastServerMessageTicks);
+            if (silence > interval.Ticks * 2)
+            {
+                _logger.LogWarning("No message on agent channel for {Seconds}s, reconnecting",
+                    TimeSpan.FromTicks(silence).TotalSeconds);
+                _failoverManager.MarkServerUnavailable();
+                callCts.Cancel();
+                return;
+            }
+
+            await WriteAsync(stream, new AgentMessage
+            {
+                Heartbeat = new HeartbeatRequest
+                {
+                    AgentId = _settings.AgentId,
+                    ActiveSessions = _sessionCache.ActiveSessionCount
+                }
+            }, callCts.Token);
+        }
+    }
+
+    /// <summary>
+    /// Sends queued local decisions in batches while the stream is open. A batch being written
+    /// when the stream breaks is lost.
+    /// </summary>
+    private async Task ReportLocalDecisionsAsync(IClientStreamWriter<AgentMessage> stream, CancellationToken ct)
+    {
+        while (await _localDecisions.Reader.WaitToReadAsync(ct))
+        {
+            var batch = new AgentLocalDecisions();
+            while (batch.Decisions.Count < LocalDecisionBatchSize && _localDecisions.Reader.TryRead(out var decision))
+                batch.Decisions.Add(decision);
+
+            await WriteAsync(stream, new AgentMessage { LocalDecisions = batch }, ct);
+
+            var dropped = Interlocked.Exchange(ref _droppedLocalDecisions, 0);
+            if (dropped > 0)
+            {
+                _logger.LogWarning(
+                    "Dropped {Count} local decisions while the agent channel was down; they are missing from the server audit log",
+                    dropped);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Client stream writes must not overlap; evaluations and heartbeats share the stream.
+    /// </summary>
+    private async Task WriteAsync(IClientStreamWriter<AgentMessage> stream, AgentMessage message, CancellationToken ct)
+    {
+        await _writeLock.WaitAsync(ct);
+        try
+        {
+            await stream.WriteAsync(message);
+        }
+        finally
+        {
+            _writeLock.Release();
+        }
+    }
+}
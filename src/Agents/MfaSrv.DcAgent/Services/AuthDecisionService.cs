@@ -7,10 +7,20 @@ using MfaSrv.Core.ValueObjects;
 namespace MfaSrv.DcAgent.Services;
 
 /// <summary>
-/// Three-tier authentication decision engine:
-/// 1. Local session cache (fastest) → ALLOW if valid cached MFA session exists
-/// 2. Central Server gRPC call → authoritative decision
-/// 3. Local policy cache with failover mode → degraded-mode decision
+/// Tiered authentication decision engine. Every query is first counted by
+/// <see cref="SprayDetectionService"/>; then:
+/// 1. Local session cache (fastest) → ALLOW if valid cached MFA session exists; with
+///    partitioned sessions (<see cref="SessionPartitioner"/>) a miss on an agent that does not
+///    own the user is looked up at an owner in the same site
+/// 2. Flood detection → logons against flooded users are denied locally, or delayed and then
+///    evaluated as usual (<see cref="SprayDetectionSettings.Action"/>)
+/// 3. Local policy evaluation (<see cref="DcAgentSettings.LocalEvaluation"/>) → the server's
+///    policy engine run on the DC against the synced policies and replicated directory;
+///    ALLOW and DENY are final and reported to the server's audit log over the agent channel,
+///    only REQUIRE_MFA continues to the server to issue a challenge
+/// 4. Central Server gRPC call → authoritative decision (multiplexed on the agent channel
+///    when it is open, otherwise a unary call)
+/// 5. Local policy cache with failover mode → degraded-mode decision
 ///
 /// Failover modes (per-policy, with global default):
 /// - FAIL_OPEN:   allow auth, log for audit
@@ -20,21 +30,33 @@ namespace MfaSrv.DcAgent.Services;
 public class AuthDecisionService
 {
     private readonly SessionCacheService _sessionCache;
+    private readonly SessionPartitioner _partitioner;
     private readonly PolicyCacheService _policyCache;
+    private readonly DirectoryCacheService _directory;
+    private readonly SprayDetectionService _sprayDetection;
     private readonly FailoverManager _failoverManager;
+    private readonly AgentChannelClient _agentChannel;
     private readonly DcAgentSettings _settings;
     private readonly ILogger<AuthDecisionService> _logger;
 
     public AuthDecisionService(
         SessionCacheService sessionCache,
+        SessionPartitioner partitioner,
         PolicyCacheService policyCache,
+        DirectoryCacheService directory,
+        SprayDetectionService sprayDetection,
         FailoverManager failoverManager,
+        AgentChannelClient agentChannel,
         IOptions<DcAgentSettings> settings,
         ILogger<AuthDecisionService> logger)
     {
         _sessionCache = sessionCache;
+        _partitioner = partitioner;
         _policyCache = policyCache;
+        _directory = directory;
+        _sprayDetection = sprayDetection;
         _failoverManager = failoverManager;
+        _agentChannel = agentChannel;
         _settings = settings.Value;
         _logger = logger;
     }
@@ -43,8 +65,11 @@ public class AuthDecisionService
     {
         try
         {
+            var spray = _sprayDetection.Record(query.UserName, DateTimeOffset.UtcNow);
+
             // 1. Check session cache first (fastest path)
-            var cachedSession = _sessionCache.FindSession(query.UserName, query.SourceIp);
+            var cachedSession = _sessionCache.FindSession(query.UserName, query.SourceIp)
+                ?? await _partitioner.FindRemoteSessionAsync(query.UserName, query.SourceIp, ct);
             if (cachedSession != null)
             {
                 _logger.LogDebug(
@@ -59,15 +84,53 @@ public class AuthDecisionService
                 };
             }
 
-            // 2. Try Central Server if available
+            // 2. A session proves MFA; without one, act on flood detection
+            if (spray != SprayFlag.None)
+            {
+                if (_sprayDetection.DenyFlagged)
+                {
+                    return new AuthResponseMessage
+                    {
+                        Decision = AuthDecision.Deny,
+                        Reason = $"Blocked by spray detection ({spray})"
+                    };
+                }
+
+                // Stay well inside the pipe timeout, after which the LSA package fails open
+                var delay = Math.Min(_sprayDetection.ThrottleDelayMs, _settings.PipeTimeoutMs / 2);
+                if (delay > 0)
+                    await Task.Delay(delay, ct);
+            }
+
+            // 3. Evaluate locally when policies and directory are in sync with the server
+            var local = EvaluateLocally(query);
+            if (local != null && local.Decision != AuthDecision.RequireMfa)
+            {
+                _logger.Log(local.Decision == AuthDecision.Deny ? LogLevel.Warning : LogLevel.Debug,
+                    "Local decision for {User}@{Domain}: {Decision} ({Reason})",
+                    query.UserName, query.Domain, local.Decision, local.Reason);
+                _agentChannel.ReportLocalDecision(query, local, DateTimeOffset.UtcNow);
+
+                return new AuthResponseMessage
+                {
+                    Decision = local.Decision,
+                    Reason = $"Local evaluation: {local.Reason}"
+                };
+            }
+
+            // 4. Try Central Server if available
             if (_failoverManager.IsCentralServerAvailable)
             {
-                var serverResponse = await _failoverManager.EvaluateViaCentralServerAsync(query, ct);
+                var serverResponse = _agentChannel.IsConnected
+                    ? await _agentChannel.EvaluateAsync(query, ct)
+                    : null;
+                serverResponse ??= await _failoverManager.EvaluateViaCentralServerAsync(query, ct);
                 if (serverResponse != null)
                 {
-                    // Cache session tokens from successful Allow decisions
+                    // Cache session tokens from successful Allow decisions (on owners only when partitioned)
                     if (serverResponse.Decision == AuthDecision.Allow &&
-                        !string.IsNullOrEmpty(serverResponse.SessionToken))
+                        !string.IsNullOrEmpty(serverResponse.SessionToken) &&
+                        _partitioner.IsLocalOwner(query.UserName))
                     {
                         _sessionCache.AddOrUpdateSession(new CachedSession
                         {
@@ -85,12 +148,12 @@ public class AuthDecisionService
                 }
             }
 
-            // 3. Fallback to local policy evaluation with failover modes
+            // 5. Fallback to local policy evaluation with failover modes
             _logger.LogWarning(
                 "Central server unavailable for auth eval: {User}@{Domain} from {Ip} via {Protocol}",
                 query.UserName, query.Domain, query.SourceIp, query.Protocol);
 
-            return EvaluateWithFailoverMode(query);
+            return EvaluateWithFailoverMode(query, local?.FailoverMode);
         }
         catch (Exception ex)
         {
@@ -105,15 +168,44 @@ public class AuthDecisionService
         }
     }
 
+    /// <summary>
+    /// Runs the compiled policies against the replicated directory. Returns null when local
+    /// evaluation is off, this agent has not yet received policies and directory from the
+    /// server since it started, or a policy has a RiskScore rule.
+    /// </summary>
+    private PolicyEvaluationResult? EvaluateLocally(AuthQueryMessage query)
+    {
+        if (!_settings.LocalEvaluation || !_directory.IsLoaded || _policyCache.PolicyEpoch == null)
+            return null;
+
+        // Risk scores are only known to the server
+        var policies = _policyCache.CompiledPolicies;
+        if (policies.UsesRiskScore)
+            return null;
+
+        _directory.TryGetUser(query.UserName, out var groups, out var ou);
+
+        return policies.Evaluate(new AuthenticationContext
+        {
+            UserId = query.UserName,
+            UserName = query.UserName,
+            SourceIp = query.SourceIp,
+            Workstation = query.Workstation,
+            Protocol = query.Protocol,
+            UserGroups = groups,
+            UserOu = ou
+        });
+    }
+
     /// <summary>
     /// Evaluates authentication using local policy cache and failover modes
     /// when the Central Server is unreachable.
     /// </summary>
-    private AuthResponseMessage EvaluateWithFailoverMode(AuthQueryMessage query)
+    private AuthResponseMessage EvaluateWithFailoverMode(AuthQueryMessage query, FailoverMode? policyFailoverMode)
     {
-        // Determine effective failover mode. Check matching policies first,
-        // then fall back to the global agent setting.
-        var failoverMode = ResolveFailoverMode(query);
+        // Determine effective failover mode: the matched policy's when evaluated locally,
+        // otherwise the best match in the policy cache, then the global agent setting.
+        var failoverMode = policyFailoverMode ?? ResolveFailoverMode(query);
 
         _logger.LogInformation(
             "Failover decision for {User}@{Domain}: mode={FailoverMode}, server_down_since={DownSince}",
@@ -9,17 +9,20 @@ public class CentralServerClient : BackgroundService
 {
     private readonly FailoverManager _failoverManager;
     private readonly PolicyCacheService _policyCache;
+    private readonly AgentChannelClient _agentChannel;
     private readonly DcAgentSettings _settings;
     private readonly ILogger<CentralServerClient> _logger;
 
     public CentralServerClient(
         FailoverManager failoverManager,
         PolicyCacheService policyCache,
+        AgentChannelClient agentChannel,
         IOptions<DcAgentSettings> settings,
         ILogger<CentralServerClient> logger)
     {
         _failoverManager = failoverManager;
         _policyCache = policyCache;
+        _agentChannel = agentChannel;
         _settings = settings.Value;
         _logger = logger;
     }
@@ -35,7 +38,9 @@ public class CentralServerClient : BackgroundService
         {
             try
             {
-                await SendHeartbeatAsync(stoppingToken);
+                // While the agent channel is open its heartbeats and stream health take over
+                if (!_agentChannel.IsConnected)
+                    await SendHeartbeatAsync(stoppingToken);
             }
             catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
             {
@@ -0,0 +1,148 @@
+using Microsoft.Extensions.Logging;
+using MfaSrv.Protocol;
+
+namespace MfaSrv.DcAgent.Services;
+
+/// <summary>
+/// In-memory copy of the Central Server's user directory (user name, groups, OU) for local
+/// policy evaluation. Received in chunks over the policy sync stream and swapped in whole once
+/// the last chunk of a version has arrived, so lookups never see a partial directory.
+///
+/// Users are stored in flat arrays: an index by user name, each user's OU as an index into the
+/// OU table, and all group memberships in one array sliced per user. Not persisted: after a
+/// restart the agent requests the directory again and evaluates via the server until it has it.
+/// </summary>
+public class DirectoryCacheService
+{
+    private readonly ILogger<DirectoryCacheService> _logger;
+    private readonly object _assemblyLock = new();
+    private volatile Snapshot? _current;
+    private List<DirectoryChunk>? _pending;
+
+    public DirectoryCacheService(ILogger<DirectoryCacheService> logger)
+    {
+        _logger = logger;
+    }
+
+    /// <summary>
+    /// Version of the directory in use; null until one has been received.
+    /// </summary>
+    public string? Version => _current?.Version;
+
+    public bool IsLoaded => _current != null;
+
+    public int UserCount => _current?.Index.Count ?? 0;
+
+    /// <summary>
+    /// Adds one chunk of a directory snapshot. Chunks of the version already in use are ignored.
+    /// Returns false if the chunk does not continue the snapshot being received, in which case
+    /// the partial snapshot is discarded and the caller must resync.
+    /// </summary>
+    public bool ApplyChunk(DirectoryChunk chunk)
+    {
+        lock (_assemblyLock)
+        {
+            if (chunk.Version == _current?.Version)
+                return true;
+
+            if (chunk.Index == 0)
+            {
+                _pending = new List<DirectoryChunk>(chunk.Count);
+            }
+            else if (_pending == null || _pending.Count != chunk.Index || _pending[0].Version != chunk.Version)
+            {
+                _pending = null;
+                return false;
+            }
+
+            _pending.Add(chunk);
+            if (_pending.Count < chunk.Count)
+                return true;
+
+            var directory = Snapshot.Build(_pending);
+            _pending = null;
+            _current = directory;
+
+            _logger.LogInformation(
+                "Directory snapshot {Version} applied: {Users} users, {Groups} groups, {Ous} OUs",
+                directory.Version, directory.Index.Count, directory.Groups.Length, directory.Ous.Length);
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Looks up a user by sAMAccountName (case-sensitive, as on the server). An unknown user
+    /// has no groups and no OU, which is also how the server evaluates one.
+    /// </summary>
+    public bool TryGetUser(string userName, out IReadOnlyList<string> groups, out string? ou)
+    {
+        var directory = _current;
+        if (directory == null || !directory.Index.TryGetValue(userName, out var user))
+        {
+            groups = Array.Empty<string>();
+            ou = null;
+            return false;
+        }
+
+        var start = directory.GroupStart[user];
+        var names = new string[directory.GroupStart[user + 1] - start];
+        for (var i = 0; i < names.Length; i++)
+            names[i] = directory.Groups[directory.GroupIds[start + i]];
+
+        groups = names;
+        ou = directory.UserOu[user] > 0 ? directory.Ous[directory.UserOu[user] - 1] : null;
+        return true;
+    }
+
+    private sealed class Snapshot
+    {
+        public required string Version { get; init; }
+        public required Dictionary<string, int> Index { get; init; }
+        public required string[] Groups { get; init; }
+        public required string[] Ous { get; init; }
+        public required int[] UserOu { get; init; }
+        public required int[] GroupStart { get; init; }
+        public required int[] GroupIds { get; init; }
+
+        public static Snapshot Build(List<DirectoryChunk> chunks)
+        {
+            var first = chunks[0];
+            var groups = first.Groups.ToArray();
+            var ous = first.Ous.ToArray();
+            var userCount = chunks.Sum(c => c.Users.Count);
+
+            var index = new Dictionary<string, int>(userCount, StringComparer.Ordinal);
+            var userOu = new int[userCount];
+            var groupStart = new int[userCount + 1];
+            var groupIds = new int[chunks.Sum(c => c.Users.Sum(u => u.Groups.Count))];
+
+            var user = 0;
+            var membership = 0;
+            foreach (var entry in chunks.SelectMany(c => c.Users))
+            {
+                index[entry.UserName] = user;
+                userOu[user] = entry.Ou > 0 && entry.Ou <= ous.Length ? entry.Ou : 0;
+                groupStart[user] = membership;
+
+                foreach (var group in entry.Groups)
+                {
+                    if ((uint)group < (uint)groups.Length)
+                        groupIds[membership++] = group;
+                }
+                user++;
+            }
+            groupStart[user] = membership;
+
+            return new Snapshot
+            {
+                Version = first.Version,
+                Index = index,
+                Groups = groups,
+                Ous = ous,
+                UserOu = userOu,
+                GroupStart = groupStart,
+                GroupIds = groupIds
+            };
+        }
+    }
+}
@@ -48,27 +48,12 @@ public class FailoverManager
             using var channel = Grpc.Net.Client.GrpcChannel.ForAddress(_settings.CentralServerUrl);
             var client = new MfaService.MfaServiceClient(channel);
 
-            var request = new AuthEvaluationRequest
-            {
-                UserName = query.UserName,
-                Domain = query.Domain,
-                SourceIp = query.SourceIp ?? string.Empty,
-                Protocol = MapProtocol(query.Protocol),
-                AgentId = _settings.AgentId
-            };
-
-            var response = await client.EvaluateAuthenticationAsync(request, cancellationToken: ct);
+            var response = await client.EvaluateAuthenticationAsync(
+                ToRequest(query, _settings.AgentId), cancellationToken: ct);
 
             MarkServerAvailable();
 
-            return new AuthResponseMessage
-            {
-                Decision = MapDecision(response.Decision),
-                SessionToken = response.SessionToken,
-                ChallengeId = response.ChallengeId,
-                Reason = response.Reason,
-                TimeoutMs = response.TimeoutMs
-            };
+            return FromResponse(response);
         }
         catch (Exception ex)
         {
@@ -78,6 +63,25 @@ public class FailoverManager
         }
     }
 
+    internal static AuthEvaluationRequest ToRequest(AuthQueryMessage query, string agentId) => new()
+    {
+        UserName = query.UserName,
+        Domain = query.Domain,
+        SourceIp = query.SourceIp ?? string.Empty,
+        Workstation = query.Workstation ?? string.Empty,
+        Protocol = MapProtocol(query.Protocol),
+        AgentId = agentId
+    };
+
+    internal static AuthResponseMessage FromResponse(AuthEvaluationResponse response) => new()
+    {
+        Decision = MapDecision(response.Decision),
+        SessionToken = response.SessionToken,
+        ChallengeId = response.ChallengeId,
+        Reason = response.Reason,
+        TimeoutMs = response.TimeoutMs
+    };
+
     private static AuthProtocolType MapProtocol(AuthProtocol protocol) => protocol switch
     {
         AuthProtocol.Kerberos => AuthProtocolType.AuthProtocolKerberos,
@@ -87,6 +91,15 @@ public class FailoverManager
         _ => AuthProtocolType.AuthProtocolUnknown
     };
 
+    internal static AuthDecisionType ToProto(AuthDecision decision) => decision switch
+    {
+        AuthDecision.Allow => AuthDecisionType.AuthDecisionAllow,
+        AuthDecision.RequireMfa => AuthDecisionType.AuthDecisionRequireMfa,
+        AuthDecision.Deny => AuthDecisionType.AuthDecisionDeny,
+        AuthDecision.Pending => AuthDecisionType.AuthDecisionPending,
+        _ => AuthDecisionType.AuthDecisionAllow
+    };
+
     private static AuthDecision MapDecision(AuthDecisionType decision) => decision switch
     {
         AuthDecisionType.AuthDecisionAllow => AuthDecision.Allow,
@@ -9,16 +9,22 @@ namespace MfaSrv.DcAgent.Services;
 public class GossipService : BackgroundService
 {
     private readonly SessionCacheService _sessionCache;
+    private readonly SessionPartitioner _partitioner;
     private readonly DcAgentSettings _settings;
+    private readonly SessionPartitioningSettings _partitioningSettings;
     private readonly ILogger<GossipService> _logger;
 
     public GossipService(
         SessionCacheService sessionCache,
+        SessionPartitioner partitioner,
         IOptions<DcAgentSettings> settings,
+        IOptions<SessionPartitioningSettings> partitioningSettings,
         ILogger<GossipService> logger)
     {
         _sessionCache = sessionCache;
+        _partitioner = partitioner;
         _settings = settings.Value;
+        _partitioningSettings = partitioningSettings.Value;
         _logger = logger;
     }
 
@@ -65,11 +71,16 @@ public class GossipService : BackgroundService
                 var request = new SyncSessionsRequest
                 {
                     SenderAgentId = _settings.AgentId,
+                    SenderUrl = _partitioner.IsEnabled ? _partitioningSettings.SelfUrl : string.Empty,
                     Since = Timestamp.FromDateTimeOffset(DateTimeOffset.UtcNow.AddMinutes(-10))
                 };
 
+                // With partitioning, each peer only gets the sessions it owns
                 foreach (var session in _sessionCache.GetAllSessions())
                 {
+                    if (!_partitioner.IsOwnedBy(peerUrl, session.UserName))
+                        continue;
+
                     request.Sessions.Add(new SessionEntry
                     {
                         SessionId = session.SessionId,
@@ -92,7 +103,7 @@ public class GossipService : BackgroundService
                     {
                         _sessionCache.RevokeSession(entry.SessionId);
                     }
-                    else
+                    else if (_partitioner.IsLocalOwner(entry.UserName))
                     {
                         var existing = _sessionCache.FindSession(entry.UserName, entry.SourceIp);
                         if (existing == null || existing.SessionId != entry.SessionId)
@@ -1,7 +1,7 @@
+using System.Buffers;
 using System.IO.Pipes;
 using System.Security.AccessControl;
 using System.Security.Principal;
-using System.Text;
 using System.Text.Json;
 using Microsoft.Extensions.Hosting;
 using Microsoft.Extensions.Logging;
@@ -12,6 +12,9 @@ namespace MfaSrv.DcAgent.Services;
 
 public class NamedPipeServer : BackgroundService
 {
+    private const int PipeBufferSize = 4096;
+    private const int MaxMessageSize = 64 * 1024;
+
     private readonly AuthDecisionService _authDecision;
     private readonly DcAgentSettings _settings;
     private readonly ILogger<NamedPipeServer> _logger;
@@ -50,7 +53,7 @@ public class NamedPipeServer : BackgroundService
                     NamedPipeServerStream.MaxAllowedServerInstances,
                     PipeTransmissionMode.Message,
                     PipeOptions.Asynchronous,
-                    4096, 4096,
+                    PipeBufferSize, PipeBufferSize,
                     pipeSecurity);
 
                 await pipeServer.WaitForConnectionAsync(stoppingToken);
@@ -79,17 +82,19 @@ public class NamedPipeServer : BackgroundService
                 using var cts = CancellationTokenSource.CreateLinkedTokenSource(ct);
                 cts.CancelAfter(_settings.PipeTimeoutMs);
 
-                // Read the query
-                var buffer = new byte[4096];
-                var bytesRead = await pipe.ReadAsync(buffer, cts.Token);
-
-                if (bytesRead == 0) return;
-
-                var json = Encoding.UTF8.GetString(buffer, 0, bytesRead);
-                var query = JsonSerializer.Deserialize<AuthQueryMessage>(json, new JsonSerializerOptions
+                // Read the query into a pooled buffer and deserialize straight from UTF-8
+                var (buffer, length) = await ReadMessageAsync(pipe, cts.Token);
+                AuthQueryMessage? query;
+                try
                 {
-                    PropertyNameCaseInsensitive = true
-                });
+                    if (length == 0) return;
+                    query = JsonSerializer.Deserialize(
+                        buffer.AsSpan(0, length), NamedPipeJsonContext.Default.AuthQueryMessage);
+                }
+                finally
+                {
+                    ArrayPool<byte>.Shared.Return(buffer);
+                }
 
                 if (query == null)
                 {
@@ -102,13 +107,9 @@ public class NamedPipeServer : BackgroundService
                 // Get decision
                 var response = await _authDecision.EvaluateAsync(query, cts.Token);
 
-                // Send response
-                var responseJson = JsonSerializer.Serialize(response, new JsonSerializerOptions
-                {
-                    PropertyNamingPolicy = JsonNamingPolicy.CamelCase
-                });
-                var responseBytes = Encoding.UTF8.GetBytes(responseJson);
-                await pipe.WriteAsync(responseBytes, cts.Token);
+                // Send response (serialized into a pooled buffer and written as a single pipe message)
+                await JsonSerializer.SerializeAsync(
+                    pipe, response, NamedPipeJsonContext.Default.AuthResponseMessage, cts.Token);
                 await pipe.FlushAsync(cts.Token);
             }
         }
@@ -121,4 +122,43 @@ public class NamedPipeServer : BackgroundService
             _logger.LogError(ex, "Error handling named pipe connection");
         }
     }
+
+    /// <summary>
+    /// Reads one complete pipe message into a buffer rented from <see cref="ArrayPool{T}.Shared"/>,
+    /// growing it while the message is incomplete. The caller must return the buffer to the pool.
+    /// </summary>
+    private static async ValueTask<(byte[] Buffer, int Length)> ReadMessageAsync(PipeStream pipe, CancellationToken ct)
+    {
+        var buffer = ArrayPool<byte>.Shared.Rent(PipeBufferSize);
+        var length = 0;
+
+        try
+        {
+            do
+            {
+                if (length == buffer.Length)
+                {
+                    if (buffer.Length >= MaxMessageSize)
+                        throw new InvalidDataException($"Pipe message exceeds {MaxMessageSize} bytes");
+
+                    var larger = ArrayPool<byte>.Shared.Rent(buffer.Length * 2);
+                    buffer.AsSpan(0, length).CopyTo(larger);
+                    ArrayPool<byte>.Shared.Return(buffer);
+                    buffer = larger;
+                }
+
+                var bytesRead = await pipe.ReadAsync(buffer.AsMemory(length), ct);
+                if (bytesRead == 0) break;
+                length += bytesRead;
+            }
+            while (!pipe.IsMessageComplete);
+
+            return (buffer, length);
+        }
+        catch
+        {
+            ArrayPool<byte>.Shared.Return(buffer);
+            throw;
+        }
+    }
 }
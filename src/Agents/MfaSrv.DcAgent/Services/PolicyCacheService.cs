@@ -1,6 +1,10 @@
 using System.Collections.Concurrent;
+using System.Text.Json;
+using System.Text.Json.Serialization;
 using Microsoft.Extensions.Logging;
+using MfaSrv.Core.Entities;
 using MfaSrv.Core.Enums;
+using MfaSrv.Core.Policies;
 
 namespace MfaSrv.DcAgent.Services;
 
@@ -17,10 +21,21 @@ public class CachedPolicy
 
 public class PolicyCacheService
 {
+    private static readonly JsonSerializerOptions PolicyJsonOptions = new()
+    {
+        PropertyNameCaseInsensitive = true,
+        Converters = { new JsonStringEnumConverter() }
+    };
+
     private readonly ConcurrentDictionary<string, CachedPolicy> _policies = new();
+    private long _generation;
+    private volatile CompiledSet? _compiled;
     private readonly ILogger<PolicyCacheService> _logger;
     private readonly SqliteCacheStore _store;
     private FailoverMode _defaultFailoverMode = FailoverMode.FailOpen;
+    private readonly object _versionLock = new();
+    private string? _policyEpoch;
+    private ulong _policyVersion;
 
     public PolicyCacheService(ILogger<PolicyCacheService> logger, SqliteCacheStore store)
     {
@@ -62,6 +77,7 @@ public class PolicyCacheService
     public void UpdatePolicy(CachedPolicy policy)
     {
         _policies.AddOrUpdate(policy.PolicyId, policy, (_, _) => policy);
+        Interlocked.Increment(ref _generation);
         _logger.LogDebug("Updated cached policy {PolicyId}: {Name}", policy.PolicyId, policy.Name);
 
         // Fire-and-forget persistence to avoid blocking the hot path
@@ -71,12 +87,85 @@ public class PolicyCacheService
     public void RemovePolicy(string policyId)
     {
         _policies.TryRemove(policyId, out _);
+        Interlocked.Increment(ref _generation);
         _logger.LogDebug("Removed cached policy {PolicyId}", policyId);
 
         // Fire-and-forget persistence
         _ = PersistRemovePolicyAsync(policyId);
     }
 
+    /// <summary>
+    /// Replaces the cached policy set with a snapshot from the server. Policies missing from
+    /// the snapshot were deleted or disabled while the agent was disconnected; unchanged
+    /// policies are not re-persisted.
+    /// </summary>
+    public void ApplySnapshot(string epoch, ulong version, IReadOnlyCollection<CachedPolicy> policies)
+    {
+        lock (_versionLock)
+        {
+            var ids = new HashSet<string>(policies.Select(p => p.PolicyId));
+            foreach (var policyId in _policies.Keys)
+            {
+                if (!ids.Contains(policyId))
+                    RemovePolicy(policyId);
+            }
+
+            foreach (var policy in policies)
+            {
+                if (!_policies.TryGetValue(policy.PolicyId, out var existing) || existing.PolicyJson != policy.PolicyJson)
+                    UpdatePolicy(policy);
+            }
+
+            _policyEpoch = epoch;
+            _policyVersion = version;
+        }
+
+        _logger.LogInformation("Applied policy snapshot v{Version}: {Count} policies", version, policies.Count);
+    }
+
+    /// <summary>
+    /// Applies one policy change (<paramref name="policy"/> null for a removal) on top of the
+    /// current version. Returns false if the change does not follow the current version, in
+    /// which case the caller must resync; an already applied version is ignored.
+    /// </summary>
+    public bool ApplyChange(string epoch, ulong version, string policyId, CachedPolicy? policy)
+    {
+        lock (_versionLock)
+        {
+            if (epoch != _policyEpoch)
+                return false;
+            if (version <= _policyVersion)
+                return true;
+            if (version != _policyVersion + 1)
+                return false;
+
+            if (policy == null)
+                RemovePolicy(policyId);
+            else
+                UpdatePolicy(policy);
+
+            _policyVersion = version;
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Server epoch of <see cref="PolicyVersion"/>; null until the first snapshot. Not persisted:
+    /// after a restart the agent takes one snapshot, which also drops policies deleted meanwhile.
+    /// </summary>
+    public string? PolicyEpoch
+    {
+        get { lock (_versionLock) return _policyEpoch; }
+    }
+
+    /// <summary>
+    /// Policy-set version last applied from the server.
+    /// </summary>
+    public ulong PolicyVersion
+    {
+        get { lock (_versionLock) return _policyVersion; }
+    }
+
     public IReadOnlyList<CachedPolicy> GetPolicies()
     {
         return _policies.Values
@@ -85,6 +174,46 @@ public class PolicyCacheService
             .ToList();
     }
 
+    /// <summary>
+    /// The cached policies compiled for local evaluation; recompiled on first use after a change.
+    /// </summary>
+    public CompiledPolicySet CompiledPolicies
+    {
+        get
+        {
+            // Read the generation before compiling: a change made during compilation bumps it,
+            // so the next caller compiles again
+            var generation = Interlocked.Read(ref _generation);
+            var compiled = _compiled;
+            if (compiled == null || compiled.Generation != generation)
+            {
+                compiled = new CompiledSet(generation, Compile());
+                _compiled = compiled;
+            }
+            return compiled.Policies;
+        }
+    }
+
+    private CompiledPolicySet Compile()
+    {
+        var policies = new List<Policy>();
+        foreach (var cached in _policies.Values.Where(p => p.IsEnabled))
+        {
+            try
+            {
+                var policy = JsonSerializer.Deserialize<Policy>(cached.PolicyJson, PolicyJsonOptions);
+                if (policy != null)
+                    policies.Add(policy);
+            }
+            catch (JsonException ex)
+            {
+                _logger.LogWarning(ex, "Cached policy {PolicyId} could not be parsed and is not evaluated locally", cached.PolicyId);
+            }
+        }
+
+        return CompiledPolicySet.Compile(policies);
+    }
+
     public FailoverMode GetEffectiveFailoverMode(string? userName = null)
     {
         // Check if any policy explicitly sets a failover mode for this context
@@ -156,4 +285,6 @@ public class PolicyCacheService
             _logger.LogWarning(ex, "Failed to persist metadata key {Key} to SQLite", key);
         }
     }
+
+    private sealed record CompiledSet(long Generation, CompiledPolicySet Policies);
 }
@@ -16,6 +16,8 @@ namespace MfaSrv.DcAgent.Services;
 public class PolicySyncClient : BackgroundService
 {
     private readonly PolicyCacheService _policyCache;
+    private readonly SessionCacheService _sessionCache;
+    private readonly DirectoryCacheService _directory;
     private readonly FailoverManager _failoverManager;
     private readonly DcAgentSettings _settings;
     private readonly ILogger<PolicySyncClient> _logger;
@@ -25,11 +27,15 @@ public class PolicySyncClient : BackgroundService
 
     public PolicySyncClient(
         PolicyCacheService policyCache,
+        SessionCacheService sessionCache,
+        DirectoryCacheService directory,
         FailoverManager failoverManager,
         IOptions<DcAgentSettings> settings,
         ILogger<PolicySyncClient> logger)
     {
         _policyCache = policyCache;
+        _sessionCache = sessionCache;
+        _directory = directory;
         _failoverManager = failoverManager;
         _settings = settings.Value;
         _logger = logger;
@@ -90,13 +96,18 @@ public class PolicySyncClient : BackgroundService
             AgentId = _settings.AgentId,
             LastSync = _policyCache.LastSyncTime.HasValue
                 ? Timestamp.FromDateTimeOffset(_policyCache.LastSyncTime.Value)
-                : Timestamp.FromDateTimeOffset(DateTimeOffset.MinValue)
+                : Timestamp.FromDateTimeOffset(DateTimeOffset.MinValue),
+            Epoch = _policyCache.PolicyEpoch ?? string.Empty,
+            LastVersion = _policyCache.PolicyVersion,
+            WantDirectory = _settings.LocalEvaluation,
+            DirectoryVersion = _directory.Version ?? string.Empty
         };
 
         _logger.LogInformation(
-            "Opening policy sync stream to {ServerUrl} (last_sync={LastSync})",
+            "Opening policy sync stream to {ServerUrl} (epoch={Epoch}, last_version={LastVersion})",
             _settings.CentralServerUrl,
-            _policyCache.LastSyncTime);
+            request.Epoch,
+            request.LastVersion);
 
         using var stream = client.SyncPolicies(request, cancellationToken: ct);
 
@@ -107,27 +118,55 @@ public class PolicySyncClient : BackgroundService
 
         await foreach (var update in stream.ResponseStream.ReadAllAsync(ct))
         {
-            if (update.Deleted)
+            if (update.RevocationFilter != null)
             {
-                _policyCache.RemovePolicy(update.PolicyId);
-                _logger.LogInformation("Policy {PolicyId} removed via sync stream", update.PolicyId);
+                if (!ApplyRevocationFilter(update.RevocationFilter))
+                {
+                    // Ending the call makes ExecuteAsync reconnect immediately and receive a fresh snapshot
+                    _logger.LogWarning(
+                        "Revocation filter delta v{Version} could not be applied (local v{LocalVersion}), resyncing",
+                        update.RevocationFilter.Version, _sessionCache.RevocationFilterVersion);
+                    return;
+                }
+                continue;
+            }
+
+            if (update.Directory != null)
+            {
+                if (!_directory.ApplyChunk(update.Directory))
+                {
+                    _logger.LogWarning(
+                        "Directory chunk {Index}/{Count} of {Version} arrived out of order, resyncing",
+                        update.Directory.Index + 1, update.Directory.Count, update.Directory.Version);
+                    return;
+                }
+                continue;
+            }
+
+            if (update.Snapshot != null)
+            {
+                _policyCache.ApplySnapshot(update.Epoch, update.Version, update.Snapshot.Policies
+                    .Select(entry => ToCachedPolicy(entry.PolicyId, entry.PolicyJson, entry.UpdatedAt))
+                    .ToList());
             }
             else
             {
-                var policyName = ExtractPolicyName(update.PolicyJson, update.PolicyId);
+                var policy = update.Deleted
+                    ? null
+                    : ToCachedPolicy(update.PolicyId, update.PolicyJson, update.UpdatedAt);
 
-                _policyCache.UpdatePolicy(new CachedPolicy
+                if (!_policyCache.ApplyChange(update.Epoch, update.Version, update.PolicyId, policy))
                 {
-                    PolicyId = update.PolicyId,
-                    Name = policyName,
-                    PolicyJson = update.PolicyJson,
-                    IsEnabled = true,
-                    UpdatedAt = update.UpdatedAt.ToDateTimeOffset()
-                });
+                    // Reconnecting with the last applied version fetches exactly the missing changes
+                    _logger.LogWarning(
+                        "Policy change v{Version} does not follow local v{LocalVersion}, resyncing",
+                        update.Version, _policyCache.PolicyVersion);
+                    return;
+                }
 
                 _logger.LogInformation(
-                    "Policy {PolicyId} ({PolicyName}) updated via sync stream",
-                    update.PolicyId, policyName);
+                    "Policy {PolicyId} {Action} via sync stream (v{Version})",
+                    update.PolicyId, update.Deleted ? "removed" : "updated", update.Version);
             }
 
             _policyCache.LastSyncTime = DateTimeOffset.UtcNow;
@@ -146,6 +185,32 @@ public class PolicySyncClient : BackgroundService
             updateCount);
     }
 
+    private static CachedPolicy ToCachedPolicy(string policyId, string policyJson, Timestamp? updatedAt) => new()
+    {
+        PolicyId = policyId,
+        Name = ExtractPolicyName(policyJson, policyId),
+        PolicyJson = policyJson,
+        IsEnabled = true,
+        UpdatedAt = updatedAt?.ToDateTimeOffset() ?? DateTimeOffset.UtcNow
+    };
+
+    private bool ApplyRevocationFilter(RevocationFilterUpdate update)
+    {
+        if (!update.Snapshot)
+            return _sessionCache.ApplyRevocationFilterDelta(update.Version, update.Added, update.Removed);
+
+        try
+        {
+            _sessionCache.ApplyRevocationFilterSnapshot(update.Version, update.Filter.Span);
+            return true;
+        }
+        catch (FormatException ex)
+        {
+            _logger.LogError(ex, "Received malformed revocation filter snapshot v{Version}", update.Version);
+            return false;
+        }
+    }
+
     /// <summary>
     /// Attempts to extract the policy name from the JSON payload.
     /// Falls back to the policy ID if parsing fails.
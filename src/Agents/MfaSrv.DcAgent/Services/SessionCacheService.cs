@@ -1,5 +1,5 @@
-using System.Collections.Concurrent;
 using Microsoft.Extensions.Logging;
+using MfaSrv.Core.Collections;
 
 namespace MfaSrv.DcAgent.Services;
 
@@ -14,16 +14,30 @@ public class CachedSession
     public bool Revoked { get; set; }
 }
 
+/// <summary>
+/// The agent's MFA sessions, held in a compact <see cref="SessionTable"/> and persisted to
+/// SQLite. Sessions are read out as <see cref="CachedSession"/> snapshots; changes go through
+/// this service.
+/// </summary>
 public class SessionCacheService
 {
-    private readonly ConcurrentDictionary<string, CachedSession> _sessions = new();
+    private readonly object _sessionsLock = new();
+    private readonly SessionTable _sessions = new();
+    private readonly Func<ulong, bool> _isRevokedByFilter;
     private readonly ILogger<SessionCacheService> _logger;
     private readonly SqliteCacheStore _store;
 
+    // Revocation filter replicated from the Central Server over the policy sync stream.
+    // Null until the first snapshot arrives; lookups then behave as before.
+    private readonly object _revocationFilterLock = new();
+    private CuckooFilter? _revocationFilter;
+    private ulong _revocationFilterVersion;
+
     public SessionCacheService(ILogger<SessionCacheService> logger, SqliteCacheStore store)
     {
         _logger = logger;
         _store = store;
+        _isRevokedByFilter = IsRevokedByFilter;
     }
 
     /// <summary>
@@ -35,9 +49,10 @@ public class SessionCacheService
         try
         {
             var sessions = await _store.LoadAllSessionsAsync();
-            foreach (var session in sessions)
+            lock (_sessionsLock)
             {
-                _sessions.TryAdd(session.SessionId, session);
+                foreach (var session in sessions)
+                    _sessions.Upsert(session);
             }
 
             _logger.LogInformation(
@@ -52,25 +67,18 @@ public class SessionCacheService
 
     public CachedSession? FindSession(string userName, string? sourceIp)
     {
-        var now = DateTimeOffset.UtcNow;
-
-        foreach (var session in _sessions.Values)
+        lock (_sessionsLock)
         {
-            if (session.UserName.Equals(userName, StringComparison.OrdinalIgnoreCase)
-                && (sourceIp == null || session.SourceIp == sourceIp)
-                && session.ExpiresAt > now
-                && !session.Revoked)
-            {
-                return session;
-            }
+            return _sessions.TryFindByUser(userName, sourceIp, DateTimeOffset.UtcNow, _isRevokedByFilter, out var handle)
+                ? _sessions.Get(handle)
+                : null;
         }
-
-        return null;
     }
 
     public void AddOrUpdateSession(CachedSession session)
     {
-        _sessions.AddOrUpdate(session.SessionId, session, (_, _) => session);
+        lock (_sessionsLock)
+            _sessions.Upsert(session);
         _logger.LogDebug("Cached session {SessionId} for {UserName}", session.SessionId, session.UserName);
 
         // Fire-and-forget persistence to avoid blocking the hot path
@@ -79,36 +87,163 @@ public class SessionCacheService
 
     public bool RevokeSession(string sessionId)
     {
-        if (_sessions.TryGetValue(sessionId, out var session))
+        CachedSession? session;
+        lock (_sessionsLock)
         {
-            session.Revoked = true;
-            _logger.LogInformation("Revoked cached session {SessionId}", sessionId);
+            if (!_sessions.TryFind(sessionId, out var handle))
+                return false;
 
-            // Fire-and-forget persistence — save the updated revoked state
-            _ = PersistSaveSessionAsync(session);
-            return true;
+            _sessions.SetRevoked(handle);
+            session = _sessions.Get(handle);
+        }
+
+        _logger.LogInformation("Revoked cached session {SessionId}", sessionId);
+
+        // Fire-and-forget persistence — save the updated revoked state
+        _ = PersistSaveSessionAsync(session!);
+        return true;
+    }
+
+    public ulong RevocationFilterVersion
+    {
+        get { lock (_revocationFilterLock) return _revocationFilterVersion; }
+    }
+
+    /// <summary>
+    /// Replaces the revocation filter with a snapshot from the Central Server and revokes
+    /// any cached sessions it contains.
+    /// </summary>
+    /// <exception cref="FormatException">The snapshot is not a valid filter.</exception>
+    public void ApplyRevocationFilterSnapshot(ulong version, ReadOnlySpan<byte> filter)
+    {
+        var parsed = CuckooFilter.FromBytes(filter);
+
+        lock (_revocationFilterLock)
+        {
+            _revocationFilter = parsed;
+            _revocationFilterVersion = version;
+        }
+
+        _logger.LogInformation(
+            "Revocation filter snapshot v{Version} applied ({Count} revoked sessions)",
+            version, parsed.Count);
+
+        RevokeSessionsInFilter();
+    }
+
+    /// <summary>
+    /// Applies a revocation filter delta. Deltas at or below the current version are ignored.
+    /// Returns false when the delta cannot be applied (no snapshot yet, a version gap, or the
+    /// filter is full); the caller must then resync to get a fresh snapshot.
+    /// </summary>
+    public bool ApplyRevocationFilterDelta(ulong version, IReadOnlyCollection<ulong> added, IReadOnlyCollection<ulong> removed)
+    {
+        lock (_revocationFilterLock)
+        {
+            if (_revocationFilter == null)
+                return false;
+            if (version <= _revocationFilterVersion)
+                return true;
+            if (version != _revocationFilterVersion + 1)
+                return false;
+
+            foreach (var hash in removed)
+                _revocationFilter.Remove(hash);
+
+            foreach (var hash in added)
+            {
+                if (!_revocationFilter.Add(hash))
+                    return false;
+            }
+
+            _revocationFilterVersion = version;
         }
-        return false;
+
+        if (added.Count > 0)
+            RevokeSessionsInFilter();
+
+        return true;
     }
 
     public void CleanupExpired()
     {
         var now = DateTimeOffset.UtcNow;
-        var expired = _sessions.Where(kv => kv.Value.ExpiresAt < now || kv.Value.Revoked).Select(kv => kv.Key).ToList();
-
-        foreach (var key in expired)
-            _sessions.TryRemove(key, out _);
+        var expired = 0;
+        lock (_sessionsLock)
+        {
+            foreach (var handle in _sessions.Handles())
+            {
+                if (_sessions.GetExpiresAt(handle) < now || _sessions.IsRevoked(handle))
+                {
+                    _sessions.Remove(handle);
+                    expired++;
+                }
+            }
+        }
 
-        if (expired.Count > 0)
-            _logger.LogDebug("Cleaned up {Count} expired/revoked sessions from cache", expired.Count);
+        if (expired > 0)
+            _logger.LogDebug("Cleaned up {Count} expired/revoked sessions from cache", expired);
 
         // Fire-and-forget cleanup in SQLite as well
         _ = PersistCleanupExpiredAsync();
     }
 
-    public int ActiveSessionCount => _sessions.Count(kv => kv.Value.ExpiresAt > DateTimeOffset.UtcNow && !kv.Value.Revoked);
+    public int ActiveSessionCount
+    {
+        get
+        {
+            var now = DateTimeOffset.UtcNow;
+            lock (_sessionsLock)
+                return _sessions.Handles().Count(h => _sessions.GetExpiresAt(h) > now && !_sessions.IsRevoked(h));
+        }
+    }
+
+    /// <summary>
+    /// Snapshot of all cached sessions, including expired and revoked ones not yet cleaned up.
+    /// </summary>
+    public IReadOnlyList<CachedSession> GetAllSessions()
+    {
+        lock (_sessionsLock)
+            return _sessions.Handles().Select(h => _sessions.Get(h)!).ToList();
+    }
+
+    /// <summary>
+    /// Approximate memory held by the in-memory session table.
+    /// </summary>
+    public long MemoryBytes
+    {
+        get { lock (_sessionsLock) return _sessions.MemoryBytes; }
+    }
 
-    public IEnumerable<CachedSession> GetAllSessions() => _sessions.Values;
+    // A false positive (~0.012%) only costs the affected user a fresh MFA prompt
+    private bool IsRevokedByFilter(ulong sessionIdHash)
+    {
+        lock (_revocationFilterLock)
+            return _revocationFilter != null && _revocationFilter.Contains(sessionIdHash);
+    }
+
+    // Makes filter hits sticky so a session stays revoked after the server prunes its entry
+    private void RevokeSessionsInFilter()
+    {
+        var revoked = new List<CachedSession>();
+        lock (_sessionsLock)
+        {
+            foreach (var handle in _sessions.Handles())
+            {
+                if (!_sessions.IsRevoked(handle) && IsRevokedByFilter(_sessions.GetIdHash(handle)))
+                {
+                    _sessions.SetRevoked(handle);
+                    revoked.Add(_sessions.Get(handle)!);
+                }
+            }
+        }
+
+        foreach (var session in revoked)
+        {
+            _logger.LogInformation("Revoked cached session {SessionId}", session.SessionId);
+            _ = PersistSaveSessionAsync(session);
+        }
+    }
 
     // ─── Private persistence helpers (fire-and-forget) ───────────────────
 
@@ -0,0 +1,174 @@
+using System.Collections.Concurrent;
+using Grpc.Core;
+using Grpc.Net.Client;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Collections;
+using MfaSrv.Protocol.Gossip;
+
+namespace MfaSrv.DcAgent.Services;
+
+/// <summary>
+/// Decides which DC Agents hold a session when <see cref="SessionPartitioningSettings.Enabled"/>
+/// is set. The agents of each site form a consistent-hash ring keyed by user name, and a
+/// session is held by the first <see cref="SessionPartitioningSettings.Replicas"/> agents of
+/// the ring in every site, so each agent holds about Replicas / (agents in site) of the
+/// sessions instead of all of them. Gossip and server pushes only deliver sessions to their
+/// owners; an agent that does not own a user asks that user's owners in its own site (one hop)
+/// when a logon misses its local cache.
+///
+/// Every agent must list the same peers and sites so that all rings agree. When partitioning
+/// is off every method answers as if this agent owned everything.
+/// </summary>
+public class SessionPartitioner : IDisposable
+{
+    private readonly SessionPartitioningSettings _settings;
+    private readonly DcAgentSettings _agentSettings;
+    private readonly ILogger<SessionPartitioner> _logger;
+    private readonly Dictionary<string, HashRing> _ringBySite = new(StringComparer.OrdinalIgnoreCase);
+    private readonly Dictionary<string, string> _siteByAgent = new(StringComparer.Ordinal);
+    private readonly ConcurrentDictionary<string, GrpcChannel> _channels = new(StringComparer.Ordinal);
+    private readonly HashRing? _localRing;
+
+    public SessionPartitioner(
+        IOptions<SessionPartitioningSettings> settings,
+        IOptions<DcAgentSettings> agentSettings,
+        ILogger<SessionPartitioner> logger)
+    {
+        _settings = settings.Value;
+        _agentSettings = agentSettings.Value;
+        _logger = logger;
+
+        if (!_settings.Enabled)
+            return;
+
+        if (string.IsNullOrWhiteSpace(_settings.SelfUrl))
+        {
+            _logger.LogWarning("Session partitioning requires SessionPartitioning:SelfUrl; holding all sessions instead");
+            return;
+        }
+
+        _siteByAgent[_settings.SelfUrl] = _settings.Site;
+        foreach (var peer in _agentSettings.GossipPeers)
+            _siteByAgent[peer] = _settings.Site;
+        foreach (var (site, peers) in _settings.PeerSites)
+        {
+            foreach (var peer in peers)
+            {
+                if (_siteByAgent.ContainsKey(peer) && peer != _settings.SelfUrl)
+                    _siteByAgent[peer] = site;
+            }
+        }
+
+        foreach (var site in _siteByAgent.GroupBy(a => a.Value, StringComparer.OrdinalIgnoreCase))
+        {
+            _ringBySite[site.Key] = new HashRing(site.Select(a => a.Key), _settings.VirtualNodes);
+        }
+
+        _localRing = _ringBySite[_settings.Site];
+        IsEnabled = true;
+
+        _logger.LogInformation(
+            "Session partitioning enabled: {Agents} agents in site {Site}, {Sites} sites, {Replicas} replicas",
+            _localRing.Nodes.Count, _settings.Site, _ringBySite.Count, _settings.Replicas);
+    }
+
+    /// <summary>
+    /// True when sessions are partitioned, i.e. partitioning is enabled and configured.
+    /// </summary>
+    public bool IsEnabled { get; }
+
+    /// <summary>
+    /// Ring position of a user; case-insensitive like the session cache.
+    /// </summary>
+    public static ulong KeyOf(string userName) => CuckooFilter.Hash(userName.ToLowerInvariant());
+
+    /// <summary>
+    /// True if this agent holds the sessions of <paramref name="userName"/>.
+    /// </summary>
+    public bool IsLocalOwner(string userName) =>
+        _localRing == null || _localRing.IsOwner(KeyOf(userName), _settings.Replicas, _settings.SelfUrl);
+
+    /// <summary>
+    /// True if the agent at <paramref name="agentUrl"/> holds the sessions of
+    /// <paramref name="userName"/> in its own site. Agents missing from the configuration
+    /// (including older agents that do not send their URL) are sent everything.
+    /// </summary>
+    public bool IsOwnedBy(string? agentUrl, string userName)
+    {
+        if (_localRing == null || string.IsNullOrEmpty(agentUrl) ||
+            !_siteByAgent.TryGetValue(agentUrl, out var site))
+            return true;
+
+        return _ringBySite[site].IsOwner(KeyOf(userName), _settings.Replicas, agentUrl);
+    }
+
+    /// <summary>
+    /// Agents in this site that hold the sessions of <paramref name="userName"/>, primary first.
+    /// </summary>
+    public IReadOnlyList<string> GetLocalOwners(string userName) =>
+        _localRing == null ? Array.Empty<string>() : _localRing.GetOwners(KeyOf(userName), _settings.Replicas);
+
+    /// <summary>
+    /// Asks the owners of <paramref name="userName"/> in this site for a valid session, in ring
+    /// order, within <see cref="SessionPartitioningSettings.LookupTimeoutMs"/>. The first owner
+    /// that answers is authoritative. Returns null when partitioning is off, this agent is an
+    /// owner (so its own cache already answered), or no owner could be reached.
+    /// </summary>
+    public async Task<CachedSession?> FindRemoteSessionAsync(string userName, string? sourceIp, CancellationToken ct = default)
+    {
+        if (_localRing == null || IsLocalOwner(userName))
+            return null;
+
+        using var timeout = CancellationTokenSource.CreateLinkedTokenSource(ct);
+        timeout.CancelAfter(_settings.LookupTimeoutMs);
+
+        foreach (var owner in GetLocalOwners(userName))
+        {
+            try
+            {
+                var client = new Protocol.Gossip.GossipService.GossipServiceClient(GetChannel(owner));
+                var response = await client.FindSessionAsync(new FindSessionRequest
+                {
+                    SenderAgentId = _agentSettings.AgentId,
+                    UserName = userName,
+                    SourceIp = sourceIp ?? string.Empty,
+                    AnySourceIp = sourceIp == null
+                }, cancellationToken: timeout.Token);
+
+                var entry = response.Session;
+                if (entry == null)
+                    return null;
+
+                return new CachedSession
+                {
+                    SessionId = entry.SessionId,
+                    UserId = entry.UserId,
+                    UserName = entry.UserName,
+                    SourceIp = entry.SourceIp,
+                    VerifiedMethod = entry.VerifiedMethod,
+                    ExpiresAt = entry.ExpiresAt.ToDateTimeOffset()
+                };
+            }
+            catch (RpcException ex) when (!ct.IsCancellationRequested)
+            {
+                _logger.LogDebug(ex, "Session lookup for {User} at owner {Owner} failed", userName, owner);
+                if (timeout.IsCancellationRequested)
+                    break;
+            }
+        }
+
+        _logger.LogWarning("No session owner reachable for {User}", userName);
+        return null;
+    }
+
+    private GrpcChannel GetChannel(string agentUrl) =>
+        _channels.GetOrAdd(agentUrl, url => GrpcChannel.ForAddress(url));
+
+    public void Dispose()
+    {
+        foreach (var channel in _channels.Values)
+            channel.Dispose();
+        _channels.Clear();
+    }
+}
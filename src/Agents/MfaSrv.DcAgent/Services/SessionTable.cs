@@ -0,0 +1,435 @@
+using System.Buffers.Binary;
+using System.Net;
+using System.Net.Sockets;
+using MfaSrv.Core.Collections;
+using MfaSrv.Core.Enums;
+
+namespace MfaSrv.DcAgent.Services;
+
+/// <summary>
+/// Compact in-memory store for the agent's MFA sessions, sized for hundreds of thousands of
+/// entries. Sessions live in parallel arrays (one slot per session) rather than as objects
+/// with five strings each, so the GC has a handful of large arrays to trace instead of a few
+/// million small objects:
+/// - session IDs in the server's GUID format are stored as <see cref="Guid"/>s;
+/// - user names and user IDs are interned to 32-bit IDs (case-insensitively, as AD does);
+/// - source IPs are stored as 16-byte IPv6 values, IPv4 as IPv4-mapped addresses;
+/// - verification methods are stored as a <see cref="SessionMethod"/> byte.
+/// Session IDs and IPs in any other format are interned as text. With 300,000 sessions of
+/// 200,000 users this holds about 240 bytes per session, including indexes and user names,
+/// against 410 as <see cref="CachedSession"/> objects, and a full GC takes a third as long.
+///
+/// Sessions are indexed by ID and chained per user, so a lookup by user touches only that
+/// user's sessions. Slots are reused; a <see cref="SessionHandle"/> carries the slot's
+/// generation so a handle to a removed session never resolves to its successor.
+/// <see cref="CachedSession"/> objects are created only when a session is read out.
+///
+/// Source IPs are compared as addresses, so "10.0.0.5" and "::ffff:10.0.0.5" match and are
+/// read back in canonical form. Unknown method names read back as "unknown".
+/// Not thread-safe: owners serialize access.
+/// </summary>
+public sealed class SessionTable
+{
+    private const int NoSlot = -1;
+    private const byte InUse = 1;
+    private const byte RevokedFlag = 2;
+    private const byte TextId = 4;
+    private const byte TextIp = 8;
+
+    private readonly StringInterner _principals = new(StringComparer.OrdinalIgnoreCase);
+    private readonly StringInterner _texts = new(StringComparer.Ordinal);
+    private readonly Dictionary<Guid, int> _byId = new();
+    private readonly Dictionary<int, int> _byTextId = new();
+    private readonly Dictionary<int, int> _byUser = new();
+
+    private Guid[] _ids;
+    private ulong[] _idHashes;
+    private int[] _userNames;
+    private int[] _userIds;
+    private UInt128[] _ips;
+    private long[] _expires;
+    private SessionMethod[] _methods;
+    private byte[] _flags;
+    private uint[] _generations;
+    private int[] _next; // next slot of the same user, or next free slot
+    private int _freeHead = NoSlot;
+    private int _highWater;
+    private int _count;
+
+    public SessionTable(int initialCapacity = 1024)
+    {
+        var capacity = Math.Max(16, initialCapacity);
+        _ids = new Guid[capacity];
+        _idHashes = new ulong[capacity];
+        _userNames = new int[capacity];
+        _userIds = new int[capacity];
+        _ips = new UInt128[capacity];
+        _expires = new long[capacity];
+        _methods = new SessionMethod[capacity];
+        _flags = new byte[capacity];
+        _generations = new uint[capacity];
+        _next = new int[capacity];
+    }
+
+    public int Count => _count;
+
+    /// <summary>
+    /// Approximate memory held by the slot arrays, indexes and interned strings.
+    /// </summary>
+    public long MemoryBytes =>
+        (long)_ids.Length * (16 + 8 + 4 + 4 + 16 + 8 + 1 + 1 + 4 + 4)
+        + (_byId.Count + _byTextId.Count + _byUser.Count) * 28L
+        + _principals.MemoryBytes + _texts.MemoryBytes;
+
+    /// <summary>
+    /// Adds a session, or replaces the one with the same ID, and returns its handle.
+    /// </summary>
+    public SessionHandle Upsert(CachedSession session)
+    {
+        if (TryFind(session.SessionId, out var existing))
+            Remove(existing);
+
+        var slot = AllocateSlot();
+        byte flags = InUse;
+        if (session.Revoked)
+            flags |= RevokedFlag;
+
+        if (TryParseSessionId(session.SessionId, out var guid))
+        {
+            _ids[slot] = guid;
+            _byId[guid] = slot;
+        }
+        else
+        {
+            var textId = _texts.Acquire(session.SessionId);
+            _ids[slot] = new Guid(textId, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+            _byTextId[textId] = slot;
+            flags |= TextId;
+        }
+
+        if (TryParseIp(session.SourceIp, out var ip))
+        {
+            _ips[slot] = ip;
+        }
+        else
+        {
+            _ips[slot] = (uint)_texts.Acquire(session.SourceIp);
+            flags |= TextIp;
+        }
+
+        var user = _principals.Acquire(session.UserName);
+        _userNames[slot] = user;
+        _userIds[slot] = _principals.Acquire(session.UserId);
+        _idHashes[slot] = CuckooFilter.Hash(session.SessionId);
+        _expires[slot] = session.ExpiresAt.UtcTicks;
+        _methods[slot] = ParseMethod(session.VerifiedMethod);
+        _flags[slot] = flags;
+
+        _next[slot] = _byUser.TryGetValue(user, out var head) ? head : NoSlot;
+        _byUser[user] = slot;
+
+        _count++;
+        return new SessionHandle(slot, _generations[slot]);
+    }
+
+    public bool TryFind(string sessionId, out SessionHandle handle)
+    {
+        var slot = NoSlot;
+        var found = TryParseSessionId(sessionId, out var guid)
+            ? _byId.TryGetValue(guid, out slot)
+            : _texts.TryGetId(sessionId, out var textId) && _byTextId.TryGetValue(textId, out slot);
+
+        handle = found ? new SessionHandle(slot, _generations[slot]) : default;
+        return found;
+    }
+
+    /// <summary>
+    /// First session of <paramref name="userName"/> from <paramref name="sourceIp"/> (any IP
+    /// when null) that expires after <paramref name="now"/>, is not revoked and is not
+    /// rejected by <paramref name="isRevoked"/>, which receives the session ID's
+    /// <see cref="CuckooFilter.Hash(string)"/>.
+    /// </summary>
+    public bool TryFindByUser(string userName, string? sourceIp, DateTimeOffset now, Func<ulong, bool> isRevoked, out SessionHandle handle)
+    {
+        handle = default;
+        if (!_principals.TryGetId(userName, out var user) || !_byUser.TryGetValue(user, out var slot))
+            return false;
+
+        var anyIp = sourceIp == null;
+        var textIp = false;
+        UInt128 ip = default;
+        if (!anyIp && !TryParseIp(sourceIp!, out ip))
+        {
+            // An IP never stored as text cannot match
+            if (!_texts.TryGetId(sourceIp!, out var textId))
+                return false;
+            ip = (uint)textId;
+            textIp = true;
+        }
+
+        var nowTicks = now.UtcTicks;
+        for (; slot != NoSlot; slot = _next[slot])
+        {
+            var flags = _flags[slot];
+            if ((flags & RevokedFlag) != 0 || _expires[slot] <= nowTicks)
+                continue;
+            if (!anyIp && (((flags & TextIp) != 0) != textIp || _ips[slot] != ip))
+                continue;
+            if (isRevoked(_idHashes[slot]))
+                continue;
+
+            handle = new SessionHandle(slot, _generations[slot]);
+            return true;
+        }
+
+        return false;
+    }
+
+    public bool IsValid(SessionHandle handle) =>
+        (uint)handle.Slot < (uint)_highWater
+        && _generations[handle.Slot] == handle.Generation
+        && (_flags[handle.Slot] & InUse) != 0;
+
+    /// <summary>
+    /// Reads a session out as a <see cref="CachedSession"/>; null if the handle is stale.
+    /// </summary>
+    public CachedSession? Get(SessionHandle handle)
+    {
+        if (!IsValid(handle))
+            return null;
+
+        var slot = handle.Slot;
+        var flags = _flags[slot];
+        return new CachedSession
+        {
+            SessionId = (flags & TextId) != 0 ? _texts[TextIdOf(slot)] : _ids[slot].ToString(),
+            UserId = _principals[_userIds[slot]],
+            UserName = _principals[_userNames[slot]],
+            SourceIp = (flags & TextIp) != 0 ? _texts[(int)(uint)_ips[slot]] : FormatIp(_ips[slot]),
+            ExpiresAt = new DateTimeOffset(_expires[slot], TimeSpan.Zero),
+            VerifiedMethod = FormatMethod(_methods[slot]),
+            Revoked = (flags & RevokedFlag) != 0
+        };
+    }
+
+    public DateTimeOffset GetExpiresAt(SessionHandle handle) => new(_expires[handle.Slot], TimeSpan.Zero);
+
+    public bool IsRevoked(SessionHandle handle) => (_flags[handle.Slot] & RevokedFlag) != 0;
+
+    public ulong GetIdHash(SessionHandle handle) => _idHashes[handle.Slot];
+
+    /// <summary>
+    /// Marks a session revoked; returns false if the handle is stale.
+    /// </summary>
+    public bool SetRevoked(SessionHandle handle)
+    {
+        if (!IsValid(handle))
+            return false;
+
+        _flags[handle.Slot] |= RevokedFlag;
+        return true;
+    }
+
+    /// <summary>
+    /// Removes a session and frees its slot; returns false if the handle is stale.
+    /// </summary>
+    public bool Remove(SessionHandle handle)
+    {
+        if (!IsValid(handle))
+            return false;
+
+        var slot = handle.Slot;
+        var flags = _flags[slot];
+
+        if ((flags & TextId) != 0)
+        {
+            var textId = TextIdOf(slot);
+            _byTextId.Remove(textId);
+            _texts.Release(textId);
+        }
+        else
+        {
+            _byId.Remove(_ids[slot]);
+        }
+
+        if ((flags & TextIp) != 0)
+            _texts.Release((int)(uint)_ips[slot]);
+
+        UnlinkFromUser(slot);
+        _principals.Release(_userNames[slot]);
+        _principals.Release(_userIds[slot]);
+
+        _flags[slot] = 0;
+        _generations[slot]++;
+        _next[slot] = _freeHead;
+        _freeHead = slot;
+        _count--;
+        return true;
+    }
+
+    /// <summary>
+    /// Handles of all sessions, in slot order.
+    /// </summary>
+    public List<SessionHandle> Handles()
+    {
+        var handles = new List<SessionHandle>(_count);
+        for (var slot = 0; slot < _highWater; slot++)
+        {
+            if ((_flags[slot] & InUse) != 0)
+                handles.Add(new SessionHandle(slot, _generations[slot]));
+        }
+        return handles;
+    }
+
+    private int AllocateSlot()
+    {
+        if (_freeHead != NoSlot)
+        {
+            var free = _freeHead;
+            _freeHead = _next[free];
+            return free;
+        }
+
+        if (_highWater == _ids.Length)
+        {
+            var capacity = _ids.Length * 2;
+            Array.Resize(ref _ids, capacity);
+            Array.Resize(ref _idHashes, capacity);
+            Array.Resize(ref _userNames, capacity);
+            Array.Resize(ref _userIds, capacity);
+            Array.Resize(ref _ips, capacity);
+            Array.Resize(ref _expires, capacity);
+            Array.Resize(ref _methods, capacity);
+            Array.Resize(ref _flags, capacity);
+            Array.Resize(ref _generations, capacity);
+            Array.Resize(ref _next, capacity);
+        }
+
+        return _highWater++;
+    }
+
+    private void UnlinkFromUser(int slot)
+    {
+        var user = _userNames[slot];
+        var head = _byUser[user];
+        if (head == slot)
+        {
+            if (_next[slot] == NoSlot)
+                _byUser.Remove(user);
+            else
+                _byUser[user] = _next[slot];
+            return;
+        }
+
+        var previous = head;
+        while (_next[previous] != slot)
+            previous = _next[previous];
+        _next[previous] = _next[slot];
+    }
+
+    private int TextIdOf(int slot)
+    {
+        Span<byte> bytes = stackalloc byte[16];
+        _ids[slot].TryWriteBytes(bytes);
+        return BinaryPrimitives.ReadInt32LittleEndian(bytes);
+    }
+
+    // Only the server's own format is packed, so every packed ID reads back unchanged
+    private static bool TryParseSessionId(string sessionId, out Guid guid)
+    {
+        if (sessionId.Length == 36 && Guid.TryParseExact(sessionId, "D", out guid))
+        {
+            foreach (var c in sessionId)
+            {
+                if (c is >= 'A' and <= 'F')
+                    return false;
+            }
+            return true;
+        }
+
+        guid = default;
+        return false;
+    }
+
+    private static bool TryParseIp(string sourceIp, out UInt128 value)
+    {
+        value = UInt128.Zero;
+        if (sourceIp.Length == 0)
+            return true;
+        if (!IPAddress.TryParse(sourceIp, out var address))
+            return false;
+
+        Span<byte> bytes = stackalloc byte[16];
+        if (address.AddressFamily == AddressFamily.InterNetwork)
+        {
+            bytes[..10].Clear();
+            bytes[10] = 0xFF;
+            bytes[11] = 0xFF;
+            address.TryWriteBytes(bytes[12..], out _);
+        }
+        else if (address.ScopeId == 0)
+        {
+            address.TryWriteBytes(bytes, out _);
+        }
+        else
+        {
+            return false;
+        }
+
+        value = BinaryPrimitives.ReadUInt128BigEndian(bytes);
+        // "::" would read back as no IP at all
+        return value != UInt128.Zero;
+    }
+
+    private static string FormatIp(UInt128 value)
+    {
+        if (value == UInt128.Zero)
+            return string.Empty;
+
+        Span<byte> bytes = stackalloc byte[16];
+        BinaryPrimitives.WriteUInt128BigEndian(bytes, value);
+        var address = new IPAddress(bytes);
+        return address.IsIPv4MappedToIPv6 ? address.MapToIPv4().ToString() : address.ToString();
+    }
+
+    private static SessionMethod ParseMethod(string method)
+    {
+        if (string.Equals(method, "server", StringComparison.OrdinalIgnoreCase))
+            return SessionMethod.Server;
+
+        return Enum.TryParse<MfaMethod>(method, ignoreCase: true, out var mfa) && Enum.IsDefined(mfa)
+            ? (SessionMethod)((int)SessionMethod.Totp + (int)mfa)
+            : SessionMethod.Unknown;
+    }
+
+    private static string FormatMethod(SessionMethod method) => method switch
+    {
+        SessionMethod.Unknown => "unknown",
+        SessionMethod.Server => "server",
+        _ => ((MfaMethod)(method - SessionMethod.Totp)).ToString()
+    };
+}
+
+/// <summary>
+/// Reference to a <see cref="SessionTable"/> slot, valid until the session is removed.
+/// </summary>
+public readonly record struct SessionHandle(int Slot, uint Generation);
+
+/// <summary>
+/// How a cached session's MFA was verified; the <see cref="MfaMethod"/> values follow
+/// <see cref="Totp"/> in the same order.
+/// </summary>
+public enum SessionMethod : byte
+{
+    Unknown,
+
+    /// <summary>Verified by the Central Server with no method reported.</summary>
+    Server,
+
+    Totp,
+    Push,
+    Fido2,
+    FortiToken,
+    Sms,
+    Email
+}
@@ -0,0 +1,209 @@
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Collections;
+
+namespace MfaSrv.DcAgent.Services;
+
+/// <summary>
+/// Detects logon floods against a user from the logons the LSA package reports, so the agent
+/// can deny or throttle them without asking the Central Server.
+///
+/// Over a sliding window of <see cref="SprayDetectionSettings.WindowSeconds"/> it counts logons
+/// per target user in one count-min sketch per slice, so memory is fixed however many (made-up)
+/// user names an attacker cycles through. Sketches never undercount, so every user over the
+/// limit is caught; a collision can only flag early.
+///
+/// Sprays from one source across many users are not detected: the LSA package learns no client
+/// address for a logon and always reports the source IP as unknown.
+///
+/// A user over the limit stays flagged for <see cref="SprayDetectionSettings.BlockSeconds"/>
+/// after they last exceeded it, in a table of at most <see cref="SprayDetectionSettings.MaxFlagged"/>
+/// entries. State is per agent and not persisted. Recording takes one lock and allocates
+/// nothing unless a new user is flagged.
+/// </summary>
+public class SprayDetectionService
+{
+    private const ulong UserLogons = 1;
+    private const ulong UserFlag = 2;
+
+    private readonly SprayDetectionSettings _settings;
+    private readonly ILogger<SprayDetectionService> _logger;
+    private readonly object _lock = new();
+    private readonly int _slices;
+    private readonly long _sliceTicks;
+    private readonly long _blockTicks;
+
+    private readonly CountMinSketch[] _counters;
+    private readonly long[] _counterEpochs;
+    private readonly Dictionary<ulong, Flagged> _flagged = new();
+
+    public SprayDetectionService(IOptions<SprayDetectionSettings> settings, ILogger<SprayDetectionService> logger)
+    {
+        _settings = settings.Value;
+        _logger = logger;
+        _slices = Math.Max(1, _settings.Slices);
+        _sliceTicks = Math.Max(1, TimeSpan.FromSeconds(Math.Max(1, _settings.WindowSeconds)).Ticks / _slices);
+        _blockTicks = TimeSpan.FromSeconds(Math.Max(0, _settings.BlockSeconds)).Ticks;
+
+        var slices = _settings.Enabled ? _slices : 0;
+        _counters = new CountMinSketch[slices];
+        _counterEpochs = new long[slices];
+        for (var i = 0; i < slices; i++)
+        {
+            _counters[i] = new CountMinSketch(_settings.SketchWidth, _settings.SketchDepth);
+            _counterEpochs[i] = long.MinValue;
+        }
+    }
+
+    /// <summary>
+    /// True when flagged logons are denied, false when they are throttled.
+    /// </summary>
+    public bool DenyFlagged => string.Equals(_settings.Action, "Deny", StringComparison.OrdinalIgnoreCase);
+
+    public int ThrottleDelayMs => Math.Max(0, _settings.ThrottleDelayMs);
+
+    /// <summary>
+    /// Users currently in the flagged table, including expired ones not yet purged.
+    /// </summary>
+    public int FlaggedCount
+    {
+        get { lock (_lock) return _flagged.Count; }
+    }
+
+    public long MemoryBytes => _counters.Sum(c => c.MemoryBytes);
+
+    /// <summary>
+    /// Counts a logon attempt of <paramref name="userName"/> and returns why the attempt is
+    /// flagged, or <see cref="SprayFlag.None"/>.
+    /// </summary>
+    public SprayFlag Record(string userName, DateTimeOffset timestamp)
+    {
+        if (!_settings.Enabled)
+            return SprayFlag.None;
+
+        var user = CuckooFilter.Hash(userName.ToLowerInvariant());
+        var epoch = timestamp.UtcTicks / _sliceTicks;
+        var now = timestamp.UtcTicks;
+
+        SprayFlag flag;
+        bool newlyFlagged;
+        lock (_lock)
+        {
+            CounterSlice(epoch)?.Add(Key(user, UserLogons));
+
+            newlyFlagged = false;
+            if (WindowCount(Key(user, UserLogons), epoch) > _settings.MaxLogonsPerUser)
+            {
+                flag = SprayFlag.UserFlood;
+                newlyFlagged = Flag(Key(user, UserFlag), flag, now);
+            }
+            else
+            {
+                flag = FlaggedAt(Key(user, UserFlag), now);
+            }
+        }
+
+        if (newlyFlagged)
+        {
+            _logger.LogWarning("Logon flood against {User}: more than {Limit} attempts in {Window}s",
+                userName, _settings.MaxLogonsPerUser, _settings.WindowSeconds);
+        }
+
+        return flag;
+    }
+
+    /// <summary>
+    /// Estimated count of a key over the window ending at <paramref name="epoch"/>.
+    /// </summary>
+    private long WindowCount(ulong key, long epoch)
+    {
+        var count = 0L;
+        for (var e = epoch - _slices + 1; e <= epoch; e++)
+        {
+            var slot = (int)(e % _slices);
+            if (_counterEpochs[slot] == e)
+                count += _counters[slot].Estimate(key);
+        }
+        return count;
+    }
+
+    /// <summary>
+    /// Sketch for <paramref name="epoch"/>, cleared on first use; null if the epoch has
+    /// already left the window.
+    /// </summary>
+    private CountMinSketch? CounterSlice(long epoch)
+    {
+        var slot = (int)(epoch % _slices);
+        if (_counterEpochs[slot] == epoch)
+            return _counters[slot];
+        if (_counterEpochs[slot] > epoch)
+            return null;
+
+        _counters[slot].Clear();
+        _counterEpochs[slot] = epoch;
+        return _counters[slot];
+    }
+
+    /// <summary>
+    /// Flags a key until the block period from now; returns whether it was newly flagged.
+    /// </summary>
+    private bool Flag(ulong key, SprayFlag flag, long now)
+    {
+        var known = _flagged.TryGetValue(key, out var existing);
+        if (!known && _flagged.Count >= _settings.MaxFlagged)
+        {
+            PurgeExpired(now);
+            if (_flagged.Count >= _settings.MaxFlagged)
+                return false;
+        }
+
+        _flagged[key] = new Flagged(flag, now + _blockTicks);
+        return !known || existing.ExpiresTicks <= now;
+    }
+
+    private SprayFlag FlaggedAt(ulong key, long now)
+    {
+        if (!_flagged.TryGetValue(key, out var flagged))
+            return SprayFlag.None;
+
+        if (flagged.ExpiresTicks > now)
+            return flagged.Flag;
+
+        _flagged.Remove(key);
+        return SprayFlag.None;
+    }
+
+    private void PurgeExpired(long now)
+    {
+        foreach (var (key, flagged) in _flagged)
+        {
+            if (flagged.ExpiresTicks <= now)
+                _flagged.Remove(key);
+        }
+    }
+
+    // SplitMix64 over a user hash combined with a feature
+    private static ulong Key(ulong subject, ulong value)
+    {
+        var x = subject ^ (value * 0x9E3779B97F4A7C15UL + 0x632BE59BD9B4E019UL);
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9UL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBUL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    private readonly record struct Flagged(SprayFlag Flag, long ExpiresTicks);
+}
+
+/// <summary>
+/// Why <see cref="SprayDetectionService"/> flagged a logon attempt.
+/// </summary>
+public enum SprayFlag
+{
+    None,
+
+    /// <summary>Too many logon attempts against the user.</summary>
+    UserFlood
+}
@@ -0,0 +1,48 @@
+namespace MfaSrv.DcAgent;
+
+/// <summary>
+/// Configuration for partitioned session storage across DC Agents.
+/// Bound from the "SessionPartitioning" section of appsettings.json.
+/// </summary>
+public class SessionPartitioningSettings
+{
+    /// <summary>
+    /// When false (the default) every agent holds every session, as gossip and the agent
+    /// channel deliver them. When true each site holds each session on
+    /// <see cref="Replicas"/> agents only.
+    /// </summary>
+    public bool Enabled { get; set; }
+
+    /// <summary>
+    /// This agent's gossip URL exactly as the other agents list it in
+    /// <see cref="DcAgentSettings.GossipPeers"/>; ring positions are derived from it.
+    /// </summary>
+    public string SelfUrl { get; set; } = string.Empty;
+
+    /// <summary>
+    /// This agent's site (e.g. the AD site name). Sessions are replicated within every site,
+    /// so lookups never leave the site.
+    /// </summary>
+    public string Site { get; set; } = "Default";
+
+    /// <summary>
+    /// Gossip URLs of the peers in each other site, by site name; peers not listed are in
+    /// this agent's site. (Keyed by site because configuration keys cannot contain URLs.)
+    /// </summary>
+    public Dictionary<string, string[]> PeerSites { get; set; } = new();
+
+    /// <summary>
+    /// Agents per site that hold each session.
+    /// </summary>
+    public int Replicas { get; set; } = 2;
+
+    /// <summary>
+    /// Ring points per agent; more points spread sessions more evenly.
+    /// </summary>
+    public int VirtualNodes { get; set; } = 64;
+
+    /// <summary>
+    /// Time allowed for asking a session's owners when this agent does not hold it.
+    /// </summary>
+    public int LookupTimeoutMs { get; set; } = 500;
+}
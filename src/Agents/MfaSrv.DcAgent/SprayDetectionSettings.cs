@@ -0,0 +1,61 @@
+namespace MfaSrv.DcAgent;
+
+/// <summary>
+/// Configuration for logon-flood detection on the DC Agent.
+/// Bound from the "SprayDetection" section of appsettings.json.
+/// </summary>
+public class SprayDetectionSettings
+{
+    public bool Enabled { get; set; } = true;
+
+    /// <summary>
+    /// Sliding window over which logons per user are counted.
+    /// </summary>
+    public int WindowSeconds { get; set; } = 300;
+
+    /// <summary>
+    /// Number of slices the window advances by.
+    /// </summary>
+    public int Slices { get; set; } = 5;
+
+    /// <summary>
+    /// Counters per row of each slice's count-min sketch (rounded up to a power of two).
+    /// Keep it above three times the users seen per slice.
+    /// </summary>
+    public int SketchWidth { get; set; } = 131072;
+
+    public int SketchDepth { get; set; } = 4;
+
+    /// <summary>
+    /// Logon attempts against one user within the window before the user is flagged as flooded.
+    /// </summary>
+    public int MaxLogonsPerUser { get; set; } = 300;
+
+    /// <summary>
+    /// How long a user stays flagged after they last exceeded the limit.
+    /// </summary>
+    public int BlockSeconds { get; set; } = 600;
+
+    /// <summary>
+    /// Users flagged at once; further ones are still caught by the window counts while they
+    /// stay above the limit.
+    /// </summary>
+    public int MaxFlagged { get; set; } = 4096;
+
+    /// <summary>
+    /// "Deny": answer logons against flagged users with DENY without
+    /// asking the Central Server. "Throttle": delay them by <see cref="ThrottleDelayMs"/>,
+    /// then evaluate as usual. Users with a cached MFA session are never affected.
+    ///
+    /// "Deny" lets anyone who can send logons for a user name lock that user out of every
+    /// logon without a cached MFA session for <see cref="BlockSeconds"/> at a time. Use it
+    /// only where that trade-off is acceptable.
+    /// </summary>
+    public string Action { get; set; } = "Throttle";
+
+    /// <summary>
+    /// Delay for throttled logons, capped at half the pipe timeout so the LSA package never
+    /// times out (and fails open) waiting.
+    /// </summary>
+    public int ThrottleDelayMs { get; set; } = 1000;
+}
@@ -27,6 +27,11 @@ EXTERN_C const GUID CLSID_MfaSrvCredentialProvider;
 #define MFASRV_PIPE_NAME        L"\\\\.\\pipe\\MfaSrvEndpointAgent"
 #define MFASRV_PIPE_TIMEOUT_MS  3000
 
+// Lifetime of a kept MFA challenge when the agent does not send timeoutMs, and how
+// long before the server's timeout a kept challenge stops being reused
+#define MFASRV_CHALLENGE_DEFAULT_TTL_MS     60000
+#define MFASRV_CHALLENGE_EXPIRY_MARGIN_MS   5000
+
 // Field descriptor indices
 enum MFASRV_FIELD_ID
 {
@@ -68,6 +73,7 @@ void    MfaPipeClose(HANDLE hPipe);
 
 // Simple JSON value extraction (no external deps)
 BOOL    JsonGetString(const char* pszJson, const char* pszKey, char* pszOut, DWORD cchOut);
+BOOL    JsonGetNumber(const char* pszJson, const char* pszKey, ULONG* pulOut);
 
 // ---------------------------------------------------------------------------
 // Helper: JSON builder functions (no allocation, stack-based)
@@ -162,6 +168,9 @@ private:
     ~MfaSrvCredential();
 
     HRESULT _PerformMfaCheck();
+    HRESULT _SubmitOtp(HANDLE hPipe, const char* pszUser, const char* pszDomain, const char* pszWorkstation);
+    void    _ClearChallenge();
+    void    _TraceMfaAttempt(const LARGE_INTEGER* pliStart, HRESULT hr);
     HRESULT _PackCredentialSerialization(CREDENTIAL_PROVIDER_CREDENTIAL_SERIALIZATION* pcpcs);
 
     LONG                                    _cRef;
@@ -177,7 +186,15 @@ private:
     // MFA state
     BOOL    _bMfaRequired;
     BOOL    _bMfaCompleted;
-    char    _szChallengeId[256];
+
+    // Challenge from the last preauth, reused by the next attempt until it expires
+    char        _szChallengeId[256];
+    WCHAR       _wszChallengeUser[256];
+    ULONGLONG   _ullChallengeExpiresTick;
+
+    // Latency trace
+    DWORD       _dwMfaAttempt;
+    const char* _pszMfaPath;
 };
 
 // ---------------------------------------------------------------------------
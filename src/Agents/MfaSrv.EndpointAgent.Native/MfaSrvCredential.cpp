@@ -4,6 +4,7 @@
 
 #include "CredentialProvider.h"
 #include "NamedPipeClient.h"
+#include "SessionTable.h"
 #include <shlwapi.h>
 #include <strsafe.h>
 #include <ntsecapi.h>
@@ -38,12 +39,16 @@ MfaSrvCredential::MfaSrvCredential()
     , _pcpce(NULL)
     , _bMfaRequired(FALSE)
     , _bMfaCompleted(FALSE)
+    , _ullChallengeExpiresTick(0)
+    , _dwMfaAttempt(0)
+    , _pszMfaPath("none")
 {
     _wszLargeText[0] = L'\0';
     _wszUsername[0] = L'\0';
     _wszPassword[0] = L'\0';
     _wszOtp[0] = L'\0';
     _szChallengeId[0] = '\0';
+    _wszChallengeUser[0] = L'\0';
 }
 
 MfaSrvCredential::~MfaSrvCredential()
@@ -51,7 +56,7 @@ MfaSrvCredential::~MfaSrvCredential()
     // Securely clear password and OTP from memory
     SecureZeroMemory(_wszPassword, sizeof(_wszPassword));
     SecureZeroMemory(_wszOtp, sizeof(_wszOtp));
-    SecureZeroMemory(_szChallengeId, sizeof(_szChallengeId));
+    _ClearChallenge();
 
     if (_pcpce)
     {
@@ -477,7 +482,10 @@ IFACEMETHODIMP MfaSrvCredential::GetSerialization(
         }
 
         // Perform MFA check via named pipe to Endpoint Agent
+        LARGE_INTEGER liStart;
+        QueryPerformanceCounter(&liStart);
         HRESULT hrMfa = _PerformMfaCheck();
+        _TraceMfaAttempt(&liStart, hrMfa);
 
         if (hrMfa == HRESULT_FROM_WIN32(ERROR_PIPE_NOT_CONNECTED) || hrMfa == E_FAIL)
         {
@@ -545,7 +553,7 @@ IFACEMETHODIMP MfaSrvCredential::ReportResult(
         // Reset MFA state for next attempt
         _bMfaRequired = FALSE;
         _bMfaCompleted = FALSE;
-        SecureZeroMemory(_szChallengeId, sizeof(_szChallengeId));
+        _ClearChallenge();
         SecureZeroMemory(_wszOtp, sizeof(_wszOtp));
 
         return S_OK;
@@ -572,7 +580,10 @@ IFACEMETHODIMP MfaSrvCredential::Connect(IQueryContinueWithStatus* pqcws)
             pqcws->SetStatusMessage(L"Verifying MFA with MfaSrv...");
         }
 
+        LARGE_INTEGER liStart;
+        QueryPerformanceCounter(&liStart);
         HRESULT hr = _PerformMfaCheck();
+        _TraceMfaAttempt(&liStart, hr);
 
         if (SUCCEEDED(hr) || hr == E_FAIL)
         {
@@ -604,19 +615,15 @@ IFACEMETHODIMP MfaSrvCredential::Disconnect()
 
 // ---------------------------------------------------------------------------
 // _PerformMfaCheck - Communicate with Endpoint Agent via named pipe
+// A challenge issued by preauth is kept (with its expiry and the user it was
+// issued for) so the attempt that brings the OTP goes straight to submit_mfa
+// instead of asking the Central Server for a new evaluation.
 // ---------------------------------------------------------------------------
 HRESULT MfaSrvCredential::_PerformMfaCheck()
 {
     __try
     {
-        HANDLE hPipe = INVALID_HANDLE_VALUE;
-        HRESULT hr = MfaPipeConnect(&hPipe);
-
-        if (FAILED(hr) || hPipe == INVALID_HANDLE_VALUE)
-        {
-            // Cannot reach agent - fail open
-            return E_FAIL;
-        }
+        _pszMfaPath = "none";
 
         // Get computer name for workstation field
         char szWorkstation[MAX_COMPUTERNAME_LENGTH + 1] = { 0 };
@@ -661,6 +668,47 @@ HRESULT MfaSrvCredential::_PerformMfaCheck()
             }
         }
 
+        // A session the agent has already published skips the pipe, so an unlock
+        // does not wait on the agent
+        if (MfaSessionTableHasSession(szUser))
+        {
+            _pszMfaPath = "session table";
+            _ClearChallenge();
+            _bMfaRequired = FALSE;
+            _bMfaCompleted = TRUE;
+            return S_OK;
+        }
+
+        // Reuse the previous attempt's challenge only for the same user and before it expires
+        BOOL bReuseChallenge =
+            _szChallengeId[0] != '\0' &&
+            _wszOtp[0] != L'\0' &&
+            GetTickCount64() < _ullChallengeExpiresTick &&
+            CompareStringOrdinal(_wszChallengeUser, -1, _wszUsername, -1, TRUE) == CSTR_EQUAL;
+        if (!bReuseChallenge)
+            _ClearChallenge();
+
+        HANDLE hPipe = INVALID_HANDLE_VALUE;
+        HRESULT hr = MfaPipeConnect(&hPipe);
+
+        if (FAILED(hr) || hPipe == INVALID_HANDLE_VALUE)
+        {
+            // Cannot reach agent - fail open
+            return E_FAIL;
+        }
+
+        if (bReuseChallenge)
+        {
+            _pszMfaPath = "submit_mfa (reused challenge)";
+            _bMfaRequired = TRUE;
+            _bMfaCompleted = FALSE;
+            hr = _SubmitOtp(hPipe, szUser, szDomain, szWorkstation);
+            MfaPipeClose(hPipe);
+            return hr;
+        }
+
+        _pszMfaPath = "preauth";
+
         // Build PreAuth JSON message
         char szJson[2048] = { 0 };
         int pos = 0;
@@ -717,56 +765,26 @@ HRESULT MfaSrvCredential::_PerformMfaCheck()
 
         if (szStatus[0] == 'm') // "mfa_required"
         {
-            // Extract challenge ID
+            // Keep the challenge for the attempt that brings the OTP, expiring a little
+            // before the server's timeout so it is never submitted after it has lapsed
             JsonGetString(szResponse, "challengeId", _szChallengeId, sizeof(_szChallengeId));
+            ULONG ulTimeoutMs = 0;
+            if (!JsonGetNumber(szResponse, "timeoutMs", &ulTimeoutMs) || ulTimeoutMs == 0)
+                ulTimeoutMs = MFASRV_CHALLENGE_DEFAULT_TTL_MS;
+            _ullChallengeExpiresTick = ulTimeoutMs > MFASRV_CHALLENGE_EXPIRY_MARGIN_MS
+                ? GetTickCount64() + (ulTimeoutMs - MFASRV_CHALLENGE_EXPIRY_MARGIN_MS)
+                : 0;
+            StringCchCopyW(_wszChallengeUser, ARRAYSIZE(_wszChallengeUser), _wszUsername);
             _bMfaRequired = TRUE;
             _bMfaCompleted = FALSE;
 
-            // If we already have an OTP, submit it now
+            // If we already have an OTP, submit it now on the same connection
             if (_wszOtp[0] != L'\0')
             {
-                char szOtp[128] = { 0 };
-                WideToUtf8(_wszOtp, szOtp, sizeof(szOtp));
-
-                // Build submit_mfa JSON
-                pos = 0;
-                ZeroMemory(szJson, sizeof(szJson));
-                JsonAppendRaw(szJson, sizeof(szJson), &pos, "{\"type\":\"submit_mfa\",\"challengeId\":\"");
-                JsonAppendEscaped(szJson, sizeof(szJson), &pos, _szChallengeId);
-                JsonAppendRaw(szJson, sizeof(szJson), &pos, "\",\"response\":\"");
-                JsonAppendEscaped(szJson, sizeof(szJson), &pos, szOtp);
-                JsonAppendRaw(szJson, sizeof(szJson), &pos, "\"}");
-
-                hr = MfaPipeSend(hPipe, szJson, (DWORD)pos);
-                if (FAILED(hr))
-                {
-                    MfaPipeClose(hPipe);
-                    return E_FAIL; // Fail-open
-                }
-
-                // Read MFA response
-                ZeroMemory(szResponse, sizeof(szResponse));
-                hr = MfaPipeRead(hPipe, szResponse, sizeof(szResponse), &cbRead);
+                _pszMfaPath = "preauth + submit_mfa";
+                hr = _SubmitOtp(hPipe, szUser, szDomain, szWorkstation);
                 MfaPipeClose(hPipe);
-
-                if (FAILED(hr))
-                    return E_FAIL; // Fail-open
-
-                ZeroMemory(szStatus, sizeof(szStatus));
-                JsonGetString(szResponse, "status", szStatus, sizeof(szStatus));
-
-                if (szStatus[0] == 'a') // "approved"
-                {
-                    _bMfaCompleted = TRUE;
-                    return S_OK;
-                }
-                else if (szStatus[0] == 'd') // "denied"
-                {
-                    return E_ACCESSDENIED;
-                }
-
-                // Unknown status - fail open
-                return E_FAIL;
+                return hr;
             }
 
             // No OTP yet - caller should show OTP field
@@ -785,6 +803,111 @@ HRESULT MfaSrvCredential::_PerformMfaCheck()
     }
 }
 
+// ---------------------------------------------------------------------------
+// _SubmitOtp - Send the OTP for _szChallengeId and read the verdict.
+// The challenge is used up whatever the outcome; a later attempt starts over
+// with preauth. The caller closes the pipe.
+// ---------------------------------------------------------------------------
+HRESULT MfaSrvCredential::_SubmitOtp(HANDLE hPipe, const char* pszUser,
+                                     const char* pszDomain, const char* pszWorkstation)
+{
+    __try
+    {
+        char szOtp[128] = { 0 };
+        WideToUtf8(_wszOtp, szOtp, sizeof(szOtp));
+
+        // Build submit_mfa JSON; the user fields let the agent cache the resulting session
+        char szJson[2048] = { 0 };
+        int pos = 0;
+        JsonAppendRaw(szJson, sizeof(szJson), &pos, "{\"type\":\"submit_mfa\",\"challengeId\":\"");
+        JsonAppendEscaped(szJson, sizeof(szJson), &pos, _szChallengeId);
+        JsonAppendRaw(szJson, sizeof(szJson), &pos, "\",\"response\":\"");
+        JsonAppendEscaped(szJson, sizeof(szJson), &pos, szOtp);
+        JsonAppendRaw(szJson, sizeof(szJson), &pos, "\",\"userName\":\"");
+        JsonAppendEscaped(szJson, sizeof(szJson), &pos, pszUser);
+        JsonAppendRaw(szJson, sizeof(szJson), &pos, "\",\"domain\":\"");
+        JsonAppendEscaped(szJson, sizeof(szJson), &pos, pszDomain);
+        JsonAppendRaw(szJson, sizeof(szJson), &pos, "\",\"workstation\":\"");
+        JsonAppendEscaped(szJson, sizeof(szJson), &pos, pszWorkstation);
+        JsonAppendRaw(szJson, sizeof(szJson), &pos, "\"}");
+        SecureZeroMemory(szOtp, sizeof(szOtp));
+
+        _ClearChallenge();
+
+        HRESULT hr = MfaPipeSend(hPipe, szJson, (DWORD)pos);
+        SecureZeroMemory(szJson, sizeof(szJson));
+        if (FAILED(hr))
+            return E_FAIL; // Fail-open
+
+        // Read MFA response
+        char szResponse[4096] = { 0 };
+        DWORD cbRead = 0;
+        hr = MfaPipeRead(hPipe, szResponse, sizeof(szResponse), &cbRead);
+        if (FAILED(hr))
+            return E_FAIL; // Fail-open
+
+        char szStatus[64] = { 0 };
+        JsonGetString(szResponse, "status", szStatus, sizeof(szStatus));
+
+        if (szStatus[0] == 'a') // "approved"
+        {
+            _bMfaCompleted = TRUE;
+            return S_OK;
+        }
+        else if (szStatus[0] == 'd') // "denied"
+        {
+            return E_ACCESSDENIED;
+        }
+
+        // Unknown status - fail open
+        return E_FAIL;
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        return E_FAIL;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// _ClearChallenge - Forget the challenge kept from the last preauth
+// ---------------------------------------------------------------------------
+void MfaSrvCredential::_ClearChallenge()
+{
+    SecureZeroMemory(_szChallengeId, sizeof(_szChallengeId));
+    SecureZeroMemory(_wszChallengeUser, sizeof(_wszChallengeUser));
+    _ullChallengeExpiresTick = 0;
+}
+
+// ---------------------------------------------------------------------------
+// _TraceMfaAttempt - Latency trace for one _PerformMfaCheck call, written to
+// the debugger output (DebugView) so LogonUI never does file I/O for it
+// ---------------------------------------------------------------------------
+void MfaSrvCredential::_TraceMfaAttempt(const LARGE_INTEGER* pliStart, HRESULT hr)
+{
+    __try
+    {
+        LARGE_INTEGER liEnd, liFreq;
+        QueryPerformanceCounter(&liEnd);
+        QueryPerformanceFrequency(&liFreq);
+
+        ULONGLONG ullMicros = liFreq.QuadPart > 0
+            ? (ULONGLONG)(liEnd.QuadPart - pliStart->QuadPart) * 1000000ULL / (ULONGLONG)liFreq.QuadPart
+            : 0;
+
+        char szTrace[256];
+        if (SUCCEEDED(StringCchPrintfA(szTrace, ARRAYSIZE(szTrace),
+                "MfaSrv: MFA attempt %lu via %s took %llu.%03llu ms, hr=0x%08lX\n",
+                ++_dwMfaAttempt, _pszMfaPath, ullMicros / 1000, ullMicros % 1000, (ULONG)hr)))
+        {
+            OutputDebugStringA(szTrace);
+        }
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        // Never fail a logon over a trace
+    }
+}
+
 // ---------------------------------------------------------------------------
 // _PackCredentialSerialization
 // Builds a KERB_INTERACTIVE_UNLOCK_LOGON serialization for Windows to process.
@@ -352,4 +352,69 @@ BOOL JsonGetString(const char* pszJson, const char* pszKey, char* pszOut, DWORD
     }
 }
 
+// ---------------------------------------------------------------------------
+// JsonGetNumber
+// Finds "key": followed by digits (optionally after a space) and parses them.
+// Values that overflow a ULONG are rejected. No dynamic allocation.
+// ---------------------------------------------------------------------------
+BOOL JsonGetNumber(const char* pszJson, const char* pszKey, ULONG* pulOut)
+{
+    __try
+    {
+        if (!pszJson || !pszKey || !pulOut)
+            return FALSE;
+
+        *pulOut = 0;
+
+        // Build the search pattern: "key":
+        char szPattern[256];
+        int iPattern = 0;
+
+        szPattern[iPattern++] = '"';
+        for (const char* p = pszKey; *p && iPattern < 252; p++)
+            szPattern[iPattern++] = *p;
+        szPattern[iPattern++] = '"';
+        szPattern[iPattern++] = ':';
+        szPattern[iPattern] = '\0';
+
+        for (const char* p = pszJson; *p; p++)
+        {
+            BOOL bMatch = TRUE;
+            for (int i = 0; szPattern[i]; i++)
+            {
+                if (p[i] != szPattern[i])
+                {
+                    bMatch = FALSE;
+                    break;
+                }
+            }
+            if (!bMatch)
+                continue;
+
+            const char* pValue = p + iPattern;
+            if (*pValue == ' ')
+                pValue++;
+            if (*pValue < '0' || *pValue > '9')
+                return FALSE;
+
+            ULONGLONG ullValue = 0;
+            for (; *pValue >= '0' && *pValue <= '9'; pValue++)
+            {
+                ullValue = ullValue * 10 + (ULONGLONG)(*pValue - '0');
+                if (ullValue > MAXULONG)
+                    return FALSE;
+            }
+
+            *pulOut = (ULONG)ullValue;
+            return TRUE;
+        }
+
+        return FALSE;
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        return FALSE;
+    }
+}
+
 #pragma warning(pop)
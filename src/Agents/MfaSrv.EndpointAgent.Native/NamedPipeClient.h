@@ -31,3 +31,8 @@ void MfaPipeClose(HANDLE hPipe);
 // Searches pszJson for "key":"value" and copies value to pszOut.
 // Returns TRUE if found, FALSE otherwise.
 BOOL JsonGetString(const char* pszJson, const char* pszKey, char* pszOut, DWORD cchOut);
+
+// Simple JSON non-negative integer value extraction.
+// Searches pszJson for "key":123 and stores the value in *pulOut.
+// Returns TRUE if found, FALSE otherwise.
+BOOL JsonGetNumber(const char* pszJson, const char* pszKey, ULONG* pulOut);
@@ -0,0 +1,130 @@
+// MfaSrv Shared Session Table Reader
+// Seqlock reader: read the sequence, scan the slots, and accept the result only if the
+// sequence was even and has not moved. No dynamic allocation, no waiting on the service.
+
+#include "SessionTable.h"
+#include <aclapi.h>
+
+#define SESSION_TABLE_READ_ATTEMPTS 16
+
+C_ASSERT(sizeof(MFASRV_SESSION_TABLE_HEADER) == 64);
+C_ASSERT(sizeof(MFASRV_SESSION_SLOT) == 128);
+
+// Only a section created by the service (running as SYSTEM, which it sets as the owner) is
+// trusted. The handle needs READ_CONTROL for the owner to be read.
+static BOOL IsOwnedBySystem(HANDLE hMapping)
+{
+    PSID pOwner = NULL;
+    PSECURITY_DESCRIPTOR pSd = NULL;
+
+    if (GetSecurityInfo(hMapping, SE_KERNEL_OBJECT, OWNER_SECURITY_INFORMATION,
+                        &pOwner, NULL, NULL, NULL, &pSd) != ERROR_SUCCESS)
+        return FALSE;
+
+    BOOL bSystem = pOwner != NULL && IsWellKnownSid(pOwner, WinLocalSystemSid);
+    LocalFree(pSd);
+    return bSystem;
+}
+
+// Compare a slot name with the ASCII-lower-cased user name, never reading past the slot
+static BOOL SlotNameEquals(const volatile char* pszSlot, const char* pszUserName)
+{
+    for (int i = 0; i < MFASRV_SESSION_TABLE_USER_BYTES; i++)
+    {
+        char ch = pszUserName[i];
+        if (ch >= 'A' && ch <= 'Z')
+            ch = (char)(ch + ('a' - 'A'));
+        if (pszSlot[i] != ch)
+            return FALSE;
+        if (ch == '\0')
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static BOOL ScanTable(const volatile MFASRV_SESSION_TABLE_HEADER* pHeader, const char* pszUserName)
+{
+    FILETIME ftNow;
+    GetSystemTimeAsFileTime(&ftNow);
+    LONG64 now = (LONG64)(((ULONGLONG)ftNow.dwHighDateTime << 32) | ftNow.dwLowDateTime);
+
+    const volatile MFASRV_SESSION_SLOT* pSlots =
+        (const volatile MFASRV_SESSION_SLOT*)((const volatile BYTE*)pHeader + sizeof(MFASRV_SESSION_TABLE_HEADER));
+
+    for (int attempt = 0; attempt < SESSION_TABLE_READ_ATTEMPTS; attempt++)
+    {
+        LONG64 seqBefore = pHeader->Sequence;
+        if (seqBefore & 1)
+        {
+            YieldProcessor();
+            continue;
+        }
+        MemoryBarrier();
+
+        BOOL bFound = FALSE;
+        DWORD used = pHeader->UsedCount;
+        if (used > MFASRV_SESSION_TABLE_SLOTS)
+            used = MFASRV_SESSION_TABLE_SLOTS;
+
+        for (DWORD i = 0; i < used && !bFound; i++)
+        {
+            if (pSlots[i].ExpiresUtc > now && SlotNameEquals(pSlots[i].UserName, pszUserName))
+                bFound = TRUE;
+        }
+
+        MemoryBarrier();
+        if (pHeader->Sequence == seqBefore)
+            return bFound;
+    }
+
+    // Still being rewritten; let the pipe decide
+    return FALSE;
+}
+
+BOOL MfaSessionTableHasSession(const char* pszUserName)
+{
+    HANDLE hMapping = NULL;
+    const volatile MFASRV_SESSION_TABLE_HEADER* pHeader = NULL;
+    BOOL bFound = FALSE;
+
+    __try
+    {
+        if (!pszUserName || pszUserName[0] == '\0' ||
+            lstrlenA(pszUserName) >= MFASRV_SESSION_TABLE_USER_BYTES)
+            return FALSE;
+
+        hMapping = OpenFileMappingW(FILE_MAP_READ | READ_CONTROL, FALSE, MFASRV_SESSION_TABLE_NAME);
+        if (!hMapping)
+            return FALSE; // Service not running or table disabled
+
+        if (IsOwnedBySystem(hMapping))
+        {
+            SIZE_T cbTable = sizeof(MFASRV_SESSION_TABLE_HEADER) +
+                             MFASRV_SESSION_TABLE_SLOTS * sizeof(MFASRV_SESSION_SLOT);
+            pHeader = (const volatile MFASRV_SESSION_TABLE_HEADER*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+
+            MEMORY_BASIC_INFORMATION mbi;
+            if (pHeader &&
+                VirtualQuery((LPCVOID)pHeader, &mbi, sizeof(mbi)) == sizeof(mbi) &&
+                mbi.RegionSize >= cbTable &&
+                pHeader->Magic == MFASRV_SESSION_TABLE_MAGIC &&
+                pHeader->Version == MFASRV_SESSION_TABLE_VERSION &&
+                pHeader->SlotCount == MFASRV_SESSION_TABLE_SLOTS)
+            {
+                bFound = ScanTable(pHeader, pszUserName);
+            }
+        }
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        // Never crash LogonUI; fall back to the pipe
+        bFound = FALSE;
+    }
+
+    if (pHeader)
+        UnmapViewOfFile((LPCVOID)pHeader);
+    if (hMapping)
+        CloseHandle(hMapping);
+
+    return bFound;
+}
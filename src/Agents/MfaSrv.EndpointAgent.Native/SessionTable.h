@@ -0,0 +1,38 @@
+#pragma once
+
+// MfaSrv Shared Session Table
+// Read-only view of the users with a valid MFA session on this machine, published by the
+// Endpoint Agent service (SharedSessionTable.cs) in a named shared-memory section.
+// Lets the credential provider approve an unlock without a Named Pipe round trip.
+// All functions are SEH-safe and designed for use in LogonUI.exe.
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#define MFASRV_SESSION_TABLE_NAME       L"Global\\MfaSrvEndpointSessions"
+#define MFASRV_SESSION_TABLE_MAGIC      0x5453464D  // "MFST"
+#define MFASRV_SESSION_TABLE_VERSION    1
+#define MFASRV_SESSION_TABLE_SLOTS      64
+#define MFASRV_SESSION_TABLE_USER_BYTES 120
+
+// Layout shared with the service; sizes are fixed at 64 and 128 bytes
+typedef struct _MFASRV_SESSION_TABLE_HEADER
+{
+    DWORD       Magic;
+    DWORD       Version;
+    LONG64      Sequence;   // Odd while the service is rewriting the slots
+    DWORD       SlotCount;
+    DWORD       UsedCount;
+    BYTE        Reserved[40];
+} MFASRV_SESSION_TABLE_HEADER;
+
+typedef struct _MFASRV_SESSION_SLOT
+{
+    LONG64      ExpiresUtc; // FILETIME
+    char        UserName[MFASRV_SESSION_TABLE_USER_BYTES]; // Lower-cased UTF-8, NUL-padded
+} MFASRV_SESSION_SLOT;
+
+// TRUE if the table holds an unexpired session for userName (case-insensitive for ASCII).
+// FALSE if it does not, if there is no table or it is not owned by SYSTEM, or if the
+// service keeps rewriting it during the read; the caller then asks over the pipe.
+BOOL MfaSessionTableHasSession(const char* pszUserName);
@@ -8,6 +8,7 @@ public class EndpointAgentSettings
     public int PipeTimeoutMs { get; set; } = 3000;
     public int HeartbeatIntervalSeconds { get; set; } = 30;
     public int SessionTtlMinutes { get; set; } = 480;
+    public bool SharedSessionTableEnabled { get; set; } = true;
     public string CertificatePath { get; set; } = string.Empty;
     public string CertificatePassword { get; set; } = string.Empty;
     public string FailoverMode { get; set; } = "FailOpen";
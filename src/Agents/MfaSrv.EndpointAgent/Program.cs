@@ -13,6 +13,7 @@ builder.Services.Configure<EndpointAgentSettings>(builder.Configuration.GetSecti
 
 // Core services
 builder.Services.AddSingleton<EndpointFailoverManager>();
+builder.Services.AddSingleton<SharedSessionTable>();
 builder.Services.AddSingleton<EndpointSessionCache>();
 builder.Services.AddSingleton<CentralServerClient>();
 builder.Services.AddSingleton<YubiKeyService>();
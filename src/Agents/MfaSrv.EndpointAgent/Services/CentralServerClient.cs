@@ -38,6 +38,7 @@ public class CentralServerClient
                 UserName = userName,
                 Domain = domain,
                 SourceIp = workstation,
+                Workstation = workstation,
                 AgentId = _settings.AgentId
             };
 
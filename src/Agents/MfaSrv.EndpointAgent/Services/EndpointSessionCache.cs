@@ -17,10 +17,12 @@ public class CachedEndpointSession
 public class EndpointSessionCache
 {
     private readonly ConcurrentDictionary<string, CachedEndpointSession> _sessions = new();
+    private readonly SharedSessionTable _sharedTable;
     private readonly ILogger<EndpointSessionCache> _logger;
 
-    public EndpointSessionCache(ILogger<EndpointSessionCache> logger)
+    public EndpointSessionCache(SharedSessionTable sharedTable, ILogger<EndpointSessionCache> logger)
     {
+        _sharedTable = sharedTable;
         _logger = logger;
     }
 
@@ -45,6 +47,7 @@ public class EndpointSessionCache
     public void AddOrUpdateSession(CachedEndpointSession session)
     {
         _sessions.AddOrUpdate(session.SessionId, session, (_, _) => session);
+        PublishShared();
         _logger.LogDebug("Cached session {SessionId} for {UserName}", session.SessionId, session.UserName);
     }
 
@@ -53,6 +56,7 @@ public class EndpointSessionCache
         if (_sessions.TryGetValue(sessionId, out var session))
         {
             session.Revoked = true;
+            PublishShared();
             _logger.LogInformation("Revoked cached session {SessionId}", sessionId);
             return true;
         }
@@ -71,10 +75,16 @@ public class EndpointSessionCache
             _sessions.TryRemove(key, out _);
 
         if (expired.Count > 0)
+        {
+            PublishShared();
             _logger.LogDebug("Cleaned up {Count} expired/revoked sessions from cache", expired.Count);
+        }
     }
 
     public int ActiveSessionCount => _sessions.Count(kv => kv.Value.ExpiresAt > DateTimeOffset.UtcNow && !kv.Value.Revoked);
 
     public IEnumerable<CachedEndpointSession> GetAllSessions() => _sessions.Values;
+
+    // Enumerated lazily, inside the table's write lock, so a publish never undoes a later change
+    private void PublishShared() => _sharedTable.Publish(_sessions.Select(kv => kv.Value));
 }
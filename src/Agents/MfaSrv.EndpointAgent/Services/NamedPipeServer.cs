@@ -1,7 +1,7 @@
+using System.Buffers;
 using System.IO.Pipes;
 using System.Security.AccessControl;
 using System.Security.Principal;
-using System.Text;
 using System.Text.Json;
 using System.Text.Json.Serialization;
 using Microsoft.Extensions.Hosting;
@@ -20,16 +20,8 @@ public class NamedPipeServer : BackgroundService
     private readonly EndpointAgentSettings _settings;
     private readonly ILogger<NamedPipeServer> _logger;
 
-    private static readonly JsonSerializerOptions ReadOptions = new()
-    {
-        PropertyNameCaseInsensitive = true
-    };
-
-    private static readonly JsonSerializerOptions WriteOptions = new()
-    {
-        PropertyNamingPolicy = JsonNamingPolicy.CamelCase,
-        DefaultIgnoreCondition = JsonIgnoreCondition.WhenWritingNull
-    };
+    private const int PipeBufferSize = 4096;
+    private const int MaxMessageSize = 64 * 1024;
 
     public NamedPipeServer(
         CentralServerClient centralServerClient,
@@ -71,7 +63,7 @@ public class NamedPipeServer : BackgroundService
                     NamedPipeServerStream.MaxAllowedServerInstances,
                     PipeTransmissionMode.Message,
                     PipeOptions.Asynchronous,
-                    4096, 4096,
+                    PipeBufferSize, PipeBufferSize,
                     pipeSecurity);
 
                 await pipeServer.WaitForConnectionAsync(stoppingToken);
@@ -93,51 +85,64 @@ public class NamedPipeServer : BackgroundService
         _logger.LogInformation("Named pipe server stopped");
     }
 
+    /// <summary>
+    /// Serves messages on one connection until the client closes it, so the Credential Provider
+    /// can follow a <c>preauth</c> with <c>submit_mfa</c> without reconnecting. Each message,
+    /// including the wait for it, gets <see cref="EndpointAgentSettings.PipeTimeoutMs"/>.
+    /// </summary>
     private async Task HandleConnectionAsync(NamedPipeServerStream pipe, CancellationToken ct)
     {
         try
         {
             using (pipe)
             {
-                using var cts = CancellationTokenSource.CreateLinkedTokenSource(ct);
-                cts.CancelAfter(_settings.PipeTimeoutMs);
-
-                // Read the incoming message
-                var buffer = new byte[4096];
-                var bytesRead = await pipe.ReadAsync(buffer, cts.Token);
-
-                if (bytesRead == 0) return;
-
-                var json = Encoding.UTF8.GetString(buffer, 0, bytesRead);
-                var message = JsonSerializer.Deserialize<PipeMessage>(json, ReadOptions);
-
-                if (message == null)
+                while (pipe.IsConnected)
                 {
-                    _logger.LogWarning("Received invalid message from named pipe");
-                    return;
-                }
+                    using var cts = CancellationTokenSource.CreateLinkedTokenSource(ct);
+                    cts.CancelAfter(_settings.PipeTimeoutMs);
 
-                _logger.LogDebug("Pipe message received: type={Type}", message.Type);
+                    // Read the incoming message into a pooled buffer and deserialize straight from UTF-8
+                    var (buffer, length) = await ReadMessageAsync(pipe, cts.Token);
+                    PipeMessage? message;
+                    try
+                    {
+                        if (length == 0) return;
+                        message = JsonSerializer.Deserialize(
+                            buffer.AsSpan(0, length), EndpointPipeJsonContext.Default.PipeMessage);
+                    }
+                    finally
+                    {
+                        ArrayPool<byte>.Shared.Return(buffer);
+                    }
 
-                // Route to appropriate handler
-                var responseJson = message.Type?.ToLowerInvariant() switch
-                {
-                    "preauth" => await HandlePreAuthAsync(message, cts.Token),
-                    "submit_mfa" => await HandleSubmitMfaAsync(message, cts.Token),
-                    "check_status" => await HandleCheckStatusAsync(message, cts.Token),
-                    "fido2_begin" => await HandleFido2BeginAsync(message, cts.Token),
-                    "fido2_complete" => await HandleFido2CompleteAsync(message, cts.Token),
-                    _ => JsonSerializer.Serialize(new PipeResponse
+                    if (message == null)
                     {
-                        Success = false,
-                        Error = $"Unknown message type: {message.Type}"
-                    }, WriteOptions)
-                };
+                        _logger.LogWarning("Received invalid message from named pipe");
+                        return;
+                    }
 
-                // Send response
-                var responseBytes = Encoding.UTF8.GetBytes(responseJson);
-                await pipe.WriteAsync(responseBytes, cts.Token);
-                await pipe.FlushAsync(cts.Token);
+                    _logger.LogDebug("Pipe message received: type={Type}", message.Type);
+
+                    // Route to appropriate handler
+                    PipeResponse response = message.Type?.ToLowerInvariant() switch
+                    {
+                        "preauth" => await HandlePreAuthAsync(message, cts.Token),
+                        "submit_mfa" => await HandleSubmitMfaAsync(message, cts.Token),
+                        "check_status" => await HandleCheckStatusAsync(message, cts.Token),
+                        "fido2_begin" => await HandleFido2BeginAsync(message, cts.Token),
+                        "fido2_complete" => await HandleFido2CompleteAsync(message, cts.Token),
+                        _ => new PipeResponse
+                        {
+                            Success = false,
+                            Error = $"Unknown message type: {message.Type}"
+                        }
+                    };
+
+                    // Send response (serialized by runtime type into a pooled buffer, one pipe message)
+                    await JsonSerializer.SerializeAsync(
+                        pipe, response, response.GetType(), EndpointPipeJsonContext.Default, cts.Token);
+                    await pipe.FlushAsync(cts.Token);
+                }
             }
         }
         catch (OperationCanceledException)
@@ -150,7 +155,7 @@ public class NamedPipeServer : BackgroundService
         }
     }
 
-    private async Task<string> HandlePreAuthAsync(PipeMessage message, CancellationToken ct)
+    private async Task<PipeResponse> HandlePreAuthAsync(PipeMessage message, CancellationToken ct)
     {
         try
         {
@@ -163,24 +168,24 @@ public class NamedPipeServer : BackgroundService
             if (cachedSession != null)
             {
                 _logger.LogDebug("Found cached session for {User}, MFA not required", userName);
-                return JsonSerializer.Serialize(new PreAuthPipeResponse
+                return new PreAuthPipeResponse
                 {
                     Success = true,
                     MfaRequired = false,
                     Reason = "Cached MFA session valid"
-                }, WriteOptions);
+                };
             }
 
             // If Central Server is unavailable, use failover logic
             if (!_failoverManager.IsCentralServerAvailable)
             {
                 var failover = _failoverManager.GetFailoverDecision(userName);
-                return JsonSerializer.Serialize(new PreAuthPipeResponse
+                return new PreAuthPipeResponse
                 {
                     Success = true,
                     MfaRequired = !failover.Allow,
                     Reason = failover.Reason
-                }, WriteOptions);
+                };
             }
 
             // Call Central Server
@@ -190,12 +195,12 @@ public class NamedPipeServer : BackgroundService
             {
                 // Server unreachable - apply failover
                 var failover = _failoverManager.GetFailoverDecision(userName);
-                return JsonSerializer.Serialize(new PreAuthPipeResponse
+                return new PreAuthPipeResponse
                 {
                     Success = true,
                     MfaRequired = !failover.Allow,
                     Reason = failover.Reason
-                }, WriteOptions);
+                };
             }
 
             var mfaRequired = response.Decision == AuthDecisionType.AuthDecisionRequireMfa;
@@ -227,7 +232,7 @@ public class NamedPipeServer : BackgroundService
                     domain);
             }
 
-            return JsonSerializer.Serialize(new PreAuthPipeResponse
+            return new PreAuthPipeResponse
             {
                 Success = true,
                 MfaRequired = mfaRequired,
@@ -235,21 +240,21 @@ public class NamedPipeServer : BackgroundService
                 Method = mfaRequired ? response.RequiredMethod : null,
                 Reason = response.Reason,
                 TimeoutMs = response.TimeoutMs
-            }, WriteOptions);
+            };
         }
         catch (Exception ex)
         {
             _logger.LogError(ex, "Error in PreAuth handler - fail-open");
-            return JsonSerializer.Serialize(new PreAuthPipeResponse
+            return new PreAuthPipeResponse
             {
                 Success = true,
                 MfaRequired = false,
                 Reason = "Error during pre-authentication - fail-open"
-            }, WriteOptions);
+            };
         }
     }
 
-    private async Task<string> HandleSubmitMfaAsync(PipeMessage message, CancellationToken ct)
+    private async Task<PipeResponse> HandleSubmitMfaAsync(PipeMessage message, CancellationToken ct)
     {
         try
         {
@@ -258,22 +263,22 @@ public class NamedPipeServer : BackgroundService
 
             if (string.IsNullOrEmpty(challengeId))
             {
-                return JsonSerializer.Serialize(new PipeResponse
+                return new PipeResponse
                 {
                     Success = false,
                     Error = "Missing challengeId"
-                }, WriteOptions);
+                };
             }
 
             var result = await _centralServerClient.SubmitMfaAsync(challengeId, mfaResponse, ct);
 
             if (result == null)
             {
-                return JsonSerializer.Serialize(new PipeResponse
+                return new PipeResponse
                 {
                     Success = false,
                     Error = "Central server unavailable"
-                }, WriteOptions);
+                };
             }
 
             // If MFA was successful and we got a session token, cache it
@@ -290,24 +295,24 @@ public class NamedPipeServer : BackgroundService
                 });
             }
 
-            return JsonSerializer.Serialize(new PipeResponse
+            return new PipeResponse
             {
                 Success = result.Success,
                 Error = result.Error
-            }, WriteOptions);
+            };
         }
         catch (Exception ex)
         {
             _logger.LogError(ex, "Error in SubmitMfa handler");
-            return JsonSerializer.Serialize(new PipeResponse
+            return new PipeResponse
             {
                 Success = false,
                 Error = "Internal error submitting MFA"
-            }, WriteOptions);
+            };
         }
     }
 
-    private async Task<string> HandleCheckStatusAsync(PipeMessage message, CancellationToken ct)
+    private async Task<PipeResponse> HandleCheckStatusAsync(PipeMessage message, CancellationToken ct)
     {
         try
         {
@@ -315,22 +320,22 @@ public class NamedPipeServer : BackgroundService
 
             if (string.IsNullOrEmpty(challengeId))
             {
-                return JsonSerializer.Serialize(new CheckStatusPipeResponse
+                return new CheckStatusPipeResponse
                 {
                     Success = false,
                     Error = "Missing challengeId"
-                }, WriteOptions);
+                };
             }
 
             var result = await _centralServerClient.CheckStatusAsync(challengeId, ct);
 
             if (result == null)
             {
-                return JsonSerializer.Serialize(new CheckStatusPipeResponse
+                return new CheckStatusPipeResponse
                 {
                     Success = false,
                     Error = "Central server unavailable"
-                }, WriteOptions);
+                };
             }
 
             var completed = result.Status == ChallengeStatusType.ChallengeStatusApproved
@@ -340,23 +345,23 @@ public class NamedPipeServer : BackgroundService
 
             var approved = result.Status == ChallengeStatusType.ChallengeStatusApproved;
 
-            return JsonSerializer.Serialize(new CheckStatusPipeResponse
+            return new CheckStatusPipeResponse
             {
                 Success = true,
                 Status = result.Status.ToString(),
                 Completed = completed,
                 Approved = approved,
                 Error = result.Error
-            }, WriteOptions);
+            };
         }
         catch (Exception ex)
         {
             _logger.LogError(ex, "Error in CheckStatus handler");
-            return JsonSerializer.Serialize(new CheckStatusPipeResponse
+            return new CheckStatusPipeResponse
             {
                 Success = false,
                 Error = "Internal error checking status"
-            }, WriteOptions);
+            };
         }
     }
     /// <summary>
@@ -364,7 +369,7 @@ public class NamedPipeServer : BackgroundService
     /// Starts a local FIDO2 assertion flow by requesting challenge options
     /// from the Central Server (or using a pre-registered challenge).
     /// </summary>
-    private async Task<string> HandleFido2BeginAsync(PipeMessage message, CancellationToken ct)
+    private async Task<PipeResponse> HandleFido2BeginAsync(PipeMessage message, CancellationToken ct)
     {
         try
         {
@@ -374,23 +379,23 @@ public class NamedPipeServer : BackgroundService
 
             var result = await _yubiKeyService.BeginAssertionAsync(userName, domain, challengeId, ct);
 
-            return JsonSerializer.Serialize(new Fido2BeginPipeResponse
+            return new Fido2BeginPipeResponse
             {
                 Success = result.Success,
                 ChallengeId = result.ChallengeId,
                 AssertionOptionsJson = result.AssertionOptionsJson,
                 TimeoutMs = result.TimeoutMs,
                 Error = result.Error
-            }, WriteOptions);
+            };
         }
         catch (Exception ex)
         {
             _logger.LogError(ex, "Error in Fido2Begin handler");
-            return JsonSerializer.Serialize(new Fido2BeginPipeResponse
+            return new Fido2BeginPipeResponse
             {
                 Success = false,
                 Error = "Internal error starting FIDO2 assertion"
-            }, WriteOptions);
+            };
         }
     }
 
@@ -399,7 +404,7 @@ public class NamedPipeServer : BackgroundService
     /// Forwards the authenticator assertion response to the Central Server
     /// for cryptographic verification.
     /// </summary>
-    private async Task<string> HandleFido2CompleteAsync(PipeMessage message, CancellationToken ct)
+    private async Task<PipeResponse> HandleFido2CompleteAsync(PipeMessage message, CancellationToken ct)
     {
         try
         {
@@ -408,39 +413,78 @@ public class NamedPipeServer : BackgroundService
 
             if (string.IsNullOrEmpty(challengeId))
             {
-                return JsonSerializer.Serialize(new PipeResponse
+                return new PipeResponse
                 {
                     Success = false,
                     Error = "Missing challengeId"
-                }, WriteOptions);
+                };
             }
 
             if (string.IsNullOrEmpty(assertionResponse))
             {
-                return JsonSerializer.Serialize(new PipeResponse
+                return new PipeResponse
                 {
                     Success = false,
                     Error = "Missing assertion response"
-                }, WriteOptions);
+                };
             }
 
             var result = await _yubiKeyService.CompleteAssertionAsync(challengeId, assertionResponse, ct);
 
-            return JsonSerializer.Serialize(new Fido2CompletePipeResponse
+            return new Fido2CompletePipeResponse
             {
                 Success = result.Success,
                 SessionToken = result.SessionToken,
                 Error = result.Error
-            }, WriteOptions);
+            };
         }
         catch (Exception ex)
         {
             _logger.LogError(ex, "Error in Fido2Complete handler");
-            return JsonSerializer.Serialize(new Fido2CompletePipeResponse
+            return new Fido2CompletePipeResponse
             {
                 Success = false,
                 Error = "Internal error completing FIDO2 assertion"
-            }, WriteOptions);
+            };
+        }
+    }
+
+    /// <summary>
+    /// Reads one complete pipe message into a buffer rented from <see cref="ArrayPool{T}.Shared"/>,
+    /// growing it while the message is incomplete. The caller must return the buffer to the pool.
+    /// </summary>
+    private static async ValueTask<(byte[] Buffer, int Length)> ReadMessageAsync(PipeStream pipe, CancellationToken ct)
+    {
+        var buffer = ArrayPool<byte>.Shared.Rent(PipeBufferSize);
+        var length = 0;
+
+        try
+        {
+            do
+            {
+                if (length == buffer.Length)
+                {
+                    if (buffer.Length >= MaxMessageSize)
+                        throw new InvalidDataException($"Pipe message exceeds {MaxMessageSize} bytes");
+
+                    var larger = ArrayPool<byte>.Shared.Rent(buffer.Length * 2);
+                    buffer.AsSpan(0, length).CopyTo(larger);
+                    ArrayPool<byte>.Shared.Return(buffer);
+                    buffer = larger;
+                }
+
+                var bytesRead = await pipe.ReadAsync(buffer.AsMemory(length), ct);
+                if (bytesRead == 0) break;
+                length += bytesRead;
+            }
+            while (!pipe.IsMessageComplete);
+
+            return (buffer, length);
+        }
+        catch
+        {
+            ArrayPool<byte>.Shared.Return(buffer);
+            throw;
         }
     }
 }
@@ -463,38 +507,48 @@ internal class PipeResponse
     public string? Error { get; set; }
 }
 
-internal class PreAuthPipeResponse
+internal class PreAuthPipeResponse : PipeResponse
 {
-    public bool Success { get; set; }
     public bool MfaRequired { get; set; }
     public string? ChallengeId { get; set; }
     public string? Method { get; set; }
     public string? Reason { get; set; }
     public int TimeoutMs { get; set; }
-    public string? Error { get; set; }
 }
 
-internal class CheckStatusPipeResponse
+internal class CheckStatusPipeResponse : PipeResponse
 {
-    public bool Success { get; set; }
     public string? Status { get; set; }
     public bool Completed { get; set; }
     public bool Approved { get; set; }
-    public string? Error { get; set; }
 }
 
-internal class Fido2BeginPipeResponse
+internal class Fido2BeginPipeResponse : PipeResponse
 {
-    public bool Success { get; set; }
     public string? ChallengeId { get; set; }
     public string? AssertionOptionsJson { get; set; }
     public int TimeoutMs { get; set; }
-    public string? Error { get; set; }
 }
 
-internal class Fido2CompletePipeResponse
+internal class Fido2CompletePipeResponse : PipeResponse
 {
-    public bool Success { get; set; }
     public string? SessionToken { get; set; }
-    public string? Error { get; set; }
+}
+
+/// <summary>
+/// Source-generated serialization metadata for the Credential Provider pipe DTOs,
+/// so each message is (de)serialized without reflection or per-call options.
+/// </summary>
+[JsonSourceGenerationOptions(
+    PropertyNamingPolicy = JsonKnownNamingPolicy.CamelCase,
+    PropertyNameCaseInsensitive = true,
+    DefaultIgnoreCondition = JsonIgnoreCondition.WhenWritingNull)]
+[JsonSerializable(typeof(PipeMessage))]
+[JsonSerializable(typeof(PipeResponse))]
+[JsonSerializable(typeof(PreAuthPipeResponse))]
+[JsonSerializable(typeof(CheckStatusPipeResponse))]
+[JsonSerializable(typeof(Fido2BeginPipeResponse))]
+[JsonSerializable(typeof(Fido2CompletePipeResponse))]
+internal partial class EndpointPipeJsonContext : JsonSerializerContext
+{
 }
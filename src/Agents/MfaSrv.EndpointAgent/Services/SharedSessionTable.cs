@@ -0,0 +1,268 @@
+using System.ComponentModel;
+using System.Runtime.InteropServices;
+using System.Text;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using Microsoft.Win32.SafeHandles;
+
+namespace MfaSrv.EndpointAgent.Services;
+
+/// <summary>
+/// Publishes the users with a valid MFA session on this machine in a named shared-memory
+/// section (<see cref="MappingName"/>), so the credential provider can approve an unlock
+/// without a pipe round trip, even while this service is busy. Layout matches
+/// <c>SessionTable.h</c> in <c>MfaSrv.EndpointAgent.Native</c>:
+///
+///   header (64 bytes): magic, version, sequence, slot count, used count
+///   slots (128 bytes each): expiry as a UTC FILETIME, then the lower-cased user name in UTF-8
+///
+/// Updates are seqlocked: the sequence is odd while slots are being rewritten, and readers
+/// retry if it is odd or changed across their read. The section is created under
+/// <c>Global\</c> with <see cref="SecurityDescriptor"/>: owned by SYSTEM, which alone may map
+/// it. The service and LogonUI, the credential provider's host, both run as SYSTEM; only the
+/// service maps it writable, and the reader trusts it only if SYSTEM owns it.
+/// </summary>
+public sealed class SharedSessionTable : IDisposable
+{
+    public const string MappingName = @"Global\MfaSrvEndpointSessions";
+    public const uint Magic = 0x5453464D; // "MFST"
+    public const uint LayoutVersion = 1;
+    public const int SlotCount = 64;
+    public const int HeaderSize = 64;
+    public const int SlotSize = 128;
+    public const int TableSize = HeaderSize + SlotCount * SlotSize;
+    public const int MaxUserNameBytes = SlotSize - 8 - 1;
+
+    /// <summary>
+    /// Owner and group SYSTEM; a protected DACL granting SYSTEM read and write and no one
+    /// else anything. Setting SYSTEM as owner fails unless the service runs as SYSTEM.
+    /// </summary>
+    public const string SecurityDescriptor = "O:SYG:SYD:P(A;;GRGW;;;SY)";
+
+    private const int SequenceOffset = 8;
+    private const int SlotCountOffset = 16;
+    private const int UsedCountOffset = 20;
+
+    private readonly object _writeLock = new();
+    private readonly ILogger<SharedSessionTable> _logger;
+    private readonly SafeMappingHandle? _mapping;
+    private readonly UnmanagedMemoryAccessor? _view;
+    private readonly byte[] _nameBuffer = new byte[SlotSize - 8];
+    private long _sequence;
+
+    public SharedSessionTable(IOptions<EndpointAgentSettings> settings, ILogger<SharedSessionTable> logger)
+    {
+        _logger = logger;
+
+        if (!settings.Value.SharedSessionTableEnabled)
+            return;
+
+        try
+        {
+            _mapping = CreateMapping();
+            _view = MapView(_mapping);
+            WriteHeader(_view);
+            _logger.LogInformation("Publishing local MFA sessions in {Mapping}", MappingName);
+        }
+        catch (Exception ex)
+        {
+            _logger.LogError(ex, "Could not create shared session table {Mapping}; the credential provider will use the pipe only",
+                MappingName);
+            _view?.Dispose();
+            _mapping?.Dispose();
+            _view = null;
+            _mapping = null;
+        }
+    }
+
+    /// <summary>
+    /// Publishes into <paramref name="view"/>, which must hold <see cref="TableSize"/> bytes
+    /// and stays owned by the caller.
+    /// </summary>
+    public SharedSessionTable(UnmanagedMemoryAccessor view, ILogger<SharedSessionTable> logger)
+    {
+        _logger = logger;
+        _view = view;
+        WriteHeader(_view);
+    }
+
+    public bool IsEnabled => _view != null;
+
+    /// <summary>
+    /// Rewrites the table with the unexpired, unrevoked sessions for this machine. Sessions are
+    /// enumerated under the write lock, so the last of concurrent callers publishes the latest state.
+    /// Users beyond <see cref="SlotCount"/>, or with longer names, are left to the pipe.
+    /// </summary>
+    public void Publish(IEnumerable<CachedEndpointSession> sessions)
+    {
+        if (_view == null)
+            return;
+
+        lock (_writeLock)
+        {
+            var now = DateTimeOffset.UtcNow;
+
+            BeginWrite();
+            var used = 0;
+            try
+            {
+                foreach (var session in sessions)
+                {
+                    if (used == SlotCount)
+                        break;
+                    if (session.Revoked || session.ExpiresAt <= now ||
+                        !session.Workstation.Equals(Environment.MachineName, StringComparison.OrdinalIgnoreCase))
+                        continue;
+
+                    var user = session.UserName.ToLowerInvariant();
+                    if (user.Length == 0 || Encoding.UTF8.GetByteCount(user) > MaxUserNameBytes)
+                        continue;
+
+                    Array.Clear(_nameBuffer);
+                    Encoding.UTF8.GetBytes(user, _nameBuffer);
+
+                    long slot = HeaderSize + (long)used * SlotSize;
+                    _view.Write(slot, session.ExpiresAt.ToFileTime());
+                    _view.WriteArray(slot + 8, _nameBuffer, 0, _nameBuffer.Length);
+                    used++;
+                }
+            }
+            finally
+            {
+                _view.Write(UsedCountOffset, (uint)used);
+                EndWrite();
+            }
+        }
+    }
+
+    private static void WriteHeader(UnmanagedMemoryAccessor view)
+    {
+        view.Write(0, Magic);
+        view.Write(4, LayoutVersion);
+        view.Write(SlotCountOffset, (uint)SlotCount);
+    }
+
+    private static SafeMappingHandle CreateMapping()
+    {
+        if (!NativeMethods.ConvertStringSecurityDescriptorToSecurityDescriptorW(
+                SecurityDescriptor, NativeMethods.SDDL_REVISION_1, out var descriptor, IntPtr.Zero))
+            throw new Win32Exception(Marshal.GetLastPInvokeError());
+
+        try
+        {
+            var attributes = new NativeMethods.SECURITY_ATTRIBUTES
+            {
+                nLength = Marshal.SizeOf<NativeMethods.SECURITY_ATTRIBUTES>(),
+                lpSecurityDescriptor = descriptor
+            };
+
+            var mapping = NativeMethods.CreateFileMappingW(
+                NativeMethods.INVALID_HANDLE_VALUE, ref attributes, NativeMethods.PAGE_READWRITE, 0, TableSize, MappingName);
+            var error = Marshal.GetLastPInvokeError();
+            if (mapping.IsInvalid)
+                throw new Win32Exception(error);
+
+            // A section planted before the service started is never written to (or trusted,
+            // as the reader checks its owner)
+            if (error == NativeMethods.ERROR_ALREADY_EXISTS)
+            {
+                mapping.Dispose();
+                throw new IOException($"{MappingName} already exists");
+            }
+
+            return mapping;
+        }
+        finally
+        {
+            NativeMethods.LocalFree(descriptor);
+        }
+    }
+
+    private static UnmanagedMemoryAccessor MapView(SafeMappingHandle mapping)
+    {
+        var view = NativeMethods.MapViewOfFile(mapping, NativeMethods.FILE_MAP_WRITE, 0, 0, (UIntPtr)TableSize);
+        if (view.IsInvalid)
+        {
+            var error = Marshal.GetLastPInvokeError();
+            view.Dispose();
+            throw new Win32Exception(error);
+        }
+
+        view.Initialize(TableSize);
+        return new UnmanagedMemoryAccessor(view, 0, TableSize, FileAccess.ReadWrite);
+    }
+
+    // x64 keeps stores in order; the fences stop the JIT moving slot writes across the sequence
+    private void BeginWrite()
+    {
+        _view!.Write(SequenceOffset, ++_sequence);
+        Interlocked.MemoryBarrier();
+    }
+
+    private void EndWrite()
+    {
+        Interlocked.MemoryBarrier();
+        _view!.Write(SequenceOffset, ++_sequence);
+    }
+
+    public void Dispose()
+    {
+        if (_mapping == null)
+            return; // The view is the caller's
+
+        _view?.Dispose();
+        _mapping.Dispose();
+    }
+
+    private sealed class SafeMappingHandle : SafeHandleZeroOrMinusOneIsInvalid
+    {
+        public SafeMappingHandle() : base(ownsHandle: true) { }
+
+        protected override bool ReleaseHandle() => NativeMethods.CloseHandle(handle);
+    }
+
+    private sealed class SafeMappedView : SafeBuffer
+    {
+        public SafeMappedView() : base(ownsHandle: true) { }
+
+        protected override bool ReleaseHandle() => NativeMethods.UnmapViewOfFile(handle);
+    }
+
+    private static class NativeMethods
+    {
+        public const uint SDDL_REVISION_1 = 1;
+        public const uint PAGE_READWRITE = 0x04;
+        public const uint FILE_MAP_WRITE = 0x02;
+        public const int ERROR_ALREADY_EXISTS = 183;
+        public static readonly IntPtr INVALID_HANDLE_VALUE = new(-1);
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct SECURITY_ATTRIBUTES
+        {
+            public int nLength;
+            public IntPtr lpSecurityDescriptor;
+            public int bInheritHandle;
+        }
+
+        [DllImport("advapi32.dll", CharSet = CharSet.Unicode, SetLastError = true)]
+        public static extern bool ConvertStringSecurityDescriptorToSecurityDescriptorW(
+            string stringSecurityDescriptor, uint revision, out IntPtr securityDescriptor, IntPtr securityDescriptorSize);
+
+        [DllImport("kernel32.dll", CharSet = CharSet.Unicode, SetLastError = true)]
+        public static extern SafeMappingHandle CreateFileMappingW(
+            IntPtr file, ref SECURITY_ATTRIBUTES attributes, uint protect, uint maximumSizeHigh, uint maximumSizeLow, string name);
+
+        [DllImport("kernel32.dll", SetLastError = true)]
+        public static extern SafeMappedView MapViewOfFile(
+            SafeMappingHandle mapping, uint desiredAccess, uint fileOffsetHigh, uint fileOffsetLow, UIntPtr numberOfBytesToMap);
+
+        [DllImport("kernel32.dll", SetLastError = true)]
+        public static extern bool UnmapViewOfFile(IntPtr baseAddress);
+
+        [DllImport("kernel32.dll", SetLastError = true)]
+        public static extern bool CloseHandle(IntPtr handle);
+
+        [DllImport("kernel32.dll")]
+        public static extern IntPtr LocalFree(IntPtr memory);
+    }
+}
@@ -0,0 +1,159 @@
+using System.Collections.Concurrent;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.ValueObjects;
+
+namespace MfaSrv.Core.Challenges;
+
+/// <summary>
+/// Delivers the outcome of asynchronously resolved challenges (push approvals, FortiToken
+/// Mobile) to whoever is waiting for it.
+///
+/// Providers call <see cref="Complete"/> once when they learn the outcome, from a user callback
+/// or from their own batched upstream poller. Callers either await the outcome with
+/// <see cref="WaitAsync"/> or register a callback with <see cref="OnCompleted"/>, both keyed
+/// by challenge ID, instead of polling the provider. Outcomes are kept for
+/// <see cref="Retention"/> so late waiters still see them. State is per server instance.
+/// </summary>
+public sealed class ChallengeCompletionEngine
+{
+    public static readonly TimeSpan DefaultRetention = TimeSpan.FromMinutes(2);
+
+    /// <summary>
+    /// How long a challenge nobody completes is tracked. Challenges expire well before this.
+    /// </summary>
+    public static readonly TimeSpan MaxPendingAge = TimeSpan.FromMinutes(30);
+
+    private const int PruneEvery = 256;
+
+    private readonly ConcurrentDictionary<string, Entry> _entries = new(StringComparer.Ordinal);
+    private long _operations;
+
+    public ChallengeCompletionEngine()
+        : this(DefaultRetention)
+    {
+    }
+
+    public ChallengeCompletionEngine(TimeSpan retention)
+    {
+        Retention = retention;
+    }
+
+    public TimeSpan Retention { get; }
+
+    /// <summary>
+    /// Challenges with waiters or callbacks registered that have not completed yet.
+    /// </summary>
+    public int PendingCount => _entries.Count(e => !e.Value.Completion.Task.IsCompleted);
+
+    public int Count => _entries.Count;
+
+    /// <summary>
+    /// Records the final outcome of a challenge and wakes its waiters. Only the first outcome
+    /// counts; returns false if the challenge had already completed.
+    /// </summary>
+    public bool Complete(string challengeId, AsyncVerificationStatus outcome)
+    {
+        if (outcome.Status == ChallengeStatus.Issued)
+            throw new ArgumentException("An issued challenge has not completed", nameof(outcome));
+
+        var now = DateTimeOffset.UtcNow;
+        var entry = GetEntry(challengeId, now);
+        lock (entry)
+        {
+            if (entry.Completion.Task.IsCompleted)
+                return false;
+
+            // Set before the result so Prune never sees a completed entry without a timestamp
+            entry.CompletedAt = now;
+            return entry.Completion.TrySetResult(outcome);
+        }
+    }
+
+    public bool TryGetOutcome(string challengeId, out AsyncVerificationStatus outcome)
+    {
+        if (_entries.TryGetValue(challengeId, out var entry) && entry.Completion.Task.IsCompletedSuccessfully)
+        {
+            outcome = entry.Completion.Task.Result;
+            return true;
+        }
+
+        outcome = null!;
+        return false;
+    }
+
+    /// <summary>
+    /// Waits up to <paramref name="timeout"/> for the challenge to complete. Returns null if
+    /// it is still unresolved when the timeout elapses.
+    /// </summary>
+    public async Task<AsyncVerificationStatus?> WaitAsync(string challengeId, TimeSpan timeout, CancellationToken ct = default)
+    {
+        var task = GetEntry(challengeId, DateTimeOffset.UtcNow).Completion.Task;
+        if (task.IsCompleted)
+            return task.Result;
+
+        try
+        {
+            return await task.WaitAsync(timeout, ct);
+        }
+        catch (TimeoutException)
+        {
+            return null;
+        }
+    }
+
+    /// <summary>
+    /// Invokes <paramref name="callback"/> once the challenge completes, on a thread-pool
+    /// thread, or right away if it already has.
+    /// </summary>
+    public void OnCompleted(string challengeId, Action<AsyncVerificationStatus> callback)
+    {
+        GetEntry(challengeId, DateTimeOffset.UtcNow).Completion.Task.ContinueWith(
+            static (task, state) => ((Action<AsyncVerificationStatus>)state!)(task.Result),
+            callback,
+            CancellationToken.None,
+            TaskContinuationOptions.OnlyOnRanToCompletion,
+            TaskScheduler.Default);
+    }
+
+    /// <summary>
+    /// Forgets outcomes older than <see cref="Retention"/> and challenges that were never
+    /// completed within <see cref="MaxPendingAge"/>. Waiters of the latter time out normally.
+    /// </summary>
+    public int Prune(DateTimeOffset now)
+    {
+        var removed = 0;
+        foreach (var (challengeId, entry) in _entries)
+        {
+            var stale = entry.Completion.Task.IsCompleted
+                ? entry.CompletedAt + Retention <= now
+                : entry.CreatedAt + MaxPendingAge <= now;
+
+            if (stale && _entries.TryRemove(new KeyValuePair<string, Entry>(challengeId, entry)))
+                removed++;
+        }
+        return removed;
+    }
+
+    private Entry GetEntry(string challengeId, DateTimeOffset now)
+    {
+        if (Interlocked.Increment(ref _operations) % PruneEvery == 0)
+            Prune(now);
+
+        return _entries.GetOrAdd(challengeId, static (_, created) => new Entry(created), now);
+    }
+
+    private sealed class Entry
+    {
+        public Entry(DateTimeOffset createdAt)
+        {
+            CreatedAt = createdAt;
+        }
+
+        // Continuations run on the thread pool so Complete never runs waiter code inline
+        public readonly TaskCompletionSource<AsyncVerificationStatus> Completion =
+            new(TaskCreationOptions.RunContinuationsAsynchronously);
+
+        public readonly DateTimeOffset CreatedAt;
+        public DateTimeOffset CompletedAt;
+    }
+}
@@ -0,0 +1,291 @@
+using System.Buffers.Binary;
+
+namespace MfaSrv.Core.Collections;
+
+/// <summary>
+/// Cuckoo filter over 64-bit key hashes (4-slot buckets, 16-bit fingerprints).
+/// Lookup, insert and delete are O(1). There are no false negatives for keys that were
+/// added and not removed; the false-positive rate is roughly 8 / 2^16 (about 0.012%).
+///
+/// The filter is not thread-safe: owners must serialize mutations against lookups.
+/// The binary form produced by <see cref="ToBytes"/> is stable across processes, so the
+/// Central Server can ship the filter to agents and follow it with add/remove deltas.
+/// </summary>
+public sealed class CuckooFilter
+{
+    private const int SlotsPerBucket = 4;
+    private const int MaxKicks = 500;
+    private const double TargetLoadFactor = 0.9;
+    private const byte FormatVersion = 1;
+    private const int HeaderSize = 16;
+
+    private readonly ushort[] _slots;
+    private readonly uint _mask;
+    private int _count;
+    private bool _hasVictim;
+    private ushort _victimFingerprint;
+    private int _victimIndex;
+    private uint _kickState = 2463534242;
+
+    /// <summary>
+    /// Creates an empty filter sized to hold <paramref name="capacity"/> keys at ~90% load.
+    /// </summary>
+    public CuckooFilter(int capacity)
+        : this(BucketCountFor(capacity))
+    {
+    }
+
+    private CuckooFilter(uint bucketCount)
+    {
+        _slots = new ushort[bucketCount * SlotsPerBucket];
+        _mask = bucketCount - 1;
+    }
+
+    public int Count => _count;
+
+    /// <summary>
+    /// Number of keys the filter was sized for.
+    /// </summary>
+    public int Capacity => (int)(_slots.Length * TargetLoadFactor);
+
+    /// <summary>
+    /// True once an insert had to park a fingerprint in the victim stash. Further inserts
+    /// fail until the owner rebuilds the filter with more capacity.
+    /// </summary>
+    public bool IsFull => _hasVictim;
+
+    public bool Add(string key) => Add(Hash(key));
+
+    public bool Contains(string key) => Contains(Hash(key));
+
+    public bool Remove(string key) => Remove(Hash(key));
+
+    /// <summary>
+    /// Inserts a key hash. Returns false when the filter is full.
+    /// </summary>
+    public bool Add(ulong hash)
+    {
+        if (_hasVictim)
+            return false;
+
+        var fingerprint = Fingerprint(hash);
+        var index = PrimaryIndex(hash);
+        var altIndex = AltIndex(index, fingerprint);
+
+        if (TryInsert(index, fingerprint) || TryInsert(altIndex, fingerprint))
+        {
+            _count++;
+            return true;
+        }
+
+        // Both buckets full: evict a random resident to its alternate bucket and repeat
+        index = (NextKick() & 1) == 0 ? index : altIndex;
+        for (var kick = 0; kick < MaxKicks; kick++)
+        {
+            var slot = index * SlotsPerBucket + (int)(NextKick() % SlotsPerBucket);
+            (fingerprint, _slots[slot]) = (_slots[slot], fingerprint);
+
+            index = AltIndex(index, fingerprint);
+            if (TryInsert(index, fingerprint))
+            {
+                _count++;
+                return true;
+            }
+        }
+
+        // Out of kicks: keep the homeless fingerprint so nothing already added is lost
+        _hasVictim = true;
+        _victimFingerprint = fingerprint;
+        _victimIndex = index;
+        _count++;
+        return true;
+    }
+
+    public bool Contains(ulong hash)
+    {
+        var fingerprint = Fingerprint(hash);
+        var index = PrimaryIndex(hash);
+        var altIndex = AltIndex(index, fingerprint);
+
+        if (_hasVictim && _victimFingerprint == fingerprint
+            && (_victimIndex == index || _victimIndex == altIndex))
+            return true;
+
+        return BucketContains(index, fingerprint) || BucketContains(altIndex, fingerprint);
+    }
+
+    /// <summary>
+    /// Removes one occurrence of a key hash. Only remove keys that were previously added,
+    /// otherwise a colliding key may be removed instead.
+    /// </summary>
+    public bool Remove(ulong hash)
+    {
+        var fingerprint = Fingerprint(hash);
+        var index = PrimaryIndex(hash);
+        var altIndex = AltIndex(index, fingerprint);
+
+        if (_hasVictim && _victimFingerprint == fingerprint
+            && (_victimIndex == index || _victimIndex == altIndex))
+        {
+            _hasVictim = false;
+            _count--;
+            return true;
+        }
+
+        if (!TryDelete(index, fingerprint) && !TryDelete(altIndex, fingerprint))
+            return false;
+
+        _count--;
+
+        // A slot opened up; give the stashed fingerprint a home if it fits without kicking
+        if (_hasVictim
+            && (TryInsert(_victimIndex, _victimFingerprint)
+                || TryInsert(AltIndex(_victimIndex, _victimFingerprint), _victimFingerprint)))
+        {
+            _hasVictim = false;
+        }
+
+        return true;
+    }
+
+    /// <summary>
+    /// Serializes the filter: a 16-byte little-endian header followed by the fingerprint table.
+    /// </summary>
+    public byte[] ToBytes()
+    {
+        var bytes = new byte[HeaderSize + _slots.Length * sizeof(ushort)];
+        var span = bytes.AsSpan();
+
+        span[0] = FormatVersion;
+        span[1] = _hasVictim ? (byte)1 : (byte)0;
+        BinaryPrimitives.WriteUInt16LittleEndian(span[2..], _victimFingerprint);
+        BinaryPrimitives.WriteInt32LittleEndian(span[4..], _victimIndex);
+        BinaryPrimitives.WriteUInt32LittleEndian(span[8..], _mask + 1);
+        BinaryPrimitives.WriteInt32LittleEndian(span[12..], _count);
+
+        var table = span[HeaderSize..];
+        for (var i = 0; i < _slots.Length; i++)
+            BinaryPrimitives.WriteUInt16LittleEndian(table[(i * sizeof(ushort))..], _slots[i]);
+
+        return bytes;
+    }
+
+    /// <summary>
+    /// Restores a filter produced by <see cref="ToBytes"/>.
+    /// </summary>
+    /// <exception cref="FormatException">The data is truncated or not a filter.</exception>
+    public static CuckooFilter FromBytes(ReadOnlySpan<byte> data)
+    {
+        if (data.Length < HeaderSize || data[0] != FormatVersion)
+            throw new FormatException("Unrecognized cuckoo filter format");
+
+        var bucketCount = BinaryPrimitives.ReadUInt32LittleEndian(data[8..]);
+        if (bucketCount == 0 || (bucketCount & (bucketCount - 1)) != 0
+            || data.Length != HeaderSize + (long)bucketCount * SlotsPerBucket * sizeof(ushort))
+            throw new FormatException("Cuckoo filter table size does not match header");
+
+        var filter = new CuckooFilter(bucketCount)
+        {
+            _hasVictim = data[1] != 0,
+            _victimFingerprint = BinaryPrimitives.ReadUInt16LittleEndian(data[2..]),
+            _victimIndex = BinaryPrimitives.ReadInt32LittleEndian(data[4..]),
+            _count = BinaryPrimitives.ReadInt32LittleEndian(data[12..])
+        };
+
+        var table = data[HeaderSize..];
+        for (var i = 0; i < filter._slots.Length; i++)
+            filter._slots[i] = BinaryPrimitives.ReadUInt16LittleEndian(table[(i * sizeof(ushort))..]);
+
+        return filter;
+    }
+
+    /// <summary>
+    /// Stable 64-bit hash of a key (FNV-1a with a SplitMix64 finalizer). Unlike
+    /// <see cref="string.GetHashCode()"/> it is identical in every process, so hashes
+    /// computed on the server match lookups on the agents.
+    /// </summary>
+    public static ulong Hash(string key)
+    {
+        var hash = 14695981039346656037UL;
+        foreach (var c in key)
+        {
+            hash ^= c;
+            hash *= 1099511628211UL;
+        }
+
+        hash ^= hash >> 30;
+        hash *= 0xBF58476D1CE4E5B9UL;
+        hash ^= hash >> 27;
+        hash *= 0x94D049BB133111EBUL;
+        hash ^= hash >> 31;
+        return hash;
+    }
+
+    private static uint BucketCountFor(int capacity)
+    {
+        var buckets = (uint)Math.Ceiling(Math.Max(1, capacity) / (SlotsPerBucket * TargetLoadFactor));
+        return Math.Max(8u, System.Numerics.BitOperations.RoundUpToPowerOf2(buckets));
+    }
+
+    private static ushort Fingerprint(ulong hash)
+    {
+        // 0 marks an empty slot
+        var fingerprint = (ushort)(hash >> 48);
+        return fingerprint == 0 ? (ushort)1 : fingerprint;
+    }
+
+    private int PrimaryIndex(ulong hash) => (int)((uint)hash & _mask);
+
+    // Partial-key cuckoo hashing: the alternate bucket depends only on the current bucket
+    // and the fingerprint, and applying it twice returns the original bucket.
+    private int AltIndex(int index, ushort fingerprint) =>
+        (int)(((uint)index ^ (fingerprint * 0x5BD1E995u)) & _mask);
+
+    private bool TryInsert(int index, ushort fingerprint)
+    {
+        var start = index * SlotsPerBucket;
+        for (var i = start; i < start + SlotsPerBucket; i++)
+        {
+            if (_slots[i] == 0)
+            {
+                _slots[i] = fingerprint;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    private bool TryDelete(int index, ushort fingerprint)
+    {
+        var start = index * SlotsPerBucket;
+        for (var i = start; i < start + SlotsPerBucket; i++)
+        {
+            if (_slots[i] == fingerprint)
+            {
+                _slots[i] = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    private bool BucketContains(int index, ushort fingerprint)
+    {
+        var start = index * SlotsPerBucket;
+        return _slots[start] == fingerprint || _slots[start + 1] == fingerprint
+            || _slots[start + 2] == fingerprint || _slots[start + 3] == fingerprint;
+    }
+
+    // xorshift32 picks which slot to evict. The state is not serialized, so a filter loaded from
+    // a snapshot may place later entries differently from the server's; lookups and removals
+    // search both candidate buckets, so membership answers do not depend on placement.
+    private uint NextKick()
+    {
+        var x = _kickState;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        _kickState = x;
+        return x;
+    }
+}
@@ -0,0 +1,105 @@
+namespace MfaSrv.Core.Collections;
+
+/// <summary>
+/// Consistent-hash ring over named nodes. Each node is placed at <c>virtualNodes</c> points;
+/// a key is owned by the first distinct nodes clockwise from its hash. Adding or removing one
+/// of N nodes moves only about 1/N of the keys. With 64 points per node the busiest of a dozen
+/// nodes is primary for up to ~30% more keys than the average; counting two owners per key it
+/// stays within ~10%.
+///
+/// Points are derived from <see cref="CuckooFilter.Hash"/> of the node name, so every process
+/// that builds a ring from the same node names agrees on the owners of every key. Immutable
+/// and thread-safe once built.
+/// </summary>
+public sealed class HashRing
+{
+    private readonly string[] _nodes;
+    private readonly ulong[] _points;
+    private readonly int[] _owners;
+
+    public HashRing(IEnumerable<string> nodes, int virtualNodes = 64)
+    {
+        _nodes = nodes.Distinct(StringComparer.Ordinal).OrderBy(n => n, StringComparer.Ordinal).ToArray();
+        var perNode = Math.Max(1, virtualNodes);
+
+        var points = new List<(ulong Point, int Node)>(_nodes.Length * perNode);
+        for (var node = 0; node < _nodes.Length; node++)
+        {
+            for (var i = 0; i < perNode; i++)
+                points.Add((CuckooFilter.Hash($"{_nodes[node]}#{i}"), node));
+        }
+        points.Sort();
+
+        _points = points.Select(p => p.Point).ToArray();
+        _owners = points.Select(p => p.Node).ToArray();
+    }
+
+    /// <summary>
+    /// Node names in ordinal order.
+    /// </summary>
+    public IReadOnlyList<string> Nodes => _nodes;
+
+    /// <summary>
+    /// Writes up to <paramref name="owners"/>.Length distinct owners of a key, primary first,
+    /// and returns how many were written (fewer when the ring has fewer nodes).
+    /// </summary>
+    public int GetOwners(ulong keyHash, Span<int> owners)
+    {
+        if (_points.Length == 0 || owners.Length == 0)
+            return 0;
+
+        var wanted = Math.Min(owners.Length, _nodes.Length);
+        var found = 0;
+        var index = LowerBound(keyHash);
+        for (var step = 0; step < _points.Length && found < wanted; step++)
+        {
+            var node = _owners[(index + step) % _points.Length];
+            if (!owners[..found].Contains(node))
+                owners[found++] = node;
+        }
+        return found;
+    }
+
+    /// <summary>
+    /// Distinct owners of a key, primary first.
+    /// </summary>
+    public IReadOnlyList<string> GetOwners(ulong keyHash, int replicas)
+    {
+        Span<int> owners = stackalloc int[Math.Clamp(replicas, 0, Math.Min(_nodes.Length, 64))];
+        var count = GetOwners(keyHash, owners);
+
+        var names = new string[count];
+        for (var i = 0; i < count; i++)
+            names[i] = _nodes[owners[i]];
+        return names;
+    }
+
+    /// <summary>
+    /// True if <paramref name="node"/> is one of the first <paramref name="replicas"/> owners of a key.
+    /// </summary>
+    public bool IsOwner(ulong keyHash, int replicas, string node)
+    {
+        var target = Array.BinarySearch(_nodes, node, StringComparer.Ordinal);
+        if (target < 0)
+            return false;
+
+        Span<int> owners = stackalloc int[Math.Clamp(replicas, 0, Math.Min(_nodes.Length, 64))];
+        var count = GetOwners(keyHash, owners);
+        return owners[..count].Contains(target);
+    }
+
+    // First point at or after the hash, wrapping to the start of the ring
+    private int LowerBound(ulong hash)
+    {
+        int lo = 0, hi = _points.Length;
+        while (lo < hi)
+        {
+            var mid = (lo + hi) >>> 1;
+            if (_points[mid] < hash)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo == _points.Length ? 0 : lo;
+    }
+}
@@ -0,0 +1,76 @@
+using System.Numerics;
+
+namespace MfaSrv.Core.Collections;
+
+/// <summary>
+/// HyperLogLog distinct-count sketch with 16 four-bit registers packed into one
+/// <see cref="ulong"/>, for keeping a cardinality estimate per user in 8 bytes. The standard
+/// error is about 26% for large counts; small counts (up to ~40) use linear counting and are
+/// typically within one of the true count. Sketches merge with <see cref="Merge"/>, so a
+/// sliding window can be kept as one sketch per time slice.
+///
+/// Values are plain <see cref="ulong"/>s (0 is the empty sketch) and all operations are pure
+/// functions; hashes must be well mixed, such as those from <see cref="CuckooFilter.Hash"/>.
+/// </summary>
+public static class PackedHyperLogLog
+{
+    private const int Registers = 16;
+    private const int IndexBits = 4;
+    private const int MaxRank = 15;
+    private const double Alpha = 0.673; // bias correction for 16 registers
+
+    /// <summary>
+    /// Returns the sketch with <paramref name="hash"/> added.
+    /// </summary>
+    public static ulong Add(ulong sketch, ulong hash)
+    {
+        var shift = (int)(hash >> (64 - IndexBits)) * 4;
+        var remainder = hash << IndexBits;
+        var rank = remainder == 0 ? MaxRank : Math.Min(MaxRank, BitOperations.LeadingZeroCount(remainder) + 1);
+
+        var current = (int)(sketch >> shift) & 0xF;
+        return rank > current
+            ? (sketch & ~(0xFUL << shift)) | ((ulong)rank << shift)
+            : sketch;
+    }
+
+    /// <summary>
+    /// Union of two sketches (register-wise maximum).
+    /// </summary>
+    public static ulong Merge(ulong a, ulong b)
+    {
+        if (a == 0 || a == b)
+            return b;
+        if (b == 0)
+            return a;
+
+        var merged = 0UL;
+        for (var shift = 0; shift < Registers * 4; shift += 4)
+            merged |= Math.Max((a >> shift) & 0xF, (b >> shift) & 0xF) << shift;
+        return merged;
+    }
+
+    /// <summary>
+    /// Estimated number of distinct hashes added.
+    /// </summary>
+    public static double Estimate(ulong sketch)
+    {
+        if (sketch == 0)
+            return 0;
+
+        var sum = 0.0;
+        var zeros = 0;
+        for (var shift = 0; shift < Registers * 4; shift += 4)
+        {
+            var rank = (int)(sketch >> shift) & 0xF;
+            sum += 1.0 / (1UL << rank);
+            if (rank == 0)
+                zeros++;
+        }
+
+        var estimate = Alpha * Registers * Registers / sum;
+        return estimate <= 2.5 * Registers && zeros > 0
+            ? Registers * Math.Log((double)Registers / zeros)
+            : estimate;
+    }
+}
@@ -0,0 +1,89 @@
+namespace MfaSrv.Core.Collections;
+
+/// <summary>
+/// Maps strings to dense 32-bit IDs so large tables can store an <see cref="int"/> per entry
+/// instead of a string reference, with each distinct string held once. IDs are reference
+/// counted: <see cref="Acquire"/> adds a reference, <see cref="Release"/> drops one, and an ID
+/// whose last reference is released is reused for the next new string.
+///
+/// Equality follows the comparer given at construction (e.g. case-insensitive for account
+/// names); the first spelling acquired is the one returned. Not thread-safe: owners
+/// serialize access.
+/// </summary>
+public sealed class StringInterner
+{
+    private readonly Dictionary<string, int> _ids;
+    private string?[] _strings = new string?[64];
+    private int[] _references = new int[64];
+    private readonly Stack<int> _freeIds = new();
+    private int _nextId;
+
+    public StringInterner(IEqualityComparer<string>? comparer = null)
+    {
+        _ids = new Dictionary<string, int>(comparer ?? StringComparer.Ordinal);
+    }
+
+    /// <summary>
+    /// Distinct strings currently interned.
+    /// </summary>
+    public int Count => _ids.Count;
+
+    public string this[int id] => _strings[id] ?? throw new ArgumentOutOfRangeException(nameof(id), "ID is not in use");
+
+    /// <summary>
+    /// Returns the ID of <paramref name="value"/>, interning it if needed, and adds a reference.
+    /// </summary>
+    public int Acquire(string value)
+    {
+        if (!_ids.TryGetValue(value, out var id))
+        {
+            if (!_freeIds.TryPop(out id))
+            {
+                id = _nextId++;
+                if (id == _strings.Length)
+                {
+                    Array.Resize(ref _strings, id * 2);
+                    Array.Resize(ref _references, id * 2);
+                }
+            }
+
+            _strings[id] = value;
+            _ids[value] = id;
+        }
+
+        _references[id]++;
+        return id;
+    }
+
+    /// <summary>
+    /// Drops a reference taken by <see cref="Acquire"/>; the string is forgotten with its last one.
+    /// </summary>
+    public void Release(int id)
+    {
+        if (--_references[id] > 0)
+            return;
+
+        _ids.Remove(_strings[id]!);
+        _strings[id] = null;
+        _freeIds.Push(id);
+    }
+
+    /// <summary>
+    /// Looks up the ID of an interned string without adding a reference.
+    /// </summary>
+    public bool TryGetId(string value, out int id) => _ids.TryGetValue(value, out id);
+
+    /// <summary>
+    /// Approximate memory held by the table and its strings.
+    /// </summary>
+    public long MemoryBytes
+    {
+        get
+        {
+            var bytes = (long)_strings.Length * (sizeof(long) + sizeof(int)) + _ids.Count * 24L;
+            foreach (var s in _ids.Keys)
+                bytes += 22 + 2L * s.Length;
+            return bytes;
+        }
+    }
+}
@@ -0,0 +1,8 @@
+namespace MfaSrv.Core.Enums;
+
+public enum DeliveryChannel
+{
+    Sms,
+    Email,
+    Push
+}
@@ -1,3 +1,4 @@
+using MfaSrv.Core.Entities;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.ValueObjects;
 
@@ -8,4 +9,15 @@ public interface IMfaChallengeOrchestrator
     Task<ChallengeResult> IssueChallengeAsync(string userId, MfaMethod method, ChallengeContext context, CancellationToken ct = default);
     Task<VerificationResult> VerifyChallengeAsync(string challengeId, string response, CancellationToken ct = default);
     Task<AsyncVerificationStatus> CheckChallengeStatusAsync(string challengeId, CancellationToken ct = default);
+
+    /// <summary>
+    /// Like <see cref="CheckChallengeStatusAsync"/>, but while an asynchronous challenge is
+    /// still issued waits up to <paramref name="timeout"/> for its outcome.
+    /// </summary>
+    Task<AsyncVerificationStatus> WaitForChallengeStatusAsync(string challengeId, TimeSpan timeout, CancellationToken ct = default);
+
+    /// <summary>
+    /// Returns a copy of the challenge's current state, or null if it does not exist.
+    /// </summary>
+    Task<MfaChallenge?> GetChallengeAsync(string challengeId, CancellationToken ct = default);
 }
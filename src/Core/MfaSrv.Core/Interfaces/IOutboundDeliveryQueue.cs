@@ -0,0 +1,15 @@
+using MfaSrv.Core.ValueObjects;
+
+namespace MfaSrv.Core.Interfaces;
+
+/// <summary>
+/// Queue for outbound OTP and push delivery. Providers enqueue while issuing a challenge and
+/// return without waiting for the gateway.
+/// </summary>
+public interface IOutboundDeliveryQueue
+{
+    /// <summary>
+    /// Queues a message for background delivery. Returns false when the queue is full.
+    /// </summary>
+    bool TryEnqueue(OutboundMessage message);
+}
@@ -0,0 +1,18 @@
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.ValueObjects;
+
+namespace MfaSrv.Core.Interfaces;
+
+/// <summary>
+/// Sends queued <see cref="OutboundMessage"/>s over one channel (SMS gateway, SMTP, FCM).
+/// </summary>
+public interface IOutboundGateway
+{
+    DeliveryChannel Channel { get; }
+
+    /// <summary>
+    /// Sends one message. Returns false if the gateway rejected it or could not be reached;
+    /// the caller decides whether to retry.
+    /// </summary>
+    Task<bool> SendAsync(OutboundMessage message, CancellationToken ct = default);
+}
@@ -8,5 +8,6 @@ public interface ISessionManager
     Task<MfaSession?> ValidateSessionAsync(string sessionToken, CancellationToken ct = default);
     Task<MfaSession?> FindActiveSessionAsync(string userId, string sourceIp, CancellationToken ct = default);
     Task RevokeSessionAsync(string sessionId, CancellationToken ct = default);
-    Task CleanupExpiredSessionsAsync(CancellationToken ct = default);
+    Task<int> ExpireSessionsAsync(int maxCount, CancellationToken ct = default);
+    Task<int> PurgeSessionsAsync(DateTimeOffset endedBefore, int maxCount, CancellationToken ct = default);
 }
@@ -0,0 +1,265 @@
+using System.Globalization;
+using System.Text.RegularExpressions;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.ValueObjects;
+
+namespace MfaSrv.Core.Policies;
+
+/// <summary>
+/// Enabled policies in evaluation order, compiled once into predicates: rule operators are
+/// resolved, regular expressions built, time windows parsed and protocol rules tabulated, so
+/// evaluating a context runs no parsing and allocates nothing. The Central Server and DC Agents
+/// in local evaluation mode use the same set, so both reach the same decision for the same
+/// user, groups and OU.
+///
+/// Policies are tried by ascending priority (ties by ID); rule groups are OR'd and rules within
+/// a group AND'd. Policies without rule groups or actions never match. A rule whose regular
+/// expression does not parse never matches. Instances are immutable and thread-safe.
+///
+/// RiskScore rules compare <see cref="AuthenticationContext.RiskScore"/>, which only the
+/// Central Server computes; see <see cref="UsesRiskScore"/>.
+/// </summary>
+public sealed class CompiledPolicySet
+{
+    private static readonly TimeSpan RegexTimeout = TimeSpan.FromMilliseconds(100);
+
+    private static readonly PolicyEvaluationResult NoMatch = new()
+    {
+        Decision = AuthDecision.Allow,
+        Reason = "No matching policy"
+    };
+
+    private readonly CompiledPolicy[] _policies;
+
+    private CompiledPolicySet(CompiledPolicy[] policies, bool usesRiskScore)
+    {
+        _policies = policies;
+        UsesRiskScore = usesRiskScore;
+    }
+
+    public static CompiledPolicySet Empty { get; } = new(Array.Empty<CompiledPolicy>(), false);
+
+    /// <summary>
+    /// Number of policies that can match.
+    /// </summary>
+    public int Count => _policies.Length;
+
+    /// <summary>
+    /// True if any policy has a RiskScore rule, so contexts without a risk score may be
+    /// decided differently than the Central Server would.
+    /// </summary>
+    public bool UsesRiskScore { get; }
+
+    public static CompiledPolicySet Compile(IEnumerable<Policy> policies)
+    {
+        var enabled = policies
+            .Where(p => p.IsEnabled && p.RuleGroups.Count > 0 && p.Actions.Count > 0)
+            .OrderBy(p => p.Priority)
+            .ThenBy(p => p.Id, StringComparer.Ordinal)
+            .ToList();
+
+        var usesRiskScore = enabled.Any(p => p.RuleGroups.Any(g => g.Rules.Any(r => r.RuleType == PolicyRuleType.RiskScore)));
+
+        return enabled.Count == 0
+            ? Empty
+            : new CompiledPolicySet(enabled.Select(CompilePolicy).ToArray(), usesRiskScore);
+    }
+
+    /// <summary>
+    /// Returns the first matching policy's decision, or Allow when no policy matches.
+    /// </summary>
+    public PolicyEvaluationResult Evaluate(AuthenticationContext context)
+    {
+        foreach (var policy in _policies)
+        {
+            foreach (var group in policy.Groups)
+            {
+                if (Matches(group, context))
+                    return policy.Result;
+            }
+        }
+
+        return NoMatch;
+    }
+
+    private static bool Matches(Func<AuthenticationContext, bool>[] rules, AuthenticationContext context)
+    {
+        foreach (var rule in rules)
+        {
+            if (!rule(context))
+                return false;
+        }
+        return true;
+    }
+
+    private static CompiledPolicy CompilePolicy(Policy policy)
+    {
+        var action = policy.Actions[0];
+        var decision = action.ActionType switch
+        {
+            PolicyActionType.RequireMfa => AuthDecision.RequireMfa,
+            PolicyActionType.Deny => AuthDecision.Deny,
+            _ => AuthDecision.Allow // Allow, AlertOnly
+        };
+
+        var groups = policy.RuleGroups
+            .Where(g => g.Rules.Count > 0)
+            .Select(g => g.Rules.Select(CompileRule).ToArray())
+            .ToArray();
+
+        return new CompiledPolicy(groups, new PolicyEvaluationResult
+        {
+            Decision = decision,
+            MatchedPolicyId = policy.Id,
+            MatchedPolicyName = policy.Name,
+            RequiredMethod = action.RequiredMethod,
+            FailoverMode = policy.FailoverMode,
+            Reason = $"Matched policy: {policy.Name}"
+        });
+    }
+
+    private static Func<AuthenticationContext, bool> CompileRule(PolicyRule rule)
+    {
+        var predicate = CompileCondition(rule);
+        return rule.Negate ? context => !predicate(context) : predicate;
+    }
+
+    private static Func<AuthenticationContext, bool> CompileCondition(PolicyRule rule)
+    {
+        switch (rule.RuleType)
+        {
+            case PolicyRuleType.SourceUser:
+            {
+                var match = CompileMatcher(rule.Operator, rule.Value);
+                return context => match(context.UserName);
+            }
+            case PolicyRuleType.SourceGroup:
+            {
+                var match = CompileMatcher(rule.Operator, rule.Value);
+                return context =>
+                {
+                    foreach (var group in context.UserGroups)
+                    {
+                        if (match(group))
+                            return true;
+                    }
+                    return false;
+                };
+            }
+            case PolicyRuleType.SourceIp:
+            {
+                var match = CompileMatcher(rule.Operator, rule.Value);
+                return context => match(context.SourceIp ?? string.Empty);
+            }
+            case PolicyRuleType.SourceOu:
+            {
+                var match = CompileMatcher(rule.Operator, rule.Value);
+                return context => match(context.UserOu ?? string.Empty);
+            }
+            case PolicyRuleType.TargetResource:
+            {
+                var match = CompileMatcher(rule.Operator, rule.Value);
+                return context => match(context.TargetResource ?? string.Empty);
+            }
+            case PolicyRuleType.AuthProtocol:
+            {
+                var match = CompileMatcher(rule.Operator, rule.Value);
+                var matching = Enum.GetValues<AuthProtocol>().Where(p => match(p.ToString())).ToHashSet();
+                return context => matching.Contains(context.Protocol);
+            }
+            case PolicyRuleType.TimeWindow:
+                return CompileTimeWindow(rule.Value);
+            case PolicyRuleType.RiskScore:
+                return CompileRiskScore(rule.Value);
+            default:
+                return static _ => false;
+        }
+    }
+
+    private static Func<string, bool> CompileMatcher(string op, string expected)
+    {
+        switch (op.ToLowerInvariant())
+        {
+            case "contains":
+                return actual => actual.Contains(expected, StringComparison.OrdinalIgnoreCase);
+            case "startswith":
+                return actual => actual.StartsWith(expected, StringComparison.OrdinalIgnoreCase);
+            case "endswith":
+                return actual => actual.EndsWith(expected, StringComparison.OrdinalIgnoreCase);
+            case "regex":
+                Regex regex;
+                try
+                {
+                    regex = new Regex(expected, RegexOptions.IgnoreCase | RegexOptions.CultureInvariant, RegexTimeout);
+                }
+                catch (ArgumentException)
+                {
+                    return static _ => false;
+                }
+                return actual =>
+                {
+                    try
+                    {
+                        return regex.IsMatch(actual);
+                    }
+                    catch (RegexMatchTimeoutException)
+                    {
+                        return false;
+                    }
+                };
+            default: // "equals" and unknown operators
+                return actual => actual.Equals(expected, StringComparison.OrdinalIgnoreCase);
+        }
+    }
+
+    /// <summary>
+    /// Format: "HH:mm-HH:mm" in local time (e.g., "09:00-17:00" for business hours); a range
+    /// whose end is before its start spans midnight.
+    /// </summary>
+    private static Func<AuthenticationContext, bool> CompileTimeWindow(string value)
+    {
+        var parts = value.Split('-');
+        if (parts.Length != 2 ||
+            !TimeOnly.TryParse(parts[0].Trim(), out var start) ||
+            !TimeOnly.TryParse(parts[1].Trim(), out var end))
+        {
+            return static _ => false;
+        }
+
+        return context =>
+        {
+            var now = TimeOnly.FromDateTime(context.Timestamp.LocalDateTime);
+            return start <= end
+                ? now >= start && now <= end
+                : now >= start || now <= end;
+        };
+    }
+
+    /// <summary>
+    /// Format: a comparison and a score, e.g. "> 50", ">= 50", "&lt; 20", "&lt;= 20" or "= 0";
+    /// a bare number means "&gt;=". The rule operator is not used.
+    /// </summary>
+    private static Func<AuthenticationContext, bool> CompileRiskScore(string value)
+    {
+        var text = value.Trim();
+        var op = text.StartsWith(">=") || text.StartsWith("<=") ? text[..2]
+            : text.StartsWith('>') || text.StartsWith('<') || text.StartsWith('=') ? text[..1]
+            : ">=";
+        var number = text.StartsWith(op) ? text[op.Length..].Trim() : text;
+
+        if (!int.TryParse(number, NumberStyles.Integer, CultureInfo.InvariantCulture, out var threshold))
+            return static _ => false;
+
+        return op switch
+        {
+            ">" => context => context.RiskScore > threshold,
+            "<" => context => context.RiskScore < threshold,
+            "<=" => context => context.RiskScore <= threshold,
+            "=" => context => context.RiskScore == threshold,
+            _ => context => context.RiskScore >= threshold
+        };
+    }
+
+    private sealed record CompiledPolicy(Func<AuthenticationContext, bool>[][] Groups, PolicyEvaluationResult Result);
+}
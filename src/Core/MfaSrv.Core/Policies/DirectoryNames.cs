@@ -0,0 +1,35 @@
+namespace MfaSrv.Core.Policies;
+
+/// <summary>
+/// Helpers for Active Directory distinguished names.
+/// </summary>
+public static class DirectoryNames
+{
+    /// <summary>
+    /// The DN of the container holding <paramref name="distinguishedName"/>, e.g.
+    /// "OU=Sales,DC=example,DC=com" for "CN=Smith\, John,OU=Sales,DC=example,DC=com".
+    /// Null for an empty DN or one without a parent.
+    /// </summary>
+    public static string? ParentContainer(string? distinguishedName)
+    {
+        if (string.IsNullOrEmpty(distinguishedName))
+            return null;
+
+        for (var i = 0; i < distinguishedName.Length; i++)
+        {
+            if (distinguishedName[i] == '\\')
+            {
+                i++; // skip the escaped character
+                continue;
+            }
+
+            if (distinguishedName[i] == ',')
+            {
+                var parent = distinguishedName[(i + 1)..].TrimStart();
+                return parent.Length > 0 ? parent : null;
+            }
+        }
+
+        return null;
+    }
+}
@@ -7,9 +7,16 @@ public record AuthenticationContext
     public required string UserId { get; init; }
     public required string UserName { get; init; }
     public string? SourceIp { get; init; }
+    public string? Workstation { get; init; }
     public string? TargetResource { get; init; }
     public AuthProtocol Protocol { get; init; }
     public IReadOnlyList<string> UserGroups { get; init; } = Array.Empty<string>();
     public string? UserOu { get; init; }
+
+    /// <summary>
+    /// Risk score (0-100) computed by the Central Server; null where it is not available,
+    /// in which case RiskScore rules do not match.
+    /// </summary>
+    public int? RiskScore { get; init; }
     public DateTimeOffset Timestamp { get; init; } = DateTimeOffset.UtcNow;
 }
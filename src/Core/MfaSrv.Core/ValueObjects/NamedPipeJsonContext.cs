@@ -0,0 +1,17 @@
+using System.Text.Json.Serialization;
+
+namespace MfaSrv.Core.ValueObjects;
+
+/// <summary>
+/// Source-generated System.Text.Json metadata for the LSA DLL ↔ DC Agent named pipe messages.
+/// Avoids reflection warm-up and per-message <c>JsonSerializerOptions</c> allocation on the logon path.
+/// Reads are case-insensitive; writes use camelCase to match Protocol.h.
+/// </summary>
+[JsonSourceGenerationOptions(
+    PropertyNamingPolicy = JsonKnownNamingPolicy.CamelCase,
+    PropertyNameCaseInsensitive = true)]
+[JsonSerializable(typeof(AuthQueryMessage))]
+[JsonSerializable(typeof(AuthResponseMessage))]
+public partial class NamedPipeJsonContext : JsonSerializerContext
+{
+}
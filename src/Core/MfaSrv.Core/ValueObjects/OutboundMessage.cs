@@ -0,0 +1,33 @@
+using MfaSrv.Core.Enums;
+
+namespace MfaSrv.Core.ValueObjects;
+
+/// <summary>
+/// A one-time code or push notification waiting to be delivered by an
+/// <see cref="Interfaces.IOutboundGateway"/>.
+/// </summary>
+public record OutboundMessage
+{
+    public required DeliveryChannel Channel { get; init; }
+
+    /// <summary>
+    /// Phone number, e-mail address or device token.
+    /// </summary>
+    public required string Recipient { get; init; }
+
+    /// <summary>
+    /// E-mail subject or push notification title.
+    /// </summary>
+    public string? Subject { get; init; }
+
+    public required string Body { get; init; }
+
+    public string? ChallengeId { get; init; }
+
+    /// <summary>
+    /// The message is dropped instead of delivered after this time (the challenge has expired).
+    /// </summary>
+    public DateTimeOffset? ExpiresAt { get; init; }
+
+    public DateTimeOffset EnqueuedAt { get; init; } = DateTimeOffset.UtcNow;
+}
@@ -6,4 +6,6 @@ public record VerificationContext
     public required string UserId { get; init; }
     public byte[]? EncryptedSecret { get; init; }
     public byte[]? SecretNonce { get; init; }
+    public string? EnrollmentId { get; init; }
+    public byte[]? EncryptionKey { get; init; }
 }
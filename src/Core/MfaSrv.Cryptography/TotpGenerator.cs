@@ -20,31 +20,23 @@ public static class TotpGenerator
 
     public static string ComputeTotp(byte[] secret, DateTimeOffset timestamp, int digits = DefaultDigits, int periodSeconds = DefaultPeriodSeconds)
     {
-        var timeStep = GetTimeStep(timestamp, periodSeconds);
-        return ComputeHotp(secret, timeStep, digits);
+        using var key = TotpKey.Create(secret);
+        var code = key.ComputeCode(GetTimeStep(timestamp, periodSeconds), digits);
+        return code.ToString().PadLeft(digits, '0');
     }
 
+    /// <summary>
+    /// One-off validation of <paramref name="code"/> against a raw secret. Repeated validation
+    /// for the same enrollment should keep a <see cref="TotpKey"/> instead.
+    /// </summary>
     public static bool Validate(byte[] secret, string code, DateTimeOffset timestamp,
         int digits = DefaultDigits, int periodSeconds = DefaultPeriodSeconds, int toleranceSteps = DefaultToleranceSteps)
     {
         if (string.IsNullOrEmpty(code) || code.Length != digits)
             return false;
 
-        var currentStep = GetTimeStep(timestamp, periodSeconds);
-
-        for (var i = -toleranceSteps; i <= toleranceSteps; i++)
-        {
-            var step = currentStep + i;
-            var expected = ComputeHotp(secret, step, digits);
-            if (CryptographicOperations.FixedTimeEquals(
-                System.Text.Encoding.ASCII.GetBytes(expected),
-                System.Text.Encoding.ASCII.GetBytes(code)))
-            {
-                return true;
-            }
-        }
-
-        return false;
+        using var key = TotpKey.Create(secret);
+        return key.Match(code, GetTimeStep(timestamp, periodSeconds), toleranceSteps, digits) >= 0;
     }
 
     public static string GenerateProvisioningUri(byte[] secret, string userName, string issuer)
@@ -55,28 +47,8 @@ public static class TotpGenerator
         return $"otpauth://totp/{encodedIssuer}:{encodedUser}?secret={base32Secret}&issuer={encodedIssuer}&algorithm=SHA1&digits={DefaultDigits}&period={DefaultPeriodSeconds}";
     }
 
-    private static long GetTimeStep(DateTimeOffset timestamp, int periodSeconds)
+    public static long GetTimeStep(DateTimeOffset timestamp, int periodSeconds = DefaultPeriodSeconds)
     {
         return timestamp.ToUnixTimeSeconds() / periodSeconds;
     }
-
-    private static string ComputeHotp(byte[] secret, long counter, int digits)
-    {
-        var counterBytes = BitConverter.GetBytes(counter);
-        if (BitConverter.IsLittleEndian)
-            Array.Reverse(counterBytes);
-
-        using var hmac = new HMACSHA1(secret);
-        var hash = hmac.ComputeHash(counterBytes);
-
-        var offset = hash[^1] & 0x0F;
-        var binaryCode =
-            ((hash[offset] & 0x7F) << 24) |
-            ((hash[offset + 1] & 0xFF) << 16) |
-            ((hash[offset + 2] & 0xFF) << 8) |
-            (hash[offset + 3] & 0xFF);
-
-        var otp = binaryCode % (int)Math.Pow(10, digits);
-        return otp.ToString().PadLeft(digits, '0');
-    }
 }
@@ -0,0 +1,205 @@
+using System.Buffers.Binary;
+using System.Numerics;
+using System.Security.Cryptography;
+
+namespace MfaSrv.Cryptography;
+
+/// <summary>
+/// A TOTP secret prepared for repeated HOTP computation (RFC 4226 / RFC 6238, HMAC-SHA1).
+///
+/// HMAC-SHA1 of an 8-byte counter is two SHA-1 compressions on top of the key's inner
+/// (K xor ipad) and outer (K xor opad) blocks. Those two blocks are hashed once here and their
+/// intermediate states kept, so each code costs exactly two compressions, computed on stack
+/// buffers without allocating. The states are key-equivalent: they are held in a pinned array
+/// (never copied by the GC) and zeroed on <see cref="Dispose"/>.
+/// </summary>
+public sealed class TotpKey : IDisposable
+{
+    private const int BlockSize = 64;
+    private const int DigestSize = 20;
+
+    private static readonly int[] PowersOfTen = { 1, 10, 100, 1_000, 10_000, 100_000, 1_000_000, 10_000_000, 100_000_000 };
+
+    // [0..4] inner state, [5..9] outer state
+    private readonly uint[] _state = GC.AllocateArray<uint>(10, pinned: true);
+    private bool _disposed;
+
+    private TotpKey()
+    {
+    }
+
+    public static TotpKey Create(ReadOnlySpan<byte> secret)
+    {
+        Span<byte> key = stackalloc byte[BlockSize];
+        Span<byte> pad = stackalloc byte[BlockSize];
+        key.Clear();
+
+        if (secret.Length > BlockSize)
+            SHA1.HashData(secret, key);
+        else
+            secret.CopyTo(key);
+
+        var totpKey = new TotpKey();
+        var state = totpKey._state.AsSpan();
+
+        for (var i = 0; i < BlockSize; i++)
+            pad[i] = (byte)(key[i] ^ 0x36);
+        InitialState(state[..5]);
+        Compress(state[..5], pad);
+
+        for (var i = 0; i < BlockSize; i++)
+            pad[i] = (byte)(key[i] ^ 0x5c);
+        InitialState(state[5..]);
+        Compress(state[5..], pad);
+
+        CryptographicOperations.ZeroMemory(key);
+        CryptographicOperations.ZeroMemory(pad);
+        return totpKey;
+    }
+
+    /// <summary>
+    /// HOTP value for <paramref name="counter"/> (the TOTP time step), truncated to
+    /// <paramref name="digits"/> decimal digits.
+    /// </summary>
+    public int ComputeCode(long counter, int digits = 6)
+    {
+        ObjectDisposedException.ThrowIf(_disposed, this);
+        if (digits < 1 || digits >= PowersOfTen.Length)
+            throw new ArgumentOutOfRangeException(nameof(digits));
+
+        Span<uint> h = stackalloc uint[5];
+        Span<byte> block = stackalloc byte[BlockSize];
+        Span<byte> digest = stackalloc byte[DigestSize];
+
+        // Inner hash: H(K ^ ipad || counter), message padded to one block
+        _state.AsSpan(0, 5).CopyTo(h);
+        block.Clear();
+        BinaryPrimitives.WriteInt64BigEndian(block, counter);
+        block[8] = 0x80;
+        BinaryPrimitives.WriteInt64BigEndian(block[56..], (BlockSize + 8) * 8L);
+        Compress(h, block);
+        WriteDigest(h, digest);
+
+        // Outer hash: H(K ^ opad || inner digest)
+        _state.AsSpan(5, 5).CopyTo(h);
+        block.Clear();
+        digest.CopyTo(block);
+        block[DigestSize] = 0x80;
+        BinaryPrimitives.WriteInt64BigEndian(block[56..], (BlockSize + DigestSize) * 8L);
+        Compress(h, block);
+        WriteDigest(h, digest);
+
+        CryptographicOperations.ZeroMemory(block);
+
+        var offset = digest[^1] & 0x0F;
+        var binary = BinaryPrimitives.ReadInt32BigEndian(digest[offset..]) & 0x7FFFFFFF;
+        return binary % PowersOfTen[digits];
+    }
+
+    /// <summary>
+    /// Compares <paramref name="code"/> with the codes of every step from
+    /// <paramref name="currentStep"/> - <paramref name="toleranceSteps"/> to
+    /// <paramref name="currentStep"/> + <paramref name="toleranceSteps"/>. All steps are
+    /// computed regardless of where the match is, so timing does not reveal it. Returns the
+    /// latest matching step, or -1.
+    /// </summary>
+    public long Match(ReadOnlySpan<char> code, long currentStep, int toleranceSteps, int digits = 6)
+    {
+        if (!TryParseCode(code, digits, out var given))
+            return -1;
+
+        var matched = -1L;
+        for (var step = currentStep - toleranceSteps; step <= currentStep + toleranceSteps; step++)
+        {
+            var mismatch = ComputeCode(step, digits) ^ given;
+            // Branch-free select: step when mismatch == 0, otherwise keep the previous value
+            var mask = ((long)(uint)mismatch - 1) >> 63;
+            matched = (step & mask) | (matched & ~mask);
+        }
+
+        return matched;
+    }
+
+    public void Dispose()
+    {
+        if (_disposed)
+            return;
+        _disposed = true;
+        CryptographicOperations.ZeroMemory(System.Runtime.InteropServices.MemoryMarshal.AsBytes(_state.AsSpan()));
+    }
+
+    private static bool TryParseCode(ReadOnlySpan<char> code, int digits, out int value)
+    {
+        value = 0;
+        if (code.Length != digits)
+            return false;
+
+        foreach (var c in code)
+        {
+            var digit = c - '0';
+            if ((uint)digit > 9)
+                return false;
+            value = value * 10 + digit;
+        }
+        return true;
+    }
+
+    private static void InitialState(Span<uint> h)
+    {
+        h[0] = 0x67452301;
+        h[1] = 0xEFCDAB89;
+        h[2] = 0x98BADCFE;
+        h[3] = 0x10325476;
+        h[4] = 0xC3D2E1F0;
+    }
+
+    private static void WriteDigest(ReadOnlySpan<uint> h, Span<byte> digest)
+    {
+        for (var i = 0; i < 5; i++)
+            BinaryPrimitives.WriteUInt32BigEndian(digest[(i * 4)..], h[i]);
+    }
+
+    /// <summary>
+    /// SHA-1 compression function (FIPS 180-4, 6.1.2) over one 64-byte block.
+    /// </summary>
+    private static void Compress(Span<uint> h, ReadOnlySpan<byte> block)
+    {
+        Span<uint> w = stackalloc uint[80];
+        for (var t = 0; t < 16; t++)
+            w[t] = BinaryPrimitives.ReadUInt32BigEndian(block[(t * 4)..]);
+        for (var t = 16; t < 80; t++)
+            w[t] = BitOperations.RotateLeft(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+
+        uint a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        uint temp;
+
+        for (var t = 0; t < 20; t++)
+        {
+            temp = BitOperations.RotateLeft(a, 5) + ((b & c) | (~b & d)) + e + 0x5A827999 + w[t];
+            e = d; d = c; c = BitOperations.RotateLeft(b, 30); b = a; a = temp;
+        }
+        for (var t = 20; t < 40; t++)
+        {
+            temp = BitOperations.RotateLeft(a, 5) + (b ^ c ^ d) + e + 0x6ED9EBA1 + w[t];
+            e = d; d = c; c = BitOperations.RotateLeft(b, 30); b = a; a = temp;
+        }
+        for (var t = 40; t < 60; t++)
+        {
+            temp = BitOperations.RotateLeft(a, 5) + ((b & c) | (b & d) | (c & d)) + e + 0x8F1BBCDC + w[t];
+            e = d; d = c; c = BitOperations.RotateLeft(b, 30); b = a; a = temp;
+        }
+        for (var t = 60; t < 80; t++)
+        {
+            temp = BitOperations.RotateLeft(a, 5) + (b ^ c ^ d) + e + 0xCA62C1D6 + w[t];
+            e = d; d = c; c = BitOperations.RotateLeft(b, 30); b = a; a = temp;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+
+        w.Clear();
+    }
+}
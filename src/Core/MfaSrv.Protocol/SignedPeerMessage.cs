@@ -0,0 +1,33 @@
+using Google.Protobuf;
+
+namespace MfaSrv.Protocol
+{
+    /// <summary>
+    /// A server-to-server message carrying an HMAC over its own serialized form. The signature
+    /// is computed with <see cref="Signature"/> empty and covers every other field, including
+    /// <see cref="SignedAtUnixMs"/>.
+    /// </summary>
+    public interface ISignedPeerMessage : IMessage
+    {
+        long SignedAtUnixMs { get; set; }
+        ByteString Signature { get; set; }
+    }
+}
+
+namespace MfaSrv.Protocol.Ha
+{
+    public sealed partial class PeerHeartbeat : ISignedPeerMessage
+    {
+    }
+
+    public sealed partial class ForwardAuditRequest : ISignedPeerMessage
+    {
+    }
+}
+
+namespace MfaSrv.Protocol.Replication
+{
+    public sealed partial class ReplicateChallengesRequest : ISignedPeerMessage
+    {
+    }
+}
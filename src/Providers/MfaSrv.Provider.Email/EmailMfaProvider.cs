@@ -12,6 +12,7 @@ public class EmailMfaProvider : IMfaProvider
 {
     private readonly EmailSettings _settings;
     private readonly EmailSender _emailSender;
+    private readonly IOutboundDeliveryQueue _delivery;
     private readonly IChallengeStore _store;
     private readonly ILogger<EmailMfaProvider> _logger;
 
@@ -20,11 +21,13 @@ public class EmailMfaProvider : IMfaProvider
     public EmailMfaProvider(
         IOptions<EmailSettings> settings,
         EmailSender emailSender,
+        IOutboundDeliveryQueue delivery,
         IChallengeStore store,
         ILogger<EmailMfaProvider> logger)
     {
         _settings = settings.Value;
         _emailSender = emailSender;
+        _delivery = delivery;
         _store = store;
         _logger = logger;
     }
@@ -155,11 +158,23 @@ public class EmailMfaProvider : IMfaProvider
         var subject = _settings.SubjectTemplate;
         var body = _settings.BodyTemplate.Replace("{code}", code);
 
-        var sent = await _emailSender.SendEmailAsync(emailAddress, subject, body, ct);
+        // Stored before delivery is queued so a fast reply always finds the challenge
+        await _store.SetAsync(ChallengePrefix + challengeId, new PendingChallenge(code, expiry, 0, emailAddress), TimeSpan.FromMinutes(_settings.CodeExpiryMinutes + 1), ct);
 
-        if (!sent)
+        var queued = _delivery.TryEnqueue(new OutboundMessage
         {
-            _logger.LogError("Failed to send email challenge to user {UserId}", ctx.UserId);
+            Channel = DeliveryChannel.Email,
+            Recipient = emailAddress,
+            Subject = subject,
+            Body = body,
+            ChallengeId = challengeId,
+            ExpiresAt = expiry
+        });
+
+        if (!queued)
+        {
+            await _store.RemoveAsync(ChallengePrefix + challengeId, ct);
+            _logger.LogError("Email delivery queue full, challenge for user {UserId} not sent", ctx.UserId);
             return new ChallengeResult
             {
                 Success = false,
@@ -168,8 +183,6 @@ public class EmailMfaProvider : IMfaProvider
             };
         }
 
-        await _store.SetAsync(ChallengePrefix + challengeId, new PendingChallenge(code, expiry, 0, emailAddress), TimeSpan.FromMinutes(_settings.CodeExpiryMinutes + 1), ct);
-
         _logger.LogInformation("Email challenge {ChallengeId} issued for user {UserId} to {Email}",
             challengeId, ctx.UserId, MaskEmailAddress(emailAddress));
 
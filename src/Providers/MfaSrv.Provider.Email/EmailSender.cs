@@ -1,11 +1,14 @@
 using System.Net;
 using System.Net.Mail;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.ValueObjects;
 using Microsoft.Extensions.Logging;
 using Microsoft.Extensions.Options;
 
 namespace MfaSrv.Provider.Email;
 
-public class EmailSender
+public class EmailSender : IOutboundGateway
 {
     private readonly EmailSettings _settings;
     private readonly ILogger<EmailSender> _logger;
@@ -16,6 +19,11 @@ public class EmailSender
         _logger = logger;
     }
 
+    public DeliveryChannel Channel => DeliveryChannel.Email;
+
+    public Task<bool> SendAsync(OutboundMessage message, CancellationToken ct = default) =>
+        SendEmailAsync(message.Recipient, message.Subject ?? _settings.SubjectTemplate, message.Body, ct);
+
     public async Task<bool> SendEmailAsync(string toAddress, string subject, string htmlBody, CancellationToken ct = default)
     {
         if (_settings.SmtpHost == "localhost" && _settings.SmtpPort == 25
@@ -0,0 +1,173 @@
+using System.Collections.Concurrent;
+using MfaSrv.Core.Challenges;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.ValueObjects;
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+
+namespace MfaSrv.Provider.FortiToken;
+
+/// <summary>
+/// Polls FortiAuthenticator for the outcome of pending FortiToken Mobile push requests.
+///
+/// Every <see cref="FortiTokenSettings.PushPollIntervalMs"/> one sweep asks for the status of
+/// each tracked push session once, with at most <see cref="FortiTokenSettings.PushPollConcurrency"/>
+/// requests in flight, and hands resolved outcomes to <see cref="ChallengeCompletionEngine"/>.
+/// Upstream load therefore depends on the number of pending pushes, not on how often clients
+/// check their challenges.
+/// </summary>
+public class FortiPushPoller : BackgroundService
+{
+    private const string ChallengePrefix = "forti:challenge:";
+
+    private readonly FortiAuthClient _fortiClient;
+    private readonly ChallengeCompletionEngine _completions;
+    private readonly IChallengeStore _store;
+    private readonly FortiTokenSettings _settings;
+    private readonly ILogger<FortiPushPoller> _logger;
+    private readonly ConcurrentDictionary<string, TrackedPush> _pending = new(StringComparer.Ordinal);
+
+    public FortiPushPoller(
+        FortiAuthClient fortiClient,
+        ChallengeCompletionEngine completions,
+        IChallengeStore store,
+        IOptions<FortiTokenSettings> settings,
+        ILogger<FortiPushPoller> logger)
+    {
+        _fortiClient = fortiClient;
+        _completions = completions;
+        _store = store;
+        _settings = settings.Value;
+        _logger = logger;
+    }
+
+    public int PendingCount => _pending.Count;
+
+    /// <summary>
+    /// Starts polling a push session on behalf of a challenge. Tracking the same challenge
+    /// again is a no-op.
+    /// </summary>
+    public void Track(string challengeId, string pushSessionId, DateTimeOffset expiresAt)
+    {
+        _pending.TryAdd(challengeId, new TrackedPush(pushSessionId, expiresAt));
+    }
+
+    /// <summary>
+    /// Stops polling a challenge that was resolved by other means (e.g. OTP fallback).
+    /// </summary>
+    public void Untrack(string challengeId)
+    {
+        _pending.TryRemove(challengeId, out _);
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        using var timer = new PeriodicTimer(TimeSpan.FromMilliseconds(Math.Max(100, _settings.PushPollIntervalMs)));
+
+        try
+        {
+            while (await timer.WaitForNextTickAsync(stoppingToken))
+            {
+                try
+                {
+                    await PollOnceAsync(stoppingToken);
+                }
+                catch (Exception ex) when (!stoppingToken.IsCancellationRequested)
+                {
+                    _logger.LogError(ex, "FortiToken push status sweep failed");
+                }
+            }
+        }
+        catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+        {
+        }
+    }
+
+    /// <summary>
+    /// Runs one sweep over all tracked push sessions. Returns the number resolved.
+    /// </summary>
+    public async Task<int> PollOnceAsync(CancellationToken ct = default)
+    {
+        if (_pending.IsEmpty)
+            return 0;
+
+        var now = DateTimeOffset.UtcNow;
+        var resolved = 0;
+
+        await Parallel.ForEachAsync(
+            _pending.ToArray(),
+            new ParallelOptions { MaxDegreeOfParallelism = Math.Max(1, _settings.PushPollConcurrency), CancellationToken = ct },
+            async (item, token) =>
+            {
+                var (challengeId, push) = item;
+
+                AsyncVerificationStatus? outcome;
+                if (now > push.ExpiresAt)
+                {
+                    outcome = new AsyncVerificationStatus { Status = ChallengeStatus.Expired, Error = "Challenge has expired" };
+                }
+                else
+                {
+                    var result = await _fortiClient.CheckPushStatusAsync(push.SessionId, token);
+                    if (!result.Success)
+                    {
+                        _logger.LogWarning("Failed to poll FortiAuth push status for challenge {ChallengeId}: {Error}",
+                            challengeId, result.Error);
+                        return;
+                    }
+
+                    outcome = MapPushStatus(result.Status);
+                    if (outcome == null)
+                    {
+                        if (result.Status is not ("pending" or "waiting"))
+                            _logger.LogWarning("Unknown FortiAuth push status '{Status}' for challenge {ChallengeId}",
+                                result.Status, challengeId);
+                        return;
+                    }
+                }
+
+                await ResolveAsync(challengeId, outcome, token);
+                Interlocked.Increment(ref resolved);
+            });
+
+        return resolved;
+    }
+
+    /// <summary>
+    /// Maps a FortiAuthenticator push status to a final outcome, or null while it is pending.
+    /// </summary>
+    public static AsyncVerificationStatus? MapPushStatus(string status) => status switch
+    {
+        "approved" or "allow" or "accept" => new AsyncVerificationStatus { Status = ChallengeStatus.Approved },
+        "denied" or "deny" or "reject" => new AsyncVerificationStatus
+        {
+            Status = ChallengeStatus.Denied,
+            Error = "Authentication request was denied by user"
+        },
+        _ => null
+    };
+
+    private async Task ResolveAsync(string challengeId, AsyncVerificationStatus outcome, CancellationToken ct)
+    {
+        _pending.TryRemove(challengeId, out _);
+
+        // Keep the outcome in the shared store briefly so other instances can report it too
+        var key = ChallengePrefix + challengeId;
+        var challenge = await _store.GetAsync<FortiTokenMfaProvider.PendingFortiChallenge>(key, ct);
+        if (challenge != null && challenge.Status == ChallengeStatus.Issued)
+        {
+            challenge.Status = outcome.Status;
+            await _store.SetAsync(key, challenge, TimeSpan.FromMinutes(1), ct);
+        }
+
+        if (_completions.Complete(challengeId, outcome))
+        {
+            _logger.LogInformation("FortiToken push challenge {ChallengeId} resolved: {Status}",
+                challengeId, outcome.Status);
+        }
+    }
+
+    private sealed record TrackedPush(string SessionId, DateTimeOffset ExpiresAt);
+}
@@ -1,5 +1,6 @@
 using System.Security.Cryptography;
 using System.Text;
+using MfaSrv.Core.Challenges;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.Interfaces;
 using MfaSrv.Core.ValueObjects;
@@ -12,12 +13,16 @@ namespace MfaSrv.Provider.FortiToken;
 /// MFA provider that integrates with FortiAuthenticator REST API for
 /// hardware token (FortiToken 200) and software token (FortiToken Mobile) authentication.
 /// Supports both synchronous OTP verification and asynchronous push notification flows.
+/// Push outcomes are polled by <see cref="FortiPushPoller"/> and published through
+/// <see cref="ChallengeCompletionEngine"/>; status checks never call FortiAuthenticator.
 /// </summary>
 public class FortiTokenMfaProvider : IMfaProvider
 {
     private readonly FortiTokenSettings _settings;
     private readonly FortiAuthClient _fortiClient;
     private readonly IChallengeStore _store;
+    private readonly FortiPushPoller _pushPoller;
+    private readonly ChallengeCompletionEngine _completions;
     private readonly ILogger<FortiTokenMfaProvider> _logger;
 
     private const string ChallengePrefix = "forti:challenge:";
@@ -26,11 +31,15 @@ public class FortiTokenMfaProvider : IMfaProvider
         FortiAuthClient fortiClient,
         IOptions<FortiTokenSettings> settings,
         IChallengeStore store,
+        FortiPushPoller pushPoller,
+        ChallengeCompletionEngine completions,
         ILogger<FortiTokenMfaProvider> logger)
     {
         _fortiClient = fortiClient;
         _settings = settings.Value;
         _store = store;
+        _pushPoller = pushPoller;
+        _completions = completions;
         _logger = logger;
     }
 
@@ -231,6 +240,7 @@ public class FortiTokenMfaProvider : IMfaProvider
         if (DateTimeOffset.UtcNow > challenge.ExpiresAt)
         {
             await _store.RemoveAsync(ChallengePrefix + ctx.ChallengeId, ct);
+            Resolve(ctx.ChallengeId, ChallengeStatus.Expired, "Challenge has expired");
             _logger.LogWarning(
                 "FortiToken challenge {ChallengeId} expired for user {UserId}",
                 ctx.ChallengeId, ctx.UserId);
@@ -258,6 +268,7 @@ public class FortiTokenMfaProvider : IMfaProvider
         {
             challenge.Status = ChallengeStatus.Failed;
             await _store.RemoveAsync(ChallengePrefix + ctx.ChallengeId, ct);
+            Resolve(ctx.ChallengeId, ChallengeStatus.Failed, "Challenge failed");
             _logger.LogWarning(
                 "FortiToken challenge {ChallengeId} exceeded max attempts for user {UserId}",
                 ctx.ChallengeId, ctx.UserId);
@@ -295,6 +306,7 @@ public class FortiTokenMfaProvider : IMfaProvider
         // Success - remove the challenge
         challenge.Status = ChallengeStatus.Approved;
         await _store.RemoveAsync(ChallengePrefix + ctx.ChallengeId, ct);
+        Resolve(ctx.ChallengeId, ChallengeStatus.Approved, null);
 
         _logger.LogInformation(
             "FortiToken verification succeeded for challenge {ChallengeId}, user {UserId}",
@@ -307,12 +319,16 @@ public class FortiTokenMfaProvider : IMfaProvider
     }
 
     /// <summary>
-    /// Checks the asynchronous status of a push-based challenge by polling
-    /// the FortiAuthenticator push status API.
+    /// Returns the asynchronous status of a push-based challenge. The outcome comes from
+    /// <see cref="ChallengeCompletionEngine"/> once <see cref="FortiPushPoller"/> has seen it
+    /// resolve; until then the challenge is reported as issued.
     /// </summary>
     public async Task<AsyncVerificationStatus> CheckAsyncStatusAsync(
         string challengeId, CancellationToken ct = default)
     {
+        if (_completions.TryGetOutcome(challengeId, out var outcome))
+            return outcome;
+
         var challenge = await _store.GetAsync<PendingFortiChallenge>(ChallengePrefix + challengeId, ct);
         if (challenge == null)
         {
@@ -327,23 +343,13 @@ public class FortiTokenMfaProvider : IMfaProvider
         if (challenge.Status == ChallengeStatus.Issued &&
             DateTimeOffset.UtcNow > challenge.ExpiresAt)
         {
-            challenge.Status = ChallengeStatus.Expired;
             await _store.RemoveAsync(ChallengePrefix + challengeId, ct);
-
-            return new AsyncVerificationStatus
-            {
-                Status = ChallengeStatus.Expired,
-                Error = "Challenge has expired"
-            };
+            return Resolve(challengeId, ChallengeStatus.Expired, "Challenge has expired");
         }
 
-        // If the challenge was already resolved locally (e.g. via VerifyAsync with OTP),
-        // return that status directly.
+        // Resolved by another instance; the store keeps the outcome briefly
         if (challenge.Status != ChallengeStatus.Issued)
         {
-            // Clean up resolved challenges after reporting the final status.
-            await _store.RemoveAsync(ChallengePrefix + challengeId, ct);
-
             return new AsyncVerificationStatus
             {
                 Status = challenge.Status,
@@ -357,67 +363,10 @@ public class FortiTokenMfaProvider : IMfaProvider
             };
         }
 
-        // For push challenges, poll FortiAuthenticator for the push session status.
+        // Issued on another instance (shared store): poll it from here as well
         if (!string.IsNullOrEmpty(challenge.PushSessionId))
-        {
-            var pushStatus = await _fortiClient.CheckPushStatusAsync(
-                challenge.PushSessionId, ct);
+            _pushPoller.Track(challengeId, challenge.PushSessionId, challenge.ExpiresAt);
 
-            if (pushStatus.Success)
-            {
-                switch (pushStatus.Status)
-                {
-                    case "approved":
-                    case "allow":
-                    case "accept":
-                        challenge.Status = ChallengeStatus.Approved;
-                        await _store.RemoveAsync(ChallengePrefix + challengeId, ct);
-                        _logger.LogInformation(
-                            "FortiToken push approved for challenge {ChallengeId}", challengeId);
-                        return new AsyncVerificationStatus
-                        {
-                            Status = ChallengeStatus.Approved
-                        };
-
-                    case "denied":
-                    case "deny":
-                    case "reject":
-                        challenge.Status = ChallengeStatus.Denied;
-                        await _store.RemoveAsync(ChallengePrefix + challengeId, ct);
-                        _logger.LogInformation(
-                            "FortiToken push denied for challenge {ChallengeId}", challengeId);
-                        return new AsyncVerificationStatus
-                        {
-                            Status = ChallengeStatus.Denied,
-                            Error = "Authentication request was denied by user"
-                        };
-
-                    case "pending":
-                    case "waiting":
-                        // Still waiting for user response
-                        return new AsyncVerificationStatus
-                        {
-                            Status = ChallengeStatus.Issued
-                        };
-
-                    default:
-                        _logger.LogWarning(
-                            "Unknown FortiAuth push status '{Status}' for challenge {ChallengeId}",
-                            pushStatus.Status, challengeId);
-                        return new AsyncVerificationStatus
-                        {
-                            Status = ChallengeStatus.Issued
-                        };
-                }
-            }
-
-            // Push status check failed - keep the challenge alive but report the issue
-            _logger.LogWarning(
-                "Failed to poll FortiAuth push status for challenge {ChallengeId}: {Error}",
-                challengeId, pushStatus.Error);
-        }
-
-        // Default: still issued and waiting
         return new AsyncVerificationStatus
         {
             Status = ChallengeStatus.Issued
@@ -461,6 +410,9 @@ public class FortiTokenMfaProvider : IMfaProvider
         };
         await _store.SetAsync(ChallengePrefix + challengeId, pending, TimeSpan.FromMinutes(_settings.ChallengeExpiryMinutes + 1), ct);
 
+        if (!string.IsNullOrEmpty(pushResult.SessionId))
+            _pushPoller.Track(challengeId, pushResult.SessionId, expiresAt);
+
         _logger.LogInformation(
             "FortiToken push challenge {ChallengeId} issued for user {UserId}, " +
             "push session {PushSessionId}, expires at {ExpiresAt}",
@@ -546,6 +498,17 @@ public class FortiTokenMfaProvider : IMfaProvider
         return ctx.UserId;
     }
 
+    /// <summary>
+    /// Publishes a locally decided outcome and stops polling the push session, if any.
+    /// </summary>
+    private AsyncVerificationStatus Resolve(string challengeId, ChallengeStatus status, string? error)
+    {
+        var outcome = new AsyncVerificationStatus { Status = status, Error = error };
+        _pushPoller.Untrack(challengeId);
+        _completions.Complete(challengeId, outcome);
+        return outcome;
+    }
+
     /// <summary>
     /// Performs a constant-time comparison of two strings to prevent timing attacks
     /// on OTP verification. Used as a local validation fallback.
@@ -9,4 +9,6 @@ public class FortiTokenSettings
     public int ChallengeExpiryMinutes { get; set; } = 5;
     public int MaxAttempts { get; set; } = 3;
     public bool UsePushNotification { get; set; } = true;  // FortiToken Mobile push
+    public int PushPollIntervalMs { get; set; } = 2000;    // one status sweep over all pending pushes
+    public int PushPollConcurrency { get; set; } = 8;      // parallel status requests per sweep
 }
@@ -1,6 +1,7 @@
 using System.Security.Cryptography;
 using System.Text;
 using System.Text.Json;
+using MfaSrv.Core.Challenges;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.Interfaces;
 using MfaSrv.Core.ValueObjects;
@@ -11,28 +12,32 @@ namespace MfaSrv.Provider.Push;
 
 /// <summary>
 /// MFA provider that issues push notification challenges to a registered mobile device.
-/// The user approves or denies the authentication request from their device, and the
-/// server polls the challenge status asynchronously.
+/// The user approves or denies the authentication request from their device; the app's
+/// callback resolves the challenge and publishes the outcome through
+/// <see cref="ChallengeCompletionEngine"/>, which wakes anyone waiting for it.
 /// </summary>
 public class PushMfaProvider : IMfaProvider
 {
-    private readonly PushNotificationClient _pushClient;
+    private readonly IOutboundDeliveryQueue _delivery;
     private readonly PushSettings _settings;
     private readonly ILogger<PushMfaProvider> _logger;
     private readonly IChallengeStore _store;
+    private readonly ChallengeCompletionEngine _completions;
 
     private const string ChallengePrefix = "push:challenge:";
     private const string EnrollmentPrefix = "push:enroll:";
 
     public PushMfaProvider(
-        PushNotificationClient pushClient,
+        IOutboundDeliveryQueue delivery,
         IOptions<PushSettings> settings,
         IChallengeStore store,
+        ChallengeCompletionEngine completions,
         ILogger<PushMfaProvider> logger)
     {
-        _pushClient = pushClient;
+        _delivery = delivery;
         _settings = settings.Value;
         _store = store;
+        _completions = completions;
         _logger = logger;
     }
 
@@ -183,9 +188,9 @@ public class PushMfaProvider : IMfaProvider
 
     /// <summary>
     /// Issues a push notification challenge. The device token is extracted from
-    /// the encrypted secret stored in the enrollment. A push notification is
-    /// sent to the mobile app, and the challenge is stored in the pending
-    /// dictionary for asynchronous status polling.
+    /// the encrypted secret stored in the enrollment. The challenge is stored for
+    /// asynchronous status checks and the push notification is queued for delivery
+    /// to the mobile app.
     /// </summary>
     public async Task<ChallengeResult> IssueChallengeAsync(ChallengeContext ctx, CancellationToken ct = default)
     {
@@ -251,14 +256,24 @@ public class PushMfaProvider : IMfaProvider
             ? $"Approve sign-in to {ctx.TargetResource}?"
             : "Approve your sign-in request?";
 
-        var sent = await _pushClient.SendPushAsync(deviceToken, title, body, challengeId, ct);
+        // Delivery happens in the background; if it finally fails the delivery queue
+        // publishes a failed outcome for the challenge.
+        var queued = _delivery.TryEnqueue(new OutboundMessage
+        {
+            Channel = DeliveryChannel.Push,
+            Recipient = deviceToken,
+            Subject = title,
+            Body = body,
+            ChallengeId = challengeId,
+            ExpiresAt = expiresAt
+        });
 
-        if (!sent)
+        if (!queued)
         {
             // Remove the pending challenge since delivery failed.
             await _store.RemoveAsync(ChallengePrefix + challengeId, ct);
 
-            _logger.LogError("Failed to deliver push notification for challenge {ChallengeId}", challengeId);
+            _logger.LogError("Push delivery queue full, challenge {ChallengeId} not sent", challengeId);
             return new ChallengeResult
             {
                 Success = false,
@@ -302,6 +317,11 @@ public class PushMfaProvider : IMfaProvider
         if (DateTimeOffset.UtcNow > pending.ExpiresAt)
         {
             await _store.RemoveAsync(ChallengePrefix + ctx.ChallengeId, ct);
+            _completions.Complete(ctx.ChallengeId, new AsyncVerificationStatus
+            {
+                Status = ChallengeStatus.Expired,
+                Error = "Challenge has expired"
+            });
 
             _logger.LogInformation("Challenge {ChallengeId} has expired", ctx.ChallengeId);
             return new VerificationResult
@@ -328,6 +348,7 @@ public class PushMfaProvider : IMfaProvider
             case "APPROVE":
                 pending.Status = ChallengeStatus.Approved;
                 await _store.SetAsync(ChallengePrefix + ctx.ChallengeId, pending, TimeSpan.FromMinutes(1), ct);
+                _completions.Complete(ctx.ChallengeId, new AsyncVerificationStatus { Status = ChallengeStatus.Approved });
                 _logger.LogInformation("Challenge {ChallengeId} approved by user {UserId}", ctx.ChallengeId, ctx.UserId);
                 return new VerificationResult
                 {
@@ -337,6 +358,11 @@ public class PushMfaProvider : IMfaProvider
             case "DENY":
                 pending.Status = ChallengeStatus.Denied;
                 await _store.SetAsync(ChallengePrefix + ctx.ChallengeId, pending, TimeSpan.FromMinutes(1), ct);
+                _completions.Complete(ctx.ChallengeId, new AsyncVerificationStatus
+                {
+                    Status = ChallengeStatus.Denied,
+                    Error = "Authentication request was denied by user"
+                });
                 _logger.LogInformation("Challenge {ChallengeId} denied by user {UserId}", ctx.ChallengeId, ctx.UserId);
                 return new VerificationResult
                 {
@@ -357,11 +383,16 @@ public class PushMfaProvider : IMfaProvider
     }
 
     /// <summary>
-    /// Returns the current asynchronous status of a push challenge.
-    /// Called by the server when polling on behalf of the authentication flow.
+    /// Returns the current asynchronous status of a push challenge. Outcomes resolved on this
+    /// instance come from <see cref="ChallengeCompletionEngine"/>; the store covers challenges
+    /// resolved on another instance and keeps resolved entries for a minute, so any number
+    /// of status checks see the same result.
     /// </summary>
     public async Task<AsyncVerificationStatus> CheckAsyncStatusAsync(string challengeId, CancellationToken ct = default)
     {
+        if (_completions.TryGetOutcome(challengeId, out var outcome))
+            return outcome;
+
         var pending = await _store.GetAsync<PendingPushChallenge>(ChallengePrefix + challengeId, ct);
         if (pending == null)
         {
@@ -379,13 +410,7 @@ public class PushMfaProvider : IMfaProvider
             await _store.RemoveAsync(ChallengePrefix + challengeId, ct);
         }
 
-        // Clean up resolved challenges (keep them until polled at least once).
-        if (pending.Status is ChallengeStatus.Approved or ChallengeStatus.Denied or ChallengeStatus.Expired)
-        {
-            await _store.RemoveAsync(ChallengePrefix + challengeId, ct);
-        }
-
-        return new AsyncVerificationStatus
+        var status = new AsyncVerificationStatus
         {
             Status = pending.Status,
             Error = pending.Status switch
@@ -395,6 +420,11 @@ public class PushMfaProvider : IMfaProvider
                 _ => null
             }
         };
+
+        if (status.Status != ChallengeStatus.Issued)
+            _completions.Complete(challengeId, status);
+
+        return status;
     }
 
     // ── Internal models ─────────────────────────────────────────────────
@@ -1,11 +1,14 @@
 using System.Net.Http.Json;
 using System.Text.Json;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.ValueObjects;
 using Microsoft.Extensions.Logging;
 using Microsoft.Extensions.Options;
 
 namespace MfaSrv.Provider.Push;
 
-public class PushNotificationClient
+public class PushNotificationClient : IOutboundGateway
 {
     private readonly HttpClient _httpClient;
     private readonly PushSettings _settings;
@@ -18,6 +21,11 @@ public class PushNotificationClient
         _logger = logger;
     }
 
+    public DeliveryChannel Channel => DeliveryChannel.Push;
+
+    public Task<bool> SendAsync(OutboundMessage message, CancellationToken ct = default) =>
+        SendPushAsync(message.Recipient, message.Subject ?? string.Empty, message.Body, message.ChallengeId ?? string.Empty, ct);
+
     public async Task<bool> SendPushAsync(string deviceToken, string title, string body, string challengeId, CancellationToken ct = default)
     {
         if (string.IsNullOrEmpty(_settings.FcmServerKey))
@@ -37,10 +45,14 @@ public class PushNotificationClient
                 data = new { challengeId, action = "mfa_approve" }
             };
 
-            _httpClient.DefaultRequestHeaders.Clear();
-            _httpClient.DefaultRequestHeaders.TryAddWithoutValidation("Authorization", $"key={_settings.FcmServerKey}");
+            // Per-request header: the client is shared by concurrent delivery workers
+            using var request = new HttpRequestMessage(HttpMethod.Post, _settings.FcmSendUrl)
+            {
+                Content = JsonContent.Create(payload)
+            };
+            request.Headers.TryAddWithoutValidation("Authorization", $"key={_settings.FcmServerKey}");
 
-            var response = await _httpClient.PostAsJsonAsync(_settings.FcmSendUrl, payload, ct);
+            using var response = await _httpClient.SendAsync(request, ct);
             if (response.IsSuccessStatusCode)
             {
                 _logger.LogInformation("Push notification sent for challenge {ChallengeId}", challengeId);
@@ -1,10 +1,14 @@
+using System.Net.Http.Headers;
 using System.Net.Http.Json;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.ValueObjects;
 using Microsoft.Extensions.Logging;
 using Microsoft.Extensions.Options;
 
 namespace MfaSrv.Provider.Sms;
 
-public class SmsGatewayClient
+public class SmsGatewayClient : IOutboundGateway
 {
     private readonly HttpClient _httpClient;
     private readonly SmsSettings _settings;
@@ -17,6 +21,11 @@ public class SmsGatewayClient
         _logger = logger;
     }
 
+    public DeliveryChannel Channel => DeliveryChannel.Sms;
+
+    public Task<bool> SendAsync(OutboundMessage message, CancellationToken ct = default) =>
+        SendSmsAsync(message.Recipient, message.Body, ct);
+
     public async Task<bool> SendSmsAsync(string toNumber, string message, CancellationToken ct = default)
     {
         if (string.IsNullOrEmpty(_settings.GatewayUrl))
@@ -29,10 +38,15 @@ public class SmsGatewayClient
         try
         {
             var payload = new { to = toNumber, from = _settings.FromNumber, body = message };
-            _httpClient.DefaultRequestHeaders.Authorization =
-                new System.Net.Http.Headers.AuthenticationHeaderValue("Bearer", _settings.ApiKey);
 
-            var response = await _httpClient.PostAsJsonAsync(_settings.GatewayUrl, payload, ct);
+            // Per-request header: the client is shared by concurrent delivery workers
+            using var request = new HttpRequestMessage(HttpMethod.Post, _settings.GatewayUrl)
+            {
+                Content = JsonContent.Create(payload)
+            };
+            request.Headers.Authorization = new AuthenticationHeaderValue("Bearer", _settings.ApiKey);
+
+            using var response = await _httpClient.SendAsync(request, ct);
 
             if (response.IsSuccessStatusCode)
             {
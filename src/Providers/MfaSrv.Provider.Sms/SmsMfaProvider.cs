@@ -12,6 +12,7 @@ public class SmsMfaProvider : IMfaProvider
 {
     private readonly SmsSettings _settings;
     private readonly SmsGatewayClient _smsClient;
+    private readonly IOutboundDeliveryQueue _delivery;
     private readonly IChallengeStore _store;
     private readonly ILogger<SmsMfaProvider> _logger;
 
@@ -20,11 +21,13 @@ public class SmsMfaProvider : IMfaProvider
     public SmsMfaProvider(
         IOptions<SmsSettings> settings,
         SmsGatewayClient smsClient,
+        IOutboundDeliveryQueue delivery,
         IChallengeStore store,
         ILogger<SmsMfaProvider> logger)
     {
         _settings = settings.Value;
         _smsClient = smsClient;
+        _delivery = delivery;
         _store = store;
         _logger = logger;
     }
@@ -152,11 +155,23 @@ public class SmsMfaProvider : IMfaProvider
         var expiry = DateTimeOffset.UtcNow.AddMinutes(_settings.CodeExpiryMinutes);
 
         var message = _settings.MessageTemplate.Replace("{code}", code);
-        var sent = await _smsClient.SendSmsAsync(phoneNumber, message, ct);
 
-        if (!sent)
+        // Stored before delivery is queued so a fast reply always finds the challenge
+        await _store.SetAsync(ChallengePrefix + challengeId, new PendingChallenge(code, expiry, 0, phoneNumber), TimeSpan.FromMinutes(_settings.CodeExpiryMinutes + 1), ct);
+
+        var queued = _delivery.TryEnqueue(new OutboundMessage
+        {
+            Channel = DeliveryChannel.Sms,
+            Recipient = phoneNumber,
+            Body = message,
+            ChallengeId = challengeId,
+            ExpiresAt = expiry
+        });
+
+        if (!queued)
         {
-            _logger.LogError("Failed to send SMS challenge to user {UserId}", ctx.UserId);
+            await _store.RemoveAsync(ChallengePrefix + challengeId, ct);
+            _logger.LogError("SMS delivery queue full, challenge for user {UserId} not sent", ctx.UserId);
             return new ChallengeResult
             {
                 Success = false,
@@ -165,8 +180,6 @@ public class SmsMfaProvider : IMfaProvider
             };
         }
 
-        await _store.SetAsync(ChallengePrefix + challengeId, new PendingChallenge(code, expiry, 0, phoneNumber), TimeSpan.FromMinutes(_settings.CodeExpiryMinutes + 1), ct);
-
         _logger.LogInformation("SMS challenge {ChallengeId} issued for user {UserId} to {Phone}",
             challengeId, ctx.UserId, MaskPhoneNumber(phoneNumber));
 
@@ -15,6 +15,13 @@ public class TotpMfaProvider : IMfaProvider
 
     private const string DefaultIssuer = "MfaSrv";
 
+    private readonly TotpValidationEngine _validator;
+
+    public TotpMfaProvider(TotpValidationEngine validator)
+    {
+        _validator = validator;
+    }
+
     public Task<EnrollmentInitResult> BeginEnrollmentAsync(EnrollmentContext ctx, CancellationToken ct = default)
     {
         var secret = TotpGenerator.GenerateSecret();
@@ -60,7 +67,7 @@ public class TotpMfaProvider : IMfaProvider
 
     public Task<VerificationResult> VerifyAsync(VerificationContext ctx, string response, CancellationToken ct = default)
     {
-        if (ctx.EncryptedSecret == null || ctx.SecretNonce == null)
+        if (ctx.EncryptedSecret == null || ctx.SecretNonce == null || ctx.EncryptionKey == null || ctx.EnrollmentId == null)
         {
             return Task.FromResult(new VerificationResult
             {
@@ -69,16 +76,15 @@ public class TotpMfaProvider : IMfaProvider
             });
         }
 
-        // Note: The actual decryption happens in the caller (MfaChallengeOrchestrator or Controller)
-        // because they have access to the encryption key. This method receives the encrypted secret
-        // and would need the key injected. For now, we handle TOTP verification at the orchestrator level.
-        //
-        // In a real implementation, you'd inject the encryption key or have a secret resolution service.
+        var result = _validator.Validate(
+            ctx.EnrollmentId, ctx.EncryptedSecret, ctx.SecretNonce, ctx.EncryptionKey,
+            response, DateTimeOffset.UtcNow);
 
-        return Task.FromResult(new VerificationResult
+        return Task.FromResult(result switch
         {
-            Success = false,
-            Error = "TOTP verification should be performed with decrypted secret"
+            TotpValidationResult.Valid => new VerificationResult { Success = true },
+            TotpValidationResult.Replayed => new VerificationResult { Success = false, Error = "Code has already been used" },
+            _ => new VerificationResult { Success = false, Error = "Invalid code" }
         });
     }
 
@@ -0,0 +1,182 @@
+using System.Collections.Concurrent;
+using System.Security.Cryptography;
+using MfaSrv.Cryptography;
+
+namespace MfaSrv.Provider.Totp;
+
+public enum TotpValidationResult
+{
+    Valid,
+    Invalid,
+    Replayed
+}
+
+/// <summary>
+/// Validates TOTP codes for enrolled authenticators.
+///
+/// The enrollment secret is decrypted once and kept as a <see cref="TotpKey"/> (precomputed
+/// HMAC states, pinned and zeroed on eviction) for <see cref="KeyTtl"/>, so mass
+/// re-authentication does not pay an AES-GCM decrypt and a full HMAC setup per code.
+///
+/// Each enrollment also records the last time step it accepted. A code for that step or an
+/// earlier one is rejected as a replay (RFC 6238 section 5.2), which also stops an older
+/// code within the tolerance window from being used after a newer one. Replay state is
+/// per server instance.
+/// </summary>
+public sealed class TotpValidationEngine : IDisposable
+{
+    public const int Digits = 6;
+    public const int PeriodSeconds = 30;
+    public const int ToleranceSteps = 1;
+
+    public static readonly TimeSpan DefaultKeyTtl = TimeSpan.FromMinutes(10);
+    private const int PurgeEvery = 1024;
+
+    private readonly ConcurrentDictionary<string, EnrollmentState> _enrollments = new(StringComparer.Ordinal);
+    private long _validations;
+
+    public TotpValidationEngine()
+        : this(DefaultKeyTtl)
+    {
+    }
+
+    public TotpValidationEngine(TimeSpan keyTtl)
+    {
+        KeyTtl = keyTtl;
+    }
+
+    public TimeSpan KeyTtl { get; }
+
+    /// <summary>
+    /// Number of enrollments with cached key or replay state.
+    /// </summary>
+    public int Count => _enrollments.Count;
+
+    public TotpValidationResult Validate(
+        string enrollmentId, byte[] encryptedSecret, byte[] secretNonce, byte[] encryptionKey,
+        string code, DateTimeOffset now)
+    {
+        if (string.IsNullOrEmpty(code) || code.Length != Digits)
+            return TotpValidationResult.Invalid;
+
+        if (Interlocked.Increment(ref _validations) % PurgeEvery == 0)
+            PurgeExpired(now);
+
+        while (true)
+        {
+            var state = _enrollments.GetOrAdd(enrollmentId, _ => new EnrollmentState());
+            lock (state)
+            {
+                // Purged between lookup and lock: its replay state must not be updated
+                if (state.Removed)
+                    continue;
+
+                return ValidateLocked(state, encryptedSecret, secretNonce, encryptionKey, code, now);
+            }
+        }
+    }
+
+    private TotpValidationResult ValidateLocked(
+        EnrollmentState state, byte[] encryptedSecret, byte[] secretNonce, byte[] encryptionKey,
+        string code, DateTimeOffset now)
+    {
+        if (state.Key == null || state.KeyExpiresAt <= now)
+        {
+            state.Key?.Dispose();
+            state.Key = null;
+
+            byte[] secret;
+            try
+            {
+                secret = AesGcmEncryption.Decrypt(encryptedSecret, secretNonce, encryptionKey);
+            }
+            catch (Exception ex) when (ex is CryptographicException or ArgumentException)
+            {
+                return TotpValidationResult.Invalid;
+            }
+
+            state.Key = TotpKey.Create(secret);
+            state.KeyExpiresAt = now + KeyTtl;
+            CryptographicOperations.ZeroMemory(secret);
+        }
+
+        var matched = state.Key.Match(code, TotpGenerator.GetTimeStep(now, PeriodSeconds), ToleranceSteps, Digits);
+        if (matched < 0)
+            return TotpValidationResult.Invalid;
+
+        if (matched <= state.LastAcceptedStep)
+            return TotpValidationResult.Replayed;
+
+        state.LastAcceptedStep = matched;
+        return TotpValidationResult.Valid;
+    }
+
+    /// <summary>
+    /// Drops the cached key of an enrollment (e.g. when it is revoked). Replay state is kept
+    /// until its steps leave the tolerance window.
+    /// </summary>
+    public void Evict(string enrollmentId)
+    {
+        if (_enrollments.TryGetValue(enrollmentId, out var state))
+        {
+            lock (state)
+            {
+                state.Key?.Dispose();
+                state.Key = null;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Disposes keys past their TTL and forgets enrollments whose last accepted step can no
+    /// longer be replayed.
+    /// </summary>
+    public int PurgeExpired(DateTimeOffset now)
+    {
+        var oldestReplayableStep = TotpGenerator.GetTimeStep(now, PeriodSeconds) - ToleranceSteps;
+        var removed = 0;
+
+        foreach (var (enrollmentId, state) in _enrollments)
+        {
+            lock (state)
+            {
+                if (state.Key != null && state.KeyExpiresAt <= now)
+                {
+                    state.Key.Dispose();
+                    state.Key = null;
+                }
+
+                if (state.Key == null
+                    && state.LastAcceptedStep < oldestReplayableStep
+                    && _enrollments.TryRemove(new KeyValuePair<string, EnrollmentState>(enrollmentId, state)))
+                {
+                    state.Removed = true;
+                    removed++;
+                }
+            }
+        }
+
+        return removed;
+    }
+
+    public void Dispose()
+    {
+        foreach (var state in _enrollments.Values)
+        {
+            lock (state)
+            {
+                state.Key?.Dispose();
+                state.Key = null;
+            }
+        }
+        _enrollments.Clear();
+    }
+
+    private sealed class EnrollmentState
+    {
+        public TotpKey? Key;
+        public DateTimeOffset KeyExpiresAt;
+        public long LastAcceptedStep = -1;
+        public bool Removed;
+    }
+}
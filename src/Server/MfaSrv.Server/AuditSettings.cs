@@ -0,0 +1,52 @@
+namespace MfaSrv.Server;
+
+/// <summary>
+/// Configuration for how audit log entries are persisted.
+/// Bound from the "Audit" section of appsettings.json.
+/// </summary>
+public class AuditSettings
+{
+    /// <summary>
+    /// <see cref="AuditWriteMode.Synchronous"/> writes each entry before the request continues.
+    /// <see cref="AuditWriteMode.Batched"/> queues entries and writes them in batches on a background task.
+    /// </summary>
+    public AuditWriteMode Mode { get; set; } = AuditWriteMode.Batched;
+
+    /// <summary>
+    /// Maximum number of entries waiting to be written in batched mode.
+    /// </summary>
+    public int QueueCapacity { get; set; } = 10000;
+
+    /// <summary>
+    /// Maximum number of entries written in one database transaction.
+    /// </summary>
+    public int BatchSize { get; set; } = 500;
+
+    /// <summary>
+    /// Longest time (in milliseconds) a queued entry waits for a batch to fill before it is written.
+    /// </summary>
+    public int FlushIntervalMs { get; set; } = 1000;
+
+    /// <summary>
+    /// Queue fill level (percent of <see cref="QueueCapacity"/>) above which routine events
+    /// (authentication attempts, policy evaluations, agent heartbeats) are sampled.
+    /// </summary>
+    public int SamplingThresholdPercent { get; set; } = 80;
+
+    /// <summary>
+    /// While sampling, one in this many routine events is kept.
+    /// </summary>
+    public int SamplingRate { get; set; } = 10;
+
+    /// <summary>
+    /// Audit entries older than this many days are dropped, one hourly segment at a time.
+    /// 0 keeps the audit log forever.
+    /// </summary>
+    public int RetentionDays { get; set; }
+}
+
+public enum AuditWriteMode
+{
+    Synchronous,
+    Batched
+}
@@ -25,4 +25,27 @@ public class BackupSettings
     /// Whether the automatic backup service is enabled.
     /// </summary>
     public bool Enabled { get; set; } = true;
+
+    /// <summary>
+    /// Database pages copied per step of the online backup. The source is read-locked only
+    /// while a step runs, so smaller steps mean shorter waits for writers.
+    /// </summary>
+    public int PagesPerStep { get; set; } = 256;
+
+    /// <summary>
+    /// Minimum pause between backup steps, in milliseconds.
+    /// </summary>
+    public int StepDelayMs { get; set; } = 5;
+
+    /// <summary>
+    /// Average backup read rate limit in bytes per second; 0 for no limit.
+    /// </summary>
+    public long MaxBytesPerSecond { get; set; } = 32L * 1024 * 1024;
+
+    /// <summary>
+    /// Switches the server's SQLite database to WAL journal mode at startup, so a backup reads
+    /// one snapshot without blocking writers. Disable for databases on network file systems,
+    /// which do not support WAL; writes then restart the backup copy.
+    /// </summary>
+    public bool UseWalJournal { get; set; } = true;
 }
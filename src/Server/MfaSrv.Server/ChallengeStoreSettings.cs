@@ -0,0 +1,34 @@
+namespace MfaSrv.Server;
+
+/// <summary>
+/// Configuration for where MFA providers keep pending challenge state.
+/// Bound from the "ChallengeStore" section of appsettings.json.
+/// </summary>
+public class ChallengeStoreSettings
+{
+    /// <summary>
+    /// <see cref="ChallengeStoreMode.Distributed"/> uses IDistributedCache (Redis when
+    /// <c>ConnectionStrings:Redis</c> is set). <see cref="ChallengeStoreMode.Local"/> keeps
+    /// challenges in process, optionally replicated to <see cref="ReplicationPeers"/>.
+    /// </summary>
+    public ChallengeStoreMode Mode { get; set; } = ChallengeStoreMode.Distributed;
+
+    /// <summary>
+    /// gRPC URLs of the other server instances that local challenge state is copied to.
+    /// Only used in <see cref="ChallengeStoreMode.Local"/> mode; empty disables replication.
+    /// Requires <see cref="HaSettings.PeerSecret"/>, and the peers only accept changes from
+    /// the hosts in their own list.
+    /// </summary>
+    public string[] ReplicationPeers { get; set; } = Array.Empty<string>();
+
+    /// <summary>
+    /// Maximum number of changes waiting to be replicated. Beyond this the oldest are dropped.
+    /// </summary>
+    public int ReplicationQueueCapacity { get; set; } = 10000;
+}
+
+public enum ChallengeStoreMode
+{
+    Distributed,
+    Local
+}
@@ -2,6 +2,7 @@ using Microsoft.AspNetCore.Mvc;
 using Microsoft.EntityFrameworkCore;
 using MfaSrv.Core.Enums;
 using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
 
 namespace MfaSrv.Server.Controllers;
 
@@ -10,10 +11,12 @@ namespace MfaSrv.Server.Controllers;
 public class AuditController : ControllerBase
 {
     private readonly MfaSrvDbContext _db;
+    private readonly AuditStore _auditStore;
 
-    public AuditController(MfaSrvDbContext db)
+    public AuditController(MfaSrvDbContext db, AuditStore auditStore)
     {
         _db = db;
+        _auditStore = auditStore;
     }
 
     [HttpGet]
@@ -36,7 +39,18 @@ public class AuditController : ControllerBase
         if (to.HasValue)
             query = query.Where(e => e.Timestamp <= to.Value);
 
-        var total = await query.CountAsync();
+        // Per-user totals use the (UserId, Timestamp) index; everything else comes from hourly rollups
+        long total;
+        if (!string.IsNullOrEmpty(userId))
+        {
+            total = await query.LongCountAsync();
+        }
+        else
+        {
+            var counts = await _auditStore.GetCountsAsync(from, to);
+            total = counts.Where(c => !eventType.HasValue || c.Key.EventType == eventType.Value).Sum(c => c.Value);
+        }
+
         var entries = await query
             .OrderByDescending(e => e.Timestamp)
             .Skip((page - 1) * pageSize)
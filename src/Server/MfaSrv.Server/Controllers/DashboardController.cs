@@ -1,7 +1,5 @@
 using Microsoft.AspNetCore.Mvc;
-using Microsoft.EntityFrameworkCore;
 using MfaSrv.Core.Enums;
-using MfaSrv.Server.Data;
 using MfaSrv.Server.Services;
 
 namespace MfaSrv.Server.Controllers;
@@ -13,104 +11,66 @@ namespace MfaSrv.Server.Controllers;
 [Route("api/[controller]")]
 public class DashboardController : ControllerBase
 {
-    private readonly MfaSrvDbContext _db;
     private readonly PolicySyncStreamService _policySyncStream;
+    private readonly AuditStore _auditStore;
+    private readonly DashboardStatisticsService _statistics;
 
-    public DashboardController(MfaSrvDbContext db, PolicySyncStreamService policySyncStream)
+    public DashboardController(
+        PolicySyncStreamService policySyncStream,
+        AuditStore auditStore,
+        DashboardStatisticsService statistics)
     {
-        _db = db;
         _policySyncStream = policySyncStream;
+        _auditStore = auditStore;
+        _statistics = statistics;
     }
 
     /// <summary>
     /// Returns a comprehensive snapshot of system statistics.
+    /// Served from <see cref="DashboardStatisticsService"/> without querying the database.
     /// </summary>
     [HttpGet("stats")]
-    public async Task<IActionResult> GetStats()
+    public IActionResult GetStats()
     {
-        var now = DateTimeOffset.UtcNow;
-        var last24h = now.AddHours(-24);
-
-        // User statistics
-        var totalUsers = await _db.Users.CountAsync();
-        var mfaEnabledUsers = await _db.Users.CountAsync(u => u.MfaEnabled);
-
-        // Session statistics
-        var activeSessions = await _db.MfaSessions
-            .CountAsync(s => s.Status == SessionStatus.Active && s.ExpiresAt > now);
-
-        // Agent statistics
-        var onlineAgents = await _db.AgentRegistrations
-            .CountAsync(a => a.Status == AgentStatus.Online);
-        var totalAgents = await _db.AgentRegistrations.CountAsync();
-
-        // Audit event counts for last 24 hours
-        var authEvents24h = await _db.AuditLog
-            .CountAsync(e => e.Timestamp >= last24h && e.EventType == AuditEventType.AuthenticationAttempt);
-        var mfaChallenges24h = await _db.AuditLog
-            .CountAsync(e => e.Timestamp >= last24h && e.EventType == AuditEventType.MfaChallengeIssued);
-        var mfaSuccesses24h = await _db.AuditLog
-            .CountAsync(e => e.Timestamp >= last24h && e.EventType == AuditEventType.MfaChallengeVerified);
-        var mfaFailures24h = await _db.AuditLog
-            .CountAsync(e => e.Timestamp >= last24h && e.EventType == AuditEventType.MfaChallengeFailed);
-        var deniedAuths24h = await _db.AuditLog
-            .CountAsync(e => e.Timestamp >= last24h
-                && e.EventType == AuditEventType.AuthenticationAttempt
-                && !e.Success);
-
-        // Enrollment breakdown by method
-        var enrollmentsByMethod = await _db.MfaEnrollments
-            .Where(e => e.Status == EnrollmentStatus.Active)
-            .GroupBy(e => e.Method)
-            .Select(g => new { Method = g.Key.ToString(), Count = g.Count() })
-            .ToListAsync();
-
-        // Policy statistics
-        var activePolicies = await _db.Policies.CountAsync(p => p.IsEnabled);
-        var totalPolicies = await _db.Policies.CountAsync();
-
-        // Recent audit events
-        var recentEvents = await _db.AuditLog
-            .OrderByDescending(e => e.Timestamp)
-            .Take(10)
-            .Select(e => new
-            {
-                e.EventType,
-                e.UserId,
-                e.UserName,
-                e.SourceIp,
-                e.Timestamp,
-                e.Success,
-                e.Details
-            })
-            .ToListAsync();
+        var stats = _statistics.GetSnapshot();
+        var entities = stats.Entities;
 
         return Ok(new
         {
-            users = new { total = totalUsers, mfaEnabled = mfaEnabledUsers },
-            sessions = new { active = activeSessions },
+            users = new { total = entities.TotalUsers, mfaEnabled = entities.MfaEnabledUsers },
+            sessions = new { active = stats.ActiveSessions },
             agents = new
             {
-                online = onlineAgents,
-                total = totalAgents,
+                online = entities.OnlineAgents,
+                total = entities.TotalAgents,
                 syncSubscribers = _policySyncStream.SubscriberCount
             },
-            policies = new { active = activePolicies, total = totalPolicies },
+            policies = new { active = entities.ActivePolicies, total = entities.TotalPolicies },
             last24Hours = new
             {
-                authentications = authEvents24h,
-                mfaChallenges = mfaChallenges24h,
-                mfaSuccesses = mfaSuccesses24h,
-                mfaFailures = mfaFailures24h,
-                denied = deniedAuths24h
+                authentications = stats.Count(AuditEventType.AuthenticationAttempt),
+                mfaChallenges = stats.Count(AuditEventType.MfaChallengeIssued),
+                mfaSuccesses = stats.Count(AuditEventType.MfaChallengeVerified),
+                mfaFailures = stats.Count(AuditEventType.MfaChallengeFailed),
+                denied = stats.Count(AuditEventType.AuthenticationAttempt, success: false)
             },
-            enrollmentsByMethod,
-            recentEvents
+            enrollmentsByMethod = entities.EnrollmentsByMethod
+                .Select(e => new { Method = e.Key.ToString(), Count = e.Value }),
+            recentEvents = stats.RecentEvents.Select(e => new
+            {
+                e.EventType,
+                e.UserId,
+                e.UserName,
+                e.SourceIp,
+                e.Timestamp,
+                e.Success,
+                e.Details
+            })
         });
     }
 
     /// <summary>
-    /// Returns audit event counts grouped by hour and event type for charting.
+    /// Returns audit event counts per hour for charting, one row per hour (oldest first).
     /// </summary>
     [HttpGet("stats/hourly")]
     public async Task<IActionResult> GetHourlyStats([FromQuery] int hours = 24)
@@ -118,20 +78,28 @@ public class DashboardController : ControllerBase
         if (hours < 1) hours = 1;
         if (hours > 168) hours = 168; // Cap at 7 days
 
-        var since = DateTimeOffset.UtcNow.AddHours(-hours);
+        var now = DateTimeOffset.UtcNow;
+        var since = now.AddHours(-hours);
 
-        var events = await _db.AuditLog
-            .Where(e => e.Timestamp >= since)
-            .GroupBy(e => new { Hour = e.Timestamp.Hour, e.EventType })
-            .Select(g => new
-            {
-                g.Key.Hour,
-                EventType = g.Key.EventType.ToString(),
-                Count = g.Count()
-            })
-            .OrderBy(x => x.Hour)
-            .ToListAsync();
+        var series = (await _auditStore.GetHourlySeriesAsync(since, now))
+            .ToLookup(r => r.Hour);
+
+        var rows = new List<object>();
+        for (var hour = AuditStore.HourOf(since); hour <= AuditStore.HourOf(now); hour++)
+        {
+            var counts = series[hour];
+            long Count(AuditEventType type) => counts.Where(r => r.EventType == type).Sum(r => r.Count);
 
-        return Ok(events);
+            rows.Add(new
+            {
+                hour = AuditStore.StartOf(hour),
+                authentications = Count(AuditEventType.AuthenticationAttempt),
+                mfaChallenges = Count(AuditEventType.MfaChallengeIssued),
+                successes = Count(AuditEventType.MfaChallengeVerified),
+                failures = Count(AuditEventType.MfaChallengeFailed)
+            });
+        }
+
+        return Ok(rows);
     }
 }
@@ -6,6 +6,7 @@ using MfaSrv.Core.Interfaces;
 using MfaSrv.Core.ValueObjects;
 using MfaSrv.Cryptography;
 using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
 
 namespace MfaSrv.Server.Controllers;
 
@@ -15,12 +16,18 @@ public class EnrollmentsController : ControllerBase
 {
     private readonly MfaSrvDbContext _db;
     private readonly IEnumerable<IMfaProvider> _providers;
+    private readonly EnrollmentCache _enrollmentCache;
     private readonly byte[] _encryptionKey;
 
-    public EnrollmentsController(MfaSrvDbContext db, IEnumerable<IMfaProvider> providers, Microsoft.Extensions.Configuration.IConfiguration config)
+    public EnrollmentsController(
+        MfaSrvDbContext db,
+        IEnumerable<IMfaProvider> providers,
+        EnrollmentCache enrollmentCache,
+        Microsoft.Extensions.Configuration.IConfiguration config)
     {
         _db = db;
         _providers = providers;
+        _enrollmentCache = enrollmentCache;
         // In production, use a proper key management service
         var keyBase64 = config["MfaSrv:EncryptionKey"] ?? Convert.ToBase64String(new byte[32]);
         _encryptionKey = Convert.FromBase64String(keyBase64);
@@ -131,6 +138,7 @@ public class EnrollmentsController : ControllerBase
             enrollment.ActivatedAt = DateTimeOffset.UtcNow;
             user.MfaEnabled = true;
             await _db.SaveChangesAsync();
+            _enrollmentCache.Invalidate(enrollment.UserId);
 
             return Ok(new { Success = true });
         }
@@ -146,6 +154,7 @@ public class EnrollmentsController : ControllerBase
 
         enrollment.Status = EnrollmentStatus.Revoked;
         await _db.SaveChangesAsync();
+        _enrollmentCache.Invalidate(enrollment.UserId);
 
         // Check if user has any active enrollments left
         var hasActive = await _db.MfaEnrollments
@@ -6,6 +6,7 @@ using MfaSrv.Core.Interfaces;
 using MfaSrv.Core.ValueObjects;
 using MfaSrv.Cryptography;
 using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
 
 namespace MfaSrv.Server.Controllers;
 
@@ -21,17 +22,20 @@ public class SelfEnrollmentController : ControllerBase
     private readonly MfaSrvDbContext _db;
     private readonly IEnumerable<IMfaProvider> _providers;
     private readonly IAuditLogger _auditLogger;
+    private readonly EnrollmentCache _enrollmentCache;
     private readonly byte[] _encryptionKey;
 
     public SelfEnrollmentController(
         MfaSrvDbContext db,
         IEnumerable<IMfaProvider> providers,
         IAuditLogger auditLogger,
+        EnrollmentCache enrollmentCache,
         IConfiguration config)
     {
         _db = db;
         _providers = providers;
         _auditLogger = auditLogger;
+        _enrollmentCache = enrollmentCache;
         var keyBase64 = config["MfaSrv:EncryptionKey"] ?? Convert.ToBase64String(new byte[32]);
         _encryptionKey = Convert.FromBase64String(keyBase64);
     }
@@ -215,6 +219,7 @@ public class SelfEnrollmentController : ControllerBase
             enrollment.ActivatedAt = DateTimeOffset.UtcNow;
             user.MfaEnabled = true;
             await _db.SaveChangesAsync();
+            _enrollmentCache.Invalidate(userId);
 
             await _auditLogger.LogAsync(
                 AuditEventType.UserEnrolled,
@@ -239,6 +244,7 @@ public class SelfEnrollmentController : ControllerBase
 
         enrollment.Status = EnrollmentStatus.Revoked;
         await _db.SaveChangesAsync();
+        _enrollmentCache.Invalidate(userId);
 
         // Check if user has any active enrollments left
         var hasActive = await _db.MfaEnrollments
@@ -18,6 +18,8 @@ public class MfaSrvDbContext : DbContext
     public DbSet<MfaSession> MfaSessions => Set<MfaSession>();
     public DbSet<MfaChallenge> MfaChallenges => Set<MfaChallenge>();
     public DbSet<AuditLogEntry> AuditLog => Set<AuditLogEntry>();
+    public DbSet<AuditSegment> AuditSegments => Set<AuditSegment>();
+    public DbSet<AuditHourlyRollup> AuditHourlyRollups => Set<AuditHourlyRollup>();
     public DbSet<AgentRegistration> AgentRegistrations => Set<AgentRegistration>();
     public DbSet<LeaderLease> LeaderLeases => Set<LeaderLease>();
 
@@ -83,8 +85,13 @@ public class MfaSrvDbContext : DbContext
         {
             e.HasKey(x => x.Id);
             e.HasIndex(x => x.UserId);
-            e.HasIndex(x => x.ExpiresAt);
-            e.HasIndex(x => new { x.UserId, x.SourceIp, x.Status });
+            // Every expiry query also filters on Status; with Status first, cleanup batches seek
+            // straight to the rows still to do instead of rescanning those already done
+            e.HasIndex(x => new { x.Status, x.ExpiresAt });
+            // Active-session lookup: equality on the first three columns and a range on ExpiresAt,
+            // so only unexpired rows of the user and IP are visited and sorted by CreatedAt
+            e.HasIndex(x => new { x.UserId, x.SourceIp, x.Status, x.ExpiresAt, x.CreatedAt })
+                .HasDatabaseName("IX_MfaSessions_ActiveLookup");
             e.HasOne(x => x.User).WithMany().HasForeignKey(x => x.UserId).OnDelete(DeleteBehavior.Cascade);
         });
 
@@ -100,11 +107,22 @@ public class MfaSrvDbContext : DbContext
             e.HasKey(x => x.Id);
             e.Property(x => x.Id).ValueGeneratedOnAdd();
             e.HasIndex(x => x.Timestamp);
-            e.HasIndex(x => x.UserId);
-            e.HasIndex(x => x.EventType);
+            e.HasIndex(x => new { x.EventType, x.Timestamp });
+            e.HasIndex(x => new { x.UserId, x.Timestamp });
             e.Property(x => x.Details).HasMaxLength(4096);
         });
 
+        modelBuilder.Entity<AuditSegment>(e =>
+        {
+            e.HasKey(x => x.Hour);
+            e.Property(x => x.Hour).ValueGeneratedNever();
+        });
+
+        modelBuilder.Entity<AuditHourlyRollup>(e =>
+        {
+            e.HasKey(x => new { x.Hour, x.EventType, x.Success });
+        });
+
         modelBuilder.Entity<AgentRegistration>(e =>
         {
             e.HasKey(x => x.Id);
@@ -117,6 +135,7 @@ public class MfaSrvDbContext : DbContext
             e.HasKey(x => x.LeaseKey);
             e.Property(x => x.LeaseKey).HasMaxLength(64);
             e.Property(x => x.HolderId).HasMaxLength(256);
+            e.Property(x => x.FencingToken).IsConcurrencyToken();
         });
     }
 }
@@ -0,0 +1,51 @@
+namespace MfaSrv.Server;
+
+/// <summary>
+/// Configuration for background delivery of SMS codes, e-mail codes and push notifications.
+/// Bound from the "Delivery" section of appsettings.json.
+/// </summary>
+public class DeliverySettings
+{
+    /// <summary>
+    /// Maximum number of messages waiting per channel. Challenges issued while the queue is
+    /// full fail immediately.
+    /// </summary>
+    public int QueueCapacity { get; set; } = 10000;
+
+    /// <summary>
+    /// Send attempts per message, including the first.
+    /// </summary>
+    public int MaxAttempts { get; set; } = 4;
+
+    /// <summary>
+    /// Delay before the first retry; doubled for each further retry, with ±50% jitter.
+    /// </summary>
+    public int RetryBaseDelayMs { get; set; } = 500;
+
+    public DeliveryGatewaySettings Sms { get; set; } = new();
+
+    public DeliveryGatewaySettings Email { get; set; } = new() { RatePerSecond = 20, Burst = 40, MaxConcurrency = 4 };
+
+    public DeliveryGatewaySettings Push { get; set; } = new() { RatePerSecond = 200, Burst = 400, MaxConcurrency = 32 };
+}
+
+/// <summary>
+/// Limits applied to one gateway (SMS provider, SMTP relay, FCM).
+/// </summary>
+public class DeliveryGatewaySettings
+{
+    /// <summary>
+    /// Sustained sends per second (token bucket refill rate).
+    /// </summary>
+    public int RatePerSecond { get; set; } = 50;
+
+    /// <summary>
+    /// Sends allowed back to back after an idle period (token bucket size).
+    /// </summary>
+    public int Burst { get; set; } = 100;
+
+    /// <summary>
+    /// Sends in flight at once.
+    /// </summary>
+    public int MaxConcurrency { get; set; } = 16;
+}
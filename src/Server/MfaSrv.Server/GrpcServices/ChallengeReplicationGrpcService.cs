@@ -0,0 +1,64 @@
+using Grpc.Core;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Protocol.Replication;
+using MfaSrv.Server.Services;
+
+namespace MfaSrv.Server.GrpcServices;
+
+/// <summary>
+/// Receives challenge store changes from peer server instances and applies them to the
+/// local <see cref="LocalChallengeStore"/>. Only batches signed with the peer secret and sent
+/// from a host in <see cref="ChallengeStoreSettings.ReplicationPeers"/> are applied.
+/// </summary>
+public class ChallengeReplicationGrpcService : ChallengeReplicationService.ChallengeReplicationServiceBase
+{
+    private readonly LocalChallengeStore _store;
+    private readonly PeerAuthenticator _authenticator;
+    private readonly ChallengeStoreSettings _settings;
+    private readonly ILogger<ChallengeReplicationGrpcService> _logger;
+
+    public ChallengeReplicationGrpcService(
+        LocalChallengeStore store,
+        PeerAuthenticator authenticator,
+        IOptions<ChallengeStoreSettings> settings,
+        ILogger<ChallengeReplicationGrpcService> logger)
+    {
+        _store = store;
+        _authenticator = authenticator;
+        _settings = settings.Value;
+        _logger = logger;
+    }
+
+    public override async Task<ReplicateChallengesResponse> Replicate(
+        ReplicateChallengesRequest request, ServerCallContext context)
+    {
+        var remote = context.GetHttpContext().Connection.RemoteIpAddress;
+        if (!await _authenticator.IsPeerAddressAsync(remote, _settings.ReplicationPeers, context.CancellationToken))
+        {
+            _logger.LogWarning("Refused challenge store changes from {Address}: not a replication peer", remote);
+            throw new RpcException(new Status(StatusCode.PermissionDenied, "Not a replication peer"));
+        }
+
+        if (!_authenticator.Verify(request))
+        {
+            _logger.LogWarning("Refused challenge store changes from {Address} ({Instance}): invalid or replayed signature",
+                remote, request.SenderInstanceId);
+            throw new RpcException(new Status(StatusCode.Unauthenticated, "Invalid peer signature"));
+        }
+
+        foreach (var entry in request.Entries)
+        {
+            _store.ApplyReplicated(
+                entry.Key,
+                entry.Removed ? null : entry.Value.ToByteArray(),
+                entry.ExpiresAt?.ToDateTimeOffset() ?? DateTimeOffset.UtcNow,
+                entry.Removed);
+        }
+
+        _logger.LogDebug("Applied {Count} challenge store changes from {Instance}",
+            request.Entries.Count, request.SenderInstanceId);
+
+        return new ReplicateChallengesResponse { Applied = request.Entries.Count };
+    }
+}
@@ -0,0 +1,104 @@
+using Grpc.Core;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Protocol.Ha;
+using MfaSrv.Server.Services;
+
+namespace MfaSrv.Server.GrpcServices;
+
+/// <summary>
+/// Answers leader election heartbeats from peer server instances. Only heartbeats signed with
+/// the peer secret and sent from a host in <see cref="HaSettings.Peers"/> are accepted; the
+/// answer is signed the same way. Also stores the audit events evaluation nodes forward to the
+/// leader.
+/// </summary>
+public class HaPeerGrpcService : HaPeerService.HaPeerServiceBase
+{
+    private readonly LeaderElectionService _leaderElection;
+    private readonly PeerAuthenticator _authenticator;
+    private readonly IServiceScopeFactory _scopeFactory;
+    private readonly HaSettings _settings;
+    private readonly ILogger<HaPeerGrpcService> _logger;
+
+    public HaPeerGrpcService(
+        LeaderElectionService leaderElection,
+        PeerAuthenticator authenticator,
+        IServiceScopeFactory scopeFactory,
+        IOptions<HaSettings> settings,
+        ILogger<HaPeerGrpcService> logger)
+    {
+        _leaderElection = leaderElection;
+        _authenticator = authenticator;
+        _scopeFactory = scopeFactory;
+        _settings = settings.Value;
+        _logger = logger;
+    }
+
+    public override async Task<PeerHeartbeat> Heartbeat(PeerHeartbeat request, ServerCallContext context)
+    {
+        var remote = context.GetHttpContext().Connection.RemoteIpAddress;
+        if (!await _authenticator.IsPeerAddressAsync(remote, _settings.Peers, context.CancellationToken))
+        {
+            _logger.LogWarning("Refused heartbeat from {Address}: not an HA peer", remote);
+            throw new RpcException(new Status(StatusCode.PermissionDenied, "Not an HA peer"));
+        }
+
+        if (!_authenticator.Verify(request))
+        {
+            _logger.LogWarning("Refused heartbeat from {Address} ({Instance}): invalid or replayed signature",
+                remote, request.InstanceId);
+            throw new RpcException(new Status(StatusCode.Unauthenticated, "Invalid peer signature"));
+        }
+
+        var reply = _leaderElection.HandlePeerHeartbeat(request);
+        _authenticator.Sign(reply);
+        return reply;
+    }
+
+    /// <summary>
+    /// Stores audit events recorded on an evaluation node. Evaluation nodes are not listed in
+    /// <see cref="HaSettings.Peers"/>, so only the signature is checked. Only the leader
+    /// accepts them; a standby refuses, and the node retries against the leader it follows.
+    /// </summary>
+    public override async Task<ForwardAuditResponse> ForwardAudit(ForwardAuditRequest request, ServerCallContext context)
+    {
+        if (!_authenticator.Verify(request))
+        {
+            _logger.LogWarning("Refused forwarded audit events from {Address} ({Node}): invalid or replayed signature",
+                context.GetHttpContext().Connection.RemoteIpAddress, request.NodeId);
+            throw new RpcException(new Status(StatusCode.Unauthenticated, "Invalid peer signature"));
+        }
+
+        if (!_leaderElection.IsLeader)
+            throw new RpcException(new Status(StatusCode.FailedPrecondition, "This instance is not the leader"));
+
+        var entries = new List<AuditLogEntry>(request.Events.Count);
+        foreach (var auditEvent in request.Events)
+        {
+            var eventType = (AuditEventType)auditEvent.EventType;
+            if (!Enum.IsDefined(eventType))
+                continue;
+
+            entries.Add(new AuditLogEntry
+            {
+                EventType = eventType,
+                UserId = auditEvent.UserId,
+                SourceIp = NullIfEmpty(auditEvent.SourceIp),
+                TargetResource = NullIfEmpty(auditEvent.TargetResource),
+                Details = NullIfEmpty(auditEvent.Details),
+                AgentId = $"evaluation-node:{request.NodeId}",
+                Timestamp = auditEvent.Timestamp?.ToDateTimeOffset() ?? DateTimeOffset.UtcNow
+            });
+        }
+
+        // Resolved here rather than injected, so heartbeats do not create a database context
+        using var scope = _scopeFactory.CreateScope();
+        await scope.ServiceProvider.GetRequiredService<AuditLogService>().LogForwardedAsync(entries, context.CancellationToken);
+        return new ForwardAuditResponse { Accepted = entries.Count };
+    }
+
+    private static string? NullIfEmpty(string value) => value.Length == 0 ? null : value;
+}
@@ -0,0 +1,239 @@
+using System.Collections.Concurrent;
+using System.Threading.Channels;
+using Grpc.Core;
+using Google.Protobuf.WellKnownTypes;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Protocol;
+using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
+
+namespace MfaSrv.Server.GrpcServices;
+
+public partial class MfaGrpcService
+{
+    /// <summary>
+    /// Bidirectional per-agent channel. The agent opens it once and multiplexes evaluation
+    /// requests over it, correlated by request ID; up to <see cref="AgentChannelService.MaxInFlight"/>
+    /// evaluations run concurrently, each in its own DI scope. The same stream carries heartbeats
+    /// and pushes session created/revoked events to the agent, and the agent reports the decisions
+    /// it made from its synced policies on it for the audit log. When the stream ends the agent
+    /// is marked offline.
+    /// </summary>
+    public override async Task AgentChannel(
+        IAsyncStreamReader<AgentMessage> requestStream,
+        IServerStreamWriter<ServerMessage> responseStream,
+        ServerCallContext context)
+    {
+        var ct = context.CancellationToken;
+
+        if (!await requestStream.MoveNext(ct)
+            || requestStream.Current.PayloadCase != AgentMessage.PayloadOneofCase.Open)
+        {
+            throw new RpcException(new Status(StatusCode.InvalidArgument, "Agent channel must start with an open message"));
+        }
+
+        var agentId = requestStream.Current.Open.AgentId;
+        var subscriberId = string.IsNullOrEmpty(agentId) ? context.Peer : agentId;
+
+        // IServerStreamWriter allows one write at a time: results, heartbeat acks and pushes
+        // are queued here and written by a single loop
+        var outbound = Channel.CreateUnbounded<ServerMessage>(new UnboundedChannelOptions { SingleReader = true });
+        var pending = new ConcurrentDictionary<ulong, Task>();
+        var sessions = _agentChannels.Subscribe(subscriberId);
+        using var callCts = CancellationTokenSource.CreateLinkedTokenSource(ct);
+
+        var writer = Task.Run(async () =>
+        {
+            await foreach (var message in outbound.Reader.ReadAllAsync(callCts.Token))
+                await responseStream.WriteAsync(message);
+        });
+
+        var pushes = Task.Run(async () =>
+        {
+            await foreach (var notification in sessions.Reader.ReadAllAsync(callCts.Token))
+                outbound.Writer.TryWrite(new ServerMessage { Session = ToProto(notification) });
+        });
+
+        outbound.Writer.TryWrite(new ServerMessage
+        {
+            Accepted = new AgentChannelAccepted { MaxInFlight = AgentChannelService.MaxInFlight }
+        });
+
+        try
+        {
+            await SetAgentStatusAsync(_db, agentId, Core.Enums.AgentStatus.Online, ct);
+
+            while (await requestStream.MoveNext(ct))
+            {
+                var message = requestStream.Current;
+                switch (message.PayloadCase)
+                {
+                    case AgentMessage.PayloadOneofCase.Evaluate:
+                    {
+                        var evaluation = message.Evaluate;
+                        var requestId = evaluation.RequestId;
+                        if (pending.Count >= AgentChannelService.MaxInFlight || pending.ContainsKey(requestId))
+                        {
+                            outbound.Writer.TryWrite(new ServerMessage
+                            {
+                                Result = new AgentEvaluationResult
+                                {
+                                    RequestId = requestId,
+                                    Error = "In-flight window exceeded"
+                                }
+                            });
+                            break;
+                        }
+
+                        var task = EvaluateOnChannelAsync(evaluation, outbound.Writer, callCts.Token);
+                        pending[requestId] = task;
+                        _ = task.ContinueWith(t => pending.TryRemove(requestId, out _), TaskScheduler.Default);
+                        break;
+                    }
+
+                    case AgentMessage.PayloadOneofCase.LocalDecisions:
+                        await AuditLocalDecisionsAsync(subscriberId, message.LocalDecisions, ct);
+                        break;
+
+                    case AgentMessage.PayloadOneofCase.Heartbeat:
+                        await SetAgentStatusAsync(_db, agentId, Core.Enums.AgentStatus.Online, ct);
+                        outbound.Writer.TryWrite(new ServerMessage
+                        {
+                            Heartbeat = new HeartbeatResponse { Acknowledged = true }
+                        });
+                        break;
+                }
+            }
+
+            // Agent half-closed: finish what it already asked for
+            await Task.WhenAll(pending.Values);
+        }
+        catch (OperationCanceledException)
+        {
+            _logger.LogInformation("Agent channel cancelled for agent {AgentId}", subscriberId);
+        }
+        catch (Exception ex)
+        {
+            _logger.LogWarning(ex, "Agent channel error for agent {AgentId}", subscriberId);
+            throw;
+        }
+        finally
+        {
+            outbound.Writer.TryComplete();
+            try
+            {
+                await writer;
+            }
+            catch (Exception)
+            {
+                // Stream already broken; nothing left to deliver
+            }
+
+            callCts.Cancel();
+            try
+            {
+                await pushes;
+            }
+            catch (OperationCanceledException)
+            {
+            }
+
+            // A reconnect may already have replaced this channel; only the current one marks the agent offline
+            if (_agentChannels.Unsubscribe(subscriberId, sessions))
+                await SetAgentStatusAsync(_db, agentId, Core.Enums.AgentStatus.Offline, CancellationToken.None);
+        }
+    }
+
+    private async Task EvaluateOnChannelAsync(
+        AgentEvaluation evaluation, ChannelWriter<ServerMessage> outbound, CancellationToken ct)
+    {
+        var result = new AgentEvaluationResult { RequestId = evaluation.RequestId };
+
+        try
+        {
+            using var scope = _scopeFactory.CreateScope();
+            var services = scope.ServiceProvider;
+            result.Response = await EvaluateCoreAsync(
+                evaluation.Request,
+                services.GetRequiredService<MfaSrvDbContext>(),
+                services.GetRequiredService<ISessionManager>(),
+                services.GetRequiredService<IPolicyEngine>(),
+                services.GetRequiredService<IAuditLogger>(),
+                ct);
+        }
+        catch (OperationCanceledException) when (ct.IsCancellationRequested)
+        {
+            return;
+        }
+        catch (Exception ex)
+        {
+            _logger.LogError(ex, "Agent channel evaluation {RequestId} failed", evaluation.RequestId);
+            result.Error = "Evaluation failed";
+        }
+
+        outbound.TryWrite(new ServerMessage { Result = result });
+    }
+
+    /// <summary>
+    /// Writes decisions an agent made locally to the audit log, with the time the agent made
+    /// them; an evaluation node forwards them to the leader instead. A failure is logged and
+    /// does not close the channel.
+    /// </summary>
+    private async Task AuditLocalDecisionsAsync(string agentId, AgentLocalDecisions decisions, CancellationToken ct)
+    {
+        try
+        {
+            var entries = decisions.Decisions.Select(d => new AuditLogEntry
+            {
+                EventType = AuditEventType.PolicyEvaluated,
+                UserId = d.Request.UserName,
+                SourceIp = NullIfEmpty(d.Request.SourceIp),
+                TargetResource = NullIfEmpty(d.Request.TargetResource),
+                Details = $"Decision: {FromProto(d.Decision)}, Policy: {NullIfEmpty(d.PolicyName) ?? "none"}, evaluated on agent {agentId}",
+                Timestamp = d.DecidedAt?.ToDateTimeOffset() ?? DateTimeOffset.UtcNow
+            }).ToList();
+
+            if (_auditForwarder.IsEnabled)
+            {
+                foreach (var entry in entries)
+                {
+                    _auditForwarder.TryEnqueue(
+                        entry.EventType, entry.UserId ?? string.Empty, entry.SourceIp, entry.TargetResource, entry.Details, entry.Timestamp);
+                }
+                return;
+            }
+
+            using var scope = _scopeFactory.CreateScope();
+            await scope.ServiceProvider.GetRequiredService<AuditLogService>().LogForwardedAsync(entries, ct);
+        }
+        catch (Exception ex) when (ex is not OperationCanceledException)
+        {
+            _logger.LogError(ex, "Failed to audit {Count} local decisions from agent {AgentId}",
+                decisions.Decisions.Count, agentId);
+        }
+    }
+
+    private static string? NullIfEmpty(string value) => value.Length == 0 ? null : value;
+
+    private static AuthDecision FromProto(AuthDecisionType decision) => decision switch
+    {
+        AuthDecisionType.AuthDecisionRequireMfa => AuthDecision.RequireMfa,
+        AuthDecisionType.AuthDecisionDeny => AuthDecision.Deny,
+        AuthDecisionType.AuthDecisionPending => AuthDecision.Pending,
+        _ => AuthDecision.Allow
+    };
+
+    private static SessionEvent ToProto(SessionChangeNotification notification) => new()
+    {
+        SessionId = notification.SessionId,
+        UserName = notification.UserName,
+        SourceIp = notification.SourceIp,
+        ExpiresAt = Timestamp.FromDateTimeOffset(notification.ExpiresAt),
+        Revoked = notification.Revoked,
+        VerifiedMethod = notification.VerifiedMethod
+    };
+}
@@ -0,0 +1,236 @@
+using System.Runtime.CompilerServices;
+using System.Threading.Channels;
+using Grpc.Core;
+using Google.Protobuf.WellKnownTypes;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Logging;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.ValueObjects;
+using MfaSrv.Protocol;
+
+namespace MfaSrv.Server.GrpcServices;
+
+public partial class MfaGrpcService
+{
+    private const int SessionSnapshotBatchSize = 1000;
+
+    /// <summary>
+    /// Longest an evaluation node stream stays idle before the leader sends a keepalive; nodes
+    /// stop answering after <see cref="HaSettings.EvaluationMaxStalenessMs"/> without one.
+    /// </summary>
+    private static readonly TimeSpan EvaluationKeepaliveInterval = TimeSpan.FromSeconds(5);
+
+    /// <summary>
+    /// Server-streaming RPC that feeds an evaluation node's session view: every active session,
+    /// in batches ending with <c>snapshot_complete</c>, then each session created or revoked on
+    /// this server as it happens, with an empty update as keepalive while idle. Revocations
+    /// missed if the node falls behind still reach it through the revocation filter on its
+    /// policy sync stream. Only the leader serves it, and ends it on losing leadership.
+    /// </summary>
+    public override async Task StreamSessions(
+        StreamSessionsRequest request,
+        IServerStreamWriter<SessionStreamUpdate> responseStream,
+        ServerCallContext context)
+    {
+        var ct = context.CancellationToken;
+        var subscriberId = $"evaluation-node:{request.NodeId}";
+        EnsureLeaderForEvaluationNode(subscriberId);
+
+        // Subscribe before reading the snapshot so no change between the two is missed;
+        // a session in both is applied twice, which the node ignores
+        var changes = _agentChannels.Subscribe(subscriberId);
+
+        try
+        {
+            var now = DateTimeOffset.UtcNow;
+            var active = await _db.MfaSessions
+                .AsNoTracking()
+                .Where(s => s.Status == SessionStatus.Active && s.ExpiresAt > now)
+                .OrderBy(s => s.CreatedAt)
+                .Join(_db.Users, s => s.UserId, u => u.Id, (s, u) => new
+                {
+                    s.Id,
+                    u.SamAccountName,
+                    s.SourceIp,
+                    s.ExpiresAt,
+                    s.VerifiedMethod
+                })
+                .ToListAsync(ct);
+
+            for (var start = 0; start == 0 || start < active.Count; start += SessionSnapshotBatchSize)
+            {
+                var batch = new SessionStreamUpdate
+                {
+                    SnapshotComplete = start + SessionSnapshotBatchSize >= active.Count
+                };
+
+                foreach (var session in active.Skip(start).Take(SessionSnapshotBatchSize))
+                {
+                    batch.Sessions.Add(new SessionEvent
+                    {
+                        SessionId = session.Id,
+                        UserName = session.SamAccountName,
+                        SourceIp = session.SourceIp,
+                        ExpiresAt = Timestamp.FromDateTimeOffset(session.ExpiresAt),
+                        VerifiedMethod = session.VerifiedMethod.ToString()
+                    });
+                }
+
+                await responseStream.WriteAsync(batch, ct);
+            }
+
+            _logger.LogInformation("Sent {Count} active sessions to evaluation node {NodeId}", active.Count, request.NodeId);
+
+            await foreach (var notification in ReadWithKeepalivesAsync(changes.Reader, EvaluationKeepaliveInterval, ct))
+            {
+                EnsureLeaderForEvaluationNode(subscriberId);
+
+                var update = new SessionStreamUpdate();
+                if (notification != null)
+                    update.Sessions.Add(ToProto(notification));
+                await responseStream.WriteAsync(update, ct);
+            }
+        }
+        catch (OperationCanceledException)
+        {
+            _logger.LogInformation("Session stream cancelled for evaluation node {NodeId}", request.NodeId);
+        }
+        finally
+        {
+            _agentChannels.Unsubscribe(subscriberId, changes);
+        }
+    }
+
+    /// <summary>
+    /// Refuses an evaluation node stream unless this instance is the leader (always the case
+    /// without HA). A standby's streams would go quiet on failover while still looking
+    /// connected; refused, the node moves on to its next upstream until it finds the leader.
+    /// </summary>
+    private void EnsureLeaderForEvaluationNode(string subscriberId)
+    {
+        if (_leaderElection.IsLeader)
+            return;
+
+        _logger.LogInformation("Refusing replication stream for {Subscriber}: not the leader", subscriberId);
+        throw new RpcException(new Status(StatusCode.FailedPrecondition, "This instance is not the leader"));
+    }
+
+    /// <summary>
+    /// Reads <paramref name="reader"/> like <c>ReadAllAsync</c>, but yields null whenever nothing
+    /// has arrived for <paramref name="keepaliveInterval"/>; without an interval it never does.
+    /// </summary>
+    private static async IAsyncEnumerable<T?> ReadWithKeepalivesAsync<T>(
+        ChannelReader<T> reader,
+        TimeSpan? keepaliveInterval,
+        [EnumeratorCancellation] CancellationToken ct)
+        where T : class
+    {
+        Task<bool>? wait = null;
+        while (true)
+        {
+            while (reader.TryRead(out var item))
+                yield return item;
+
+            // A wait outlives a keepalive, so the reader never has two pending
+            wait ??= reader.WaitToReadAsync(ct).AsTask();
+
+            if (keepaliveInterval is { } interval)
+            {
+                var idle = false;
+                try
+                {
+                    await wait.WaitAsync(interval, ct);
+                }
+                catch (TimeoutException)
+                {
+                    idle = true;
+                }
+
+                if (idle)
+                {
+                    yield return null;
+                    continue;
+                }
+            }
+
+            var more = await wait;
+            wait = null;
+            if (!more)
+                yield break;
+        }
+    }
+
+    /// <summary>
+    /// <see cref="EvaluateCoreAsync"/> on an evaluation node: the same steps against
+    /// <see cref="Services.EvaluationReplica"/> instead of the database. Users are identified by
+    /// sAMAccountName, which the node's audit entries are keyed by. Audit entries are queued
+    /// for the leader (<see cref="Services.EvaluationAuditForwarder"/>), or written through
+    /// <paramref name="auditLogger"/> if the node cannot forward them.
+    ///
+    /// A node sees only its share of each user's logons, so it keeps no risk features: while
+    /// any policy uses the risk score, the whole evaluation is passed to the leader, as a DC
+    /// Agent in local evaluation mode does.
+    /// </summary>
+    private async Task<AuthEvaluationResponse> EvaluateOnReplicaAsync(
+        AuthEvaluationRequest request, IAuditLogger auditLogger, CancellationToken ct)
+    {
+        if (!_replica.IsReady)
+            throw new RpcException(new Status(StatusCode.Unavailable, "Evaluation node is not synchronized with the leader"));
+
+        // Risk scores are only known to the leader
+        if (_replica.Policies.UsesRiskScore)
+            return await _replicaSync.EvaluateOnLeaderAsync(request, ct);
+
+        var timestamp = DateTimeOffset.UtcNow;
+        var known = _replica.TryGetUser(request.UserName, out var groups, out var ou);
+
+        if (known)
+        {
+            var sessionId = _replica.FindSession(request.UserName, request.SourceIp, timestamp);
+            if (sessionId != null)
+            {
+                return new AuthEvaluationResponse
+                {
+                    Decision = AuthDecisionType.AuthDecisionAllow,
+                    SessionToken = sessionId,
+                    Reason = "Active MFA session found"
+                };
+            }
+        }
+
+        var result = _replica.Policies.Evaluate(new AuthenticationContext
+        {
+            UserId = known ? request.UserName : string.Empty,
+            UserName = request.UserName,
+            SourceIp = request.SourceIp,
+            Workstation = request.Workstation,
+            TargetResource = request.TargetResource,
+            Protocol = MapProtocol(request.Protocol),
+            UserGroups = groups,
+            UserOu = ou,
+            Timestamp = timestamp
+        });
+
+        var details = $"Decision: {result.Decision}, Policy: {result.MatchedPolicyName ?? "none"}";
+        if (_auditForwarder.IsEnabled)
+        {
+            _auditForwarder.TryEnqueue(
+                AuditEventType.PolicyEvaluated, request.UserName, request.SourceIp, request.TargetResource, details, timestamp);
+        }
+        else
+        {
+            await auditLogger.LogAsync(
+                AuditEventType.PolicyEvaluated, request.UserName, request.SourceIp, request.TargetResource, details, ct);
+        }
+
+        return new AuthEvaluationResponse
+        {
+            Decision = MapDecision(result.Decision),
+            MatchedPolicyId = result.MatchedPolicyId ?? string.Empty,
+            Reason = result.Reason ?? string.Empty,
+            RequiredMethod = result.RequiredMethod?.ToString() ?? string.Empty,
+            TimeoutMs = 300000
+        };
+    }
+}
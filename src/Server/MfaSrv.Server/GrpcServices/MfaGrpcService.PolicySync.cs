@@ -9,10 +9,21 @@ namespace MfaSrv.Server.GrpcServices;
 
 public partial class MfaGrpcService
 {
+    private static readonly JsonSerializerOptions PolicyJsonOptions = new()
+    {
+        PropertyNamingPolicy = JsonNamingPolicy.CamelCase,
+        WriteIndented = false
+    };
+
+    private static readonly PolicyUpdate PolicyKeepalive = new() { Keepalive = true };
+
     /// <summary>
     /// Server-streaming RPC that sends policy updates to DC Agents.
-    /// First sends a full snapshot of all current enabled policies, then
-    /// keeps the stream open to push real-time change notifications.
+    /// An agent resuming in the current epoch first receives the policy changes it missed since
+    /// <c>last_version</c>; otherwise it receives one policy-set snapshot. The session revocation
+    /// filter snapshot follows, then the user directory for agents that asked for it and do not
+    /// hold its current version; then the stream stays open for real-time change notifications.
+    /// Evaluation nodes are served only by the leader and also get keepalives while idle.
     /// </summary>
     public override async Task SyncPolicies(
         SyncPoliciesRequest request,
@@ -21,60 +32,86 @@ public partial class MfaGrpcService
     {
         var agentId = request.AgentId;
         _logger.LogInformation(
-            "Agent {AgentId} starting policy sync stream (last_sync={LastSync})",
-            agentId, request.LastSync?.ToDateTimeOffset());
+            "Agent {AgentId} starting policy sync stream (epoch={Epoch}, last_version={LastVersion})",
+            agentId, request.Epoch, request.LastVersion);
 
-        // Send initial snapshot of all current enabled policies
-        var policies = await _db.Policies
-            .Include(p => p.RuleGroups).ThenInclude(g => g.Rules)
-            .Include(p => p.Actions)
-            .Where(p => p.IsEnabled)
-            .AsNoTracking()
-            .ToListAsync(context.CancellationToken);
+        if (request.EvaluationNode)
+            EnsureLeaderForEvaluationNode(agentId);
+        var keepaliveInterval = request.EvaluationNode ? EvaluationKeepaliveInterval : (TimeSpan?)null;
 
-        _logger.LogInformation(
-            "Sending {Count} initial policies to agent {AgentId}",
-            policies.Count, agentId);
+        // Subscribe before catching up so no change between the two is missed;
+        // changes already covered by the catch-up are skipped by version below
+        var channel = _policySyncStream.Subscribe(agentId);
 
-        foreach (var policy in policies)
+        try
         {
-            var policyJson = JsonSerializer.Serialize(policy, new JsonSerializerOptions
+            var sentVersion = await SendPoliciesSinceAsync(
+                request.Epoch, request.LastVersion, responseStream, agentId, context.CancellationToken);
+
+            // Revocation filter snapshot is taken after subscribing so no delta is missed;
+            // deltas already covered by the snapshot version are ignored by the agent
+            await responseStream.WriteAsync(new PolicyUpdate
             {
-                PropertyNamingPolicy = JsonNamingPolicy.CamelCase,
-                WriteIndented = false
+                RevocationFilter = PolicySyncStreamService.ToProto(_revocations.GetFilterSnapshot())
             });
 
-            var update = new PolicyUpdate
+            // Likewise after subscribing; a newer directory published meanwhile follows from the
+            // channel, and the agent skips a version it already holds
+            if (request.WantDirectory)
             {
-                PolicyId = policy.Id,
-                PolicyJson = policyJson,
-                Deleted = false,
-                UpdatedAt = Timestamp.FromDateTimeOffset(policy.UpdatedAt)
-            };
-
-            await responseStream.WriteAsync(update);
-        }
+                var directory = await _directorySnapshots.GetSnapshotAsync(_db, context.CancellationToken);
+                if (directory[0].Directory.Version != request.DirectoryVersion)
+                {
+                    foreach (var chunk in directory)
+                        await responseStream.WriteAsync(chunk);
 
-        // Subscribe to real-time policy changes
-        var channel = _policySyncStream.Subscribe(agentId);
+                    _logger.LogInformation(
+                        "Sent directory snapshot {Version} ({Chunks} chunks) to agent {AgentId}",
+                        directory[0].Directory.Version, directory.Count, agentId);
+                }
+            }
 
-        try
-        {
-            await foreach (var notification in channel.Reader.ReadAllAsync(context.CancellationToken))
+            await foreach (var update in ReadWithKeepalivesAsync(channel.Reader, keepaliveInterval, context.CancellationToken))
             {
-                var update = new PolicyUpdate
+                if (request.EvaluationNode)
+                    EnsureLeaderForEvaluationNode(agentId);
+
+                if (update == null)
+                {
+                    await responseStream.WriteAsync(PolicyKeepalive);
+                    continue;
+                }
+
+                if (update.RevocationFilter != null)
                 {
-                    PolicyId = notification.PolicyId,
-                    PolicyJson = notification.PolicyJson,
-                    Deleted = notification.Deleted,
-                    UpdatedAt = Timestamp.FromDateTimeOffset(notification.UpdatedAt)
-                };
+                    await responseStream.WriteAsync(update);
+                    continue;
+                }
+
+                if (update.Directory != null)
+                {
+                    if (request.WantDirectory)
+                        await responseStream.WriteAsync(update);
+                    continue;
+                }
+
+                if (update.Version <= sentVersion)
+                    continue;
+
+                if (update.Version != sentVersion + 1)
+                {
+                    // Notifications were dropped from the agent's queue; fill the gap
+                    sentVersion = await SendPoliciesSinceAsync(
+                        _policySyncStream.Epoch, sentVersion, responseStream, agentId, context.CancellationToken);
+                    continue;
+                }
 
                 await responseStream.WriteAsync(update);
+                sentVersion = update.Version;
 
                 _logger.LogDebug(
-                    "Streamed policy update {PolicyId} (deleted={Deleted}) to agent {AgentId}",
-                    notification.PolicyId, notification.Deleted, agentId);
+                    "Streamed policy update {PolicyId} v{Version} (deleted={Deleted}) to agent {AgentId}",
+                    update.PolicyId, update.Version, update.Deleted, agentId);
             }
         }
         catch (OperationCanceledException)
@@ -92,4 +129,54 @@ public partial class MfaGrpcService
             _logger.LogInformation("Agent {AgentId} disconnected from policy sync stream", agentId);
         }
     }
+
+    /// <summary>
+    /// Sends the changes after <paramref name="lastVersion"/>, or a snapshot if they are no
+    /// longer available. Returns the policy-set version the agent is at afterwards.
+    /// </summary>
+    private async Task<ulong> SendPoliciesSinceAsync(
+        string epoch,
+        ulong lastVersion,
+        IServerStreamWriter<PolicyUpdate> responseStream,
+        string agentId,
+        CancellationToken ct)
+    {
+        if (_policySyncStream.TryGetChangesSince(epoch, lastVersion, out var changes))
+        {
+            foreach (var change in changes)
+                await responseStream.WriteAsync(change);
+
+            _logger.LogInformation(
+                "Sent {Count} policy changes since v{LastVersion} to agent {AgentId}",
+                changes.Count, lastVersion, agentId);
+            return changes.Count > 0 ? changes[^1].Version : lastVersion;
+        }
+
+        var snapshot = await _policySyncStream.GetSnapshotAsync(LoadPolicySnapshotAsync, ct);
+        await responseStream.WriteAsync(snapshot);
+
+        _logger.LogInformation(
+            "Sent policy snapshot v{Version} ({Count} policies) to agent {AgentId}",
+            snapshot.Version, snapshot.Snapshot.Policies.Count, agentId);
+        return snapshot.Version;
+    }
+
+    private async Task<IReadOnlyList<PolicyEntry>> LoadPolicySnapshotAsync(CancellationToken ct)
+    {
+        var policies = await _db.Policies
+            .Include(p => p.RuleGroups).ThenInclude(g => g.Rules)
+            .Include(p => p.Actions)
+            .Where(p => p.IsEnabled)
+            .AsNoTracking()
+            .ToListAsync(ct);
+
+        return policies
+            .Select(policy => new PolicyEntry
+            {
+                PolicyId = policy.Id,
+                PolicyJson = JsonSerializer.Serialize(policy, PolicyJsonOptions),
+                UpdatedAt = Timestamp.FromDateTimeOffset(policy.UpdatedAt)
+            })
+            .ToList();
+    }
 }
@@ -1,7 +1,9 @@
 using Grpc.Core;
+using Microsoft.Extensions.DependencyInjection;
 using Microsoft.Extensions.Logging;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.Policies;
 using MfaSrv.Core.ValueObjects;
 using MfaSrv.Protocol;
 using MfaSrv.Server.Data;
@@ -18,6 +20,20 @@ public partial class MfaGrpcService : MfaService.MfaServiceBase
     private readonly MfaSrvDbContext _db;
     private readonly ILogger<MfaGrpcService> _logger;
     private readonly Services.PolicySyncStreamService _policySyncStream;
+    private readonly Services.SessionRevocationService _revocations;
+    private readonly Services.AgentChannelService _agentChannels;
+    private readonly Services.DirectorySnapshotService _directorySnapshots;
+    private readonly Services.RiskScoringService _riskScoring;
+    private readonly Services.EvaluationReplica _replica;
+    private readonly Services.EvaluationAuditForwarder _auditForwarder;
+    private readonly Services.EvaluationReplicaSyncService _replicaSync;
+    private readonly Services.LeaderElectionService _leaderElection;
+    private readonly IServiceScopeFactory _scopeFactory;
+
+    /// <summary>
+    /// Longest a CheckChallengeStatus call may wait for an asynchronous outcome.
+    /// </summary>
+    private const int MaxChallengeStatusWaitMs = 30_000;
 
     public MfaGrpcService(
         IPolicyEngine policyEngine,
@@ -26,7 +42,16 @@ public partial class MfaGrpcService : MfaService.MfaServiceBase
         IAuditLogger auditLogger,
         MfaSrvDbContext db,
         ILogger<MfaGrpcService> logger,
-        Services.PolicySyncStreamService policySyncStream)
+        Services.PolicySyncStreamService policySyncStream,
+        Services.SessionRevocationService revocations,
+        Services.AgentChannelService agentChannels,
+        Services.DirectorySnapshotService directorySnapshots,
+        Services.RiskScoringService riskScoring,
+        Services.EvaluationReplica replica,
+        Services.EvaluationAuditForwarder auditForwarder,
+        Services.EvaluationReplicaSyncService replicaSync,
+        Services.LeaderElectionService leaderElection,
+        IServiceScopeFactory scopeFactory)
     {
         _policyEngine = policyEngine;
         _sessionManager = sessionManager;
@@ -35,22 +60,58 @@ public partial class MfaGrpcService : MfaService.MfaServiceBase
         _db = db;
         _logger = logger;
         _policySyncStream = policySyncStream;
+        _revocations = revocations;
+        _agentChannels = agentChannels;
+        _directorySnapshots = directorySnapshots;
+        _riskScoring = riskScoring;
+        _replica = replica;
+        _auditForwarder = auditForwarder;
+        _replicaSync = replicaSync;
+        _leaderElection = leaderElection;
+        _scopeFactory = scopeFactory;
     }
 
-    public override async Task<AuthEvaluationResponse> EvaluateAuthentication(AuthEvaluationRequest request, ServerCallContext context)
+    public override Task<AuthEvaluationResponse> EvaluateAuthentication(AuthEvaluationRequest request, ServerCallContext context)
+        => EvaluateCoreAsync(request, _db, _sessionManager, _policyEngine, _auditLogger, context.CancellationToken);
+
+    /// <summary>
+    /// Authentication decision shared by the unary RPC and the agent channel. The agent channel
+    /// runs evaluations concurrently, so it passes services from a scope of its own per request.
+    /// On an evaluation node only the audit logger is used, and only if audit events cannot be
+    /// forwarded to the leader.
+    /// </summary>
+    private async Task<AuthEvaluationResponse> EvaluateCoreAsync(
+        AuthEvaluationRequest request,
+        MfaSrvDbContext db,
+        ISessionManager sessionManager,
+        IPolicyEngine policyEngine,
+        IAuditLogger auditLogger,
+        CancellationToken ct)
     {
         _logger.LogInformation("Auth evaluation for {User}@{Domain} from {Ip}", request.UserName, request.Domain, request.SourceIp);
 
+        // Evaluation nodes answer from replicated state and never read the database
+        if (_replica.IsEnabled)
+            return await EvaluateOnReplicaAsync(request, auditLogger, ct);
+
         // Check for existing active session
-        var user = await _db.Users.FirstOrDefaultAsync(u => u.SamAccountName == request.UserName, context.CancellationToken);
+        var user = await db.Users.FirstOrDefaultAsync(u => u.SamAccountName == request.UserName, ct);
+        var timestamp = DateTimeOffset.UtcNow;
+
+        // Every logon of a known user feeds the risk features, including those a session covers
+        int? riskScore = user != null
+            ? _riskScoring.RecordLogon(user.Id, request.SourceIp, request.Workstation, timestamp).Score
+            : null;
+
         if (user != null)
         {
-            var existingSession = await _sessionManager.FindActiveSessionAsync(user.Id, request.SourceIp, context.CancellationToken);
+            var existingSession = await sessionManager.FindActiveSessionAsync(user.Id, request.SourceIp, ct);
             if (existingSession != null)
             {
                 return new AuthEvaluationResponse
                 {
                     Decision = AuthDecisionType.AuthDecisionAllow,
+                    SessionToken = existingSession.Id,
                     Reason = "Active MFA session found"
                 };
             }
@@ -58,10 +119,10 @@ public partial class MfaGrpcService : MfaService.MfaServiceBase
 
         // Build auth context and evaluate policies
         var groups = user != null
-            ? await _db.UserGroupMemberships
+            ? await db.UserGroupMemberships
                 .Where(m => m.UserId == user.Id)
                 .Select(m => m.GroupName)
-                .ToListAsync(context.CancellationToken)
+                .ToListAsync(ct)
             : new List<string>();
 
         var authContext = new AuthenticationContext
@@ -69,20 +130,24 @@ public partial class MfaGrpcService : MfaService.MfaServiceBase
             UserId = user?.Id ?? string.Empty,
             UserName = request.UserName,
             SourceIp = request.SourceIp,
+            Workstation = request.Workstation,
             TargetResource = request.TargetResource,
             Protocol = MapProtocol(request.Protocol),
-            UserGroups = groups
+            UserGroups = groups,
+            UserOu = DirectoryNames.ParentContainer(user?.DistinguishedName),
+            RiskScore = riskScore,
+            Timestamp = timestamp
         };
 
-        var result = await _policyEngine.EvaluateAsync(authContext, context.CancellationToken);
+        var result = await policyEngine.EvaluateAsync(authContext, ct);
 
-        await _auditLogger.LogAsync(
+        await auditLogger.LogAsync(
             AuditEventType.PolicyEvaluated,
             user?.Id ?? request.UserName,
             request.SourceIp,
             request.TargetResource,
             $"Decision: {result.Decision}, Policy: {result.MatchedPolicyName ?? "none"}",
-            context.CancellationToken);
+            ct);
 
         return new AuthEvaluationResponse
         {
@@ -139,7 +204,7 @@ public partial class MfaGrpcService : MfaService.MfaServiceBase
         // If verification succeeded, create a session
         if (result.Success)
         {
-            var challenge = await _db.MfaChallenges.FindAsync(new object[] { request.ChallengeId }, context.CancellationToken);
+            var challenge = await _challengeOrchestrator.GetChallengeAsync(request.ChallengeId, context.CancellationToken);
             if (challenge != null)
             {
                 var session = await _sessionManager.CreateSessionAsync(
@@ -155,7 +220,12 @@ public partial class MfaGrpcService : MfaService.MfaServiceBase
 
     public override async Task<CheckChallengeStatusResponse> CheckChallengeStatus(CheckChallengeStatusRequest request, ServerCallContext context)
     {
-        var status = await _challengeOrchestrator.CheckChallengeStatusAsync(request.ChallengeId, context.CancellationToken);
+        var status = request.WaitMs > 0
+            ? await _challengeOrchestrator.WaitForChallengeStatusAsync(
+                request.ChallengeId,
+                TimeSpan.FromMilliseconds(Math.Min(request.WaitMs, MaxChallengeStatusWaitMs)),
+                context.CancellationToken)
+            : await _challengeOrchestrator.CheckChallengeStatusAsync(request.ChallengeId, context.CancellationToken);
 
         return new CheckChallengeStatusResponse
         {
@@ -209,17 +279,23 @@ public partial class MfaGrpcService : MfaService.MfaServiceBase
 
     public override async Task<HeartbeatResponse> Heartbeat(HeartbeatRequest request, ServerCallContext context)
     {
-        var agent = await _db.AgentRegistrations.FindAsync(new object[] { request.AgentId }, context.CancellationToken);
-        if (agent != null)
-        {
-            agent.Status = Core.Enums.AgentStatus.Online;
-            agent.LastHeartbeatAt = DateTimeOffset.UtcNow;
-            await _db.SaveChangesAsync(context.CancellationToken);
-        }
+        await SetAgentStatusAsync(_db, request.AgentId, Core.Enums.AgentStatus.Online, context.CancellationToken);
 
         return new HeartbeatResponse { Acknowledged = true };
     }
 
+    private static async Task SetAgentStatusAsync(MfaSrvDbContext db, string agentId, Core.Enums.AgentStatus status, CancellationToken ct)
+    {
+        var agent = await db.AgentRegistrations.FindAsync(new object[] { agentId }, ct);
+        if (agent == null)
+            return;
+
+        agent.Status = status;
+        if (status == Core.Enums.AgentStatus.Online)
+            agent.LastHeartbeatAt = DateTimeOffset.UtcNow;
+        await db.SaveChangesAsync(ct);
+    }
+
     private static AuthProtocol MapProtocol(AuthProtocolType proto) => proto switch
     {
         AuthProtocolType.AuthProtocolKerberos => AuthProtocol.Kerberos,
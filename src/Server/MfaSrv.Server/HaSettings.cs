@@ -4,7 +4,8 @@ namespace MfaSrv.Server;
 /// Configuration for High Availability (active-passive) mode.
 /// When enabled, multiple server instances coordinate via database-backed
 /// leader election. Only the active leader processes background tasks
-/// (session cleanup, policy sync, backups).
+/// (session cleanup, policy sync, backups). Evaluation nodes (<see cref="EvaluationNode"/>)
+/// never lead and only scale out authentication evaluation.
 /// </summary>
 public class HaSettings
 {
@@ -30,4 +31,51 @@ public class HaSettings
     /// Should be significantly less than LeaseDurationSeconds.
     /// </summary>
     public int LeaseRenewIntervalSeconds { get; set; } = 10;
+
+    /// <summary>
+    /// gRPC URLs of the other server instances. When set, instances exchange heartbeats and a
+    /// standby takes over as soon as the leader stops answering, instead of waiting for the
+    /// lease to expire. On evaluation nodes, the instances to look for the leader among.
+    /// </summary>
+    public string[] Peers { get; set; } = Array.Empty<string>();
+
+    /// <summary>
+    /// Base64-encoded secret of at least 32 bytes, the same on every instance. Heartbeats and
+    /// challenge store replication between instances are signed with it; without it, peer
+    /// endpoints refuse all calls.
+    /// </summary>
+    public string PeerSecret { get; set; } = string.Empty;
+
+    /// <summary>
+    /// How often each peer is sent a heartbeat (in milliseconds).
+    /// </summary>
+    public int HeartbeatIntervalMs { get; set; } = 150;
+
+    /// <summary>
+    /// How long a leader may go without answering heartbeats before a standby takes over
+    /// (in milliseconds).
+    /// </summary>
+    public int PeerFailureTimeoutMs { get; set; } = 600;
+
+    /// <summary>
+    /// Run as a stateless evaluation node: never take the leader lease, and answer
+    /// EvaluateAuthentication (unary and on the agent channel) from policies, directory and
+    /// sessions replicated from the leader instead of the database. Place these behind a load
+    /// balancer for the evaluation and agent channel RPCs only.
+    /// </summary>
+    public bool EvaluationNode { get; set; }
+
+    /// <summary>
+    /// gRPC URL an evaluation node replicates from first. The node follows the leader among
+    /// this URL and <see cref="Peers"/>: only the leader serves replication, so on failover the
+    /// node moves on to the next candidate until it reaches the new leader.
+    /// </summary>
+    public string UpstreamUrl { get; set; } = string.Empty;
+
+    /// <summary>
+    /// How long an evaluation node may go without hearing from the leader on either replication
+    /// stream (in milliseconds) before it reports not ready and refuses evaluations. The leader
+    /// sends keepalives well within this.
+    /// </summary>
+    public int EvaluationMaxStalenessMs { get; set; } = 15000;
 }
@@ -39,6 +39,15 @@ builder.Services.Configure<LdapSettings>(builder.Configuration.GetSection("Ldap"
 // HA settings
 builder.Services.Configure<HaSettings>(builder.Configuration.GetSection("HA"));
 
+// Session validation settings
+builder.Services.Configure<SessionSettings>(builder.Configuration.GetSection("Sessions"));
+
+// Audit log persistence settings
+builder.Services.Configure<AuditSettings>(builder.Configuration.GetSection("Audit"));
+
+// Risk scoring settings
+builder.Services.Configure<RiskSettings>(builder.Configuration.GetSection("Risk"));
+
 // Token signing key
 var signingKeyBase64 = builder.Configuration["MfaSrv:TokenSigningKey"];
 byte[] signingKey;
@@ -55,10 +64,21 @@ else
 // Core services
 builder.Services.AddSingleton<ITokenService>(new SessionTokenService(signingKey));
 builder.Services.AddSingleton<PolicySyncStreamService>();
+builder.Services.AddSingleton<DirectorySnapshotService>();
+builder.Services.AddSingleton<AgentChannelService>();
+builder.Services.AddSingleton<RiskScoringService>();
+builder.Services.AddSingleton<CompiledPolicyCache>();
 builder.Services.AddScoped<IPolicyEngine, PolicyEngine>();
+builder.Services.AddSingleton<ActiveSessionCache>();
 builder.Services.AddScoped<ISessionManager, SessionManager>();
 builder.Services.AddScoped<IMfaChallengeOrchestrator, MfaChallengeOrchestrator>();
-builder.Services.AddScoped<IAuditLogger, AuditLogService>();
+builder.Services.AddSingleton<MfaProviderRegistry>();
+builder.Services.AddSingleton<EnrollmentCache>();
+builder.Services.AddSingleton<ChallengeStateStore>();
+builder.Services.AddHostedService(sp => sp.GetRequiredService<ChallengeStateStore>());
+builder.Services.AddScoped<AuditLogService>();
+builder.Services.AddScoped<IAuditLogger>(sp => sp.GetRequiredService<AuditLogService>());
+builder.Services.AddScoped<AuditStore>();
 builder.Services.AddScoped<IUserSyncService, UserSyncService>();
 
 // MFA Provider settings
@@ -69,12 +89,29 @@ builder.Services.Configure<Fido2Settings>(builder.Configuration.GetSection("Prov
 builder.Services.Configure<FortiTokenSettings>(builder.Configuration.GetSection("Providers:FortiToken"));
 
 // MFA Provider support services
-builder.Services.AddHttpClient<PushNotificationClient>();
-builder.Services.AddHttpClient<SmsGatewayClient>();
+builder.Services.AddHttpClient<PushNotificationClient>()
+    .ConfigurePrimaryHttpMessageHandler(CreateGatewayHandler)
+    .SetHandlerLifetime(Timeout.InfiniteTimeSpan);
+builder.Services.AddHttpClient<SmsGatewayClient>()
+    .ConfigurePrimaryHttpMessageHandler(CreateGatewayHandler)
+    .SetHandlerLifetime(Timeout.InfiniteTimeSpan);
 builder.Services.AddSingleton<EmailSender>();
 builder.Services.AddHttpClient<FortiAuthClient>();
+builder.Services.AddSingleton<MfaSrv.Core.Challenges.ChallengeCompletionEngine>();
+builder.Services.AddSingleton<FortiPushPoller>();
+builder.Services.AddHostedService(sp => sp.GetRequiredService<FortiPushPoller>());
+
+// Outbound OTP/push delivery (queued, rate limited per gateway)
+builder.Services.Configure<DeliverySettings>(builder.Configuration.GetSection("Delivery"));
+builder.Services.AddSingleton<IOutboundGateway>(sp => sp.GetRequiredService<SmsGatewayClient>());
+builder.Services.AddSingleton<IOutboundGateway>(sp => sp.GetRequiredService<EmailSender>());
+builder.Services.AddSingleton<IOutboundGateway>(sp => sp.GetRequiredService<PushNotificationClient>());
+builder.Services.AddSingleton<OutboundDeliveryService>();
+builder.Services.AddSingleton<IOutboundDeliveryQueue>(sp => sp.GetRequiredService<OutboundDeliveryService>());
+builder.Services.AddHostedService(sp => sp.GetRequiredService<OutboundDeliveryService>());
 
 // MFA Providers - register all available providers
+builder.Services.AddSingleton<MfaSrv.Provider.Totp.TotpValidationEngine>();
 builder.Services.AddSingleton<IMfaProvider, MfaSrv.Provider.Totp.TotpMfaProvider>();
 builder.Services.AddSingleton<IMfaProvider, PushMfaProvider>();
 builder.Services.AddSingleton<IMfaProvider, SmsMfaProvider>();
@@ -96,7 +133,21 @@ else
 {
     builder.Services.AddDistributedMemoryCache();
 }
-builder.Services.AddSingleton<IChallengeStore, RedisChallengeStore>();
+
+// Challenge store: distributed cache above, or in process with optional peer replication
+builder.Services.Configure<ChallengeStoreSettings>(builder.Configuration.GetSection("ChallengeStore"));
+var challengeStoreMode = builder.Configuration.GetSection("ChallengeStore").Get<ChallengeStoreSettings>()?.Mode
+    ?? ChallengeStoreMode.Distributed;
+if (challengeStoreMode == ChallengeStoreMode.Local)
+{
+    builder.Services.AddSingleton<LocalChallengeStore>();
+    builder.Services.AddSingleton<IChallengeStore>(sp => sp.GetRequiredService<LocalChallengeStore>());
+    builder.Services.AddHostedService<ChallengeStoreReplicator>();
+}
+else
+{
+    builder.Services.AddSingleton<IChallengeStore, RedisChallengeStore>();
+}
 
 // Backup services
 builder.Services.Configure<BackupSettings>(builder.Configuration.GetSection("Backup"));
@@ -105,17 +156,38 @@ builder.Services.AddHostedService(sp => sp.GetRequiredService<DatabaseBackupServ
 builder.Services.AddScoped<DatabaseExportService>();
 
 // HA - Leader election
+builder.Services.AddSingleton<PeerAuthenticator>();
+builder.Services.AddSingleton<IHaPeerTransport, GrpcHaPeerTransport>();
 builder.Services.AddSingleton<LeaderElectionService>();
 builder.Services.AddHostedService(sp => sp.GetRequiredService<LeaderElectionService>());
 
+// HA - Evaluation node replica (idle unless HA:EvaluationNode is set)
+builder.Services.AddSingleton<EvaluationReplica>();
+builder.Services.AddSingleton<EvaluationAuditForwarder>();
+builder.Services.AddSingleton<EvaluationReplicaSyncService>();
+builder.Services.AddHostedService(sp => sp.GetRequiredService<EvaluationReplicaSyncService>());
+
 // Health checks
 builder.Services.AddHealthChecks()
     .AddCheck<MfaSrvHealthCheck>("mfasrv", tags: new[] { "live" })
     .AddCheck<MfaSrvReadinessCheck>("readiness", tags: new[] { "ready" })
     .AddDbContextCheck<MfaSrvDbContext>("database", tags: new[] { "live", "ready" });
 
+// Session revocation set (stateless validation fast path)
+builder.Services.AddSingleton<SessionRevocationService>();
+builder.Services.AddHostedService(sp => sp.GetRequiredService<SessionRevocationService>());
+
+// Batched audit log writer
+builder.Services.AddSingleton<AuditLogWriter>();
+builder.Services.AddHostedService(sp => sp.GetRequiredService<AuditLogWriter>());
+
+// In-memory dashboard statistics
+builder.Services.AddSingleton<DashboardStatisticsService>();
+builder.Services.AddHostedService(sp => sp.GetRequiredService<DashboardStatisticsService>());
+
 // Background services
 builder.Services.AddHostedService<SessionCleanupService>();
+builder.Services.AddHostedService<AuditRollupService>();
 
 // First-run setup wizard
 builder.Services.AddSingleton<SetupService>();
@@ -142,6 +214,49 @@ if (!setupService.IsSetupRequired())
     using var scope = app.Services.CreateScope();
     var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
     db.Database.EnsureCreated();
+
+    // WAL lets scheduled backups read a snapshot without blocking the auth write path
+    if (db.Database.IsSqlite() && (builder.Configuration.GetSection("Backup").Get<BackupSettings>()?.UseWalJournal ?? true))
+        db.Database.ExecuteSqlRaw("PRAGMA journal_mode=WAL");
+
+    // EnsureCreated leaves an existing schema alone; bring tables and indexes added since up to date
+    if (db.Database.IsSqlite())
+    {
+        db.Database.ExecuteSqlRaw("DROP INDEX IF EXISTS IX_MfaSessions_UserId_SourceIp_Status");
+        db.Database.ExecuteSqlRaw("DROP INDEX IF EXISTS IX_MfaSessions_ExpiresAt");
+        db.Database.ExecuteSqlRaw(
+            "CREATE INDEX IF NOT EXISTS IX_MfaSessions_Status_ExpiresAt ON MfaSessions (Status, ExpiresAt)");
+        db.Database.ExecuteSqlRaw(
+            "CREATE INDEX IF NOT EXISTS IX_MfaSessions_ActiveLookup ON MfaSessions (UserId, SourceIp, Status, ExpiresAt, CreatedAt)");
+
+        // Fencing token on the leader lease (SQLite has no ADD COLUMN IF NOT EXISTS)
+        var hasFencingToken = db.Database
+            .SqlQueryRaw<int>("SELECT COUNT(*) AS Value FROM pragma_table_info('LeaderLeases') WHERE name = 'FencingToken'")
+            .AsEnumerable()
+            .Single() > 0;
+        if (!hasFencingToken)
+            db.Database.ExecuteSqlRaw("ALTER TABLE LeaderLeases ADD COLUMN FencingToken INTEGER NOT NULL DEFAULT 0");
+
+        // Hourly audit segments and rollups, and the audit indexes they are built from
+        db.Database.ExecuteSqlRaw(
+            "CREATE TABLE IF NOT EXISTS AuditSegments (" +
+            "Hour INTEGER NOT NULL CONSTRAINT PK_AuditSegments PRIMARY KEY, " +
+            "EventCount INTEGER NOT NULL, " +
+            "SealedAt TEXT NOT NULL)");
+        db.Database.ExecuteSqlRaw(
+            "CREATE TABLE IF NOT EXISTS AuditHourlyRollups (" +
+            "Hour INTEGER NOT NULL, " +
+            "EventType INTEGER NOT NULL, " +
+            "Success INTEGER NOT NULL, " +
+            "Count INTEGER NOT NULL, " +
+            "CONSTRAINT PK_AuditHourlyRollups PRIMARY KEY (Hour, EventType, Success))");
+        db.Database.ExecuteSqlRaw("DROP INDEX IF EXISTS IX_AuditLog_EventType");
+        db.Database.ExecuteSqlRaw("DROP INDEX IF EXISTS IX_AuditLog_UserId");
+        db.Database.ExecuteSqlRaw(
+            "CREATE INDEX IF NOT EXISTS IX_AuditLog_EventType_Timestamp ON AuditLog (EventType, Timestamp)");
+        db.Database.ExecuteSqlRaw(
+            "CREATE INDEX IF NOT EXISTS IX_AuditLog_UserId_Timestamp ON AuditLog (UserId, Timestamp)");
+    }
 }
 else
 {
@@ -162,6 +277,9 @@ app.MapMetrics("/metrics");
 
 app.MapControllers();
 app.MapGrpcService<MfaGrpcService>();
+app.MapGrpcService<HaPeerGrpcService>();
+if (challengeStoreMode == ChallengeStoreMode.Local)
+    app.MapGrpcService<ChallengeReplicationGrpcService>();
 
 // Health endpoints
 app.MapHealthChecks("/health", new Microsoft.AspNetCore.Diagnostics.HealthChecks.HealthCheckOptions
@@ -213,3 +331,12 @@ static async Task WriteHealthResponse(HttpContext context, Microsoft.Extensions.
 
     await context.Response.WriteAsJsonAsync(result);
 }
+
+// Long-lived pooled connections for the SMS and push gateways. Connections are recycled
+// periodically so DNS changes are still picked up, which makes handler rotation unnecessary.
+static HttpMessageHandler CreateGatewayHandler() => new SocketsHttpHandler
+{
+    PooledConnectionLifetime = TimeSpan.FromMinutes(5),
+    PooledConnectionIdleTimeout = TimeSpan.FromMinutes(1),
+    MaxConnectionsPerServer = 64
+};
@@ -0,0 +1,63 @@
+namespace MfaSrv.Server;
+
+/// <summary>
+/// Configuration for the risk score evaluated by <c>RiskScore</c> policy rules.
+/// Bound from the "Risk" section of appsettings.json.
+/// </summary>
+public class RiskSettings
+{
+    /// <summary>
+    /// Sliding window over which failures, source IPs, new workstations and off-hours logons
+    /// are counted.
+    /// </summary>
+    public int WindowMinutes { get; set; } = 60;
+
+    /// <summary>
+    /// Number of slices the window advances by; the window covers between
+    /// (Slices - 1) / Slices and all of <see cref="WindowMinutes"/>.
+    /// </summary>
+    public int Slices { get; set; } = 6;
+
+    /// <summary>
+    /// Counters per row of each slice's count-min sketch (rounded up to a power of two).
+    /// </summary>
+    public int SketchWidth { get; set; } = 262144;
+
+    /// <summary>
+    /// Rows of each slice's count-min sketch.
+    /// </summary>
+    public int SketchDepth { get; set; } = 4;
+
+    /// <summary>
+    /// Users whose distinct source IPs are tracked at once. Users idle for a whole window are
+    /// dropped; beyond the limit, new users score no distinct-IP risk until room frees up.
+    /// </summary>
+    public int MaxTrackedUsers { get; set; } = 250_000;
+
+    /// <summary>
+    /// How long a user's workstations are remembered; a logon from any other is "new".
+    /// </summary>
+    public int WorkstationHistoryDays { get; set; } = 28;
+
+    /// <summary>
+    /// User/workstation pairs remembered per quarter of the history.
+    /// </summary>
+    public int WorkstationHistoryCapacity { get; set; } = 500_000;
+
+    /// <summary>
+    /// Business hours in server local time ("HH:mm-HH:mm"); logons outside them, or at
+    /// weekends, count as off-hours.
+    /// </summary>
+    public string BusinessHours { get; set; } = "07:00-19:00";
+
+    public int FailureWeight { get; set; } = 10;
+
+    /// <summary>
+    /// Added per distinct source IP beyond the first.
+    /// </summary>
+    public int DistinctIpWeight { get; set; } = 10;
+
+    public int NewWorkstationWeight { get; set; } = 25;
+
+    public int OffHoursWeight { get; set; } = 5;
+}
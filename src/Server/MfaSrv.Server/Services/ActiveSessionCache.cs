@@ -0,0 +1,129 @@
+using System.Collections.Concurrent;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Write-through index of the newest active session per (user ID, source IP), so
+/// <see cref="SessionManager.FindActiveSessionAsync"/> reads <c>MfaSessions</c> only on a cold miss.
+///
+/// Sessions created or revoked through <see cref="SessionManager"/> update the index directly.
+/// A cached session is used until it expires; one revoked by another server instance is
+/// dropped as soon as it shows up in <see cref="SessionRevocationService"/>. "No session" is
+/// cached for <see cref="NegativeTtl"/>, which bounds how long a session created on another
+/// instance can go unseen. A load that races with a write is not cached.
+///
+/// Sessions are held as detached copies and handed out as is, so a hit allocates nothing;
+/// callers must not modify them.
+/// </summary>
+public class ActiveSessionCache
+{
+    public static readonly TimeSpan NegativeTtl = TimeSpan.FromSeconds(10);
+    private const int PurgeThreshold = 100_000;
+    private static readonly TimeSpan PurgeInterval = TimeSpan.FromMinutes(1);
+
+    private readonly ConcurrentDictionary<(string UserId, string SourceIp), Entry> _entries = new();
+    private long _generation;
+    private long _nextPurgeTicks;
+
+    public int Count => _entries.Count;
+
+    /// <summary>
+    /// Generation to pass to <see cref="Store"/> for a database load started now.
+    /// </summary>
+    public long Generation => Interlocked.Read(ref _generation);
+
+    /// <summary>
+    /// Looks up the cached answer for a user and source IP. Returns false on a miss, in which
+    /// case the caller loads from the database and calls <see cref="Store"/>; otherwise
+    /// <paramref name="session"/> is the active session (shared, read-only), or null if the user has none.
+    /// </summary>
+    public bool TryGet(string userId, string sourceIp, DateTimeOffset now, Func<string, bool> isRevoked, out MfaSession? session)
+    {
+        session = null;
+        if (!_entries.TryGetValue((userId, sourceIp), out var entry))
+            return false;
+
+        if (entry.Session == null)
+        {
+            if (entry.ValidUntil > now)
+                return true;
+        }
+        else if (entry.ValidUntil > now && !isRevoked(entry.Session.Id))
+        {
+            session = entry.Session;
+            return true;
+        }
+
+        // Expired, revoked elsewhere, or a stale "no session": an older session may still be active
+        _entries.TryRemove(new KeyValuePair<(string, string), Entry>((userId, sourceIp), entry));
+        return false;
+    }
+
+    /// <summary>
+    /// Caches the result of a database load started at <paramref name="generation"/>, unless a
+    /// session was created or revoked since.
+    /// </summary>
+    public void Store(string userId, string sourceIp, MfaSession? session, long generation, DateTimeOffset now)
+    {
+        if (Interlocked.Read(ref _generation) != generation)
+            return;
+
+        PurgeIfLarge(now);
+        _entries[(userId, sourceIp)] = session == null
+            ? new Entry(null, now + NegativeTtl)
+            : new Entry(Detach(session), session.ExpiresAt);
+    }
+
+    /// <summary>
+    /// Records a session just created; it is the newest for its user and source IP.
+    /// </summary>
+    public void Created(MfaSession session)
+    {
+        Interlocked.Increment(ref _generation);
+        PurgeIfLarge(DateTimeOffset.UtcNow);
+        _entries[(session.UserId, session.SourceIp)] = new Entry(Detach(session), session.ExpiresAt);
+    }
+
+    /// <summary>
+    /// Drops the cached answer for the user and source IP of a revoked session.
+    /// </summary>
+    public void Revoked(MfaSession session)
+    {
+        Interlocked.Increment(ref _generation);
+        _entries.TryRemove((session.UserId, session.SourceIp), out _);
+    }
+
+    private void PurgeIfLarge(DateTimeOffset now)
+    {
+        // Count takes every bucket lock, so look at it at most once per interval
+        var next = Interlocked.Read(ref _nextPurgeTicks);
+        if (now.UtcTicks < next ||
+            Interlocked.CompareExchange(ref _nextPurgeTicks, (now + PurgeInterval).UtcTicks, next) != next ||
+            _entries.Count < PurgeThreshold)
+            return;
+
+        foreach (var (key, entry) in _entries)
+        {
+            if (entry.ValidUntil <= now)
+                _entries.TryRemove(new KeyValuePair<(string, string), Entry>(key, entry));
+        }
+    }
+
+    private static MfaSession Detach(MfaSession s) => new()
+    {
+        Id = s.Id,
+        UserId = s.UserId,
+        TokenHash = s.TokenHash,
+        SourceIp = s.SourceIp,
+        TargetResource = s.TargetResource,
+        VerifiedMethod = s.VerifiedMethod,
+        Status = SessionStatus.Active,
+        CreatedAt = s.CreatedAt,
+        ExpiresAt = s.ExpiresAt,
+        DcAgentId = s.DcAgentId
+    };
+
+    private sealed record Entry(MfaSession? Session, DateTimeOffset ValidUntil);
+}
@@ -0,0 +1,90 @@
+using System.Collections.Concurrent;
+using System.Threading.Channels;
+using Microsoft.Extensions.Logging;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Tracks open bidirectional agent channels (<c>MfaService.AgentChannel</c>) and fans
+/// session created/revoked events out to them. One channel per agent; a reconnecting
+/// agent replaces its previous channel.
+/// </summary>
+public class AgentChannelService
+{
+    /// <summary>
+    /// Evaluations an agent may have outstanding on its channel at once. Requests beyond
+    /// this are answered with an error instead of being queued.
+    /// </summary>
+    public const int MaxInFlight = 64;
+
+    private readonly ConcurrentDictionary<string, Channel<SessionChangeNotification>> _agents = new();
+    private readonly ILogger<AgentChannelService> _logger;
+
+    public AgentChannelService(ILogger<AgentChannelService> logger)
+    {
+        _logger = logger;
+    }
+
+    public int ConnectedCount => _agents.Count;
+
+    /// <summary>
+    /// Registers an agent channel and returns the queue its session events are delivered to.
+    /// </summary>
+    public Channel<SessionChangeNotification> Subscribe(string agentId)
+    {
+        var channel = Channel.CreateBounded<SessionChangeNotification>(new BoundedChannelOptions(1000)
+        {
+            FullMode = BoundedChannelFullMode.DropOldest,
+            SingleReader = true,
+            SingleWriter = false
+        });
+
+        _agents.AddOrUpdate(agentId, channel, (_, old) =>
+        {
+            old.Writer.TryComplete();
+            return channel;
+        });
+
+        MetricsService.AgentChannelsOpen.Set(_agents.Count);
+        _logger.LogInformation("Agent {AgentId} opened agent channel", agentId);
+        return channel;
+    }
+
+    /// <summary>
+    /// Removes an agent channel. Returns false when the agent has already reconnected and
+    /// <paramref name="channel"/> is no longer its current channel.
+    /// </summary>
+    public bool Unsubscribe(string agentId, Channel<SessionChangeNotification> channel)
+    {
+        channel.Writer.TryComplete();
+        if (!_agents.TryRemove(new KeyValuePair<string, Channel<SessionChangeNotification>>(agentId, channel)))
+            return false;
+
+        MetricsService.AgentChannelsOpen.Set(_agents.Count);
+        _logger.LogInformation("Agent {AgentId} closed agent channel", agentId);
+        return true;
+    }
+
+    public void NotifySessionChange(SessionChangeNotification notification)
+    {
+        foreach (var (agentId, channel) in _agents)
+        {
+            if (!channel.Writer.TryWrite(notification))
+                _logger.LogDebug("Channel closed for agent {AgentId}, session event not delivered", agentId);
+        }
+    }
+}
+
+/// <summary>
+/// A session created or revoked on this server, pushed to agents so they can update their
+/// session caches without waiting for the next logon.
+/// </summary>
+public record SessionChangeNotification
+{
+    public required string SessionId { get; init; }
+    public string UserName { get; init; } = string.Empty;
+    public string SourceIp { get; init; } = string.Empty;
+    public DateTimeOffset ExpiresAt { get; init; }
+    public bool Revoked { get; init; }
+    public string VerifiedMethod { get; init; } = string.Empty;
+}
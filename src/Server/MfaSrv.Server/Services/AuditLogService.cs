@@ -1,4 +1,5 @@
 using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
 using MfaSrv.Core.Entities;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.Interfaces;
@@ -9,21 +10,27 @@ namespace MfaSrv.Server.Services;
 public class AuditLogService : IAuditLogger
 {
     private readonly MfaSrvDbContext _db;
+    private readonly AuditLogWriter _writer;
+    private readonly DashboardStatisticsService _statistics;
+    private readonly AuditSettings _settings;
     private readonly ILogger<AuditLogService> _logger;
 
-    public AuditLogService(MfaSrvDbContext db, ILogger<AuditLogService> logger)
+    public AuditLogService(
+        MfaSrvDbContext db,
+        AuditLogWriter writer,
+        DashboardStatisticsService statistics,
+        IOptions<AuditSettings> settings,
+        ILogger<AuditLogService> logger)
     {
         _db = db;
+        _writer = writer;
+        _statistics = statistics;
+        _settings = settings.Value;
         _logger = logger;
     }
 
     public async Task LogAsync(AuditEventType eventType, string userId, string? sourceIp, string? targetResource, string? details, CancellationToken ct = default)
     {
-        var isSuccess = eventType is AuditEventType.MfaChallengeVerified
-            or AuditEventType.SessionCreated
-            or AuditEventType.UserEnrolled
-            or AuditEventType.AgentRegistered;
-
         var entry = new AuditLogEntry
         {
             EventType = eventType,
@@ -31,17 +38,63 @@ public class AuditLogService : IAuditLogger
             SourceIp = sourceIp,
             TargetResource = targetResource,
             Details = details,
-            Success = isSuccess,
+            Success = IsSuccess(eventType),
             Timestamp = DateTimeOffset.UtcNow
         };
 
-        _db.AuditLog.Add(entry);
-        await _db.SaveChangesAsync(ct);
+        if (_settings.Mode == AuditWriteMode.Batched)
+        {
+            // Persisted by AuditLogWriter; sampled or dropped entries are counted there
+            _writer.TryEnqueue(entry);
+        }
+        else
+        {
+            await AuditStore.AppendAsync(_db, new[] { entry }, ct);
+        }
+
+        Record(entry);
+    }
+
+    /// <summary>
+    /// Stores events recorded elsewhere (forwarded by an evaluation node, or decisions a DC agent
+    /// made locally), keeping the time each happened there.
+    /// <see cref="AuditLogEntry.Success"/> is set from the event type, as for
+    /// <see cref="LogAsync"/>; in synchronous mode the batch is saved in one transaction.
+    /// </summary>
+    public async Task LogForwardedAsync(IReadOnlyList<AuditLogEntry> entries, CancellationToken ct = default)
+    {
+        foreach (var entry in entries)
+            entry.Success = IsSuccess(entry.EventType);
+
+        if (_settings.Mode == AuditWriteMode.Batched)
+        {
+            foreach (var entry in entries)
+                _writer.TryEnqueue(entry);
+        }
+        else
+        {
+            await AuditStore.AppendAsync(_db, entries, ct);
+        }
+
+        foreach (var entry in entries)
+            Record(entry);
+    }
+
+    private static bool IsSuccess(AuditEventType eventType) => eventType is
+        AuditEventType.MfaChallengeVerified or
+        AuditEventType.SessionCreated or
+        AuditEventType.UserEnrolled or
+        AuditEventType.AgentRegistered;
+
+    private void Record(AuditLogEntry entry)
+    {
+        // Counted even when the batched writer samples or drops the entry
+        _statistics.RecordAuditEvent(entry);
 
         // Fire ETW event for real-time Windows event tracing
-        EmitEtwEvent(eventType, userId, sourceIp, targetResource, details, isSuccess);
+        EmitEtwEvent(entry.EventType, entry.UserId ?? string.Empty, entry.SourceIp, entry.TargetResource, entry.Details, entry.Success);
 
-        _logger.LogDebug("Audit: {EventType} for user {UserId} from {SourceIp}", eventType, userId, sourceIp);
+        _logger.LogDebug("Audit: {EventType} for user {UserId} from {SourceIp}", entry.EventType, entry.UserId, entry.SourceIp);
     }
 
     /// <summary>
@@ -0,0 +1,171 @@
+using System.Threading.Channels;
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server.Data;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Background writer for batched audit logging. <see cref="AuditLogService"/> enqueues entries
+/// without touching the database; this service drains the queue and inserts up to
+/// <see cref="AuditSettings.BatchSize"/> entries per SaveChanges (one transaction, batched
+/// INSERT commands), at least every <see cref="AuditSettings.FlushIntervalMs"/>.
+///
+/// Enqueueing never blocks a logon. Above the sampling threshold only one in
+/// <see cref="AuditSettings.SamplingRate"/> routine events is kept, and once the queue is full
+/// new entries are dropped. Every dropped entry is counted in
+/// <c>mfasrv_audit_events_dropped_total</c> by reason.
+/// </summary>
+public class AuditLogWriter : BackgroundService
+{
+    private readonly Channel<AuditLogEntry> _channel;
+    private readonly IServiceScopeFactory _scopeFactory;
+    private readonly AuditSettings _settings;
+    private readonly ILogger<AuditLogWriter> _logger;
+    private readonly int _samplingThreshold;
+    private long _sampleCounter;
+
+    public AuditLogWriter(
+        IServiceScopeFactory scopeFactory,
+        IOptions<AuditSettings> settings,
+        ILogger<AuditLogWriter> logger)
+    {
+        _scopeFactory = scopeFactory;
+        _settings = settings.Value;
+        _logger = logger;
+
+        var capacity = Math.Max(1, _settings.QueueCapacity);
+        _samplingThreshold = (int)((long)capacity * Math.Clamp(_settings.SamplingThresholdPercent, 0, 100) / 100);
+        _channel = Channel.CreateBounded<AuditLogEntry>(new BoundedChannelOptions(capacity)
+        {
+            FullMode = BoundedChannelFullMode.Wait,
+            SingleReader = true,
+            SingleWriter = false
+        });
+    }
+
+    /// <summary>
+    /// Number of entries waiting to be written.
+    /// </summary>
+    public int QueueDepth => _channel.Reader.Count;
+
+    /// <summary>
+    /// Queues an entry for the next batch. Returns false if the entry was sampled out or the
+    /// queue is full; the drop is counted and the caller continues without waiting.
+    /// </summary>
+    public bool TryEnqueue(AuditLogEntry entry)
+    {
+        if (IsRoutine(entry.EventType)
+            && QueueDepth >= _samplingThreshold
+            && Interlocked.Increment(ref _sampleCounter) % Math.Max(1, _settings.SamplingRate) != 0)
+        {
+            MetricsService.AuditEventsDroppedTotal.WithLabels("sampled").Inc();
+            return false;
+        }
+
+        if (_channel.Writer.TryWrite(entry))
+            return true;
+
+        MetricsService.AuditEventsDroppedTotal.WithLabels("queue_full").Inc();
+        return false;
+    }
+
+    /// <summary>
+    /// Writes everything currently queued. Used on shutdown so accepted entries are not lost.
+    /// </summary>
+    public async Task FlushAsync(CancellationToken ct = default)
+    {
+        var batch = new List<AuditLogEntry>(Math.Max(1, _settings.BatchSize));
+        while (_channel.Reader.TryRead(out var entry))
+        {
+            batch.Add(entry);
+            if (batch.Count >= _settings.BatchSize)
+            {
+                await WriteBatchAsync(batch, ct);
+                batch.Clear();
+            }
+        }
+
+        if (batch.Count > 0)
+            await WriteBatchAsync(batch, ct);
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        var interval = TimeSpan.FromMilliseconds(Math.Max(1, _settings.FlushIntervalMs));
+        var batch = new List<AuditLogEntry>(Math.Max(1, _settings.BatchSize));
+        var reader = _channel.Reader;
+
+        try
+        {
+            while (await reader.WaitToReadAsync(stoppingToken))
+            {
+                // Give a partial batch up to one flush interval to fill
+                var deadline = DateTimeOffset.UtcNow + interval;
+                while (batch.Count < _settings.BatchSize)
+                {
+                    if (reader.TryRead(out var entry))
+                    {
+                        batch.Add(entry);
+                        continue;
+                    }
+
+                    var remaining = deadline - DateTimeOffset.UtcNow;
+                    if (remaining <= TimeSpan.Zero)
+                        break;
+
+                    using var waitCts = CancellationTokenSource.CreateLinkedTokenSource(stoppingToken);
+                    waitCts.CancelAfter(remaining);
+                    try
+                    {
+                        await reader.WaitToReadAsync(waitCts.Token);
+                    }
+                    catch (OperationCanceledException) when (!stoppingToken.IsCancellationRequested)
+                    {
+                        break;
+                    }
+                }
+
+                await WriteBatchAsync(batch, CancellationToken.None);
+                batch.Clear();
+                MetricsService.AuditQueueDepth.Set(reader.Count);
+            }
+        }
+        catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+        {
+            // Shutting down - persist what was already accepted below
+        }
+
+        if (batch.Count > 0)
+            await WriteBatchAsync(batch, CancellationToken.None);
+        await FlushAsync(CancellationToken.None);
+
+        _logger.LogInformation("Audit log writer stopped");
+    }
+
+    private async Task WriteBatchAsync(List<AuditLogEntry> batch, CancellationToken ct)
+    {
+        try
+        {
+            using var scope = _scopeFactory.CreateScope();
+            var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+
+            await AuditStore.AppendAsync(db, batch, ct);
+
+            _logger.LogDebug("Wrote {Count} audit entries", batch.Count);
+        }
+        catch (Exception ex)
+        {
+            MetricsService.AuditEventsDroppedTotal.WithLabels("write_failed").Inc(batch.Count);
+            _logger.LogError(ex, "Failed to write batch of {Count} audit entries", batch.Count);
+        }
+    }
+
+    private static bool IsRoutine(AuditEventType eventType) => eventType is
+        AuditEventType.AuthenticationAttempt or
+        AuditEventType.PolicyEvaluated or
+        AuditEventType.AgentHeartbeat;
+}
@@ -0,0 +1,112 @@
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Server.Data;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Seals closed hourly audit segments into rollups and applies audit retention.
+/// See <see cref="AuditStore"/>. Runs on the leader only. Each hour sealed or dropped is its
+/// own fenced write in its own scope, so catching up on many hours never holds one long
+/// transaction, and a takeover stops the pass at the next hour.
+/// </summary>
+public class AuditRollupService : BackgroundService
+{
+    private readonly IServiceScopeFactory _scopeFactory;
+    private readonly AuditSettings _settings;
+    private readonly ILogger<AuditRollupService> _logger;
+    private readonly SetupService _setupService;
+    private readonly LeaderElectionService _leaderElection;
+    private static readonly TimeSpan Interval = TimeSpan.FromMinutes(1);
+
+    public AuditRollupService(
+        IServiceScopeFactory scopeFactory,
+        IOptions<AuditSettings> settings,
+        ILogger<AuditRollupService> logger,
+        SetupService setupService,
+        LeaderElectionService leaderElection)
+    {
+        _scopeFactory = scopeFactory;
+        _settings = settings.Value;
+        _logger = logger;
+        _setupService = setupService;
+        _leaderElection = leaderElection;
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        if (_setupService.IsSetupRequired())
+        {
+            _logger.LogInformation("Audit rollup service paused - awaiting initial setup");
+            return;
+        }
+
+        while (!stoppingToken.IsCancellationRequested)
+        {
+            try
+            {
+                if (_leaderElection.IsLeader)
+                    await MaintainSegmentsAsync(stoppingToken);
+            }
+            catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+            {
+                break;
+            }
+            catch (Exception ex)
+            {
+                _logger.LogError(ex, "Error maintaining audit segments");
+            }
+
+            await Task.Delay(Interval, stoppingToken);
+        }
+    }
+
+    private async Task MaintainSegmentsAsync(CancellationToken ct)
+    {
+        var now = DateTimeOffset.UtcNow;
+
+        var sealedCount = 0;
+        while (sealedCount < AuditStore.MaxSegmentsPerPass)
+        {
+            var sealedOne = false;
+            if (!await RunFencedAsync(async (store, c) => sealedOne = await store.SealNextSegmentAsync(now, c), ct)
+                || !sealedOne)
+                break;
+            sealedCount++;
+        }
+
+        if (sealedCount > 0)
+            _logger.LogDebug("Sealed {Count} audit segments", sealedCount);
+
+        if (_settings.RetentionDays <= 0)
+            return;
+
+        var cutoff = now.AddDays(-_settings.RetentionDays);
+        var deleted = 0;
+        while (true)
+        {
+            int? count = null;
+            if (!await RunFencedAsync(async (store, c) => count = await store.DropOldestSegmentBeforeAsync(cutoff, c), ct)
+                || count == null)
+                break;
+            deleted += count.Value;
+        }
+
+        await RunFencedAsync((store, c) => store.DropRollupsBeforeAsync(cutoff, c), ct);
+
+        if (deleted > 0)
+            _logger.LogInformation("Audit retention removed {Count} entries older than {Days} days",
+                deleted, _settings.RetentionDays);
+    }
+
+    private async Task<bool> RunFencedAsync(Func<AuditStore, CancellationToken, Task> step, CancellationToken ct)
+    {
+        // A scope per step: nothing stays tracked, and each step is fenced on its own
+        using var scope = _scopeFactory.CreateScope();
+        var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+        var store = scope.ServiceProvider.GetRequiredService<AuditStore>();
+        return await _leaderElection.RunFencedAsync(db, c => step(store, c), ct);
+    }
+}
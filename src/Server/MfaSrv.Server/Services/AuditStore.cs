@@ -0,0 +1,380 @@
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Logging;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server.Data;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Hour-partitioned view over the append-only audit log.
+///
+/// Each UTC hour is a segment. Once an hour has closed (plus a short grace period for
+/// batched writes) it is sealed: its per-(EventType, Success) counts are stored in
+/// <see cref="AuditHourlyRollup"/> and an <see cref="AuditSegment"/> marker is written.
+/// Aggregate queries read sealed hours from the rollups and only scan the raw table,
+/// via the (EventType, Timestamp) / Timestamp indexes, for the unaligned edges of the
+/// requested range and the not-yet-sealed tail.
+///
+/// Entries are written through <see cref="AppendAsync"/>, which also adds an entry that lands
+/// in an already sealed hour (a delayed batch, or an event an evaluation node forwarded late)
+/// to that hour's rollup. Sealing and appending each run in one transaction, so every entry is
+/// counted exactly once whichever commits first.
+/// </summary>
+public class AuditStore
+{
+    /// <summary>
+    /// How long after an hour closes before it is sealed, so entries still in the batched
+    /// audit queue normally land before it; later ones update the rollups instead.
+    /// </summary>
+    public static readonly TimeSpan SealGracePeriod = TimeSpan.FromMinutes(2);
+
+    /// <summary>
+    /// Most segments sealed by one <see cref="SealCompletedSegmentsAsync"/> call (one week).
+    /// </summary>
+    public const int MaxSegmentsPerPass = 168;
+
+    private readonly MfaSrvDbContext _db;
+    private readonly ILogger<AuditStore> _logger;
+
+    public AuditStore(MfaSrvDbContext db, ILogger<AuditStore> logger)
+    {
+        _db = db;
+        _logger = logger;
+    }
+
+    /// <summary>
+    /// Segment number (hours since the Unix epoch, UTC) containing <paramref name="timestamp"/>.
+    /// </summary>
+    public static long HourOf(DateTimeOffset timestamp) => timestamp.ToUnixTimeSeconds() / 3600;
+
+    public static DateTimeOffset StartOf(long hour) => DateTimeOffset.FromUnixTimeSeconds(hour * 3600);
+
+    /// <summary>
+    /// Inserts <paramref name="entries"/> in one transaction, adding those that fall in an
+    /// already sealed hour to its rollups and segment count.
+    /// </summary>
+    public static async Task AppendAsync(
+        MfaSrvDbContext db, IReadOnlyCollection<AuditLogEntry> entries, CancellationToken ct = default)
+    {
+        if (entries.Count == 0)
+            return;
+
+        await using var transaction = db.Database.IsRelational()
+            ? await db.Database.BeginTransactionAsync(ct)
+            : null;
+
+        db.AuditLog.AddRange(entries);
+
+        var sealedThrough = await db.AuditSegments.MaxAsync(s => (long?)s.Hour, ct);
+        if (sealedThrough.HasValue)
+            await AddToSealedRollupsAsync(db, entries, sealedThrough.Value, ct);
+
+        await db.SaveChangesAsync(ct);
+
+        if (transaction != null)
+            await transaction.CommitAsync(ct);
+    }
+
+    /// <summary>
+    /// Seals every closed hour after the last sealed segment (at most one week per call).
+    /// Returns the number of segments sealed. Safe to run from several instances:
+    /// a segment sealed concurrently elsewhere ends the pass.
+    /// </summary>
+    public async Task<int> SealCompletedSegmentsAsync(DateTimeOffset now, CancellationToken ct = default)
+    {
+        var sealedCount = 0;
+        while (sealedCount < MaxSegmentsPerPass && await SealNextSegmentAsync(now, ct))
+            sealedCount++;
+        return sealedCount;
+    }
+
+    /// <summary>
+    /// Seals the closed hour after the last sealed segment, in one SaveChanges. Returns false if
+    /// there is none, or if another instance sealed it first.
+    /// </summary>
+    public async Task<bool> SealNextSegmentAsync(DateTimeOffset now, CancellationToken ct = default)
+    {
+        // Counted and sealed in one transaction, so an append either lands before the count
+        // or sees the segment sealed
+        await using var transaction = _db.Database.IsRelational()
+            ? await _db.Database.BeginTransactionAsync(ct)
+            : null;
+
+        var lastSealed = await _db.AuditSegments.MaxAsync(s => (long?)s.Hour, ct);
+
+        long next;
+        if (lastSealed.HasValue)
+        {
+            next = lastSealed.Value + 1;
+        }
+        else
+        {
+            var oldest = await _db.AuditLog
+                .OrderBy(e => e.Timestamp)
+                .Select(e => (DateTimeOffset?)e.Timestamp)
+                .FirstOrDefaultAsync(ct);
+            if (oldest == null)
+                return false;
+            next = HourOf(oldest.Value);
+        }
+
+        if (next > HourOf(now - SealGracePeriod) - 1)
+            return false;
+
+        var counts = await CountRawAsync(StartOf(next), StartOf(next + 1), ct);
+
+        _db.AuditHourlyRollups.AddRange(counts.Select(c => new AuditHourlyRollup
+        {
+            Hour = next,
+            EventType = c.Key.EventType,
+            Success = c.Key.Success,
+            Count = c.Value
+        }));
+        _db.AuditSegments.Add(new AuditSegment
+        {
+            Hour = next,
+            EventCount = counts.Values.Sum(),
+            SealedAt = now
+        });
+
+        try
+        {
+            await _db.SaveChangesAsync(ct);
+
+            if (transaction != null)
+                await transaction.CommitAsync(ct);
+        }
+        catch (DbUpdateException)
+        {
+            _logger.LogDebug("Audit segment {Hour} was sealed by another instance", next);
+            return false;
+        }
+        finally
+        {
+            _db.ChangeTracker.Clear();
+        }
+
+        _logger.LogDebug("Sealed audit segment {Hour}", next);
+        return true;
+    }
+
+    /// <summary>
+    /// Event counts in [<paramref name="from"/>, <paramref name="to"/>] keyed by event type and
+    /// success. Exact: sealed full hours come from rollups, everything else from the raw log.
+    /// </summary>
+    public async Task<Dictionary<(AuditEventType EventType, bool Success), long>> GetCountsAsync(
+        DateTimeOffset? from, DateTimeOffset? to, CancellationToken ct = default)
+    {
+        var sealedThrough = await _db.AuditSegments.MaxAsync(s => (long?)s.Hour, ct);
+
+        // Full hours inside the range
+        var firstFull = from.HasValue
+            ? HourOf(from.Value) + (StartOf(HourOf(from.Value)) == from.Value ? 0 : 1)
+            : long.MinValue;
+        var lastFull = to.HasValue ? HourOf(to.Value) - 1 : long.MaxValue;
+        if (sealedThrough.HasValue)
+            lastFull = Math.Min(lastFull, sealedThrough.Value);
+
+        if (!sealedThrough.HasValue || firstFull > lastFull)
+            return await CountRawAsync(from, to, ct, toInclusive: true);
+
+        var result = await _db.AuditHourlyRollups
+            .AsNoTracking()
+            .Where(r => r.Hour >= firstFull && r.Hour <= lastFull)
+            .GroupBy(r => new { r.EventType, r.Success })
+            .Select(g => new { g.Key.EventType, g.Key.Success, Count = g.Sum(r => r.Count) })
+            .ToDictionaryAsync(x => (x.EventType, x.Success), x => x.Count, ct);
+
+        if (from.HasValue && from.Value < StartOf(firstFull))
+            Merge(result, await CountRawAsync(from.Value, StartOf(firstFull), ct));
+
+        var tailStart = StartOf(lastFull + 1);
+        if (!to.HasValue || tailStart <= to.Value)
+            Merge(result, await CountRawAsync(tailStart, to, ct, toInclusive: true));
+
+        return result;
+    }
+
+    /// <summary>
+    /// Per-hour counts for every segment overlapping [<paramref name="from"/>, <paramref name="to"/>].
+    /// Hours without events are omitted.
+    /// </summary>
+    public async Task<List<AuditHourlyRollup>> GetHourlySeriesAsync(
+        DateTimeOffset from, DateTimeOffset to, CancellationToken ct = default)
+    {
+        var firstHour = HourOf(from);
+        var lastHour = HourOf(to);
+        var sealedThrough = await _db.AuditSegments.MaxAsync(s => (long?)s.Hour, ct);
+
+        var series = sealedThrough.HasValue
+            ? await _db.AuditHourlyRollups
+                .AsNoTracking()
+                .Where(r => r.Hour >= firstHour && r.Hour <= lastHour && r.Hour <= sealedThrough.Value)
+                .ToListAsync(ct)
+            : new List<AuditHourlyRollup>();
+
+        // Unsealed hours (normally just the current one) are counted from the raw log
+        var firstUnsealed = sealedThrough.HasValue ? Math.Max(firstHour, sealedThrough.Value + 1) : firstHour;
+        for (var hour = firstUnsealed; hour <= lastHour; hour++)
+        {
+            var counts = await CountRawAsync(StartOf(hour), StartOf(hour + 1), ct);
+            series.AddRange(counts.Select(c => new AuditHourlyRollup
+            {
+                Hour = hour,
+                EventType = c.Key.EventType,
+                Success = c.Key.Success,
+                Count = c.Value
+            }));
+        }
+
+        return series;
+    }
+
+    /// <summary>
+    /// Drops every segment that ends at or before <paramref name="cutoff"/>: raw entries one hour
+    /// at a time (an index range delete each), then their rollups and segment markers.
+    /// Returns the number of audit entries deleted.
+    /// </summary>
+    public async Task<int> DropSegmentsBeforeAsync(DateTimeOffset cutoff, CancellationToken ct = default)
+    {
+        var deleted = 0;
+        while (await DropOldestSegmentBeforeAsync(cutoff, ct) is { } count)
+            deleted += count;
+
+        await DropRollupsBeforeAsync(cutoff, ct);
+        return deleted;
+    }
+
+    /// <summary>
+    /// Deletes the raw entries of the oldest hour that ends at or before <paramref name="cutoff"/>.
+    /// Returns the number deleted, or null if no such entries are left.
+    /// </summary>
+    public async Task<int?> DropOldestSegmentBeforeAsync(DateTimeOffset cutoff, CancellationToken ct = default)
+    {
+        var cutoffStart = StartOf(HourOf(cutoff));
+        var oldest = await _db.AuditLog
+            .Where(e => e.Timestamp < cutoffStart)
+            .OrderBy(e => e.Timestamp)
+            .Select(e => (DateTimeOffset?)e.Timestamp)
+            .FirstOrDefaultAsync(ct);
+        if (oldest == null)
+            return null;
+
+        var hour = HourOf(oldest.Value);
+        var start = StartOf(hour);
+        var end = StartOf(hour + 1);
+        return await _db.AuditLog
+            .Where(e => e.Timestamp >= start && e.Timestamp < end)
+            .ExecuteDeleteAsync(ct);
+    }
+
+    /// <summary>
+    /// Deletes the rollups and segment markers of hours that end at or before <paramref name="cutoff"/>.
+    /// </summary>
+    public async Task DropRollupsBeforeAsync(DateTimeOffset cutoff, CancellationToken ct = default)
+    {
+        var cutoffHour = HourOf(cutoff);
+        await _db.AuditHourlyRollups.Where(r => r.Hour < cutoffHour).ExecuteDeleteAsync(ct);
+        await _db.AuditSegments.Where(s => s.Hour < cutoffHour).ExecuteDeleteAsync(ct);
+    }
+
+    /// <summary>
+    /// Adds the entries of hours up to <paramref name="sealedThrough"/> to their rollups.
+    /// Aggregates read every hour up to the last sealed one from the rollups, so an hour
+    /// without a segment yet (older than the first one sealed) gets one.
+    /// </summary>
+    private static async Task AddToSealedRollupsAsync(
+        MfaSrvDbContext db, IReadOnlyCollection<AuditLogEntry> entries, long sealedThrough, CancellationToken ct)
+    {
+        var late = entries
+            .Where(e => HourOf(e.Timestamp) <= sealedThrough)
+            .GroupBy(e => (Hour: HourOf(e.Timestamp), e.EventType, e.Success))
+            .ToList();
+        if (late.Count == 0)
+            return;
+
+        var hours = late.Select(g => g.Key.Hour).Distinct().ToList();
+        var segments = await db.AuditSegments
+            .Where(s => hours.Contains(s.Hour))
+            .ToDictionaryAsync(s => s.Hour, ct);
+        var rollups = await db.AuditHourlyRollups
+            .Where(r => hours.Contains(r.Hour))
+            .ToDictionaryAsync(r => (r.Hour, r.EventType, r.Success), ct);
+
+        foreach (var group in late)
+        {
+            if (!segments.TryGetValue(group.Key.Hour, out var segment))
+            {
+                segment = new AuditSegment { Hour = group.Key.Hour, SealedAt = DateTimeOffset.UtcNow };
+                db.AuditSegments.Add(segment);
+                segments[group.Key.Hour] = segment;
+            }
+            segment.EventCount += group.Count();
+
+            if (!rollups.TryGetValue(group.Key, out var rollup))
+            {
+                rollup = new AuditHourlyRollup
+                {
+                    Hour = group.Key.Hour,
+                    EventType = group.Key.EventType,
+                    Success = group.Key.Success
+                };
+                db.AuditHourlyRollups.Add(rollup);
+                rollups[group.Key] = rollup;
+            }
+            rollup.Count += group.Count();
+        }
+
+        MetricsService.AuditLateEntriesTotal.Inc(late.Sum(g => g.Count()));
+    }
+
+    private async Task<Dictionary<(AuditEventType EventType, bool Success), long>> CountRawAsync(
+        DateTimeOffset? from, DateTimeOffset? to, CancellationToken ct, bool toInclusive = false)
+    {
+        var query = _db.AuditLog.AsNoTracking();
+        if (from.HasValue)
+            query = query.Where(e => e.Timestamp >= from.Value);
+        if (to.HasValue)
+            query = toInclusive
+                ? query.Where(e => e.Timestamp <= to.Value)
+                : query.Where(e => e.Timestamp < to.Value);
+
+        return await query
+            .GroupBy(e => new { e.EventType, e.Success })
+            .Select(g => new { g.Key.EventType, g.Key.Success, Count = g.LongCount() })
+            .ToDictionaryAsync(x => (x.EventType, x.Success), x => x.Count, ct);
+    }
+
+    private static void Merge(
+        Dictionary<(AuditEventType EventType, bool Success), long> target,
+        Dictionary<(AuditEventType EventType, bool Success), long> source)
+    {
+        foreach (var (key, count) in source)
+            target[key] = target.GetValueOrDefault(key) + count;
+    }
+}
+
+/// <summary>
+/// EF Core entity marking a sealed hourly audit segment.
+/// </summary>
+public class AuditSegment
+{
+    /// <summary>
+    /// Hours since the Unix epoch (UTC); see <see cref="AuditStore.HourOf"/>.
+    /// </summary>
+    public long Hour { get; set; }
+    public long EventCount { get; set; }
+    public DateTimeOffset SealedAt { get; set; }
+}
+
+/// <summary>
+/// EF Core entity holding the number of audit events of one type and outcome in a sealed hour.
+/// </summary>
+public class AuditHourlyRollup
+{
+    public long Hour { get; set; }
+    public AuditEventType EventType { get; set; }
+    public bool Success { get; set; }
+    public long Count { get; set; }
+}
@@ -0,0 +1,436 @@
+using System.Collections.Concurrent;
+using System.Linq.Expressions;
+using System.Threading.Channels;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.EntityFrameworkCore.Query;
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.Logging;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server.Data;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// State of open MFA challenges, shared by every server instance through the
+/// <c>MfaChallenges</c> row and cached in memory.
+///
+/// The row is the authority on status and attempt count. A challenge is inserted when it is
+/// issued; each verification attempt is counted with a conditional UPDATE that fails once the
+/// challenge is settled or out of attempts; and a challenge is settled with a conditional
+/// UPDATE from Issued. Instances behind a load balancer therefore share one attempt budget and
+/// agree on one outcome. <see cref="GetAsync"/> re-reads a cached challenge that is still
+/// Issued; settled challenges never change again and are answered from memory.
+///
+/// Enrollment <c>LastUsedAt</c> stamps are only informational and are written in the
+/// background, at most every <see cref="FlushInterval"/>. Challenges are evicted from memory
+/// <see cref="EvictionDelay"/> after they expire, and the sweep marks those never answered
+/// Expired in the database. Callers must hold the challenge's lock while reading its fields.
+/// </summary>
+public class ChallengeStateStore : BackgroundService
+{
+    public static readonly TimeSpan FlushInterval = TimeSpan.FromMilliseconds(200);
+    public static readonly TimeSpan EvictionDelay = TimeSpan.FromMinutes(1);
+    private static readonly TimeSpan SweepInterval = TimeSpan.FromSeconds(30);
+
+    private readonly ConcurrentDictionary<string, MfaChallenge> _challenges = new(StringComparer.Ordinal);
+    private readonly ConcurrentDictionary<string, DateTimeOffset> _enrollmentsUsed = new(StringComparer.Ordinal);
+    private readonly Channel<bool> _signal = Channel.CreateBounded<bool>(new BoundedChannelOptions(1)
+    {
+        FullMode = BoundedChannelFullMode.DropWrite
+    });
+    private readonly IServiceScopeFactory _scopeFactory;
+    private readonly ILogger<ChallengeStateStore> _logger;
+
+    public ChallengeStateStore(IServiceScopeFactory scopeFactory, ILogger<ChallengeStateStore> logger)
+    {
+        _scopeFactory = scopeFactory;
+        _logger = logger;
+    }
+
+    /// <summary>
+    /// Number of challenges held in memory.
+    /// </summary>
+    public int Count => _challenges.Count;
+
+    /// <summary>
+    /// Number of enrollment stamps waiting to be written.
+    /// </summary>
+    public int PendingWrites => _enrollmentsUsed.Count;
+
+    /// <summary>
+    /// Inserts a newly issued challenge, so any instance can verify it, and caches it.
+    /// </summary>
+    public async Task AddAsync(MfaSrvDbContext db, MfaChallenge challenge, CancellationToken ct = default)
+    {
+        var row = Copy(challenge);
+        db.MfaChallenges.Add(row);
+        await db.SaveChangesAsync(ct);
+        db.Entry(row).State = EntityState.Detached;
+
+        _challenges[challenge.Id] = challenge;
+    }
+
+    /// <summary>
+    /// Returns the cached challenge, loading it from <paramref name="db"/> if it is not in
+    /// memory. One that is still Issued is re-read, as another instance may have settled it.
+    /// </summary>
+    public async Task<MfaChallenge?> GetAsync(MfaSrvDbContext db, string challengeId, CancellationToken ct = default)
+    {
+        if (!_challenges.TryGetValue(challengeId, out var challenge))
+            return await LoadAsync(db, challengeId, ct);
+
+        bool issued;
+        lock (challenge)
+            issued = challenge.Status == ChallengeStatus.Issued;
+
+        if (issued)
+            await RefreshAsync(db, challenge, ct);
+        return challenge;
+    }
+
+    /// <summary>
+    /// Returns the cached challenge without re-reading it, loading it if it is not in memory.
+    /// For callers that go on to change it with <see cref="TryCountAttemptAsync"/> or
+    /// <see cref="TrySettleAsync"/>, which check the row themselves.
+    /// </summary>
+    public async Task<MfaChallenge?> GetCachedAsync(MfaSrvDbContext db, string challengeId, CancellationToken ct = default)
+    {
+        if (_challenges.TryGetValue(challengeId, out var challenge))
+            return challenge;
+
+        return await LoadAsync(db, challengeId, ct);
+    }
+
+    /// <summary>
+    /// Returns a detached copy of the challenge, as <see cref="GetAsync"/> sees it.
+    /// </summary>
+    public async Task<MfaChallenge?> GetSnapshotAsync(MfaSrvDbContext db, string challengeId, CancellationToken ct = default)
+    {
+        var challenge = await GetAsync(db, challengeId, ct);
+        if (challenge == null)
+            return null;
+
+        lock (challenge)
+            return Copy(challenge);
+    }
+
+    /// <summary>
+    /// Counts one verification attempt against the row. Returns false, with the cached copy
+    /// refreshed, if the challenge is no longer Issued or has no attempts left.
+    /// </summary>
+    public async Task<bool> TryCountAttemptAsync(MfaSrvDbContext db, MfaChallenge challenge, CancellationToken ct = default)
+    {
+        var id = challenge.Id;
+        var counted = await UpdateAsync(
+            db,
+            db.MfaChallenges.Where(c => c.Id == id && c.Status == ChallengeStatus.Issued && c.AttemptCount < c.MaxAttempts),
+            u => u.SetProperty(c => c.AttemptCount, c => c.AttemptCount + 1),
+            c => c.AttemptCount++,
+            ct) == 1;
+
+        if (!counted)
+        {
+            await RefreshAsync(db, challenge, ct);
+            return false;
+        }
+
+        lock (challenge)
+            challenge.AttemptCount++;
+        return true;
+    }
+
+    /// <summary>
+    /// Moves an Issued challenge to <paramref name="status"/>. With
+    /// <paramref name="onlyIfExhausted"/>, only one that has used up its attempts. Returns
+    /// false, with the cached copy refreshed, if the row did not qualify, e.g. because a
+    /// verification on another instance settled it first.
+    /// </summary>
+    public async Task<bool> TrySettleAsync(
+        MfaSrvDbContext db,
+        MfaChallenge challenge,
+        ChallengeStatus status,
+        DateTimeOffset? respondedAt,
+        CancellationToken ct = default,
+        bool onlyIfExhausted = false)
+    {
+        var id = challenge.Id;
+        var rows = db.MfaChallenges.Where(c => c.Id == id && c.Status == ChallengeStatus.Issued);
+        if (onlyIfExhausted)
+            rows = rows.Where(c => c.AttemptCount >= c.MaxAttempts);
+
+        var settled = await UpdateAsync(
+            db,
+            rows,
+            u => u.SetProperty(c => c.Status, status).SetProperty(c => c.RespondedAt, respondedAt),
+            c =>
+            {
+                c.Status = status;
+                c.RespondedAt = respondedAt;
+            },
+            ct) == 1;
+
+        if (!settled)
+        {
+            await RefreshAsync(db, challenge, ct);
+            return false;
+        }
+
+        lock (challenge)
+        {
+            challenge.Status = status;
+            challenge.RespondedAt = respondedAt;
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Runs <paramref name="work"/> with a database context of its own, for challenge updates
+    /// that happen outside a request, such as provider callbacks. Failures are logged.
+    /// </summary>
+    public async Task RunInScopeAsync(string challengeId, Func<MfaSrvDbContext, Task> work)
+    {
+        try
+        {
+            using var scope = _scopeFactory.CreateScope();
+            await work(scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>());
+        }
+        catch (Exception ex)
+        {
+            _logger.LogError(ex, "Failed to update challenge {ChallengeId}", challengeId);
+        }
+    }
+
+    /// <summary>
+    /// Schedules an update of the enrollment's <c>LastUsedAt</c>.
+    /// </summary>
+    public void MarkEnrollmentUsed(string enrollmentId, DateTimeOffset usedAt)
+    {
+        _enrollmentsUsed[enrollmentId] = usedAt;
+        _signal.Writer.TryWrite(true);
+    }
+
+    /// <summary>
+    /// Writes everything pending. Used on shutdown so accepted changes are not lost.
+    /// </summary>
+    public async Task FlushAsync(CancellationToken ct = default)
+    {
+        while (PendingWrites > 0)
+        {
+            if (!await WriteEnrollmentsAsync(ct))
+                break;
+        }
+    }
+
+    /// <summary>
+    /// Evicts challenges that expired more than <see cref="EvictionDelay"/> before
+    /// <paramref name="now"/> from memory.
+    /// </summary>
+    public int EvictExpired(DateTimeOffset now)
+    {
+        var evicted = 0;
+        foreach (var (id, challenge) in _challenges)
+        {
+            lock (challenge)
+            {
+                if (challenge.ExpiresAt + EvictionDelay > now)
+                    continue;
+            }
+
+            if (_challenges.TryRemove(new KeyValuePair<string, MfaChallenge>(id, challenge)))
+                evicted++;
+        }
+
+        return evicted;
+    }
+
+    /// <summary>
+    /// Marks every challenge that expired before <paramref name="now"/> without an answer as
+    /// Expired, on whichever instance issued it. Returns the number marked.
+    /// </summary>
+    public async Task<int> ExpireUnansweredAsync(MfaSrvDbContext db, DateTimeOffset now, CancellationToken ct = default)
+    {
+        return await UpdateAsync(
+            db,
+            db.MfaChallenges.Where(c => c.Status == ChallengeStatus.Issued && c.ExpiresAt < now),
+            u => u.SetProperty(c => c.Status, ChallengeStatus.Expired),
+            c => c.Status = ChallengeStatus.Expired,
+            ct);
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        var nextSweep = DateTimeOffset.UtcNow + SweepInterval;
+
+        try
+        {
+            while (!stoppingToken.IsCancellationRequested)
+            {
+                using (var waitCts = CancellationTokenSource.CreateLinkedTokenSource(stoppingToken))
+                {
+                    waitCts.CancelAfter(SweepInterval);
+                    try
+                    {
+                        await _signal.Reader.ReadAsync(waitCts.Token);
+                    }
+                    catch (OperationCanceledException) when (!stoppingToken.IsCancellationRequested)
+                    {
+                        // Idle for a sweep interval
+                    }
+                }
+
+                // Coalesce the burst of changes that arrives within one interval
+                await Task.Delay(FlushInterval, stoppingToken);
+                await FlushAsync(stoppingToken);
+
+                var now = DateTimeOffset.UtcNow;
+                if (now >= nextSweep)
+                {
+                    await SweepAsync(now, stoppingToken);
+                    nextSweep = now + SweepInterval;
+                }
+            }
+        }
+        catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+        {
+            // Shutting down - persist what was already accepted below
+        }
+
+        await FlushAsync(CancellationToken.None);
+        _logger.LogInformation("Challenge state store stopped");
+    }
+
+    private async Task SweepAsync(DateTimeOffset now, CancellationToken ct)
+    {
+        try
+        {
+            using var scope = _scopeFactory.CreateScope();
+            var expired = await ExpireUnansweredAsync(scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>(), now, ct);
+            var evicted = EvictExpired(now);
+
+            if (expired > 0 || evicted > 0)
+                _logger.LogDebug("Marked {Expired} unanswered challenges expired, evicted {Evicted} from memory", expired, evicted);
+        }
+        catch (Exception ex) when (ex is not OperationCanceledException)
+        {
+            _logger.LogError(ex, "Failed to sweep expired challenges, will retry");
+        }
+    }
+
+    private async Task<MfaChallenge?> LoadAsync(MfaSrvDbContext db, string challengeId, CancellationToken ct)
+    {
+        var stored = await db.MfaChallenges
+            .AsNoTracking()
+            .FirstOrDefaultAsync(c => c.Id == challengeId, ct);
+
+        return stored == null ? null : _challenges.GetOrAdd(challengeId, stored);
+    }
+
+    /// <summary>
+    /// Copies status and attempt count from the row. Only moves forward: a settled challenge
+    /// stays settled and the attempt count never drops.
+    /// </summary>
+    private static async Task RefreshAsync(MfaSrvDbContext db, MfaChallenge challenge, CancellationToken ct)
+    {
+        var id = challenge.Id;
+        var row = await db.MfaChallenges
+            .AsNoTracking()
+            .Where(c => c.Id == id)
+            .Select(c => new { c.Status, c.AttemptCount, c.RespondedAt })
+            .FirstOrDefaultAsync(ct);
+        if (row == null)
+            return;
+
+        lock (challenge)
+        {
+            if (challenge.Status == ChallengeStatus.Issued)
+            {
+                challenge.Status = row.Status;
+                challenge.RespondedAt = row.RespondedAt;
+            }
+            challenge.AttemptCount = Math.Max(challenge.AttemptCount, row.AttemptCount);
+        }
+    }
+
+    /// <summary>
+    /// One set-based UPDATE of <paramref name="rows"/>; returns the number of rows changed.
+    /// </summary>
+    private static async Task<int> UpdateAsync(
+        MfaSrvDbContext db,
+        IQueryable<MfaChallenge> rows,
+        Expression<Func<SetPropertyCalls<MfaChallenge>, SetPropertyCalls<MfaChallenge>>> setters,
+        Action<MfaChallenge> apply,
+        CancellationToken ct)
+    {
+        if (db.Database.IsRelational())
+            return await rows.ExecuteUpdateAsync(setters, ct);
+
+        // Providers without bulk updates (the in-memory test database)
+        var tracked = await rows.ToListAsync(ct);
+        foreach (var row in tracked)
+            apply(row);
+        await db.SaveChangesAsync(ct);
+        foreach (var row in tracked)
+            db.Entry(row).State = EntityState.Detached;
+        return tracked.Count;
+    }
+
+    /// <summary>
+    /// Writes all pending enrollment stamps. Returns false if the write failed; the stamps are
+    /// re-queued for the next attempt.
+    /// </summary>
+    private async Task<bool> WriteEnrollmentsAsync(CancellationToken ct)
+    {
+        var enrollmentsUsed = new Dictionary<string, DateTimeOffset>(StringComparer.Ordinal);
+        foreach (var (id, usedAt) in _enrollmentsUsed)
+        {
+            if (_enrollmentsUsed.TryRemove(new KeyValuePair<string, DateTimeOffset>(id, usedAt)))
+                enrollmentsUsed[id] = usedAt;
+        }
+
+        if (enrollmentsUsed.Count == 0)
+            return true;
+
+        try
+        {
+            using var scope = _scopeFactory.CreateScope();
+            var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+
+            var enrollmentIds = enrollmentsUsed.Keys.ToList();
+            var enrollments = await db.MfaEnrollments
+                .Where(e => enrollmentIds.Contains(e.Id))
+                .ToListAsync(ct);
+            foreach (var enrollment in enrollments)
+                enrollment.LastUsedAt = enrollmentsUsed[enrollment.Id];
+
+            await db.SaveChangesAsync(ct);
+
+            _logger.LogDebug("Persisted {Enrollments} enrollment stamps", enrollmentsUsed.Count);
+            return true;
+        }
+        catch (Exception ex)
+        {
+            _logger.LogError(ex, "Failed to persist {Count} enrollment stamps, will retry", enrollmentsUsed.Count);
+
+            foreach (var (id, usedAt) in enrollmentsUsed)
+                _enrollmentsUsed.TryAdd(id, usedAt);
+            return false;
+        }
+    }
+
+    private static MfaChallenge Copy(MfaChallenge challenge) => new()
+    {
+        Id = challenge.Id,
+        UserId = challenge.UserId,
+        EnrollmentId = challenge.EnrollmentId,
+        Method = challenge.Method,
+        Status = challenge.Status,
+        SourceIp = challenge.SourceIp,
+        TargetResource = challenge.TargetResource,
+        IssuedAt = challenge.IssuedAt,
+        ExpiresAt = challenge.ExpiresAt,
+        RespondedAt = challenge.RespondedAt,
+        AttemptCount = challenge.AttemptCount,
+        MaxAttempts = challenge.MaxAttempts
+    };
+}
@@ -0,0 +1,114 @@
+using Google.Protobuf;
+using Google.Protobuf.WellKnownTypes;
+using Grpc.Net.Client;
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Protocol.Replication;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Sends <see cref="LocalChallengeStore"/> changes to the peer instances listed in
+/// <see cref="ChallengeStoreSettings.ReplicationPeers"/> so a challenge issued on one
+/// instance can be verified on another.
+///
+/// Replication is asynchronous and best effort: changes are batched and sent to every peer
+/// in parallel, and a batch a peer fails to accept is not retried. Challenges are short-lived,
+/// so a peer that was down simply does not know the challenges issued meanwhile. Batches are
+/// signed with <see cref="HaSettings.PeerSecret"/>; without it nothing is sent.
+/// </summary>
+public class ChallengeStoreReplicator : BackgroundService
+{
+    private const int BatchSize = 256;
+    private static readonly TimeSpan SendTimeout = TimeSpan.FromSeconds(5);
+
+    private readonly LocalChallengeStore _store;
+    private readonly ChallengeStoreSettings _settings;
+    private readonly LeaderElectionService _leaderElection;
+    private readonly PeerAuthenticator _authenticator;
+    private readonly ILogger<ChallengeStoreReplicator> _logger;
+
+    public ChallengeStoreReplicator(
+        LocalChallengeStore store,
+        IOptions<ChallengeStoreSettings> settings,
+        LeaderElectionService leaderElection,
+        PeerAuthenticator authenticator,
+        ILogger<ChallengeStoreReplicator> logger)
+    {
+        _store = store;
+        _settings = settings.Value;
+        _leaderElection = leaderElection;
+        _authenticator = authenticator;
+        _logger = logger;
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        var changes = _store.Changes;
+        if (changes == null || _settings.ReplicationPeers.Length == 0)
+        {
+            _logger.LogInformation("No challenge store replication peers configured, replication disabled");
+            return;
+        }
+
+        if (!_authenticator.IsConfigured)
+        {
+            _logger.LogError("ChallengeStore:ReplicationPeers is set but HA:PeerSecret is not; challenge store replication disabled");
+            return;
+        }
+
+        _logger.LogInformation("Replicating challenge store to {PeerCount} peers", _settings.ReplicationPeers.Length);
+
+        var peers = _settings.ReplicationPeers
+            .Select(url => (Url: url, Channel: GrpcChannel.ForAddress(url)))
+            .ToList();
+
+        try
+        {
+            while (await changes.WaitToReadAsync(stoppingToken))
+            {
+                var request = new ReplicateChallengesRequest { SenderInstanceId = _leaderElection.InstanceId };
+                while (request.Entries.Count < BatchSize && changes.TryRead(out var change))
+                    request.Entries.Add(ToEntry(change));
+                _authenticator.Sign(request);
+
+                await Task.WhenAll(peers.Select(peer => SendAsync(peer.Url, peer.Channel, request, stoppingToken)));
+            }
+        }
+        catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+        {
+            _logger.LogInformation("Challenge store replication stopping");
+        }
+        finally
+        {
+            foreach (var peer in peers)
+                peer.Channel.Dispose();
+        }
+    }
+
+    private async Task SendAsync(string url, GrpcChannel channel, ReplicateChallengesRequest request, CancellationToken ct)
+    {
+        try
+        {
+            var client = new ChallengeReplicationService.ChallengeReplicationServiceClient(channel);
+            await client.ReplicateAsync(request, deadline: DateTime.UtcNow.Add(SendTimeout), cancellationToken: ct);
+        }
+        catch (Exception ex) when (!ct.IsCancellationRequested)
+        {
+            _logger.LogWarning(ex, "Failed to replicate {Count} challenge store changes to {Peer}",
+                request.Entries.Count, url);
+        }
+    }
+
+    private static ChallengeStoreEntry ToEntry(ChallengeStoreChange change)
+    {
+        var entry = new ChallengeStoreEntry { Key = change.Key, Removed = change.Removed };
+        if (!change.Removed)
+        {
+            entry.Value = UnsafeByteOperations.UnsafeWrap(change.Json!);
+            entry.ExpiresAt = Timestamp.FromDateTimeOffset(change.ExpiresAt);
+        }
+        return entry;
+    }
+}
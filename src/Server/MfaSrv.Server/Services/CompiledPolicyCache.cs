@@ -0,0 +1,50 @@
+using Microsoft.EntityFrameworkCore;
+using MfaSrv.Core.Policies;
+using MfaSrv.Server.Data;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Caches the <see cref="CompiledPolicySet"/> of the enabled policies so that
+/// <see cref="PolicyEngine"/> does not load and compile every policy on each evaluation.
+///
+/// The set is keyed by <see cref="PolicySyncStreamService.Version"/>, which every policy write
+/// on this instance advances before it returns, so local changes apply to the next evaluation.
+/// <see cref="Ttl"/> only bounds staleness for changes made on another server instance.
+/// </summary>
+public class CompiledPolicyCache
+{
+    public static readonly TimeSpan Ttl = TimeSpan.FromSeconds(5);
+
+    private readonly PolicySyncStreamService _policySync;
+    private volatile CachedSet? _current;
+
+    public CompiledPolicyCache(PolicySyncStreamService policySync)
+    {
+        _policySync = policySync;
+    }
+
+    public async Task<CompiledPolicySet> GetAsync(MfaSrvDbContext db, CancellationToken ct = default)
+    {
+        // Read before loading: a write that lands during the load advances the version past it
+        var version = _policySync.Version;
+        var now = DateTimeOffset.UtcNow;
+
+        var current = _current;
+        if (current != null && current.Version == version && current.LoadedAt + Ttl > now)
+            return current.Policies;
+
+        var policies = await db.Policies
+            .Where(p => p.IsEnabled)
+            .Include(p => p.RuleGroups).ThenInclude(g => g.Rules)
+            .Include(p => p.Actions)
+            .AsNoTracking()
+            .ToListAsync(ct);
+
+        var compiled = CompiledPolicySet.Compile(policies);
+        _current = new CachedSet(compiled, version, now);
+        return compiled;
+    }
+
+    private sealed record CachedSet(CompiledPolicySet Policies, ulong Version, DateTimeOffset LoadedAt);
+}
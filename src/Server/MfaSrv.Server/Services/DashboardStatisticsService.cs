@@ -0,0 +1,357 @@
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.Logging;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server.Data;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// In-memory statistics behind the admin dashboard, so a dashboard load does not query the database.
+///
+/// Audit event counts are kept in a sliding 24-hour window of one-minute buckets (a ring of 1440
+/// slots with running totals) fed by <see cref="AuditLogService"/>. Active sessions are counted
+/// by expiry minute, fed by <see cref="SessionManager"/> on create and revoke; expired minutes
+/// drop out as time passes. Both are rebuilt from the database once at startup. Events that
+/// happened before this service was constructed come from that rebuild, and later events come
+/// from the hooks, so nothing is counted twice.
+///
+/// User, agent, policy and enrollment counts change through many writers (LDAP sync, the portal,
+/// agent heartbeats) and change slowly, so they are recounted on a background timer.
+///
+/// Counts are per server instance: with several active instances each one only sees the
+/// audit events and sessions it handled itself since startup.
+/// </summary>
+public class DashboardStatisticsService : BackgroundService
+{
+    public const int WindowMinutes = 24 * 60;
+    private const int RecentEventCount = 10;
+    private static readonly int EventTypeCount = Enum.GetValues<AuditEventType>().Length;
+    private static readonly TimeSpan EntityRefreshInterval = TimeSpan.FromMinutes(1);
+
+    private readonly IServiceScopeFactory _scopeFactory;
+    private readonly SetupService _setupService;
+    private readonly ILogger<DashboardStatisticsService> _logger;
+    private readonly DateTimeOffset _startedAt;
+
+    private readonly object _lock = new();
+
+    // Audit window: slot (minute % WindowMinutes) holds counts for that minute of the last
+    // WindowMinutes ending at _currentMinute; Advance clears a slot before it is reused
+    private readonly int[] _slotCounts;
+    private readonly long[] _windowTotals;
+    private long _currentMinute;
+
+    // Active sessions by expiry minute
+    private readonly SortedDictionary<long, int> _sessionExpiries = new();
+    private int _activeSessions;
+
+    private readonly LinkedList<AuditLogEntry> _recentEvents = new();
+    private EntityCounts _entities = new(0, 0, 0, 0, 0, 0, new Dictionary<MfaMethod, int>());
+
+    public DashboardStatisticsService(
+        IServiceScopeFactory scopeFactory,
+        SetupService setupService,
+        ILogger<DashboardStatisticsService> logger)
+    {
+        _scopeFactory = scopeFactory;
+        _setupService = setupService;
+        _logger = logger;
+        _startedAt = DateTimeOffset.UtcNow;
+        _slotCounts = new int[WindowMinutes * EventTypeCount * 2];
+        _windowTotals = new long[EventTypeCount * 2];
+
+        _currentMinute = MinuteOf(_startedAt);
+    }
+
+    /// <summary>
+    /// True once the startup rebuild from the database has completed.
+    /// </summary>
+    public bool IsInitialized { get; private set; }
+
+    private static long MinuteOf(DateTimeOffset timestamp) => timestamp.ToUnixTimeSeconds() / 60;
+
+    private static int Index(AuditEventType eventType, bool success) => (int)eventType * 2 + (success ? 1 : 0);
+
+    /// <summary>
+    /// Counts one audit event. Events outside the 24-hour window are ignored.
+    /// </summary>
+    public void RecordAuditEvent(AuditLogEntry entry)
+    {
+        lock (_lock)
+        {
+            AddToWindow(entry.EventType, entry.Success, MinuteOf(entry.Timestamp), 1);
+
+            _recentEvents.AddFirst(entry);
+            if (_recentEvents.Count > RecentEventCount)
+                _recentEvents.RemoveLast();
+        }
+    }
+
+    public void SessionCreated(DateTimeOffset expiresAt) => AdjustSessions(expiresAt, 1);
+
+    /// <summary>
+    /// Removes a revoked session. Sessions that have already expired are ignored; they
+    /// dropped out of the count when their expiry minute passed.
+    /// </summary>
+    public void SessionEnded(DateTimeOffset expiresAt) => AdjustSessions(expiresAt, -1);
+
+    /// <summary>
+    /// Current statistics. Cost does not depend on traffic or table sizes.
+    /// </summary>
+    public DashboardStatistics GetSnapshot() => GetSnapshot(DateTimeOffset.UtcNow);
+
+    public DashboardStatistics GetSnapshot(DateTimeOffset now)
+    {
+        var events = new Dictionary<(AuditEventType EventType, bool Success), long>();
+        int activeSessions;
+        List<AuditLogEntry> recent;
+
+        lock (_lock)
+        {
+            Advance(MinuteOf(now));
+            ExpireSessions(MinuteOf(now));
+
+            for (var i = 0; i < _windowTotals.Length; i++)
+            {
+                if (_windowTotals[i] != 0)
+                    events[((AuditEventType)(i / 2), i % 2 == 1)] = _windowTotals[i];
+            }
+            activeSessions = _activeSessions;
+            recent = _recentEvents.ToList();
+        }
+
+        return new DashboardStatistics(_entities, activeSessions, events, recent, now);
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        if (_setupService.IsSetupRequired())
+        {
+            _logger.LogInformation("Dashboard statistics paused - awaiting initial setup");
+            return;
+        }
+
+        while (!stoppingToken.IsCancellationRequested)
+        {
+            try
+            {
+                if (!IsInitialized)
+                    await InitializeAsync(stoppingToken);
+                else
+                    await RefreshEntityCountsAsync(stoppingToken);
+            }
+            catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+            {
+                break;
+            }
+            catch (Exception ex)
+            {
+                _logger.LogError(ex, "Error refreshing dashboard statistics");
+            }
+
+            await Task.Delay(EntityRefreshInterval, stoppingToken);
+        }
+    }
+
+    /// <summary>
+    /// Rebuilds the audit window, active session count, recent events and entity counts from
+    /// the database. Only data from before this service was constructed is loaded; anything
+    /// newer reaches the service through the event hooks.
+    /// </summary>
+    public async Task InitializeAsync(CancellationToken ct = default)
+    {
+        using var scope = _scopeFactory.CreateScope();
+        var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+        var store = scope.ServiceProvider.GetRequiredService<AuditStore>();
+        var cutoff = _startedAt;
+        var windowStart = cutoff.AddMinutes(-WindowMinutes);
+
+        // Sealed hours are loaded at hour granularity (credited to the hour's first minute inside
+        // the window); the current, unsealed hour is read minute by minute from the raw log.
+        var currentHourStart = AuditStore.StartOf(AuditStore.HourOf(cutoff));
+        var hourly = await store.GetHourlySeriesAsync(windowStart, currentHourStart.AddTicks(-1), ct);
+        var tail = await db.AuditLog
+            .AsNoTracking()
+            .Where(e => e.Timestamp >= currentHourStart && e.Timestamp < cutoff)
+            .Select(e => new { e.EventType, e.Success, e.Timestamp })
+            .ToListAsync(ct);
+
+        var sessionExpiries = await db.MfaSessions
+            .AsNoTracking()
+            .Where(s => s.Status == SessionStatus.Active && s.ExpiresAt > cutoff && s.CreatedAt < cutoff)
+            .Select(s => s.ExpiresAt)
+            .ToListAsync(ct);
+
+        var recent = await db.AuditLog
+            .AsNoTracking()
+            .Where(e => e.Timestamp < cutoff)
+            .OrderByDescending(e => e.Timestamp)
+            .Take(RecentEventCount)
+            .ToListAsync(ct);
+
+        var entities = await CountEntitiesAsync(db, ct);
+
+        lock (_lock)
+        {
+            var firstMinute = MinuteOf(windowStart) + 1;
+            foreach (var rollup in hourly)
+            {
+                var minute = Math.Max(MinuteOf(AuditStore.StartOf(rollup.Hour)), firstMinute);
+                AddToWindow(rollup.EventType, rollup.Success, minute, (int)rollup.Count);
+            }
+            foreach (var e in tail)
+                AddToWindow(e.EventType, e.Success, MinuteOf(e.Timestamp), 1);
+
+            foreach (var expiresAt in sessionExpiries)
+                AdjustSessionsLocked(expiresAt, 1, _currentMinute);
+
+            // Hooked events are newer than anything loaded here
+            foreach (var entry in recent)
+            {
+                if (_recentEvents.Count >= RecentEventCount)
+                    break;
+                _recentEvents.AddLast(entry);
+            }
+        }
+
+        _entities = entities;
+        IsInitialized = true;
+
+        _logger.LogInformation(
+            "Dashboard statistics initialized: {Sessions} active sessions, {Events} audit events in the last 24 hours",
+            sessionExpiries.Count, hourly.Sum(r => r.Count) + tail.Count);
+    }
+
+    /// <summary>
+    /// Recounts users, agents, policies and enrollments.
+    /// </summary>
+    public async Task RefreshEntityCountsAsync(CancellationToken ct = default)
+    {
+        using var scope = _scopeFactory.CreateScope();
+        var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+        _entities = await CountEntitiesAsync(db, ct);
+    }
+
+    private static async Task<EntityCounts> CountEntitiesAsync(MfaSrvDbContext db, CancellationToken ct)
+    {
+        var totalUsers = await db.Users.CountAsync(ct);
+        var mfaEnabledUsers = await db.Users.CountAsync(u => u.MfaEnabled, ct);
+        var onlineAgents = await db.AgentRegistrations.CountAsync(a => a.Status == AgentStatus.Online, ct);
+        var totalAgents = await db.AgentRegistrations.CountAsync(ct);
+        var activePolicies = await db.Policies.CountAsync(p => p.IsEnabled, ct);
+        var totalPolicies = await db.Policies.CountAsync(ct);
+        var enrollmentsByMethod = await db.MfaEnrollments
+            .Where(e => e.Status == EnrollmentStatus.Active)
+            .GroupBy(e => e.Method)
+            .Select(g => new { g.Key, Count = g.Count() })
+            .ToDictionaryAsync(x => x.Key, x => x.Count, ct);
+
+        return new EntityCounts(totalUsers, mfaEnabledUsers, onlineAgents, totalAgents,
+            activePolicies, totalPolicies, enrollmentsByMethod);
+    }
+
+    private void AdjustSessions(DateTimeOffset expiresAt, int delta)
+    {
+        lock (_lock)
+        {
+            AdjustSessionsLocked(expiresAt, delta, Math.Max(MinuteOf(DateTimeOffset.UtcNow), _currentMinute));
+        }
+    }
+
+    private void AdjustSessionsLocked(DateTimeOffset expiresAt, int delta, long nowMinute)
+    {
+        ExpireSessions(nowMinute);
+
+        // A session stays counted through the minute it expires in
+        var minute = MinuteOf(expiresAt);
+        if (minute < nowMinute)
+            return;
+
+        var count = _sessionExpiries.GetValueOrDefault(minute) + delta;
+        if (count == 0)
+            _sessionExpiries.Remove(minute);
+        else
+            _sessionExpiries[minute] = count;
+        _activeSessions += delta;
+    }
+
+    private void ExpireSessions(long nowMinute)
+    {
+        while (_sessionExpiries.Count > 0)
+        {
+            var first = _sessionExpiries.First();
+            if (first.Key >= nowMinute)
+                break;
+            _activeSessions -= first.Value;
+            _sessionExpiries.Remove(first.Key);
+        }
+    }
+
+    private void AddToWindow(AuditEventType eventType, bool success, long minute, int count)
+    {
+        Advance(MinuteOf(DateTimeOffset.UtcNow));
+
+        // Clock skew between writers: future events count in the current minute
+        if (minute > _currentMinute)
+            minute = _currentMinute;
+        if (minute <= _currentMinute - WindowMinutes)
+            return;
+
+        var slot = (int)(minute % WindowMinutes);
+        var index = Index(eventType, success);
+        _slotCounts[slot * _windowTotals.Length + index] += count;
+        _windowTotals[index] += count;
+    }
+
+    /// <summary>
+    /// Moves the window forward to <paramref name="minute"/>, clearing the slots that fall out of it.
+    /// Amortized O(1): each slot is cleared once per minute of elapsed time.
+    /// </summary>
+    private void Advance(long minute)
+    {
+        if (minute <= _currentMinute)
+            return;
+
+        for (var m = Math.Max(_currentMinute + 1, minute - WindowMinutes + 1); m <= minute; m++)
+        {
+            var slot = (int)(m % WindowMinutes);
+            var offset = slot * _windowTotals.Length;
+            for (var i = 0; i < _windowTotals.Length; i++)
+            {
+                _windowTotals[i] -= _slotCounts[offset + i];
+                _slotCounts[offset + i] = 0;
+            }
+        }
+
+        _currentMinute = minute;
+    }
+}
+
+/// <summary>
+/// Point-in-time dashboard figures from <see cref="DashboardStatisticsService"/>.
+/// </summary>
+public record DashboardStatistics(
+    EntityCounts Entities,
+    int ActiveSessions,
+    IReadOnlyDictionary<(AuditEventType EventType, bool Success), long> Last24Hours,
+    IReadOnlyList<AuditLogEntry> RecentEvents,
+    DateTimeOffset AsOf)
+{
+    public long Count(AuditEventType eventType) =>
+        Last24Hours.GetValueOrDefault((eventType, true)) + Last24Hours.GetValueOrDefault((eventType, false));
+
+    public long Count(AuditEventType eventType, bool success) =>
+        Last24Hours.GetValueOrDefault((eventType, success));
+}
+
+public record EntityCounts(
+    int TotalUsers,
+    int MfaEnabledUsers,
+    int OnlineAgents,
+    int TotalAgents,
+    int ActivePolicies,
+    int TotalPolicies,
+    IReadOnlyDictionary<MfaMethod, int> EnrollmentsByMethod);
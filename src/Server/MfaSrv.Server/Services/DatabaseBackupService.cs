@@ -1,3 +1,4 @@
+using System.Diagnostics;
 using Microsoft.Data.Sqlite;
 using Microsoft.Extensions.Hosting;
 using Microsoft.Extensions.Logging;
@@ -7,27 +8,44 @@ namespace MfaSrv.Server.Services;
 
 /// <summary>
 /// Background service that performs periodic SQLite database backups.
-/// Uses VACUUM INTO for hot backups that do not require exclusive locks on the source database.
+///
+/// Backups use the SQLite online backup API in steps of <see cref="BackupSettings.PagesPerStep"/>
+/// pages, pausing between steps for at least <see cref="BackupSettings.StepDelayMs"/> and as long
+/// as needed to stay within <see cref="BackupSettings.MaxBytesPerSecond"/>. In WAL mode the copy
+/// reads one snapshot held open for the whole backup, which never blocks writers. In rollback
+/// journal mode the source is read-locked only while a step runs, and a write between steps
+/// restarts the copy; after <see cref="MaxRestarts"/> restarts the rest is copied in one step.
+///
 /// Manages backup rotation by deleting the oldest files when the retention count is exceeded.
+/// Scheduled backups run on the HA leader only.
 /// </summary>
 public class DatabaseBackupService : BackgroundService
 {
+    /// <summary>
+    /// Copy restarts tolerated in rollback journal mode before the remaining pages are copied
+    /// in a single step.
+    /// </summary>
+    public const int MaxRestarts = 3;
+
     private readonly IConfiguration _configuration;
     private readonly IOptionsMonitor<BackupSettings> _settingsMonitor;
     private readonly ILogger<DatabaseBackupService> _logger;
     private readonly SetupService _setupService;
+    private readonly LeaderElectionService _leaderElection;
     private readonly SemaphoreSlim _backupLock = new(1, 1);
 
     public DatabaseBackupService(
         IConfiguration configuration,
         IOptionsMonitor<BackupSettings> settingsMonitor,
         ILogger<DatabaseBackupService> logger,
-        SetupService setupService)
+        SetupService setupService,
+        LeaderElectionService leaderElection)
     {
         _configuration = configuration;
         _settingsMonitor = settingsMonitor;
         _logger = logger;
         _setupService = setupService;
+        _leaderElection = leaderElection;
     }
 
     protected override async Task ExecuteAsync(CancellationToken stoppingToken)
@@ -57,7 +75,8 @@ public class DatabaseBackupService : BackgroundService
         {
             try
             {
-                await PerformBackupAsync(stoppingToken);
+                if (_leaderElection.IsLeader)
+                    await PerformBackupAsync(stoppingToken);
             }
             catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
             {
@@ -78,12 +97,14 @@ public class DatabaseBackupService : BackgroundService
     }
 
     /// <summary>
-    /// Performs a single backup cycle: creates the backup directory if needed,
-    /// runs VACUUM INTO to produce a consistent snapshot, then rotates old backups.
+    /// Performs a single backup cycle: creates the backup directory if needed, copies the
+    /// database page by page into a temporary file, renames it into place, then rotates old
+    /// backups.
     /// </summary>
     public async Task<string> PerformBackupAsync(CancellationToken cancellationToken = default)
     {
         await _backupLock.WaitAsync(cancellationToken);
+        string? partialPath = null;
         try
         {
             var settings = _settingsMonitor.CurrentValue;
@@ -93,26 +114,38 @@ public class DatabaseBackupService : BackgroundService
             var timestamp = DateTime.UtcNow.ToString("yyyyMMdd_HHmmss");
             var backupFileName = $"mfasrv_backup_{timestamp}.db";
             var backupPath = Path.Combine(backupDir, backupFileName);
+            partialPath = backupPath + ".partial";
 
             _logger.LogInformation("Starting database backup to {BackupPath}", backupPath);
+            var stopwatch = Stopwatch.StartNew();
 
             var connectionString = _configuration.GetConnectionString("DefaultConnection")
                                    ?? "Data Source=mfasrv.db";
 
-            await using var sourceConnection = new SqliteConnection(connectionString);
-            await sourceConnection.OpenAsync(cancellationToken);
+            await using (var sourceConnection = new SqliteConnection(connectionString))
+            await using (var destinationConnection = new SqliteConnection($"Data Source={partialPath};Pooling=False"))
+            {
+                await sourceConnection.OpenAsync(cancellationToken);
+                await destinationConnection.OpenAsync(cancellationToken);
+
+                await CopyPagesAsync(sourceConnection, destinationConnection, settings, cancellationToken);
+
+                // A copy of a WAL database is itself in WAL mode; make the backup a single file
+                await using var command = destinationConnection.CreateCommand();
+                command.CommandText = "PRAGMA journal_mode=DELETE";
+                await command.ExecuteNonQueryAsync(cancellationToken);
+            }
+
+            File.Move(partialPath, backupPath, overwrite: true);
+            partialPath = null;
 
-            // VACUUM INTO creates a fully self-contained copy of the database without
-            // holding a write lock on the source. It is safe to call on a live database.
-            await using var command = sourceConnection.CreateCommand();
-            command.CommandText = "VACUUM INTO @backupPath";
-            command.Parameters.AddWithValue("@backupPath", backupPath);
-            await command.ExecuteNonQueryAsync(cancellationToken);
+            MetricsService.DbBackupsTotal.WithLabels("success").Inc();
+            MetricsService.DbBackupDuration.Observe(stopwatch.Elapsed.TotalSeconds);
 
             var fileInfo = new FileInfo(backupPath);
             _logger.LogInformation(
-                "Database backup completed successfully: {BackupFile} ({SizeKB} KB)",
-                backupFileName, fileInfo.Length / 1024);
+                "Database backup completed successfully: {BackupFile} ({SizeKB} KB in {ElapsedMs} ms)",
+                backupFileName, fileInfo.Length / 1024, stopwatch.ElapsedMilliseconds);
 
             RotateBackups(backupDir, settings.RetentionCount);
 
@@ -124,15 +157,148 @@ public class DatabaseBackupService : BackgroundService
         }
         catch (Exception ex)
         {
+            MetricsService.DbBackupsTotal.WithLabels("failure").Inc();
             _logger.LogError(ex, "Database backup failed");
             throw;
         }
         finally
         {
+            if (partialPath != null)
+                TryDelete(partialPath);
             _backupLock.Release();
         }
     }
 
+    /// <summary>
+    /// Copies all pages of <paramref name="source"/> into <paramref name="destination"/> with the
+    /// SQLite online backup API, one step at a time.
+    /// </summary>
+    private async Task CopyPagesAsync(
+        SqliteConnection source,
+        SqliteConnection destination,
+        BackupSettings settings,
+        CancellationToken ct)
+    {
+        await using var pragma = source.CreateCommand();
+        pragma.CommandText = "PRAGMA journal_mode";
+        var wal = string.Equals(await pragma.ExecuteScalarAsync(ct) as string, "wal", StringComparison.OrdinalIgnoreCase);
+        pragma.CommandText = "PRAGMA page_size";
+        var pageSize = Convert.ToInt64(await pragma.ExecuteScalarAsync(ct));
+
+        SqliteTransaction? snapshot = null;
+        if (wal)
+        {
+            // Pin one WAL snapshot for the whole copy: readers do not block writers in WAL mode,
+            // and the copy never restarts because its snapshot never changes
+            snapshot = source.BeginTransaction(deferred: true);
+            await using var read = source.CreateCommand();
+            read.Transaction = snapshot;
+            read.CommandText = "SELECT count(*) FROM sqlite_master";
+            await read.ExecuteScalarAsync(ct);
+        }
+
+        var backup = SQLitePCL.raw.sqlite3_backup_init(destination.Handle, "main", source.Handle, "main");
+        if (backup == null)
+        {
+            snapshot?.Dispose();
+            var errorMsg = SQLitePCL.raw.sqlite3_errmsg(destination.Handle).utf8_to_string();
+            throw new InvalidOperationException($"Failed to initialize SQLite backup: {errorMsg}");
+        }
+
+        try
+        {
+            var pagesPerStep = Math.Max(1, settings.PagesPerStep);
+            var restarts = 0;
+            var lastRemaining = int.MaxValue;
+
+            while (true)
+            {
+                var pages = restarts > MaxRestarts ? -1 : pagesPerStep;
+                var step = Stopwatch.StartNew();
+                var rc = SQLitePCL.raw.sqlite3_backup_step(backup, pages);
+                step.Stop();
+
+                // Without WAL the step holds a shared lock, so a writer waits for at most the step;
+                // with WAL writers never wait on it, and there is nothing to record
+                if (!wal)
+                    MetricsService.DbBackupWriterStall.Observe(step.Elapsed.TotalSeconds);
+
+                if (rc == SQLitePCL.raw.SQLITE_DONE)
+                    break;
+
+                if (rc == SQLitePCL.raw.SQLITE_BUSY || rc == SQLitePCL.raw.SQLITE_LOCKED)
+                {
+                    // A writer holds the database; let it finish and try the step again
+                    MetricsService.DbBackupBusyRetriesTotal.Inc();
+                    await Task.Delay(StepPause(0, TimeSpan.Zero, settings), ct);
+                    continue;
+                }
+
+                if (rc != SQLitePCL.raw.SQLITE_OK)
+                {
+                    var errorMsg = SQLitePCL.raw.sqlite3_errmsg(destination.Handle).utf8_to_string();
+                    throw new InvalidOperationException($"SQLite backup step failed with code {rc}: {errorMsg}");
+                }
+
+                // The remaining count only goes up when a write by another connection made the
+                // copy start over
+                var remaining = SQLitePCL.raw.sqlite3_backup_remaining(backup);
+                if (remaining >= lastRemaining)
+                {
+                    restarts++;
+                    MetricsService.DbBackupRestartsTotal.Inc();
+                    if (restarts > MaxRestarts)
+                    {
+                        _logger.LogWarning(
+                            "Database backup restarted {Restarts} times by concurrent writes; copying the remaining " +
+                            "{Pages} pages in one step. Enable Backup:UseWalJournal to avoid this", restarts, remaining);
+                    }
+                }
+                lastRemaining = remaining;
+
+                await Task.Delay(StepPause(pagesPerStep * pageSize, step.Elapsed, settings), ct);
+            }
+
+            MetricsService.DbSizeBytes.Set(SQLitePCL.raw.sqlite3_backup_pagecount(backup) * (double)pageSize);
+        }
+        finally
+        {
+            SQLitePCL.raw.sqlite3_backup_finish(backup);
+            snapshot?.Dispose();
+        }
+    }
+
+    /// <summary>
+    /// Pause after a backup step that read <paramref name="bytes"/> in <paramref name="elapsed"/>:
+    /// at least <see cref="BackupSettings.StepDelayMs"/>, and long enough to keep the average
+    /// read rate within <see cref="BackupSettings.MaxBytesPerSecond"/>.
+    /// </summary>
+    public static TimeSpan StepPause(long bytes, TimeSpan elapsed, BackupSettings settings)
+    {
+        var pause = TimeSpan.FromMilliseconds(Math.Max(0, settings.StepDelayMs));
+
+        if (settings.MaxBytesPerSecond > 0)
+        {
+            var budgeted = TimeSpan.FromSeconds((double)bytes / settings.MaxBytesPerSecond) - elapsed;
+            if (budgeted > pause)
+                pause = budgeted;
+        }
+
+        return pause;
+    }
+
+    private void TryDelete(string path)
+    {
+        try
+        {
+            File.Delete(path);
+        }
+        catch (Exception ex)
+        {
+            _logger.LogWarning(ex, "Failed to delete incomplete backup file: {FileName}", Path.GetFileName(path));
+        }
+    }
+
     /// <summary>
     /// Deletes the oldest backup files when the total count exceeds the retention limit.
     /// Only files matching the expected backup naming pattern are considered.
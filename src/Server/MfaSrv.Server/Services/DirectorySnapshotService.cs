@@ -0,0 +1,160 @@
+using System.Security.Cryptography;
+using Google.Protobuf;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Logging;
+using MfaSrv.Core.Policies;
+using MfaSrv.Protocol;
+using MfaSrv.Server.Data;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Builds the user directory that DC Agents in local evaluation mode evaluate policies
+/// against: each user's sAMAccountName, group names and OU, the same inputs the server
+/// evaluates with. Group and OU names are interned into tables that users refer to by index,
+/// so even a large directory is a few megabytes.
+///
+/// The snapshot is split into chunks of <see cref="UsersPerChunk"/> users to stay well below
+/// the gRPC message size limit, and built once per directory change for all agents. Its
+/// version is a hash of the content: it is the same on every HA instance and across restarts,
+/// so an agent that already holds it is not sent it again.
+/// </summary>
+public class DirectorySnapshotService
+{
+    public const int UsersPerChunk = 5000;
+
+    private readonly PolicySyncStreamService _policySyncStream;
+    private readonly ILogger<DirectorySnapshotService> _logger;
+    private readonly SemaphoreSlim _buildGate = new(1, 1);
+    private volatile IReadOnlyList<PolicyUpdate>? _snapshot;
+
+    public DirectorySnapshotService(PolicySyncStreamService policySyncStream, ILogger<DirectorySnapshotService> logger)
+    {
+        _policySyncStream = policySyncStream;
+        _logger = logger;
+    }
+
+    /// <summary>
+    /// Returns the current snapshot chunks, building them on first use.
+    /// </summary>
+    public async Task<IReadOnlyList<PolicyUpdate>> GetSnapshotAsync(MfaSrvDbContext db, CancellationToken ct = default)
+    {
+        var snapshot = _snapshot;
+        if (snapshot != null)
+            return snapshot;
+
+        await _buildGate.WaitAsync(ct);
+        try
+        {
+            return _snapshot ??= await BuildAsync(db, ct);
+        }
+        finally
+        {
+            _buildGate.Release();
+        }
+    }
+
+    /// <summary>
+    /// Rebuilds the snapshot after a directory sync and, if it changed, broadcasts it to the
+    /// connected agents.
+    /// </summary>
+    public async Task PublishAsync(MfaSrvDbContext db, CancellationToken ct = default)
+    {
+        await _buildGate.WaitAsync(ct);
+        try
+        {
+            var snapshot = await BuildAsync(db, ct);
+            if (_snapshot != null && _snapshot[0].Directory.Version == snapshot[0].Directory.Version)
+                return;
+
+            _snapshot = snapshot;
+
+            // Broadcast inside the gate so chunk sequences of two publishes never interleave
+            _policySyncStream.NotifyDirectoryChange(snapshot);
+
+            _logger.LogInformation(
+                "Published directory snapshot {Version} ({Chunks} chunks) to {Agents} agents",
+                snapshot[0].Directory.Version, snapshot.Count, _policySyncStream.SubscriberCount);
+        }
+        finally
+        {
+            _buildGate.Release();
+        }
+    }
+
+    /// <summary>
+    /// Reads users and group memberships and encodes them as directory chunks.
+    /// </summary>
+    public static async Task<IReadOnlyList<PolicyUpdate>> BuildAsync(MfaSrvDbContext db, CancellationToken ct = default)
+    {
+        var users = await db.Users
+            .AsNoTracking()
+            .Select(u => new { u.Id, u.SamAccountName, u.DistinguishedName })
+            .ToListAsync(ct);
+
+        var groupsByUser = (await db.UserGroupMemberships
+                .AsNoTracking()
+                .Select(m => new { m.UserId, m.GroupName })
+                .ToListAsync(ct))
+            .ToLookup(m => m.UserId, m => m.GroupName);
+
+        var groups = new Dictionary<string, int>(StringComparer.Ordinal);
+        var ous = new Dictionary<string, int>(StringComparer.Ordinal);
+        var entries = new List<DirectoryUser>(users.Count);
+        var seen = new HashSet<string>(StringComparer.Ordinal);
+
+        // Sorted so that the same directory always encodes, and hashes, the same way
+        foreach (var user in users
+                     .OrderBy(u => u.SamAccountName, StringComparer.Ordinal)
+                     .ThenBy(u => u.Id, StringComparer.Ordinal))
+        {
+            if (user.SamAccountName.Length == 0 || !seen.Add(user.SamAccountName))
+                continue;
+
+            var entry = new DirectoryUser { UserName = user.SamAccountName };
+
+            var ou = DirectoryNames.ParentContainer(user.DistinguishedName);
+            if (ou != null)
+                entry.Ou = Intern(ous, ou) + 1;
+
+            foreach (var group in groupsByUser[user.Id].Distinct(StringComparer.Ordinal).Order(StringComparer.Ordinal))
+                entry.Groups.Add(Intern(groups, group));
+
+            entries.Add(entry);
+        }
+
+        var count = Math.Max(1, (entries.Count + UsersPerChunk - 1) / UsersPerChunk);
+        var chunks = new List<PolicyUpdate>(count);
+        for (var index = 0; index < count; index++)
+        {
+            var chunk = new DirectoryChunk { Index = index, Count = count };
+            if (index == 0)
+            {
+                chunk.Groups.AddRange(groups.Keys);
+                chunk.Ous.AddRange(ous.Keys);
+            }
+            chunk.Users.AddRange(entries.Skip(index * UsersPerChunk).Take(UsersPerChunk));
+            chunks.Add(new PolicyUpdate { Directory = chunk });
+        }
+
+        using var hash = IncrementalHash.CreateHash(HashAlgorithmName.SHA256);
+        foreach (var chunk in chunks)
+            hash.AppendData(chunk.Directory.ToByteArray());
+
+        var version = Convert.ToHexString(hash.GetHashAndReset(), 0, 8).ToLowerInvariant();
+        foreach (var chunk in chunks)
+            chunk.Directory.Version = version;
+
+        return chunks;
+    }
+
+    private static int Intern(Dictionary<string, int> table, string value)
+    {
+        if (!table.TryGetValue(value, out var index))
+        {
+            index = table.Count;
+            table.Add(value, index);
+        }
+        return index;
+    }
+}
@@ -0,0 +1,114 @@
+using System.Collections.Concurrent;
+using Microsoft.EntityFrameworkCore;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server.Data;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Caches each user's active MFA enrollments (ID, method and encrypted secret) so challenge
+/// issue and verify do not query <c>MfaEnrollments</c> on every call.
+///
+/// All of a user's active enrollments are loaded with one query and kept for
+/// <see cref="Ttl"/>. Every code path that changes an enrollment calls
+/// <see cref="Invalidate"/>; the TTL only bounds staleness for changes made on another
+/// server instance. A load that races with an invalidation is not cached.
+/// </summary>
+public class EnrollmentCache
+{
+    public static readonly TimeSpan Ttl = TimeSpan.FromSeconds(60);
+    private const int PurgeThreshold = 10_000;
+
+    private readonly ConcurrentDictionary<string, UserEnrollments> _users = new(StringComparer.Ordinal);
+    private long _generation;
+
+    public int Count => _users.Count;
+
+    /// <summary>
+    /// Returns the user's active enrollment for <paramref name="method"/>, or null if there is none.
+    /// </summary>
+    public async Task<CachedEnrollment?> GetActiveAsync(
+        MfaSrvDbContext db, string userId, MfaMethod method, CancellationToken ct = default)
+    {
+        var enrollments = await GetUserAsync(db, userId, ct);
+        foreach (var enrollment in enrollments)
+        {
+            if (enrollment.Method == method)
+                return enrollment;
+        }
+        return null;
+    }
+
+    /// <summary>
+    /// Returns the enrollment with <paramref name="enrollmentId"/> if it belongs to
+    /// <paramref name="userId"/> and is still active.
+    /// </summary>
+    public async Task<CachedEnrollment?> GetByIdAsync(
+        MfaSrvDbContext db, string userId, string enrollmentId, CancellationToken ct = default)
+    {
+        var enrollments = await GetUserAsync(db, userId, ct);
+        foreach (var enrollment in enrollments)
+        {
+            if (enrollment.Id == enrollmentId)
+                return enrollment;
+        }
+        return null;
+    }
+
+    /// <summary>
+    /// Drops the cached enrollments of a user. Call after any enrollment of the user is added,
+    /// activated, revoked or removed.
+    /// </summary>
+    public void Invalidate(string userId)
+    {
+        Interlocked.Increment(ref _generation);
+        _users.TryRemove(userId, out _);
+    }
+
+    private async Task<IReadOnlyList<CachedEnrollment>> GetUserAsync(
+        MfaSrvDbContext db, string userId, CancellationToken ct)
+    {
+        var now = DateTimeOffset.UtcNow;
+        if (_users.TryGetValue(userId, out var cached) && cached.LoadedAt + Ttl > now)
+            return cached.Enrollments;
+
+        var generation = Interlocked.Read(ref _generation);
+
+        var enrollments = await db.MfaEnrollments
+            .AsNoTracking()
+            .Where(e => e.UserId == userId && e.Status == EnrollmentStatus.Active)
+            .Select(e => new CachedEnrollment(e.Id, e.UserId, e.Method, e.EncryptedSecret, e.SecretNonce))
+            .ToListAsync(ct);
+
+        // An invalidation during the query may mean the result is already out of date
+        if (Interlocked.Read(ref _generation) == generation)
+        {
+            if (_users.Count >= PurgeThreshold)
+                PurgeExpired(now);
+            _users[userId] = new UserEnrollments(enrollments, now);
+        }
+
+        return enrollments;
+    }
+
+    private void PurgeExpired(DateTimeOffset now)
+    {
+        foreach (var (userId, entry) in _users)
+        {
+            if (entry.LoadedAt + Ttl <= now)
+                _users.TryRemove(new KeyValuePair<string, UserEnrollments>(userId, entry));
+        }
+    }
+
+    private sealed record UserEnrollments(IReadOnlyList<CachedEnrollment> Enrollments, DateTimeOffset LoadedAt);
+}
+
+/// <summary>
+/// The parts of an active <see cref="Core.Entities.MfaEnrollment"/> needed to issue and verify challenges.
+/// </summary>
+public sealed record CachedEnrollment(
+    string Id,
+    string UserId,
+    MfaMethod Method,
+    byte[] EncryptedSecret,
+    byte[] SecretNonce);
@@ -0,0 +1,82 @@
+using System.Threading.Channels;
+using Google.Protobuf.WellKnownTypes;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Enums;
+using MfaSrv.Protocol.Ha;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Queues the audit events of an evaluation node for <see cref="EvaluationReplicaSyncService"/>
+/// to forward to the leader, which stores them in the one audit log. Enqueueing never blocks an
+/// evaluation; once <see cref="QueueCapacity"/> events are waiting (the leader unreachable for
+/// a while), new ones are dropped and counted in <c>mfasrv_audit_events_dropped_total</c>.
+///
+/// Forwarding needs <see cref="HaSettings.PeerSecret"/>; without it <see cref="IsEnabled"/> is
+/// false and the node writes audit entries to its own database as before.
+/// </summary>
+public class EvaluationAuditForwarder
+{
+    public const int QueueCapacity = 10_000;
+    public const int MaxBatchSize = 500;
+
+    private readonly Channel<ForwardedAuditEvent> _channel = Channel.CreateBounded<ForwardedAuditEvent>(
+        new BoundedChannelOptions(QueueCapacity)
+        {
+            FullMode = BoundedChannelFullMode.Wait,
+            SingleReader = true,
+            SingleWriter = false
+        });
+
+    public EvaluationAuditForwarder(IOptions<HaSettings> settings, PeerAuthenticator authenticator)
+    {
+        IsEnabled = settings.Value.EvaluationNode && authenticator.IsConfigured;
+    }
+
+    /// <summary>
+    /// True on evaluation nodes that can sign requests to the leader.
+    /// </summary>
+    public bool IsEnabled { get; }
+
+    /// <summary>
+    /// Number of events waiting to be forwarded.
+    /// </summary>
+    public int QueueDepth => _channel.Reader.Count;
+
+    /// <summary>
+    /// Queues an event that happened at <paramref name="timestamp"/>. Returns false, counting
+    /// the drop, if the queue is full.
+    /// </summary>
+    public bool TryEnqueue(
+        AuditEventType eventType, string userId, string? sourceIp, string? targetResource, string? details,
+        DateTimeOffset timestamp)
+    {
+        var queued = _channel.Writer.TryWrite(new ForwardedAuditEvent
+        {
+            EventType = (int)eventType,
+            UserId = userId,
+            SourceIp = sourceIp ?? string.Empty,
+            TargetResource = targetResource ?? string.Empty,
+            Details = details ?? string.Empty,
+            Timestamp = Timestamp.FromDateTimeOffset(timestamp)
+        });
+
+        if (!queued)
+            MetricsService.AuditEventsDroppedTotal.WithLabels("forward_queue_full").Inc();
+        return queued;
+    }
+
+    /// <summary>
+    /// Waits for at least one event and returns up to <see cref="MaxBatchSize"/> of them.
+    /// </summary>
+    public async Task<List<ForwardedAuditEvent>> ReadBatchAsync(CancellationToken ct)
+    {
+        var batch = new List<ForwardedAuditEvent>();
+        while (batch.Count == 0 && await _channel.Reader.WaitToReadAsync(ct))
+        {
+            while (batch.Count < MaxBatchSize && _channel.Reader.TryRead(out var auditEvent))
+                batch.Add(auditEvent);
+        }
+        return batch;
+    }
+}
@@ -0,0 +1,471 @@
+using System.Text.Json;
+using System.Text.Json.Serialization;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Collections;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Policies;
+using MfaSrv.Protocol;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// The state an evaluation node (<see cref="HaSettings.EvaluationNode"/>) answers
+/// <c>EvaluateAuthentication</c> from instead of the database: the compiled policy set, the user
+/// directory (groups and OU by sAMAccountName), the active sessions and the session revocation
+/// filter. <see cref="EvaluationReplicaSyncService"/> keeps it current from the leader's policy
+/// sync and session streams, with the same versioning rules DC Agents apply.
+///
+/// Evaluations read immutable snapshots (policies, directory) or take a short lock (sessions),
+/// so any number of them run in parallel with the stream updates.
+///
+/// The leader sends keepalives on both streams, so a node that has heard nothing on either for
+/// <see cref="MaxStaleness"/> has lost its upstream (or the upstream lost leadership) and stops
+/// answering until the streams are back, rather than evaluating against frozen state.
+/// </summary>
+public class EvaluationReplica
+{
+    private static readonly JsonSerializerOptions PolicyJsonOptions = new()
+    {
+        PropertyNameCaseInsensitive = true,
+        Converters = { new JsonStringEnumConverter() }
+    };
+
+    private readonly ILogger<EvaluationReplica> _logger;
+
+    private readonly object _policyLock = new();
+    private readonly Dictionary<string, Policy> _policies = new(StringComparer.Ordinal);
+    private volatile CompiledPolicySet? _compiled;
+    private string? _policyEpoch;
+    private ulong _policyVersion;
+
+    private readonly object _directoryLock = new();
+    private volatile ReplicatedDirectory? _directory;
+    private List<DirectoryChunk>? _pendingChunks;
+
+    private readonly object _sessionLock = new();
+    private SessionSet? _sessions;
+    private SessionSet? _pendingSessions;
+    private CuckooFilter? _revocationFilter;
+    private ulong _revocationFilterVersion;
+
+    // UTC ticks of the last message on each upstream stream
+    private long _policyContactTicks;
+    private long _sessionContactTicks;
+
+    public EvaluationReplica(IOptions<HaSettings> settings, ILogger<EvaluationReplica> logger)
+    {
+        IsEnabled = settings.Value.EvaluationNode;
+        MaxStaleness = TimeSpan.FromMilliseconds(Math.Max(1000, settings.Value.EvaluationMaxStalenessMs));
+        _logger = logger;
+    }
+
+    /// <summary>
+    /// True on evaluation nodes.
+    /// </summary>
+    public bool IsEnabled { get; }
+
+    /// <summary>
+    /// Longest either upstream stream may go without a message before the node stops answering.
+    /// </summary>
+    public TimeSpan MaxStaleness { get; }
+
+    public bool IsReady => IsReadyAt(DateTimeOffset.UtcNow);
+
+    /// <summary>
+    /// True once policies, directory, sessions and revocation filter have all been received,
+    /// i.e. the node can answer as the leader would, and both streams have heard from the
+    /// leader within <see cref="MaxStaleness"/> of <paramref name="now"/>. A quick reconnect
+    /// keeps the node ready: the last received state is served until new snapshots replace it.
+    /// </summary>
+    public bool IsReadyAt(DateTimeOffset now)
+    {
+        var oldest = now.UtcTicks - MaxStaleness.Ticks;
+        if (Interlocked.Read(ref _policyContactTicks) < oldest || Interlocked.Read(ref _sessionContactTicks) < oldest)
+            return false;
+
+        if (_compiled == null || _directory == null)
+            return false;
+        lock (_sessionLock)
+            return _sessions != null && _revocationFilter != null;
+    }
+
+    /// <summary>
+    /// When the policy sync stream last received a message (update or keepalive);
+    /// <see cref="DateTimeOffset.MinValue"/> before the first.
+    /// </summary>
+    public DateTimeOffset PolicyStreamContact => new(Interlocked.Read(ref _policyContactTicks), TimeSpan.Zero);
+
+    /// <summary>
+    /// When the session stream last received a message (update or keepalive);
+    /// <see cref="DateTimeOffset.MinValue"/> before the first.
+    /// </summary>
+    public DateTimeOffset SessionStreamContact => new(Interlocked.Read(ref _sessionContactTicks), TimeSpan.Zero);
+
+    public void RecordPolicyStreamContact(DateTimeOffset now) =>
+        Interlocked.Exchange(ref _policyContactTicks, now.UtcTicks);
+
+    public void RecordSessionStreamContact(DateTimeOffset now) =>
+        Interlocked.Exchange(ref _sessionContactTicks, now.UtcTicks);
+
+    // ─── Policies ───────────────────────────────────────────────────────
+
+    public string? PolicyEpoch
+    {
+        get { lock (_policyLock) return _policyEpoch; }
+    }
+
+    public ulong PolicyVersion
+    {
+        get { lock (_policyLock) return _policyVersion; }
+    }
+
+    /// <summary>
+    /// The replicated policies, compiled. Empty until the first snapshot.
+    /// </summary>
+    public CompiledPolicySet Policies => _compiled ?? CompiledPolicySet.Empty;
+
+    /// <summary>
+    /// Replaces the policy set with a snapshot from the leader.
+    /// </summary>
+    public void ApplyPolicySnapshot(string epoch, ulong version, IEnumerable<PolicyEntry> policies)
+    {
+        lock (_policyLock)
+        {
+            _policies.Clear();
+            foreach (var entry in policies)
+            {
+                var policy = ParsePolicy(entry.PolicyId, entry.PolicyJson);
+                if (policy != null)
+                    _policies[entry.PolicyId] = policy;
+            }
+
+            _policyEpoch = epoch;
+            _policyVersion = version;
+            _compiled = CompiledPolicySet.Compile(_policies.Values);
+
+            _logger.LogInformation("Applied policy snapshot v{Version}: {Count} policies", version, _policies.Count);
+        }
+    }
+
+    /// <summary>
+    /// Applies one policy change (<paramref name="policyJson"/> null for a removal) on top of
+    /// the current version. Returns false if the change does not follow the current version, in
+    /// which case the caller must resync; an already applied version is ignored.
+    /// </summary>
+    public bool ApplyPolicyChange(string epoch, ulong version, string policyId, string? policyJson)
+    {
+        lock (_policyLock)
+        {
+            if (epoch != _policyEpoch)
+                return false;
+            if (version <= _policyVersion)
+                return true;
+            if (version != _policyVersion + 1)
+                return false;
+
+            var policy = policyJson == null ? null : ParsePolicy(policyId, policyJson);
+            if (policy == null)
+                _policies.Remove(policyId);
+            else
+                _policies[policyId] = policy;
+
+            _policyVersion = version;
+            _compiled = CompiledPolicySet.Compile(_policies.Values);
+            return true;
+        }
+    }
+
+    private Policy? ParsePolicy(string policyId, string policyJson)
+    {
+        try
+        {
+            return JsonSerializer.Deserialize<Policy>(policyJson, PolicyJsonOptions);
+        }
+        catch (JsonException ex)
+        {
+            _logger.LogWarning(ex, "Replicated policy {PolicyId} could not be parsed and is not evaluated", policyId);
+            return null;
+        }
+    }
+
+    // ─── Directory ──────────────────────────────────────────────────────
+
+    /// <summary>
+    /// Version of the directory in use; null until one has been received.
+    /// </summary>
+    public string? DirectoryVersion => _directory?.Version;
+
+    /// <summary>
+    /// Adds one chunk of a directory snapshot; the directory is swapped in whole after its last
+    /// chunk. Returns false if the chunk does not continue the snapshot being received, in which
+    /// case the caller must resync.
+    /// </summary>
+    public bool ApplyDirectoryChunk(DirectoryChunk chunk)
+    {
+        lock (_directoryLock)
+        {
+            if (chunk.Version == _directory?.Version)
+                return true;
+
+            if (chunk.Index == 0)
+            {
+                _pendingChunks = new List<DirectoryChunk>(chunk.Count);
+            }
+            else if (_pendingChunks == null || _pendingChunks.Count != chunk.Index || _pendingChunks[0].Version != chunk.Version)
+            {
+                _pendingChunks = null;
+                return false;
+            }
+
+            _pendingChunks.Add(chunk);
+            if (_pendingChunks.Count < chunk.Count)
+                return true;
+
+            var directory = ReplicatedDirectory.Build(_pendingChunks);
+            _pendingChunks = null;
+            _directory = directory;
+
+            _logger.LogInformation("Directory snapshot {Version} applied: {Users} users", directory.Version, directory.Users.Count);
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Looks up a user by sAMAccountName (case-sensitive, as in the database). Returns false for
+    /// an unknown user, who like on the leader has no groups, no OU and no sessions.
+    /// </summary>
+    public bool TryGetUser(string userName, out IReadOnlyList<string> groups, out string? ou)
+    {
+        var directory = _directory;
+        if (directory == null || !directory.Users.TryGetValue(userName, out var user))
+        {
+            groups = Array.Empty<string>();
+            ou = null;
+            return false;
+        }
+
+        groups = user.Groups;
+        ou = user.Ou;
+        return true;
+    }
+
+    private sealed record DirectoryEntry(string[] Groups, string? Ou);
+
+    private sealed class ReplicatedDirectory
+    {
+        public required string Version { get; init; }
+        public required Dictionary<string, DirectoryEntry> Users { get; init; }
+
+        public static ReplicatedDirectory Build(List<DirectoryChunk> chunks)
+        {
+            var groups = chunks[0].Groups.ToArray();
+            var ous = chunks[0].Ous.ToArray();
+            var users = new Dictionary<string, DirectoryEntry>(chunks.Sum(c => c.Users.Count), StringComparer.Ordinal);
+
+            // Group and OU strings are shared between users, so each user costs little more than its arrays
+            foreach (var user in chunks.SelectMany(c => c.Users))
+            {
+                users[user.UserName] = new DirectoryEntry(
+                    user.Groups.Where(g => (uint)g < (uint)groups.Length).Select(g => groups[g]).ToArray(),
+                    user.Ou > 0 && user.Ou <= ous.Length ? ous[user.Ou - 1] : null);
+            }
+
+            return new ReplicatedDirectory { Version = chunks[0].Version, Users = users };
+        }
+    }
+
+    // ─── Sessions ───────────────────────────────────────────────────────
+
+    /// <summary>
+    /// Active sessions held, including those received since the last snapshot.
+    /// </summary>
+    public int SessionCount
+    {
+        get { lock (_sessionLock) return _sessions?.Count ?? 0; }
+    }
+
+    /// <summary>
+    /// Starts receiving a session snapshot. The sessions in use keep answering evaluations until
+    /// <see cref="CompleteSessionSnapshot"/> swaps the new set in.
+    /// </summary>
+    public void BeginSessionSnapshot()
+    {
+        lock (_sessionLock)
+            _pendingSessions = new SessionSet();
+    }
+
+    /// <summary>
+    /// Swaps in the session set received since <see cref="BeginSessionSnapshot"/>.
+    /// </summary>
+    public void CompleteSessionSnapshot()
+    {
+        lock (_sessionLock)
+        {
+            if (_pendingSessions == null)
+                return;
+
+            _sessions = _pendingSessions;
+            _pendingSessions = null;
+        }
+
+        _logger.LogInformation("Session snapshot applied: {Count} active sessions", SessionCount);
+    }
+
+    /// <summary>
+    /// Applies a session created or revoked on the leader, to the snapshot being received if
+    /// there is one, otherwise to the sessions in use.
+    /// </summary>
+    public void ApplySessionEvent(SessionEvent sessionEvent)
+    {
+        lock (_sessionLock)
+        {
+            var sessions = _pendingSessions ?? _sessions;
+            if (sessions == null)
+                return;
+
+            if (sessionEvent.Revoked)
+                sessions.Remove(sessionEvent.SessionId);
+            else
+                sessions.Add(sessionEvent);
+        }
+    }
+
+    /// <summary>
+    /// Finds the active session of a user from a source IP, the newest if there are several,
+    /// as the leader's session lookup does. Sessions in the revocation filter are ignored.
+    /// </summary>
+    public string? FindSession(string userName, string sourceIp, DateTimeOffset now)
+    {
+        lock (_sessionLock)
+        {
+            if (_sessions == null)
+                return null;
+
+            return _sessions.Find(userName, sourceIp, now.UtcTicks,
+                id => _revocationFilter?.Contains(CuckooFilter.Hash(id)) == true);
+        }
+    }
+
+    // ─── Revocation filter ──────────────────────────────────────────────
+
+    public ulong RevocationFilterVersion
+    {
+        get { lock (_sessionLock) return _revocationFilterVersion; }
+    }
+
+    /// <summary>
+    /// Applies a revocation filter snapshot or delta. Returns false when a delta does not follow
+    /// the current version (or there is no snapshot yet, or the filter is full); the caller must
+    /// then resync to get a fresh snapshot.
+    /// </summary>
+    public bool ApplyRevocationFilter(RevocationFilterUpdate update)
+    {
+        if (update.Snapshot)
+        {
+            CuckooFilter filter;
+            try
+            {
+                filter = CuckooFilter.FromBytes(update.Filter.Span);
+            }
+            catch (FormatException ex)
+            {
+                _logger.LogError(ex, "Received malformed revocation filter snapshot v{Version}", update.Version);
+                return false;
+            }
+
+            lock (_sessionLock)
+            {
+                _revocationFilter = filter;
+                _revocationFilterVersion = update.Version;
+            }
+            return true;
+        }
+
+        lock (_sessionLock)
+        {
+            if (_revocationFilter == null)
+                return false;
+            if (update.Version <= _revocationFilterVersion)
+                return true;
+            if (update.Version != _revocationFilterVersion + 1)
+                return false;
+
+            foreach (var hash in update.Removed)
+                _revocationFilter.Remove(hash);
+            foreach (var hash in update.Added)
+            {
+                if (!_revocationFilter.Add(hash))
+                    return false;
+            }
+
+            _revocationFilterVersion = update.Version;
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Sessions by user name (case-sensitive, like sAMAccountName in the database) and by ID.
+    /// Expired sessions are dropped when their user is next looked up.
+    /// </summary>
+    private sealed class SessionSet
+    {
+        private readonly Dictionary<string, List<Session>> _byUser = new(StringComparer.Ordinal);
+        private readonly Dictionary<string, string> _userBySession = new(StringComparer.Ordinal);
+
+        public int Count => _userBySession.Count;
+
+        public void Add(SessionEvent sessionEvent)
+        {
+            Remove(sessionEvent.SessionId);
+
+            if (!_byUser.TryGetValue(sessionEvent.UserName, out var sessions))
+                _byUser[sessionEvent.UserName] = sessions = new List<Session>(1);
+
+            sessions.Add(new Session(
+                sessionEvent.SessionId,
+                sessionEvent.SourceIp,
+                sessionEvent.ExpiresAt?.ToDateTimeOffset().UtcTicks ?? 0));
+            _userBySession[sessionEvent.SessionId] = sessionEvent.UserName;
+        }
+
+        public void Remove(string sessionId)
+        {
+            if (!_userBySession.Remove(sessionId, out var userName))
+                return;
+
+            var sessions = _byUser[userName];
+            sessions.RemoveAll(s => s.Id == sessionId);
+            if (sessions.Count == 0)
+                _byUser.Remove(userName);
+        }
+
+        public string? Find(string userName, string sourceIp, long nowTicks, Func<string, bool> isRevoked)
+        {
+            if (!_byUser.TryGetValue(userName, out var sessions))
+                return null;
+
+            string? found = null;
+            for (var i = sessions.Count - 1; i >= 0; i--)
+            {
+                var session = sessions[i];
+                if (session.ExpiresTicks <= nowTicks)
+                {
+                    _userBySession.Remove(session.Id);
+                    sessions.RemoveAt(i);
+                    continue;
+                }
+
+                // Later entries were created later; keep scanning only to drop expired ones
+                if (found == null && session.SourceIp == sourceIp && !isRevoked(session.Id))
+                    found = session.Id;
+            }
+
+            if (sessions.Count == 0)
+                _byUser.Remove(userName);
+            return found;
+        }
+
+        private readonly record struct Session(string Id, string SourceIp, long ExpiresTicks);
+    }
+}
@@ -0,0 +1,360 @@
+using System.Runtime.CompilerServices;
+using Grpc.Core;
+using Grpc.Net.Client;
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Protocol;
+using MfaSrv.Protocol.Ha;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// On evaluation nodes, keeps <see cref="EvaluationReplica"/> current from the leader over two
+/// streams, each reconnecting with exponential backoff: <c>SyncPolicies</c> (policies,
+/// revocation filter and directory, as a DC Agent in local evaluation mode receives them) and
+/// <c>StreamSessions</c> (active sessions, then created/revoked events). Session events are
+/// also relayed to the agents connected to this node's agent channel, which otherwise would
+/// only hear of sessions created on this node.
+///
+/// The upstream candidates are <see cref="HaSettings.UpstreamUrl"/> and then
+/// <see cref="HaSettings.Peers"/>. Only the leader serves these streams, so whenever a stream
+/// fails, is refused or goes quiet for <see cref="EvaluationReplica.MaxStaleness"/>, both
+/// streams move on to the next candidate until they reach the current leader.
+///
+/// The node's audit events (<see cref="EvaluationAuditForwarder"/>) are sent in signed
+/// batches to the upstream the streams follow. A batch is retried until the leader takes it,
+/// so an event may be stored twice if an acknowledgement is lost; events still queued at
+/// shutdown are lost.
+///
+/// Risk features are only known to the leader, so evaluations under policies that use the
+/// risk score are passed to the same upstream (<see cref="EvaluateOnLeaderAsync"/>).
+/// </summary>
+public class EvaluationReplicaSyncService : BackgroundService
+{
+    private static readonly TimeSpan InitialRetryDelay = TimeSpan.FromSeconds(1);
+    private static readonly TimeSpan MaxRetryDelay = TimeSpan.FromSeconds(30);
+    private static readonly TimeSpan AuditForwardTimeout = TimeSpan.FromSeconds(10);
+    private static readonly TimeSpan LeaderEvaluationTimeout = TimeSpan.FromSeconds(5);
+
+    private readonly EvaluationReplica _replica;
+    private readonly AgentChannelService _agentChannels;
+    private readonly EvaluationAuditForwarder _auditForwarder;
+    private readonly PeerAuthenticator _authenticator;
+    private readonly HaSettings _settings;
+    private readonly ILogger<EvaluationReplicaSyncService> _logger;
+    private readonly string _nodeId;
+    private readonly string[] _upstreams;
+
+    // Index into _upstreams of the candidate both streams connect to
+    private int _current;
+
+    // One client per upstream while the service runs; null before start and after shutdown
+    private MfaService.MfaServiceClient[]? _clients;
+
+    public EvaluationReplicaSyncService(
+        EvaluationReplica replica,
+        AgentChannelService agentChannels,
+        EvaluationAuditForwarder auditForwarder,
+        PeerAuthenticator authenticator,
+        IOptions<HaSettings> settings,
+        ILogger<EvaluationReplicaSyncService> logger)
+    {
+        _replica = replica;
+        _agentChannels = agentChannels;
+        _auditForwarder = auditForwarder;
+        _authenticator = authenticator;
+        _settings = settings.Value;
+        _logger = logger;
+        _nodeId = string.IsNullOrEmpty(_settings.InstanceId)
+            ? $"{Environment.MachineName}-{Environment.ProcessId}"
+            : _settings.InstanceId;
+        _upstreams = _settings.Peers
+            .Prepend(_settings.UpstreamUrl)
+            .Where(url => !string.IsNullOrEmpty(url))
+            .Distinct(StringComparer.OrdinalIgnoreCase)
+            .ToArray();
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        if (!_replica.IsEnabled)
+            return;
+
+        if (_upstreams.Length == 0)
+        {
+            _logger.LogError("Evaluation node {NodeId} has no HA:UpstreamUrl or HA:Peers and cannot replicate", _nodeId);
+            return;
+        }
+
+        _logger.LogInformation("Evaluation node {NodeId} replicating from the leader among {Upstreams}",
+            _nodeId, string.Join(", ", _upstreams));
+
+        if (!_auditForwarder.IsEnabled)
+            _logger.LogError("Evaluation node {NodeId} has no HA:PeerSecret; its audit entries stay in its own database", _nodeId);
+
+        var channels = _upstreams.Select(url => GrpcChannel.ForAddress(url)).ToArray();
+        try
+        {
+            var clients = channels.Select(channel => new MfaService.MfaServiceClient(channel)).ToArray();
+            Volatile.Write(ref _clients, clients);
+
+            await Task.WhenAll(
+                RunWithRetryAsync("policy sync", clients, StreamPoliciesAsync, () => _replica.PolicyStreamContact, stoppingToken),
+                RunWithRetryAsync("session", clients, StreamSessionsAsync, () => _replica.SessionStreamContact, stoppingToken),
+                _auditForwarder.IsEnabled
+                    ? ForwardAuditAsync(channels.Select(channel => new HaPeerService.HaPeerServiceClient(channel)).ToArray(), stoppingToken)
+                    : Task.CompletedTask);
+        }
+        finally
+        {
+            Volatile.Write(ref _clients, null);
+            foreach (var channel in channels)
+                channel.Dispose();
+        }
+    }
+
+    /// <summary>
+    /// Evaluates <paramref name="request"/> on the upstream both streams follow, the leader.
+    /// The leader records the logon in its own risk features and audits the decision.
+    /// </summary>
+    /// <exception cref="RpcException">Unavailable if the node is not replicating.</exception>
+    public async Task<AuthEvaluationResponse> EvaluateOnLeaderAsync(AuthEvaluationRequest request, CancellationToken ct)
+    {
+        var clients = Volatile.Read(ref _clients)
+            ?? throw new RpcException(new Status(StatusCode.Unavailable, "Evaluation node is not connected to the leader"));
+
+        return await clients[Volatile.Read(ref _current)].EvaluateAuthenticationAsync(
+            request, deadline: DateTime.UtcNow + LeaderEvaluationTimeout, cancellationToken: ct);
+    }
+
+    /// <summary>
+    /// Runs <paramref name="run"/> against the current upstream until shutdown. A stream that
+    /// ends normally is reopened on the same upstream; one that fails moves both streams to the
+    /// next candidate. The backoff restarts whenever the failed stream had heard from its upstream.
+    /// </summary>
+    private async Task RunWithRetryAsync(
+        string stream,
+        MfaService.MfaServiceClient[] clients,
+        Func<MfaService.MfaServiceClient, CancellationToken, Task> run,
+        Func<DateTimeOffset> lastContact,
+        CancellationToken ct)
+    {
+        var retryDelay = InitialRetryDelay;
+
+        while (!ct.IsCancellationRequested)
+        {
+            var upstream = Volatile.Read(ref _current);
+            var contactBefore = lastContact();
+
+            try
+            {
+                await run(clients[upstream], ct);
+                retryDelay = InitialRetryDelay;
+            }
+            catch (OperationCanceledException) when (ct.IsCancellationRequested)
+            {
+                break;
+            }
+            catch (Exception ex)
+            {
+                if (lastContact() > contactBefore)
+                    retryDelay = InitialRetryDelay;
+
+                // Another stream may already have moved on; then follow it rather than skip a candidate
+                Interlocked.CompareExchange(ref _current, (upstream + 1) % _upstreams.Length, upstream);
+
+                _logger.LogWarning(ex, "Upstream {Stream} stream to {Upstream} lost, retrying on {Next} in {RetryDelay}s",
+                    stream, _upstreams[upstream], _upstreams[Volatile.Read(ref _current)], retryDelay.TotalSeconds);
+
+                try
+                {
+                    await Task.Delay(retryDelay, ct);
+                }
+                catch (OperationCanceledException)
+                {
+                    break;
+                }
+
+                retryDelay = TimeSpan.FromTicks(Math.Min(retryDelay.Ticks * 2, MaxRetryDelay.Ticks));
+            }
+        }
+    }
+
+    /// <summary>
+    /// Sends queued audit events to the upstream the streams currently follow. Failures never
+    /// move the streams: a batch is retried with backoff until the upstream they settle on,
+    /// the leader, accepts it.
+    /// </summary>
+    private async Task ForwardAuditAsync(HaPeerService.HaPeerServiceClient[] clients, CancellationToken ct)
+    {
+        var retryDelay = InitialRetryDelay;
+        List<ForwardedAuditEvent>? batch = null;
+
+        while (!ct.IsCancellationRequested)
+        {
+            var upstream = Volatile.Read(ref _current);
+            try
+            {
+                batch ??= await _auditForwarder.ReadBatchAsync(ct);
+
+                var request = new ForwardAuditRequest { NodeId = _nodeId };
+                request.Events.Add(batch);
+                _authenticator.Sign(request);
+
+                await clients[upstream].ForwardAuditAsync(request,
+                    deadline: DateTime.UtcNow + AuditForwardTimeout, cancellationToken: ct);
+
+                batch = null;
+                retryDelay = InitialRetryDelay;
+            }
+            catch (OperationCanceledException) when (ct.IsCancellationRequested)
+            {
+                break;
+            }
+            catch (Exception ex)
+            {
+                _logger.LogWarning(ex, "Forwarding {Count} audit events to {Upstream} failed, retrying in {RetryDelay}s",
+                    batch?.Count ?? 0, _upstreams[upstream], retryDelay.TotalSeconds);
+
+                try
+                {
+                    await Task.Delay(retryDelay, ct);
+                }
+                catch (OperationCanceledException)
+                {
+                    break;
+                }
+
+                retryDelay = TimeSpan.FromTicks(Math.Min(retryDelay.Ticks * 2, MaxRetryDelay.Ticks));
+            }
+        }
+    }
+
+    /// <summary>
+    /// Reads <paramref name="stream"/>, failing with <see cref="TimeoutException"/> once nothing
+    /// (not even a keepalive) has arrived for <see cref="EvaluationReplica.MaxStaleness"/>.
+    /// <paramref name="idle"/> must be the token source the call was started with.
+    /// </summary>
+    private async IAsyncEnumerable<T> ReadUntilIdleAsync<T>(
+        IAsyncStreamReader<T> stream,
+        CancellationTokenSource idle,
+        [EnumeratorCancellation] CancellationToken ct)
+    {
+        idle.CancelAfter(_replica.MaxStaleness);
+
+        while (true)
+        {
+            bool more;
+            try
+            {
+                more = await stream.MoveNext(idle.Token);
+            }
+            catch (Exception) when (idle.IsCancellationRequested && !ct.IsCancellationRequested)
+            {
+                throw new TimeoutException($"Nothing received from upstream for {_replica.MaxStaleness.TotalSeconds}s");
+            }
+
+            if (!more)
+                yield break;
+
+            idle.CancelAfter(_replica.MaxStaleness);
+            yield return stream.Current;
+        }
+    }
+
+    /// <summary>
+    /// Applies the leader's policy sync stream. Returning ends the call, and the caller
+    /// reconnects with the versions held, to resync after a gap.
+    /// </summary>
+    private async Task StreamPoliciesAsync(MfaService.MfaServiceClient client, CancellationToken ct)
+    {
+        using var idle = CancellationTokenSource.CreateLinkedTokenSource(ct);
+        using var call = client.SyncPolicies(new SyncPoliciesRequest
+        {
+            AgentId = $"evaluation-node:{_nodeId}",
+            Epoch = _replica.PolicyEpoch ?? string.Empty,
+            LastVersion = _replica.PolicyVersion,
+            WantDirectory = true,
+            DirectoryVersion = _replica.DirectoryVersion ?? string.Empty,
+            EvaluationNode = true
+        }, cancellationToken: idle.Token);
+
+        await foreach (var update in ReadUntilIdleAsync(call.ResponseStream, idle, ct))
+        {
+            _replica.RecordPolicyStreamContact(DateTimeOffset.UtcNow);
+
+            if (update.Keepalive)
+                continue;
+
+            if (update.RevocationFilter != null)
+            {
+                if (!_replica.ApplyRevocationFilter(update.RevocationFilter))
+                {
+                    _logger.LogWarning("Revocation filter v{Version} could not be applied (local v{LocalVersion}), resyncing",
+                        update.RevocationFilter.Version, _replica.RevocationFilterVersion);
+                    return;
+                }
+            }
+            else if (update.Directory != null)
+            {
+                if (!_replica.ApplyDirectoryChunk(update.Directory))
+                {
+                    _logger.LogWarning("Directory chunk {Index}/{Count} of {Version} arrived out of order, resyncing",
+                        update.Directory.Index + 1, update.Directory.Count, update.Directory.Version);
+                    return;
+                }
+            }
+            else if (update.Snapshot != null)
+            {
+                _replica.ApplyPolicySnapshot(update.Epoch, update.Version, update.Snapshot.Policies);
+            }
+            else if (!_replica.ApplyPolicyChange(update.Epoch, update.Version, update.PolicyId,
+                         update.Deleted ? null : update.PolicyJson))
+            {
+                _logger.LogWarning("Policy change v{Version} does not follow local v{LocalVersion}, resyncing",
+                    update.Version, _replica.PolicyVersion);
+                return;
+            }
+        }
+    }
+
+    private async Task StreamSessionsAsync(MfaService.MfaServiceClient client, CancellationToken ct)
+    {
+        using var idle = CancellationTokenSource.CreateLinkedTokenSource(ct);
+        using var call = client.StreamSessions(new StreamSessionsRequest { NodeId = _nodeId }, cancellationToken: idle.Token);
+
+        _replica.BeginSessionSnapshot();
+        var snapshotComplete = false;
+
+        // A keepalive is an update without sessions
+        await foreach (var update in ReadUntilIdleAsync(call.ResponseStream, idle, ct))
+        {
+            _replica.RecordSessionStreamContact(DateTimeOffset.UtcNow);
+
+            foreach (var sessionEvent in update.Sessions)
+            {
+                _replica.ApplySessionEvent(sessionEvent);
+
+                if (snapshotComplete)
+                    _agentChannels.NotifySessionChange(ToNotification(sessionEvent));
+            }
+
+            if (update.SnapshotComplete)
+            {
+                _replica.CompleteSessionSnapshot();
+                snapshotComplete = true;
+            }
+        }
+    }
+
+    private static SessionChangeNotification ToNotification(SessionEvent sessionEvent) => new()
+    {
+        SessionId = sessionEvent.SessionId,
+        UserName = sessionEvent.UserName,
+        SourceIp = sessionEvent.SourceIp,
+        ExpiresAt = sessionEvent.ExpiresAt?.ToDateTimeOffset() ?? default,
+        Revoked = sessionEvent.Revoked,
+        VerifiedMethod = sessionEvent.VerifiedMethod
+    };
+}
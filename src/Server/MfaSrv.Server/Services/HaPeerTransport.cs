@@ -0,0 +1,80 @@
+using System.Collections.Concurrent;
+using Grpc.Core;
+using Grpc.Net.Client;
+using Microsoft.Extensions.Logging;
+using MfaSrv.Protocol.Ha;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Sends leader election heartbeats to peer server instances.
+/// </summary>
+public interface IHaPeerTransport
+{
+    /// <summary>
+    /// Sends <paramref name="heartbeat"/> to the peer at <paramref name="peerUrl"/> and returns
+    /// its state, or null if it did not answer within <paramref name="timeout"/>.
+    /// </summary>
+    Task<PeerHeartbeat?> HeartbeatAsync(string peerUrl, PeerHeartbeat heartbeat, TimeSpan timeout, CancellationToken ct);
+}
+
+/// <summary>
+/// <see cref="IHaPeerTransport"/> over the peers' <c>HaPeerService</c> gRPC endpoint, with one
+/// long-lived HTTP/2 channel per peer. Heartbeats are signed with the peer secret and replies
+/// that do not verify count as no answer; without a secret nothing is sent, so failover falls
+/// back to lease expiry.
+/// </summary>
+public sealed class GrpcHaPeerTransport : IHaPeerTransport, IDisposable
+{
+    private readonly ConcurrentDictionary<string, GrpcChannel> _channels = new();
+    private readonly PeerAuthenticator _authenticator;
+    private readonly ILogger<GrpcHaPeerTransport> _logger;
+    private int _secretMissingLogged;
+
+    public GrpcHaPeerTransport(PeerAuthenticator authenticator, ILogger<GrpcHaPeerTransport> logger)
+    {
+        _authenticator = authenticator;
+        _logger = logger;
+    }
+
+    public async Task<PeerHeartbeat?> HeartbeatAsync(string peerUrl, PeerHeartbeat heartbeat, TimeSpan timeout, CancellationToken ct)
+    {
+        if (!_authenticator.IsConfigured)
+        {
+            if (Interlocked.Exchange(ref _secretMissingLogged, 1) == 0)
+                _logger.LogError("HA:Peers is set but HA:PeerSecret is not; peer heartbeats disabled, failover waits for lease expiry");
+            return null;
+        }
+
+        var channel = _channels.GetOrAdd(peerUrl, url => GrpcChannel.ForAddress(url));
+        var client = new HaPeerService.HaPeerServiceClient(channel);
+
+        // The same heartbeat goes to every peer concurrently; sign a copy for this one
+        var signed = heartbeat.Clone();
+        _authenticator.Sign(signed);
+
+        PeerHeartbeat reply;
+        try
+        {
+            reply = await client.HeartbeatAsync(signed, deadline: DateTime.UtcNow + timeout, cancellationToken: ct);
+        }
+        catch (RpcException)
+        {
+            return null;
+        }
+
+        if (!_authenticator.Verify(reply))
+        {
+            _logger.LogWarning("Ignored heartbeat reply from {Peer}: invalid or replayed signature", peerUrl);
+            return null;
+        }
+
+        return reply;
+    }
+
+    public void Dispose()
+    {
+        foreach (var channel in _channels.Values)
+            channel.Dispose();
+    }
+}
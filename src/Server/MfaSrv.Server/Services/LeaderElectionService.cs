@@ -1,47 +1,78 @@
+using System.Collections.Concurrent;
 using Microsoft.EntityFrameworkCore;
 using Microsoft.Extensions.Hosting;
 using Microsoft.Extensions.Logging;
 using Microsoft.Extensions.Options;
+using MfaSrv.Protocol.Ha;
 using MfaSrv.Server.Data;
 
 namespace MfaSrv.Server.Services;
 
 /// <summary>
-/// Simple file/database-based leader election for active-passive HA.
+/// Database-backed leader election for active-passive HA, with fencing tokens and optional
+/// direct peer heartbeats.
 ///
-/// The leader periodically renews a lease in the database. If the lease expires
-/// (leader crashed or became unreachable), another instance takes over.
+/// The leader periodically renews a lease row in the database. Every acquisition of the lease
+/// increments its <see cref="LeaderLease.FencingToken"/>, which is also the row's concurrency
+/// token, so two instances can never both acquire or renew the same lease version. Leader-only
+/// writes go through <see cref="RunFencedAsync"/>, which re-checks the token in the write's
+/// own transaction: a stale leader (paused, partitioned, or slow to notice a takeover) cannot
+/// write after another instance has taken over.
 ///
-/// This uses a "leader_lease" row in the cache_metadata-style table (or a
-/// dedicated LeaderLease table) with optimistic concurrency control.
-///
-/// For production deployments with PostgreSQL, this can be replaced with
-/// advisory locks or a distributed lock service (etcd, Consul).
+/// With <see cref="HaSettings.Peers"/> configured, instances also exchange heartbeats every
+/// <see cref="HaSettings.HeartbeatIntervalMs"/>. A standby that has seen the current lease
+/// holder alive as leader takes over as soon as it stops answering for
+/// <see cref="HaSettings.PeerFailureTimeoutMs"/>, or immediately when it announces a shutdown,
+/// instead of waiting for the lease to expire. The database lease stays the tiebreaker: a
+/// standby only preempts a holder it saw leading under the lease's current token, and never
+/// one that took over since. If only the link between the servers fails, the standby takes
+/// over once and the old leader is fenced off at its next write or renewal; leadership does
+/// not move back, because the old leader never saw the new one alive. Heartbeats are
+/// authenticated by the transport and <c>HaPeerGrpcService</c>; even so, a leader that hears
+/// of a newer token only steps down once the lease row confirms it.
 /// </summary>
 public class LeaderElectionService : BackgroundService
 {
+    public const string LeaseKey = "primary";
+
     private readonly IServiceScopeFactory _scopeFactory;
     private readonly HaSettings _settings;
     private readonly ILogger<LeaderElectionService> _logger;
+    private readonly IHaPeerTransport _peerTransport;
 
     private volatile bool _isLeader;
+    private long _fencingToken;
     private string _instanceId;
 
+    private readonly ConcurrentDictionary<string, PeerState> _peers = new(StringComparer.Ordinal);
+    private readonly SemaphoreSlim _electionSignal = new(0, 1);
+    private long _lastSignalTicks;
+
     public bool IsLeader => _isLeader;
     public string InstanceId => _instanceId;
 
+    /// <summary>
+    /// Fencing token of the lease this instance holds, or null when it is not the leader.
+    /// Always 0 when HA is disabled.
+    /// </summary>
+    public long? FencingToken => _isLeader ? Interlocked.Read(ref _fencingToken) : null;
+
+    private TimeSpan PeerFailureTimeout => TimeSpan.FromMilliseconds(Math.Max(100, _settings.PeerFailureTimeoutMs));
+
     private readonly SetupService _setupService;
 
     public LeaderElectionService(
         IServiceScopeFactory scopeFactory,
         IOptions<HaSettings> settings,
         ILogger<LeaderElectionService> logger,
-        SetupService setupService)
+        SetupService setupService,
+        IHaPeerTransport peerTransport)
     {
         _scopeFactory = scopeFactory;
         _settings = settings.Value;
         _logger = logger;
         _setupService = setupService;
+        _peerTransport = peerTransport;
         _instanceId = _settings.InstanceId;
 
         if (string.IsNullOrEmpty(_instanceId))
@@ -52,6 +83,14 @@ public class LeaderElectionService : BackgroundService
 
     protected override async Task ExecuteAsync(CancellationToken stoppingToken)
     {
+        if (_settings.EvaluationNode)
+        {
+            // Evaluation nodes hold no lease, so leader-only background work never runs on them
+            MetricsService.IsLeader.Set(0);
+            _logger.LogInformation("Evaluation node - not taking part in leader election ({InstanceId})", _instanceId);
+            return;
+        }
+
         if (_setupService.IsSetupRequired())
         {
             _isLeader = true;
@@ -69,8 +108,12 @@ public class LeaderElectionService : BackgroundService
         }
 
         _logger.LogInformation(
-            "Leader election started: instance={InstanceId}, lease={LeaseDuration}s, renew={RenewInterval}s",
-            _instanceId, _settings.LeaseDurationSeconds, _settings.LeaseRenewIntervalSeconds);
+            "Leader election started: instance={InstanceId}, lease={LeaseDuration}s, renew={RenewInterval}s, peers={PeerCount}",
+            _instanceId, _settings.LeaseDurationSeconds, _settings.LeaseRenewIntervalSeconds, _settings.Peers.Length);
+
+        var heartbeats = _settings.Peers.Length > 0
+            ? RunHeartbeatsAsync(stoppingToken)
+            : Task.CompletedTask;
 
         while (!stoppingToken.IsCancellationRequested)
         {
@@ -88,21 +131,37 @@ public class LeaderElectionService : BackgroundService
                 // If we can't reach the DB, relinquish leadership to be safe
                 if (_isLeader)
                 {
-                    _isLeader = false;
-                    MetricsService.IsLeader.Set(0);
+                    BecomeStandby();
                     _logger.LogWarning("Relinquishing leadership due to database error");
                 }
             }
 
-            await Task.Delay(TimeSpan.FromSeconds(_settings.LeaseRenewIntervalSeconds), stoppingToken);
+            try
+            {
+                // Woken early by the heartbeat loop when the leader fails or steps down
+                await _electionSignal.WaitAsync(TimeSpan.FromSeconds(_settings.LeaseRenewIntervalSeconds), stoppingToken);
+            }
+            catch (OperationCanceledException)
+            {
+                break;
+            }
+        }
+
+        try
+        {
+            await heartbeats;
+        }
+        catch (OperationCanceledException)
+        {
         }
 
-        // Release lease on shutdown
+        // Release lease on shutdown and tell peers so a standby takes over right away
         if (_isLeader)
         {
             try
             {
                 await ReleaseLeaseAsync();
+                await NotifyPeersSteppingDownAsync();
             }
             catch (Exception ex)
             {
@@ -115,12 +174,67 @@ public class LeaderElectionService : BackgroundService
         _logger.LogInformation("Leader election stopped");
     }
 
+    /// <summary>
+    /// Runs a leader-only write if this instance still holds the lease with its fencing token.
+    /// The token is checked inside the transaction <paramref name="write"/> runs in (SQLite
+    /// fails the transaction's write if a takeover commits after the check), so the write
+    /// cannot land after another instance has taken over. Returns false, and steps down,
+    /// if the token is no longer current.
+    /// </summary>
+    public async Task<bool> RunFencedAsync(
+        MfaSrvDbContext db,
+        Func<CancellationToken, Task> write,
+        CancellationToken ct = default)
+    {
+        if (!_settings.Enabled)
+        {
+            await write(ct);
+            return true;
+        }
+
+        if (!_isLeader)
+            return false;
+
+        var token = Interlocked.Read(ref _fencingToken);
+
+        await using var transaction = db.Database.IsRelational()
+            ? await db.Database.BeginTransactionAsync(ct)
+            : null;
+
+        var current = await db.LeaderLeases.AsNoTracking().AnyAsync(
+            l => l.LeaseKey == LeaseKey && l.HolderId == _instanceId && l.FencingToken == token, ct);
+
+        if (!current)
+        {
+            MetricsService.FencedWritesTotal.Inc();
+            _logger.LogWarning("Leader-only write refused: fencing token {Token} is no longer current", token);
+            BecomeStandby();
+            return false;
+        }
+
+        await write(ct);
+
+        if (transaction != null)
+            await transaction.CommitAsync(ct);
+
+        return true;
+    }
+
+    /// <summary>
+    /// Handles a heartbeat from a peer instance and returns this instance's state.
+    /// </summary>
+    public PeerHeartbeat HandlePeerHeartbeat(PeerHeartbeat heartbeat)
+    {
+        ObservePeer(heartbeat);
+        return CreateHeartbeat(steppingDown: false);
+    }
+
     private async Task TryAcquireOrRenewLeaseAsync(CancellationToken ct)
     {
         using var scope = _scopeFactory.CreateScope();
         var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
 
-        var lease = await db.LeaderLeases.FirstOrDefaultAsync(l => l.LeaseKey == "primary", ct);
+        var lease = await db.LeaderLeases.FirstOrDefaultAsync(l => l.LeaseKey == LeaseKey, ct);
 
         var now = DateTimeOffset.UtcNow;
         var leaseExpiry = now.AddSeconds(_settings.LeaseDurationSeconds);
@@ -130,8 +244,9 @@ public class LeaderElectionService : BackgroundService
             // No lease exists - try to create one
             db.LeaderLeases.Add(new LeaderLease
             {
-                LeaseKey = "primary",
+                LeaseKey = LeaseKey,
                 HolderId = _instanceId,
+                FencingToken = 1,
                 AcquiredAt = now,
                 ExpiresAt = leaseExpiry,
                 RenewedAt = now
@@ -140,29 +255,44 @@ public class LeaderElectionService : BackgroundService
             try
             {
                 await db.SaveChangesAsync(ct);
-                BecomeLeader();
+                BecomeLeader(1);
             }
             catch (DbUpdateException)
             {
                 // Another instance created it first - we remain standby
                 BecomeStandby();
             }
+            return;
         }
-        else if (lease.HolderId == _instanceId)
+
+        if (_isLeader && lease.HolderId == _instanceId && lease.FencingToken == Interlocked.Read(ref _fencingToken))
         {
-            // We hold the lease - renew it
+            // We hold the lease - renew it. The fencing token is the concurrency token, so
+            // this fails if another instance took over since the read.
             lease.ExpiresAt = leaseExpiry;
             lease.RenewedAt = now;
-            await db.SaveChangesAsync(ct);
 
-            if (!_isLeader)
-                BecomeLeader();
+            try
+            {
+                await db.SaveChangesAsync(ct);
+            }
+            catch (DbUpdateException)
+            {
+                BecomeStandby();
+            }
+            return;
         }
-        else if (lease.ExpiresAt < now)
+
+        // Our own lease without our token: an earlier run of this instance. Re-acquire it under
+        // a new token so anything that incarnation still tries to write is fenced off.
+        var ownLease = lease.HolderId == _instanceId;
+        var failedLeader = ownLease ? null : FailedLeader(lease, now);
+
+        if (ownLease || lease.ExpiresAt < now || failedLeader != null)
         {
-            // Lease expired - try to take over
             var previousHolder = lease.HolderId;
             lease.HolderId = _instanceId;
+            lease.FencingToken++;
             lease.AcquiredAt = now;
             lease.ExpiresAt = leaseExpiry;
             lease.RenewedAt = now;
@@ -170,32 +300,159 @@ public class LeaderElectionService : BackgroundService
             try
             {
                 await db.SaveChangesAsync(ct);
-                MetricsService.LeaderElectionsTotal.Inc();
-                _logger.LogWarning(
-                    "Took over leadership from expired lease (previous: {PreviousHolder})",
-                    previousHolder);
-                BecomeLeader();
             }
             catch (DbUpdateException)
             {
                 // Another instance took it - remain standby
                 BecomeStandby();
+                return;
+            }
+
+            if (!ownLease)
+            {
+                MetricsService.LeaderElectionsTotal.Inc();
+                if (failedLeader != null)
+                {
+                    MetricsService.LeaderTakeoverSeconds.Observe((now - failedLeader.LastSeenAt).TotalSeconds);
+                    _logger.LogWarning(
+                        "Took over leadership from {PreviousHolder} ({Reason}, last heartbeat {Elapsed}ms ago)",
+                        previousHolder, failedLeader.SteppingDown ? "stepped down" : "stopped answering",
+                        (long)(now - failedLeader.LastSeenAt).TotalMilliseconds);
+                }
+                else
+                {
+                    _logger.LogWarning(
+                        "Took over leadership from expired lease (previous: {PreviousHolder})",
+                        previousHolder);
+                }
             }
+
+            BecomeLeader(lease.FencingToken);
+            return;
         }
-        else
+
+        // Another instance holds a valid lease
+        BecomeStandby();
+    }
+
+    /// <summary>
+    /// The lease holder's peer state if it has stepped down or stopped answering heartbeats
+    /// after this instance saw it lead under the lease's current token; otherwise null.
+    /// </summary>
+    private PeerState? FailedLeader(LeaderLease lease, DateTimeOffset now)
+    {
+        if (!_peers.TryGetValue(lease.HolderId, out var peer) || peer.LeaderToken != lease.FencingToken)
+            return null;
+
+        return peer.SteppingDown || now - peer.LastSeenAt > PeerFailureTimeout ? peer : null;
+    }
+
+    private async Task RunHeartbeatsAsync(CancellationToken ct)
+    {
+        var interval = TimeSpan.FromMilliseconds(Math.Max(50, _settings.HeartbeatIntervalMs));
+        var timeout = PeerFailureTimeout / 2;
+        using var timer = new PeriodicTimer(interval);
+
+        do
         {
-            // Another instance holds a valid lease
-            BecomeStandby();
+            var heartbeat = CreateHeartbeat(steppingDown: false);
+            await Task.WhenAll(_settings.Peers.Select(async url =>
+            {
+                var reply = await _peerTransport.HeartbeatAsync(url, heartbeat, timeout, ct);
+                if (reply != null)
+                    ObservePeer(reply);
+            }));
+
+            if (!_isLeader && _peers.Count > 0)
+            {
+                // Only the most recent leader matters; an older one that died was already replaced
+                var leader = _peers.Values.MaxBy(p => p.LeaderToken)!;
+                if (leader.IsLeader && DateTimeOffset.UtcNow - leader.LastSeenAt > PeerFailureTimeout)
+                    SignalElection();
+            }
+        }
+        while (await timer.WaitForNextTickAsync(ct));
+    }
+
+    private void ObservePeer(PeerHeartbeat heartbeat)
+    {
+        if (string.IsNullOrEmpty(heartbeat.InstanceId) || heartbeat.InstanceId == _instanceId)
+            return;
+
+        var now = DateTimeOffset.UtcNow;
+        _peers.AddOrUpdate(
+            heartbeat.InstanceId,
+            _ => new PeerState(heartbeat.IsLeader, heartbeat.IsLeader ? heartbeat.FencingToken : 0, now, heartbeat.SteppingDown),
+            (_, previous) => new PeerState(
+                heartbeat.IsLeader,
+                heartbeat.IsLeader ? heartbeat.FencingToken : previous.LeaderToken,
+                now,
+                heartbeat.SteppingDown));
+
+        if (heartbeat.SteppingDown)
+        {
+            SignalElection(force: true);
+        }
+        else if (heartbeat.IsLeader && _isLeader && heartbeat.FencingToken > Interlocked.Read(ref _fencingToken))
+        {
+            // Renewal re-reads the lease and steps down only if it really moved
+            _logger.LogWarning(
+                "Peer {PeerId} claims to lead under newer fencing token {Token}, checking the lease",
+                heartbeat.InstanceId, heartbeat.FencingToken);
+            SignalElection();
+        }
+    }
+
+    /// <summary>
+    /// Wakes the election loop, at most once per failure timeout unless forced.
+    /// </summary>
+    private void SignalElection(bool force = false)
+    {
+        var now = Environment.TickCount64;
+        var last = Interlocked.Read(ref _lastSignalTicks);
+        if (!force && now - last < (long)PeerFailureTimeout.TotalMilliseconds)
+            return;
+
+        Interlocked.Exchange(ref _lastSignalTicks, now);
+        try
+        {
+            _electionSignal.Release();
+        }
+        catch (SemaphoreFullException)
+        {
+            // Already signalled
         }
     }
 
+    private PeerHeartbeat CreateHeartbeat(bool steppingDown)
+    {
+        var token = FencingToken;
+        return new PeerHeartbeat
+        {
+            InstanceId = _instanceId,
+            IsLeader = token.HasValue && !steppingDown,
+            FencingToken = token ?? 0,
+            SteppingDown = steppingDown
+        };
+    }
+
+    private async Task NotifyPeersSteppingDownAsync()
+    {
+        if (_settings.Peers.Length == 0)
+            return;
+
+        var heartbeat = CreateHeartbeat(steppingDown: true);
+        await Task.WhenAll(_settings.Peers.Select(url =>
+            _peerTransport.HeartbeatAsync(url, heartbeat, PeerFailureTimeout, CancellationToken.None)));
+    }
+
     private async Task ReleaseLeaseAsync()
     {
         using var scope = _scopeFactory.CreateScope();
         var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
 
         var lease = await db.LeaderLeases
-            .FirstOrDefaultAsync(l => l.LeaseKey == "primary" && l.HolderId == _instanceId);
+            .FirstOrDefaultAsync(l => l.LeaseKey == LeaseKey && l.HolderId == _instanceId);
 
         if (lease != null)
         {
@@ -205,13 +462,15 @@ public class LeaderElectionService : BackgroundService
         }
     }
 
-    private void BecomeLeader()
+    private void BecomeLeader(long fencingToken)
     {
+        Interlocked.Exchange(ref _fencingToken, fencingToken);
         if (!_isLeader)
         {
             _isLeader = true;
             MetricsService.IsLeader.Set(1);
-            _logger.LogInformation("This instance ({InstanceId}) is now the LEADER", _instanceId);
+            _logger.LogInformation("This instance ({InstanceId}) is now the LEADER (fencing token {Token})",
+                _instanceId, fencingToken);
         }
     }
 
@@ -224,6 +483,8 @@ public class LeaderElectionService : BackgroundService
             _logger.LogWarning("This instance ({InstanceId}) is now STANDBY", _instanceId);
         }
     }
+
+    private sealed record PeerState(bool IsLeader, long LeaderToken, DateTimeOffset LastSeenAt, bool SteppingDown);
 }
 
 /// <summary>
@@ -233,6 +494,11 @@ public class LeaderLease
 {
     public string LeaseKey { get; set; } = "primary";
     public string HolderId { get; set; } = string.Empty;
+
+    /// <summary>
+    /// Incremented on every acquisition of the lease; also the row's concurrency token.
+    /// </summary>
+    public long FencingToken { get; set; }
     public DateTimeOffset AcquiredAt { get; set; }
     public DateTimeOffset ExpiresAt { get; set; }
     public DateTimeOffset RenewedAt { get; set; }
@@ -0,0 +1,270 @@
+using System.Text.Json;
+using System.Threading.Channels;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Interfaces;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// In-process <see cref="IChallengeStore"/> for single-node and small HA deployments that do
+/// not run Redis.
+///
+/// Keys are spread over lock-striped dictionaries and values are kept as UTF-8 JSON, as in
+/// <see cref="RedisChallengeStore"/>: every read deserializes a private copy, so callers can
+/// change what they read without affecting the stored challenge or other readers. Expiry is
+/// checked on every read; expired entries are reclaimed by a one-second timer wheel so cleanup
+/// cost depends on what is due, not on store size.
+///
+/// When <see cref="ChallengeStoreSettings.ReplicationPeers"/> is set, every change is also
+/// queued for <see cref="ChallengeStoreReplicator"/>, which sends the same JSON to the other
+/// instances.
+/// </summary>
+public class LocalChallengeStore : IChallengeStore, IDisposable
+{
+    private const int StripeCount = 64;
+    private const int WheelSlots = 512;
+
+    public static readonly JsonSerializerOptions JsonOptions = new()
+    {
+        PropertyNamingPolicy = JsonNamingPolicy.CamelCase
+    };
+
+    private readonly Stripe[] _stripes = new Stripe[StripeCount];
+    private readonly Channel<ChallengeStoreChange>? _changes;
+    private readonly object _wheelLock = new();
+    private readonly Timer _timer;
+    private long _wheelTick;
+    private int _count;
+
+    public LocalChallengeStore(IOptions<ChallengeStoreSettings> settings)
+    {
+        for (var i = 0; i < _stripes.Length; i++)
+            _stripes[i] = new Stripe();
+
+        if (settings.Value.ReplicationPeers.Length > 0)
+        {
+            _changes = Channel.CreateBounded<ChallengeStoreChange>(
+                new BoundedChannelOptions(Math.Max(1, settings.Value.ReplicationQueueCapacity))
+                {
+                    FullMode = BoundedChannelFullMode.DropOldest,
+                    SingleReader = true,
+                    SingleWriter = false
+                });
+        }
+
+        _wheelTick = DateTimeOffset.UtcNow.UtcTicks / TimeSpan.TicksPerSecond;
+        _timer = new Timer(_ => ExpireDue(DateTimeOffset.UtcNow), null, TimeSpan.FromSeconds(1), TimeSpan.FromSeconds(1));
+    }
+
+    /// <summary>
+    /// Number of entries held, including expired ones not yet reclaimed.
+    /// </summary>
+    public int Count => Volatile.Read(ref _count);
+
+    /// <summary>
+    /// Changes waiting to be replicated, or null when replication is disabled.
+    /// </summary>
+    public ChannelReader<ChallengeStoreChange>? Changes => _changes?.Reader;
+
+    public Task SetAsync<T>(string key, T value, TimeSpan expiry, CancellationToken ct = default)
+    {
+        var expiresAt = DateTimeOffset.UtcNow.Add(expiry);
+        var json = JsonSerializer.SerializeToUtf8Bytes(value, JsonOptions);
+        Set(key, json, expiresAt);
+        _changes?.Writer.TryWrite(new ChallengeStoreChange(key, json, expiresAt, Removed: false));
+        return Task.CompletedTask;
+    }
+
+    public Task<T?> GetAsync<T>(string key, CancellationToken ct = default)
+    {
+        return Task.FromResult(Get<T>(key, DateTimeOffset.UtcNow));
+    }
+
+    public Task RemoveAsync(string key, CancellationToken ct = default)
+    {
+        Remove(key);
+        _changes?.Writer.TryWrite(new ChallengeStoreChange(key, null, default, Removed: true));
+        return Task.CompletedTask;
+    }
+
+    /// <summary>
+    /// Returns a copy of the live value for <paramref name="key"/> as of <paramref name="now"/>.
+    /// </summary>
+    public T? Get<T>(string key, DateTimeOffset now)
+    {
+        byte[] json;
+        var stripe = StripeFor(key);
+        lock (stripe)
+        {
+            if (!stripe.Entries.TryGetValue(key, out var entry))
+                return default;
+
+            if (entry.ExpiresAtTicks <= now.UtcTicks)
+            {
+                RemoveEntry(stripe, key);
+                return default;
+            }
+
+            // Stored arrays are never written to, so this one can be read outside the lock
+            json = entry.Json;
+        }
+
+        return JsonSerializer.Deserialize<T>(json, JsonOptions);
+    }
+
+    /// <summary>
+    /// Applies a change received from a peer instance without queueing it for replication again.
+    /// </summary>
+    public void ApplyReplicated(string key, byte[]? json, DateTimeOffset expiresAt, bool removed)
+    {
+        if (removed || json == null)
+            Remove(key);
+        else
+            Set(key, json, expiresAt);
+    }
+
+    /// <summary>
+    /// Reclaims entries that expired at or before <paramref name="now"/>, advancing the wheel
+    /// one slot per elapsed second. Returns the number of entries removed.
+    /// </summary>
+    public int ExpireDue(DateTimeOffset now)
+    {
+        var nowTicks = now.UtcTicks;
+        // Only slots whose whole second has passed; everything listed there is then expired
+        var target = nowTicks / TimeSpan.TicksPerSecond;
+        var removed = 0;
+
+        lock (_wheelLock)
+        {
+            var from = _wheelTick + 1;
+
+            // After a stall every slot is due; one revolution visits them all
+            if (target - from >= WheelSlots)
+                from = target - WheelSlots + 1;
+
+            for (var tick = from; tick <= target; tick++)
+            {
+                var slot = (int)(tick % WheelSlots);
+                foreach (var stripe in _stripes)
+                {
+                    lock (stripe)
+                        removed += SweepSlot(stripe, slot, nowTicks);
+                }
+            }
+
+            if (target > _wheelTick)
+                _wheelTick = target;
+        }
+
+        return removed;
+    }
+
+    public void Dispose()
+    {
+        _timer.Dispose();
+        _changes?.Writer.TryComplete();
+    }
+
+    private void Set(string key, byte[] json, DateTimeOffset expiresAt)
+    {
+        var expiresAtTicks = expiresAt.UtcTicks;
+        var tick = ToTick(expiresAtTicks);
+        var stripe = StripeFor(key);
+
+        lock (stripe)
+        {
+            if (stripe.Entries.TryGetValue(key, out var entry))
+            {
+                entry.Json = json;
+                entry.ExpiresAtTicks = expiresAtTicks;
+                if (entry.Tick == tick)
+                    return;
+                // The key stays listed in its old slot; that sweep sees the tick moved and drops it
+                entry.Tick = tick;
+            }
+            else
+            {
+                stripe.Entries[key] = new Entry { Json = json, ExpiresAtTicks = expiresAtTicks, Tick = tick };
+                Interlocked.Increment(ref _count);
+            }
+
+            var slot = (int)(tick % WheelSlots);
+            (stripe.Wheel[slot] ??= new List<string>()).Add(key);
+        }
+    }
+
+    private void Remove(string key)
+    {
+        var stripe = StripeFor(key);
+        lock (stripe)
+            RemoveEntry(stripe, key);
+    }
+
+    private void RemoveEntry(Stripe stripe, string key)
+    {
+        if (stripe.Entries.Remove(key))
+            Interlocked.Decrement(ref _count);
+    }
+
+    private int SweepSlot(Stripe stripe, int slot, long nowTicks)
+    {
+        var keys = stripe.Wheel[slot];
+        if (keys == null)
+            return 0;
+
+        var removed = 0;
+        var kept = 0;
+        for (var i = 0; i < keys.Count; i++)
+        {
+            var key = keys[i];
+            if (!stripe.Entries.TryGetValue(key, out var entry) || entry.Tick % WheelSlots != slot)
+                continue;
+
+            if (entry.ExpiresAtTicks <= nowTicks)
+            {
+                RemoveEntry(stripe, key);
+                removed++;
+                continue;
+            }
+
+            // Due in a later revolution of the wheel
+            keys[kept++] = key;
+        }
+
+        if (kept == 0)
+            stripe.Wheel[slot] = null;
+        else
+            keys.RemoveRange(kept, keys.Count - kept);
+
+        return removed;
+    }
+
+    private Stripe StripeFor(string key) =>
+        _stripes[StringComparer.Ordinal.GetHashCode(key) & (StripeCount - 1)];
+
+    /// <summary>
+    /// Wheel tick (whole seconds) in which an instant falls due, rounded up so an entry is
+    /// never swept before it expires.
+    /// </summary>
+    private static long ToTick(long utcTicks) =>
+        (utcTicks + TimeSpan.TicksPerSecond - 1) / TimeSpan.TicksPerSecond;
+
+    private sealed class Stripe
+    {
+        public readonly Dictionary<string, Entry> Entries = new(StringComparer.Ordinal);
+        public readonly List<string>?[] Wheel = new List<string>?[WheelSlots];
+    }
+
+    private sealed class Entry
+    {
+        public byte[] Json = Array.Empty<byte>();
+        public long ExpiresAtTicks;
+        public long Tick;
+    }
+}
+
+/// <summary>
+/// A change to <see cref="LocalChallengeStore"/> waiting to be sent to peer instances.
+/// <see cref="Json"/> is the stored value, null when removed; it must not be modified.
+/// </summary>
+public record ChallengeStoreChange(string Key, byte[]? Json, DateTimeOffset ExpiresAt, bool Removed);
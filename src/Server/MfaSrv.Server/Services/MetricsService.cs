@@ -54,6 +54,42 @@ public static class MetricsService
             Buckets = Histogram.LinearBuckets(0.01, 0.05, 20) // 10ms to 1s
         });
 
+    // ── Delivery Metrics ────────────────────────────────────────────────
+
+    public static readonly Counter DeliveriesTotal = Metrics.CreateCounter(
+        "mfasrv_deliveries_total",
+        "Outbound SMS, e-mail and push messages by outcome",
+        new CounterConfiguration
+        {
+            LabelNames = new[] { "channel", "result" } // delivered, retried, failed, expired, queue_full
+        });
+
+    public static readonly Histogram DeliveryLatency = Metrics.CreateHistogram(
+        "mfasrv_delivery_latency_seconds",
+        "Time from enqueue to successful delivery, including queueing, rate limiting and retries",
+        new HistogramConfiguration
+        {
+            LabelNames = new[] { "channel" },
+            Buckets = Histogram.ExponentialBuckets(0.01, 2, 12) // 10ms to ~20s
+        });
+
+    public static readonly Histogram DeliverySendDuration = Metrics.CreateHistogram(
+        "mfasrv_delivery_send_duration_seconds",
+        "Duration of a single gateway send call",
+        new HistogramConfiguration
+        {
+            LabelNames = new[] { "channel" },
+            Buckets = Histogram.ExponentialBuckets(0.005, 2, 12) // 5ms to ~10s
+        });
+
+    public static readonly Gauge DeliveryQueueDepth = Metrics.CreateGauge(
+        "mfasrv_delivery_queue_depth",
+        "Outbound messages waiting to be sent",
+        new GaugeConfiguration
+        {
+            LabelNames = new[] { "channel" }
+        });
+
     // ── Session Metrics ─────────────────────────────────────────────────
 
     public static readonly Gauge ActiveSessionsCount = Metrics.CreateGauge(
@@ -72,6 +108,22 @@ public static class MetricsService
         "mfasrv_sessions_expired_total",
         "Total sessions expired during cleanup");
 
+    public static readonly Counter SessionValidationsTotal = Metrics.CreateCounter(
+        "mfasrv_session_validations_total",
+        "Total session token validations",
+        new CounterConfiguration
+        {
+            LabelNames = new[] { "path" } // stateless, database
+        });
+
+    public static readonly Counter SessionLookupsTotal = Metrics.CreateCounter(
+        "mfasrv_session_lookups_total",
+        "Total active-session lookups during authentication evaluation",
+        new CounterConfiguration
+        {
+            LabelNames = new[] { "path" } // cache, database
+        });
+
     // ── Agent Metrics ───────────────────────────────────────────────────
 
     public static readonly Gauge RegisteredAgentsCount = Metrics.CreateGauge(
@@ -90,6 +142,10 @@ public static class MetricsService
             LabelNames = new[] { "agent_id" }
         });
 
+    public static readonly Gauge AgentChannelsOpen = Metrics.CreateGauge(
+        "mfasrv_agent_channels_open",
+        "Number of open bidirectional agent channels");
+
     // ── Policy Metrics ──────────────────────────────────────────────────
 
     public static readonly Gauge ActivePoliciesCount = Metrics.CreateGauge(
@@ -104,6 +160,18 @@ public static class MetricsService
             LabelNames = new[] { "action" } // require_mfa, deny, allow, alert_only
         });
 
+    public static readonly Histogram RiskScore = Metrics.CreateHistogram(
+        "mfasrv_risk_score",
+        "Risk score computed for each evaluated logon",
+        new HistogramConfiguration
+        {
+            Buckets = Histogram.LinearBuckets(10, 10, 10) // 10 to 100
+        });
+
+    public static readonly Gauge RiskTrackedUsers = Metrics.CreateGauge(
+        "mfasrv_risk_tracked_users",
+        "Users whose source IPs are tracked in the current risk window");
+
     // ── gRPC Metrics ────────────────────────────────────────────────────
 
     public static readonly Counter GrpcCallsTotal = Metrics.CreateCounter(
@@ -133,10 +201,52 @@ public static class MetricsService
             LabelNames = new[] { "result" } // success, failure
         });
 
+    public static readonly Histogram DbBackupDuration = Metrics.CreateHistogram(
+        "mfasrv_db_backup_duration_seconds",
+        "Duration of successful database backups",
+        new HistogramConfiguration
+        {
+            Buckets = Histogram.ExponentialBuckets(0.1, 2, 14) // 100ms .. ~14min
+        });
+
+    public static readonly Histogram DbBackupWriterStall = Metrics.CreateHistogram(
+        "mfasrv_db_backup_writer_stall_seconds",
+        "Time a backup step held the lock that blocks database writers (rollback journal mode only)",
+        new HistogramConfiguration
+        {
+            Buckets = Histogram.ExponentialBuckets(0.0005, 2, 14) // 0.5ms .. ~4s
+        });
+
+    public static readonly Counter DbBackupBusyRetriesTotal = Metrics.CreateCounter(
+        "mfasrv_db_backup_busy_retries_total",
+        "Backup steps retried because a database writer held the lock");
+
+    public static readonly Counter DbBackupRestartsTotal = Metrics.CreateCounter(
+        "mfasrv_db_backup_restarts_total",
+        "Backup copies restarted because the database was written between steps");
+
     public static readonly Gauge DbSizeBytes = Metrics.CreateGauge(
         "mfasrv_db_size_bytes",
         "Current database file size in bytes");
 
+    // ── Audit Metrics ───────────────────────────────────────────────────
+
+    public static readonly Counter AuditEventsDroppedTotal = Metrics.CreateCounter(
+        "mfasrv_audit_events_dropped_total",
+        "Audit entries not persisted in batched mode or not forwarded by an evaluation node",
+        new CounterConfiguration
+        {
+            LabelNames = new[] { "reason" } // sampled, queue_full, write_failed, forward_queue_full
+        });
+
+    public static readonly Counter AuditLateEntriesTotal = Metrics.CreateCounter(
+        "mfasrv_audit_late_entries_total",
+        "Audit entries written after their hour was sealed and added to its rollups");
+
+    public static readonly Gauge AuditQueueDepth = Metrics.CreateGauge(
+        "mfasrv_audit_queue_depth",
+        "Audit entries waiting to be written in batched mode");
+
     // ── HA Metrics ──────────────────────────────────────────────────────
 
     public static readonly Gauge IsLeader = Metrics.CreateGauge(
@@ -147,6 +257,18 @@ public static class MetricsService
         "mfasrv_leader_elections_total",
         "Total leader election events");
 
+    public static readonly Counter FencedWritesTotal = Metrics.CreateCounter(
+        "mfasrv_fenced_writes_total",
+        "Leader-only writes refused because this instance's fencing token is no longer current");
+
+    public static readonly Histogram LeaderTakeoverSeconds = Metrics.CreateHistogram(
+        "mfasrv_leader_takeover_seconds",
+        "Time from the previous leader's last heartbeat to this instance taking over",
+        new HistogramConfiguration
+        {
+            Buckets = new[] { 0.1, 0.25, 0.5, 0.75, 1, 2, 5, 10, 30, 60 }
+        });
+
     // ── Enrollment Metrics ──────────────────────────────────────────────
 
     public static readonly Counter EnrollmentsTotal = Metrics.CreateCounter(
@@ -1,6 +1,6 @@
-using Microsoft.EntityFrameworkCore;
 using Microsoft.Extensions.Configuration;
 using Microsoft.Extensions.Logging;
+using MfaSrv.Core.Challenges;
 using MfaSrv.Core.Entities;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.Interfaces;
@@ -9,22 +9,47 @@ using MfaSrv.Server.Data;
 
 namespace MfaSrv.Server.Services;
 
+/// <summary>
+/// Issues and verifies MFA challenges. Providers are resolved through
+/// <see cref="MfaProviderRegistry"/>, enrollments through <see cref="EnrollmentCache"/>, and
+/// challenge state is kept in <see cref="ChallengeStateStore"/>, which writes status and
+/// attempt count through to the shared <c>MfaChallenges</c> row, so a challenge issued on one
+/// server instance can be verified on another and its attempts are limited across all of them.
+///
+/// Challenges of asynchronous providers are settled when the provider publishes their outcome
+/// to <see cref="ChallengeCompletionEngine"/>, so callers can wait for it with
+/// <see cref="WaitForChallengeStatusAsync"/> rather than poll.
+///
+/// Failed verifications and denied pushes are reported to <see cref="RiskScoringService"/>.
+/// </summary>
 public class MfaChallengeOrchestrator : IMfaChallengeOrchestrator
 {
     private readonly MfaSrvDbContext _db;
-    private readonly IEnumerable<IMfaProvider> _providers;
+    private readonly MfaProviderRegistry _providers;
+    private readonly EnrollmentCache _enrollments;
+    private readonly ChallengeStateStore _challenges;
+    private readonly ChallengeCompletionEngine _completions;
+    private readonly RiskScoringService _riskScoring;
     private readonly ILogger<MfaChallengeOrchestrator> _logger;
     private readonly byte[]? _encryptionKey;
     private static readonly TimeSpan ChallengeTimeout = TimeSpan.FromMinutes(5);
 
     public MfaChallengeOrchestrator(
         MfaSrvDbContext db,
-        IEnumerable<IMfaProvider> providers,
+        MfaProviderRegistry providers,
+        EnrollmentCache enrollments,
+        ChallengeStateStore challenges,
+        ChallengeCompletionEngine completions,
+        RiskScoringService riskScoring,
         IConfiguration configuration,
         ILogger<MfaChallengeOrchestrator> logger)
     {
         _db = db;
         _providers = providers;
+        _enrollments = enrollments;
+        _challenges = challenges;
+        _completions = completions;
+        _riskScoring = riskScoring;
         _logger = logger;
 
         var keyBase64 = configuration["MfaSrv:EncryptionKey"];
@@ -33,7 +58,7 @@ public class MfaChallengeOrchestrator : IMfaChallengeOrchestrator
 
     public async Task<ChallengeResult> IssueChallengeAsync(string userId, MfaMethod method, ChallengeContext context, CancellationToken ct = default)
     {
-        var provider = _providers.FirstOrDefault(p => p.MethodId == method.ToString().ToUpperInvariant());
+        var provider = _providers.Get(method);
         if (provider == null)
         {
             return new ChallengeResult
@@ -44,8 +69,7 @@ public class MfaChallengeOrchestrator : IMfaChallengeOrchestrator
             };
         }
 
-        var enrollment = await _db.MfaEnrollments
-            .FirstOrDefaultAsync(e => e.UserId == userId && e.Method == method && e.Status == EnrollmentStatus.Active, ct);
+        var enrollment = await _enrollments.GetActiveAsync(_db, userId, method, ct);
 
         if (enrollment == null)
         {
@@ -81,8 +105,12 @@ public class MfaChallengeOrchestrator : IMfaChallengeOrchestrator
                 ExpiresAt = DateTimeOffset.UtcNow.Add(ChallengeTimeout)
             };
 
-            _db.MfaChallenges.Add(challenge);
-            await _db.SaveChangesAsync(ct);
+            await _challenges.AddAsync(_db, challenge, ct);
+
+            // The outcome may arrive after this request's database context is gone
+            if (provider.SupportsAsynchronousVerification)
+                _completions.OnCompleted(challenge.Id, outcome => _ = _challenges.RunInScopeAsync(
+                    challenge.Id, db => ApplyOutcomeAsync(db, challenge, outcome, CancellationToken.None)));
 
             _logger.LogInformation("Issued {Method} challenge {ChallengeId} for user {UserId}",
                 method, challenge.Id, userId);
@@ -93,40 +121,60 @@ public class MfaChallengeOrchestrator : IMfaChallengeOrchestrator
 
     public async Task<VerificationResult> VerifyChallengeAsync(string challengeId, string response, CancellationToken ct = default)
     {
-        var challenge = await _db.MfaChallenges.FindAsync(new object[] { challengeId }, ct);
+        // Not re-read first: counting the attempt against the row refuses a settled challenge
+        var challenge = await _challenges.GetCachedAsync(_db, challengeId, ct);
         if (challenge == null)
         {
             return new VerificationResult { Success = false, Error = "Challenge not found" };
         }
 
-        if (challenge.Status != ChallengeStatus.Issued)
+        string userId;
+        string enrollmentId;
+        MfaMethod method;
+        DateTimeOffset expiresAt;
+        int maxAttempts;
+        lock (challenge)
         {
-            return new VerificationResult { Success = false, Error = $"Challenge is in state: {challenge.Status}" };
+            userId = challenge.UserId;
+            enrollmentId = challenge.EnrollmentId;
+            method = challenge.Method;
+            expiresAt = challenge.ExpiresAt;
+            maxAttempts = challenge.MaxAttempts;
         }
 
-        if (challenge.ExpiresAt < DateTimeOffset.UtcNow)
+        if (expiresAt < DateTimeOffset.UtcNow)
         {
-            challenge.Status = ChallengeStatus.Expired;
-            await _db.SaveChangesAsync(ct);
-            return new VerificationResult { Success = false, Error = "Challenge expired" };
+            if (await _challenges.TrySettleAsync(_db, challenge, ChallengeStatus.Expired, null, ct))
+                return new VerificationResult { Success = false, Error = "Challenge expired" };
+            return StateError(challenge);
         }
 
-        if (challenge.AttemptCount >= challenge.MaxAttempts)
+        // Counted before the provider runs, so concurrent guesses on any instance cannot exceed MaxAttempts
+        if (!await _challenges.TryCountAttemptAsync(_db, challenge, ct))
         {
-            challenge.Status = ChallengeStatus.Failed;
-            await _db.SaveChangesAsync(ct);
-            return new VerificationResult { Success = false, Error = "Max attempts exceeded", ShouldLockout = true };
+            bool exhausted;
+            lock (challenge)
+                exhausted = challenge.Status == ChallengeStatus.Issued && challenge.AttemptCount >= challenge.MaxAttempts;
+
+            if (exhausted)
+            {
+                await _challenges.TrySettleAsync(_db, challenge, ChallengeStatus.Failed, null, ct);
+                return new VerificationResult { Success = false, Error = "Max attempts exceeded", ShouldLockout = true };
+            }
+            return StateError(challenge);
         }
 
-        challenge.AttemptCount++;
+        int attempt;
+        lock (challenge)
+            attempt = challenge.AttemptCount;
 
-        var enrollment = await _db.MfaEnrollments.FindAsync(new object[] { challenge.EnrollmentId }, ct);
+        var enrollment = await _enrollments.GetByIdAsync(_db, userId, enrollmentId, ct);
         if (enrollment == null)
         {
             return new VerificationResult { Success = false, Error = "Enrollment not found" };
         }
 
-        var provider = _providers.FirstOrDefault(p => p.MethodId == challenge.Method.ToString().ToUpperInvariant());
+        var provider = _providers.Get(method);
         if (provider == null)
         {
             return new VerificationResult { Success = false, Error = "Provider not found" };
@@ -135,60 +183,141 @@ public class MfaChallengeOrchestrator : IMfaChallengeOrchestrator
         var verificationCtx = new VerificationContext
         {
             ChallengeId = challengeId,
-            UserId = challenge.UserId,
+            UserId = userId,
             EncryptedSecret = enrollment.EncryptedSecret,
-            SecretNonce = enrollment.SecretNonce
+            SecretNonce = enrollment.SecretNonce,
+            EnrollmentId = enrollment.Id,
+            EncryptionKey = _encryptionKey
         };
 
         var result = await provider.VerifyAsync(verificationCtx, response, ct);
 
         if (result.Success)
         {
-            challenge.Status = ChallengeStatus.Approved;
-            challenge.RespondedAt = DateTimeOffset.UtcNow;
-            enrollment.LastUsedAt = DateTimeOffset.UtcNow;
-            _logger.LogInformation("Challenge {ChallengeId} verified successfully for user {UserId}", challengeId, challenge.UserId);
+            // A concurrent verification, on this or another instance, already settled the
+            // challenge; only one may create a session
+            if (!await _challenges.TrySettleAsync(_db, challenge, ChallengeStatus.Approved, DateTimeOffset.UtcNow, ct))
+                return StateError(challenge);
+        }
+        else
+        {
+            await _challenges.TrySettleAsync(_db, challenge, ChallengeStatus.Failed, null, ct, onlyIfExhausted: true);
+        }
+
+        if (result.Success)
+        {
+            _challenges.MarkEnrollmentUsed(enrollment.Id, DateTimeOffset.UtcNow);
+            _logger.LogInformation("Challenge {ChallengeId} verified successfully for user {UserId}", challengeId, userId);
         }
         else
         {
-            if (challenge.AttemptCount >= challenge.MaxAttempts)
-                challenge.Status = ChallengeStatus.Failed;
+            _riskScoring.RecordFailure(userId, DateTimeOffset.UtcNow);
             _logger.LogWarning("Challenge {ChallengeId} verification failed (attempt {Attempt}/{Max})",
-                challengeId, challenge.AttemptCount, challenge.MaxAttempts);
+                challengeId, attempt, maxAttempts);
         }
 
-        await _db.SaveChangesAsync(ct);
         return result;
     }
 
     public async Task<AsyncVerificationStatus> CheckChallengeStatusAsync(string challengeId, CancellationToken ct = default)
     {
-        var challenge = await _db.MfaChallenges.FindAsync(new object[] { challengeId }, ct);
+        var challenge = await _challenges.GetAsync(_db, challengeId, ct);
         if (challenge == null)
         {
             return new AsyncVerificationStatus { Status = ChallengeStatus.Failed, Error = "Challenge not found" };
         }
 
-        if (challenge.ExpiresAt < DateTimeOffset.UtcNow && challenge.Status == ChallengeStatus.Issued)
+        ChallengeStatus status;
+        MfaMethod method;
+        DateTimeOffset expiresAt;
+        lock (challenge)
         {
-            challenge.Status = ChallengeStatus.Expired;
-            await _db.SaveChangesAsync(ct);
+            status = challenge.Status;
+            method = challenge.Method;
+            expiresAt = challenge.ExpiresAt;
+        }
+
+        if (status == ChallengeStatus.Issued && expiresAt < DateTimeOffset.UtcNow)
+        {
+            await _challenges.TrySettleAsync(_db, challenge, ChallengeStatus.Expired, null, ct);
+            lock (challenge)
+                status = challenge.Status;
         }
 
         // For async providers (push), also check with the provider
-        var provider = _providers.FirstOrDefault(p => p.MethodId == challenge.Method.ToString().ToUpperInvariant());
-        if (provider != null && provider.SupportsAsynchronousVerification && challenge.Status == ChallengeStatus.Issued)
+        var provider = _providers.Get(method);
+        if (provider != null && provider.SupportsAsynchronousVerification && status == ChallengeStatus.Issued)
         {
             var providerStatus = await provider.CheckAsyncStatusAsync(challengeId, ct);
             if (providerStatus.Status != ChallengeStatus.Issued)
+                await ApplyOutcomeAsync(_db, challenge, providerStatus, ct);
+            return providerStatus;
+        }
+
+        return new AsyncVerificationStatus { Status = status };
+    }
+
+    public async Task<AsyncVerificationStatus> WaitForChallengeStatusAsync(string challengeId, TimeSpan timeout, CancellationToken ct = default)
+    {
+        var status = await CheckChallengeStatusAsync(challengeId, ct);
+        if (status.Status != ChallengeStatus.Issued || timeout <= TimeSpan.Zero)
+            return status;
+
+        var challenge = await _challenges.GetCachedAsync(_db, challengeId, ct);
+        if (challenge == null)
+            return status;
+
+        MfaMethod method;
+        DateTimeOffset expiresAt;
+        lock (challenge)
+        {
+            method = challenge.Method;
+            expiresAt = challenge.ExpiresAt;
+        }
+
+        var provider = _providers.Get(method);
+        if (provider == null || !provider.SupportsAsynchronousVerification)
+            return status;
+
+        // No point waiting past expiry; the check below then reports the challenge expired
+        var untilExpiry = expiresAt - DateTimeOffset.UtcNow;
+        var wait = untilExpiry < timeout ? untilExpiry : timeout;
+        if (wait > TimeSpan.Zero)
+        {
+            var outcome = await _completions.WaitAsync(challengeId, wait, ct);
+            if (outcome != null)
             {
-                challenge.Status = providerStatus.Status;
-                challenge.RespondedAt = DateTimeOffset.UtcNow;
-                await _db.SaveChangesAsync(ct);
+                await ApplyOutcomeAsync(_db, challenge, outcome, ct);
+                return outcome;
             }
-            return providerStatus;
         }
 
-        return new AsyncVerificationStatus { Status = challenge.Status };
+        return await CheckChallengeStatusAsync(challengeId, ct);
+    }
+
+    public Task<MfaChallenge?> GetChallengeAsync(string challengeId, CancellationToken ct = default)
+    {
+        return _challenges.GetSnapshotAsync(_db, challengeId, ct);
+    }
+
+    /// <summary>
+    /// Settles an issued challenge with an outcome reported by its provider. A challenge that
+    /// is already settled (verified, expired, failed), here or on another instance, keeps its
+    /// state, so the outcome is applied and a denial recorded at most once.
+    /// </summary>
+    private async Task ApplyOutcomeAsync(
+        MfaSrvDbContext db, MfaChallenge challenge, AsyncVerificationStatus outcome, CancellationToken ct)
+    {
+        if (!await _challenges.TrySettleAsync(db, challenge, outcome.Status, DateTimeOffset.UtcNow, ct))
+            return;
+
+        if (outcome.Status == ChallengeStatus.Denied)
+            _riskScoring.RecordFailure(challenge.UserId, DateTimeOffset.UtcNow);
+    }
+
+    private static VerificationResult StateError(MfaChallenge challenge)
+    {
+        lock (challenge)
+            return new VerificationResult { Success = false, Error = $"Challenge is in state: {challenge.Status}" };
     }
 }
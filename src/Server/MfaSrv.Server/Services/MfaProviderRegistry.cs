@@ -0,0 +1,39 @@
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Per-method dispatch table over the registered <see cref="IMfaProvider"/>s, built once at
+/// startup. Providers are matched to <see cref="MfaMethod"/> values by their upper-cased
+/// <see cref="IMfaProvider.MethodId"/>; the first provider registered for a method wins.
+/// </summary>
+public class MfaProviderRegistry
+{
+    private readonly IMfaProvider?[] _byMethod;
+
+    public MfaProviderRegistry(IEnumerable<IMfaProvider> providers)
+    {
+        var methods = Enum.GetValues<MfaMethod>();
+        _byMethod = new IMfaProvider?[methods.Max(m => (int)m) + 1];
+
+        var byId = new Dictionary<string, IMfaProvider>(StringComparer.Ordinal);
+        foreach (var provider in providers)
+            byId.TryAdd(provider.MethodId, provider);
+
+        foreach (var method in methods)
+        {
+            if (byId.TryGetValue(method.ToString().ToUpperInvariant(), out var provider))
+                _byMethod[(int)method] = provider;
+        }
+    }
+
+    /// <summary>
+    /// Returns the provider for <paramref name="method"/>, or null if none is registered.
+    /// </summary>
+    public IMfaProvider? Get(MfaMethod method)
+    {
+        var index = (int)method;
+        return (uint)index < (uint)_byMethod.Length ? _byMethod[index] : null;
+    }
+}
@@ -112,18 +112,22 @@ public class MfaSrvHealthCheck : IHealthCheck
 /// Readiness check - returns healthy only when this instance is ready to serve traffic.
 /// For the active instance: database connected and leader lease held.
 /// For standby: always ready (can serve read-only health/metrics endpoints).
+/// For an evaluation node: once its replica of the leader's state is complete.
 /// </summary>
 public class MfaSrvReadinessCheck : IHealthCheck
 {
     private readonly IServiceScopeFactory _scopeFactory;
     private readonly LeaderElectionService _leaderElection;
+    private readonly EvaluationReplica _replica;
 
     public MfaSrvReadinessCheck(
         IServiceScopeFactory scopeFactory,
-        LeaderElectionService leaderElection)
+        LeaderElectionService leaderElection,
+        EvaluationReplica replica)
     {
         _scopeFactory = scopeFactory;
         _leaderElection = leaderElection;
+        _replica = replica;
     }
 
     public async Task<HealthCheckResult> CheckHealthAsync(
@@ -135,6 +139,16 @@ public class MfaSrvReadinessCheck : IHealthCheck
             ["instance_id"] = _leaderElection.InstanceId
         };
 
+        if (_replica.IsEnabled)
+        {
+            data["replica_policy_version"] = _replica.PolicyVersion;
+            data["replica_sessions"] = _replica.SessionCount;
+
+            return _replica.IsReady
+                ? HealthCheckResult.Healthy("Replica ready to serve evaluations", data)
+                : HealthCheckResult.Unhealthy("Replica not synchronized with the leader", data: data);
+        }
+
         try
         {
             using var scope = _scopeFactory.CreateScope();
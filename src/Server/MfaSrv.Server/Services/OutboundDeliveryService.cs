@@ -0,0 +1,242 @@
+using System.Diagnostics;
+using System.Threading.Channels;
+using System.Threading.RateLimiting;
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Challenges;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.ValueObjects;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Delivers SMS codes, e-mail codes and push notifications off the logon path. Providers
+/// enqueue a message while issuing a challenge and return; this service sends it through the
+/// channel's <see cref="IOutboundGateway"/>.
+///
+/// Each channel has its own bounded queue, a token bucket (<see cref="DeliveryGatewaySettings.RatePerSecond"/>,
+/// <see cref="DeliveryGatewaySettings.Burst"/>) so a burst of logons cannot exceed the gateway's
+/// rate limit, and at most <see cref="DeliveryGatewaySettings.MaxConcurrency"/> sends in flight
+/// over the gateway's pooled connections. Failed sends are retried with exponential backoff
+/// and jitter; messages whose challenge has expired are dropped. A push that finally fails
+/// completes its challenge as failed so waiters do not wait for the expiry.
+///
+/// Enqueue-to-delivery latency and gateway call duration are exported per channel as
+/// <c>mfasrv_delivery_latency_seconds</c> and <c>mfasrv_delivery_send_duration_seconds</c>.
+/// </summary>
+public class OutboundDeliveryService : BackgroundService, IOutboundDeliveryQueue
+{
+    private readonly Dictionary<DeliveryChannel, Lane> _lanes = new();
+    private readonly ChallengeCompletionEngine _completions;
+    private readonly DeliverySettings _settings;
+    private readonly ILogger<OutboundDeliveryService> _logger;
+
+    public OutboundDeliveryService(
+        IEnumerable<IOutboundGateway> gateways,
+        ChallengeCompletionEngine completions,
+        IOptions<DeliverySettings> settings,
+        ILogger<OutboundDeliveryService> logger)
+    {
+        _completions = completions;
+        _settings = settings.Value;
+        _logger = logger;
+
+        foreach (var gateway in gateways)
+            _lanes[gateway.Channel] = new Lane(gateway, GatewaySettings(gateway.Channel), _settings.QueueCapacity);
+    }
+
+    /// <summary>
+    /// Messages waiting to be sent on <paramref name="channel"/>, excluding scheduled retries.
+    /// </summary>
+    public int QueueDepth(DeliveryChannel channel) =>
+        _lanes.TryGetValue(channel, out var lane) ? lane.Queue.Reader.Count : 0;
+
+    public bool TryEnqueue(OutboundMessage message)
+    {
+        var channel = ChannelLabel(message.Channel);
+        if (!_lanes.TryGetValue(message.Channel, out var lane))
+        {
+            _logger.LogError("No gateway registered for {Channel} delivery", message.Channel);
+            return false;
+        }
+
+        if (!lane.Queue.Writer.TryWrite(new Delivery(message, 1)))
+        {
+            MetricsService.DeliveriesTotal.WithLabels(channel, "queue_full").Inc();
+            return false;
+        }
+
+        MetricsService.DeliveryQueueDepth.WithLabels(channel).Set(lane.Queue.Reader.Count);
+        return true;
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        try
+        {
+            await Task.WhenAll(_lanes.Values.Select(lane => RunLaneAsync(lane, stoppingToken)));
+        }
+        catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+        {
+        }
+
+        var undelivered = _lanes.Values.Sum(lane => lane.Queue.Reader.Count);
+        if (undelivered > 0)
+            _logger.LogWarning("Outbound delivery stopped with {Count} messages undelivered", undelivered);
+    }
+
+    private async Task RunLaneAsync(Lane lane, CancellationToken ct)
+    {
+        var channel = ChannelLabel(lane.Gateway.Channel);
+
+        await foreach (var delivery in lane.Queue.Reader.ReadAllAsync(ct))
+        {
+            MetricsService.DeliveryQueueDepth.WithLabels(channel).Set(lane.Queue.Reader.Count);
+
+            if (delivery.Message.ExpiresAt < DateTimeOffset.UtcNow)
+            {
+                MetricsService.DeliveriesTotal.WithLabels(channel, "expired").Inc();
+                continue;
+            }
+
+            // Single reader and a queue limit of one: the acquire waits for a token, never fails
+            using (await lane.RateLimiter.AcquireAsync(1, ct))
+            {
+            }
+
+            await lane.Concurrency.WaitAsync(ct);
+            _ = SendAsync(lane, delivery, ct);
+        }
+    }
+
+    private async Task SendAsync(Lane lane, Delivery delivery, CancellationToken ct)
+    {
+        var channel = ChannelLabel(lane.Gateway.Channel);
+        var message = delivery.Message;
+        bool sent;
+
+        var stopwatch = Stopwatch.StartNew();
+        try
+        {
+            sent = await lane.Gateway.SendAsync(message, ct);
+        }
+        catch (Exception ex)
+        {
+            if (!ct.IsCancellationRequested)
+                _logger.LogWarning(ex, "{Channel} delivery for challenge {ChallengeId} failed", message.Channel, message.ChallengeId);
+            sent = false;
+        }
+        finally
+        {
+            lane.Concurrency.Release();
+        }
+
+        MetricsService.DeliverySendDuration.WithLabels(channel).Observe(stopwatch.Elapsed.TotalSeconds);
+
+        if (sent)
+        {
+            MetricsService.DeliveriesTotal.WithLabels(channel, "delivered").Inc();
+            MetricsService.DeliveryLatency.WithLabels(channel)
+                .Observe((DateTimeOffset.UtcNow - message.EnqueuedAt).TotalSeconds);
+            return;
+        }
+
+        if (ct.IsCancellationRequested)
+            return;
+
+        if (delivery.Attempt < _settings.MaxAttempts)
+        {
+            MetricsService.DeliveriesTotal.WithLabels(channel, "retried").Inc();
+            await Task.Delay(RetryDelay(delivery.Attempt), CancellationToken.None);
+            if (!lane.Queue.Writer.TryWrite(delivery with { Attempt = delivery.Attempt + 1 }))
+                MetricsService.DeliveriesTotal.WithLabels(channel, "queue_full").Inc();
+            return;
+        }
+
+        MetricsService.DeliveriesTotal.WithLabels(channel, "failed").Inc();
+        _logger.LogError("{Channel} delivery for challenge {ChallengeId} failed after {Attempts} attempts",
+            message.Channel, message.ChallengeId, delivery.Attempt);
+
+        if (message.Channel == DeliveryChannel.Push && message.ChallengeId != null)
+        {
+            _completions.Complete(message.ChallengeId, new AsyncVerificationStatus
+            {
+                Status = ChallengeStatus.Failed,
+                Error = "Failed to deliver push notification"
+            });
+        }
+    }
+
+    /// <summary>
+    /// Backoff before retry number <paramref name="attempt"/>: the base delay doubled per
+    /// previous retry, scaled by a random factor in [0.5, 1.5) so retries of a gateway outage
+    /// do not arrive in lockstep.
+    /// </summary>
+    public TimeSpan RetryDelay(int attempt)
+    {
+        var backoff = _settings.RetryBaseDelayMs * Math.Pow(2, Math.Max(0, attempt - 1));
+        return TimeSpan.FromMilliseconds(backoff * (0.5 + Random.Shared.NextDouble()));
+    }
+
+    public override void Dispose()
+    {
+        foreach (var lane in _lanes.Values)
+        {
+            lane.RateLimiter.Dispose();
+            lane.Concurrency.Dispose();
+        }
+        base.Dispose();
+    }
+
+    private DeliveryGatewaySettings GatewaySettings(DeliveryChannel channel) => channel switch
+    {
+        DeliveryChannel.Sms => _settings.Sms,
+        DeliveryChannel.Email => _settings.Email,
+        _ => _settings.Push
+    };
+
+    private static string ChannelLabel(DeliveryChannel channel) => channel switch
+    {
+        DeliveryChannel.Sms => "sms",
+        DeliveryChannel.Email => "email",
+        _ => "push"
+    };
+
+    private sealed record Delivery(OutboundMessage Message, int Attempt);
+
+    private sealed class Lane
+    {
+        public Lane(IOutboundGateway gateway, DeliveryGatewaySettings settings, int capacity)
+        {
+            Gateway = gateway;
+            Queue = Channel.CreateBounded<Delivery>(new BoundedChannelOptions(Math.Max(1, capacity))
+            {
+                FullMode = BoundedChannelFullMode.Wait,
+                SingleReader = true,
+                SingleWriter = false
+            });
+            Concurrency = new SemaphoreSlim(Math.Max(1, settings.MaxConcurrency));
+
+            // Refill in small steps (about 20 per second) rather than once a second so sends
+            // are spread evenly instead of released in one-second bursts
+            var rate = Math.Max(1, settings.RatePerSecond);
+            var tokensPerPeriod = Math.Max(1, rate / 20);
+            RateLimiter = new TokenBucketRateLimiter(new TokenBucketRateLimiterOptions
+            {
+                TokenLimit = Math.Max(1, settings.Burst),
+                TokensPerPeriod = tokensPerPeriod,
+                ReplenishmentPeriod = TimeSpan.FromSeconds((double)tokensPerPeriod / rate),
+                QueueLimit = 1,
+                QueueProcessingOrder = QueueProcessingOrder.OldestFirst,
+                AutoReplenishment = true
+            });
+        }
+
+        public IOutboundGateway Gateway { get; }
+        public Channel<Delivery> Queue { get; }
+        public SemaphoreSlim Concurrency { get; }
+        public TokenBucketRateLimiter RateLimiter { get; }
+    }
+}
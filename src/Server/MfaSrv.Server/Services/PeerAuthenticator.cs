@@ -0,0 +1,174 @@
+using System.Collections.Concurrent;
+using System.Net;
+using System.Net.Sockets;
+using System.Security.Cryptography;
+using Google.Protobuf;
+using Microsoft.Extensions.Options;
+using MfaSrv.Protocol;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Authenticates calls between server instances: leader election heartbeats and challenge
+/// store replication.
+///
+/// Messages are signed with HMAC-SHA256 under <see cref="HaSettings.PeerSecret"/>, shared by
+/// every instance. The MAC covers the serialized message including its signing time; a message
+/// is accepted at most once, and only within <see cref="MaxClockSkew"/> of when it was signed,
+/// so a captured message cannot be replayed later. Without a secret nothing verifies and peer
+/// endpoints refuse every call.
+///
+/// Receivers also check that the caller's address is one of the configured peers' hosts, as
+/// resolved through DNS (cached for <see cref="AddressCacheDuration"/>).
+/// </summary>
+public sealed class PeerAuthenticator
+{
+    public const int MinSecretBytes = 32;
+    public static readonly TimeSpan MaxClockSkew = TimeSpan.FromSeconds(30);
+    public static readonly TimeSpan AddressCacheDuration = TimeSpan.FromMinutes(1);
+
+    private readonly byte[]? _key;
+
+    // Signatures accepted within the skew window, with their signing time
+    private readonly ConcurrentDictionary<string, long> _seen = new(StringComparer.Ordinal);
+    private long _nextPruneMs;
+
+    private readonly ConcurrentDictionary<string, ResolvedHost> _hosts = new(StringComparer.OrdinalIgnoreCase);
+
+    public PeerAuthenticator(IOptions<HaSettings> settings)
+    {
+        var secret = settings.Value.PeerSecret;
+        if (string.IsNullOrEmpty(secret))
+            return;
+
+        var key = Convert.FromBase64String(secret);
+        if (key.Length < MinSecretBytes)
+            throw new InvalidOperationException($"HA:PeerSecret must be at least {MinSecretBytes} bytes, base64-encoded");
+        _key = key;
+    }
+
+    /// <summary>
+    /// True when a peer secret is configured; without one, messages cannot be signed or verified.
+    /// </summary>
+    public bool IsConfigured => _key != null;
+
+    public void Sign(ISignedPeerMessage message) => Sign(message, DateTimeOffset.UtcNow);
+
+    /// <summary>
+    /// Stamps <paramref name="message"/> with <paramref name="now"/> and signs it.
+    /// </summary>
+    public void Sign(ISignedPeerMessage message, DateTimeOffset now)
+    {
+        if (_key == null)
+            throw new InvalidOperationException("HA:PeerSecret is not configured");
+
+        message.SignedAtUnixMs = now.ToUnixTimeMilliseconds();
+        message.Signature = ByteString.Empty;
+        message.Signature = UnsafeByteOperations.UnsafeWrap(ComputeMac(message));
+    }
+
+    public bool Verify(ISignedPeerMessage message) => Verify(message, DateTimeOffset.UtcNow);
+
+    /// <summary>
+    /// True if <paramref name="message"/> was signed with the peer secret within
+    /// <see cref="MaxClockSkew"/> of <paramref name="now"/> and has not been accepted before.
+    /// </summary>
+    public bool Verify(ISignedPeerMessage message, DateTimeOffset now)
+    {
+        var signature = message.Signature;
+        if (_key == null || signature.Length != HMACSHA256.HashSizeInBytes)
+            return false;
+
+        var nowMs = now.ToUnixTimeMilliseconds();
+        var skewMs = (long)MaxClockSkew.TotalMilliseconds;
+        if (message.SignedAtUnixMs < nowMs - skewMs || message.SignedAtUnixMs > nowMs + skewMs)
+            return false;
+
+        byte[] expected;
+        message.Signature = ByteString.Empty;
+        try
+        {
+            expected = ComputeMac(message);
+        }
+        finally
+        {
+            message.Signature = signature;
+        }
+
+        if (!CryptographicOperations.FixedTimeEquals(expected, signature.Span))
+            return false;
+
+        PruneSeen(nowMs);
+        return _seen.TryAdd(Convert.ToBase64String(signature.Span), message.SignedAtUnixMs);
+    }
+
+    public Task<bool> IsPeerAddressAsync(IPAddress? address, IReadOnlyCollection<string> peerUrls, CancellationToken ct) =>
+        IsPeerAddressAsync(address, peerUrls, DateTimeOffset.UtcNow, ct);
+
+    /// <summary>
+    /// True if <paramref name="address"/> is an address of one of the hosts in
+    /// <paramref name="peerUrls"/>. A host is resolved again once its cached addresses are
+    /// older than <see cref="AddressCacheDuration"/>.
+    /// </summary>
+    public async Task<bool> IsPeerAddressAsync(
+        IPAddress? address, IReadOnlyCollection<string> peerUrls, DateTimeOffset now, CancellationToken ct)
+    {
+        if (address == null)
+            return false;
+        if (address.IsIPv4MappedToIPv6)
+            address = address.MapToIPv4();
+
+        foreach (var url in peerUrls)
+        {
+            var host = Uri.TryCreate(url, UriKind.Absolute, out var uri) ? uri.DnsSafeHost : url;
+            if (host.Length == 0)
+                continue;
+
+            if (!_hosts.TryGetValue(host, out var resolved) || now - resolved.ResolvedAt > AddressCacheDuration)
+            {
+                resolved = new ResolvedHost(await ResolveAsync(host, ct), now);
+                _hosts[host] = resolved;
+            }
+
+            if (resolved.Addresses.Contains(address))
+                return true;
+        }
+
+        return false;
+    }
+
+    private byte[] ComputeMac(ISignedPeerMessage message) =>
+        HMACSHA256.HashData(_key!, message.ToByteArray());
+
+    private void PruneSeen(long nowMs)
+    {
+        // At most once a second; a signature older than the skew window fails the time check anyway
+        var next = Interlocked.Read(ref _nextPruneMs);
+        if (nowMs < next || Interlocked.CompareExchange(ref _nextPruneMs, nowMs + 1000, next) != next)
+            return;
+
+        var cutoffMs = nowMs - (long)MaxClockSkew.TotalMilliseconds;
+        foreach (var (signature, signedAtMs) in _seen)
+        {
+            if (signedAtMs < cutoffMs)
+                _seen.TryRemove(signature, out _);
+        }
+    }
+
+    private static async Task<IPAddress[]> ResolveAsync(string host, CancellationToken ct)
+    {
+        if (IPAddress.TryParse(host, out var literal))
+            return new[] { literal.IsIPv4MappedToIPv6 ? literal.MapToIPv4() : literal };
+
+        try
+        {
+            return await Dns.GetHostAddressesAsync(host, ct);
+        }
+        catch (SocketException)
+        {
+            return Array.Empty<IPAddress>();
+        }
+    }
+
+    private sealed record ResolvedHost(IPAddress[] Addresses, DateTimeOffset ResolvedAt);
+}
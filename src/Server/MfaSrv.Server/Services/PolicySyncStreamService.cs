@@ -1,31 +1,61 @@
 using System.Collections.Concurrent;
 using System.Threading.Channels;
+using Google.Protobuf;
+using Google.Protobuf.WellKnownTypes;
+using MfaSrv.Protocol;
 using Microsoft.Extensions.Logging;
 
 namespace MfaSrv.Server.Services;
 
 /// <summary>
 /// Manages server-side policy sync streaming subscriptions.
-/// When a DC Agent subscribes, it receives current policies as an initial snapshot
-/// followed by real-time change notifications via a bounded channel.
+///
+/// Every policy change gets the next policy-set <see cref="Version"/> and is built into one
+/// <see cref="PolicyUpdate"/> message that all subscriber channels share; the policy JSON is
+/// serialized once by the caller and never per agent. The last <see cref="DeltaLogCapacity"/>
+/// changes are kept so a reconnecting agent receives only what it missed since the version
+/// it last applied. Agents that are further behind, or that last synced with a different
+/// server process (<see cref="Epoch"/>), receive one snapshot message instead; the snapshot
+/// is built once per version and shared by every agent that needs it.
 /// </summary>
 public class PolicySyncStreamService
 {
-    private readonly ConcurrentDictionary<string, Channel<PolicyChangeNotification>> _subscribers = new();
+    public const int DeltaLogCapacity = 1024;
+
+    private readonly ConcurrentDictionary<string, Channel<PolicyUpdate>> _subscribers = new();
     private readonly ILogger<PolicySyncStreamService> _logger;
 
+    private readonly object _versionLock = new();
+    private readonly PolicyUpdate?[] _deltaLog = new PolicyUpdate?[DeltaLogCapacity];
+    private ulong _version;
+    private PolicyUpdate? _snapshot;
+    private readonly SemaphoreSlim _snapshotGate = new(1, 1);
+
     public PolicySyncStreamService(ILogger<PolicySyncStreamService> logger)
     {
         _logger = logger;
     }
 
+    /// <summary>
+    /// Identifies this process's version sequence. Versions from another epoch are not comparable.
+    /// </summary>
+    public string Epoch { get; } = Guid.NewGuid().ToString("N");
+
+    /// <summary>
+    /// Current policy-set version; incremented once per policy change.
+    /// </summary>
+    public ulong Version
+    {
+        get { lock (_versionLock) return _version; }
+    }
+
     /// <summary>
     /// Subscribes an agent to receive policy change notifications.
     /// If the agent was already subscribed, the old channel is completed and replaced.
     /// </summary>
-    public Channel<PolicyChangeNotification> Subscribe(string agentId)
+    public Channel<PolicyUpdate> Subscribe(string agentId)
     {
-        var channel = Channel.CreateBounded<PolicyChangeNotification>(new BoundedChannelOptions(100)
+        var channel = Channel.CreateBounded<PolicyUpdate>(new BoundedChannelOptions(100)
         {
             FullMode = BoundedChannelFullMode.DropOldest,
             SingleReader = true,
@@ -55,25 +85,158 @@ public class PolicySyncStreamService
     }
 
     /// <summary>
-    /// Broadcasts a policy change notification to all connected agents.
+    /// Records a policy change under the next version and broadcasts it to all connected agents.
+    /// </summary>
+    public Task NotifyPolicyChangeAsync(string policyId, string policyJson, bool deleted, DateTimeOffset updatedAt)
+    {
+        lock (_versionLock)
+        {
+            var update = new PolicyUpdate
+            {
+                PolicyId = policyId,
+                PolicyJson = deleted ? string.Empty : policyJson,
+                Deleted = deleted,
+                UpdatedAt = Timestamp.FromDateTimeOffset(updatedAt),
+                Version = ++_version,
+                Epoch = Epoch
+            };
+
+            _deltaLog[_version % DeltaLogCapacity] = update;
+            _snapshot = null;
+
+            // Broadcast under the lock so every channel receives changes in version order
+            Broadcast(update);
+        }
+
+        if (_subscribers.Count > 0)
+        {
+            _logger.LogDebug(
+                "Policy change notification for {PolicyId} broadcast to {Count} agents",
+                policyId, _subscribers.Count);
+        }
+
+        return Task.CompletedTask;
+    }
+
+    /// <summary>
+    /// Returns the changes after <paramref name="lastVersion"/> in version order, or false if
+    /// the agent must be sent a snapshot (other epoch, too far behind, or ahead of this server).
     /// </summary>
-    public async Task NotifyPolicyChangeAsync(string policyId, string policyJson, bool deleted, DateTimeOffset updatedAt)
+    public bool TryGetChangesSince(string epoch, ulong lastVersion, out IReadOnlyList<PolicyUpdate> changes)
     {
-        var notification = new PolicyChangeNotification
+        changes = Array.Empty<PolicyUpdate>();
+        if (epoch != Epoch)
+            return false;
+
+        lock (_versionLock)
         {
-            PolicyId = policyId,
-            PolicyJson = policyJson,
-            Deleted = deleted,
-            UpdatedAt = updatedAt
+            if (lastVersion > _version || _version - lastVersion > DeltaLogCapacity)
+                return false;
+
+            var list = new List<PolicyUpdate>((int)(_version - lastVersion));
+            for (var v = lastVersion + 1; v <= _version; v++)
+                list.Add(_deltaLog[v % DeltaLogCapacity]!);
+            changes = list;
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Returns a snapshot of all enabled policies, loading it with <paramref name="loadPolicies"/>
+    /// only if no snapshot has been built since the last change. Concurrent callers share one load.
+    /// </summary>
+    /// <remarks>
+    /// The snapshot is labelled with the version current when loading started. A change that
+    /// commits during the load may already be included; replaying its delta afterwards is
+    /// harmless because every delta carries the policy's full state.
+    /// </remarks>
+    public async Task<PolicyUpdate> GetSnapshotAsync(
+        Func<CancellationToken, Task<IReadOnlyList<PolicyEntry>>> loadPolicies,
+        CancellationToken ct = default)
+    {
+        lock (_versionLock)
+        {
+            if (_snapshot != null)
+                return _snapshot;
+        }
+
+        await _snapshotGate.WaitAsync(ct);
+        try
+        {
+            ulong version;
+            lock (_versionLock)
+            {
+                if (_snapshot != null)
+                    return _snapshot;
+                version = _version;
+            }
+
+            var policies = await loadPolicies(ct);
+            var snapshot = new PolicyUpdate
+            {
+                Version = version,
+                Epoch = Epoch,
+                Snapshot = new PolicySnapshot { Policies = { policies } }
+            };
+
+            lock (_versionLock)
+            {
+                if (_version == version)
+                    _snapshot = snapshot;
+            }
+
+            _logger.LogDebug("Built policy snapshot v{Version} with {Count} policies", version, policies.Count);
+            return snapshot;
+        }
+        finally
+        {
+            _snapshotGate.Release();
+        }
+    }
+
+    /// <summary>
+    /// Broadcasts a session revocation filter snapshot or delta to all connected agents.
+    /// Called by <see cref="SessionRevocationService"/> in version order.
+    /// </summary>
+    public void NotifyRevocationFilterChange(RevocationFilterUpdate update)
+    {
+        Broadcast(new PolicyUpdate { RevocationFilter = ToProto(update) });
+    }
+
+    /// <summary>
+    /// Broadcasts the chunks of a new directory snapshot, in order, to all connected agents.
+    /// Called by <see cref="DirectorySnapshotService"/>.
+    /// </summary>
+    public void NotifyDirectoryChange(IReadOnlyList<PolicyUpdate> chunks)
+    {
+        foreach (var chunk in chunks)
+            Broadcast(chunk);
+    }
+
+    public static MfaSrv.Protocol.RevocationFilterUpdate ToProto(RevocationFilterUpdate update)
+    {
+        var proto = new MfaSrv.Protocol.RevocationFilterUpdate
+        {
+            Version = update.Version,
+            Snapshot = update.IsSnapshot
         };
 
+        if (update.Filter != null)
+            proto.Filter = ByteString.CopyFrom(update.Filter);
+        proto.Added.AddRange(update.Added);
+        proto.Removed.AddRange(update.Removed);
+        return proto;
+    }
+
+    private void Broadcast(PolicyUpdate update)
+    {
         var failedAgents = new List<string>();
 
         foreach (var (agentId, channel) in _subscribers)
         {
             try
             {
-                if (!channel.Writer.TryWrite(notification))
+                if (!channel.Writer.TryWrite(update))
                 {
                     _logger.LogWarning(
                         "Policy notification dropped for agent {AgentId} (queue full, oldest dropped)",
@@ -97,13 +260,6 @@ public class PolicySyncStreamService
         {
             Unsubscribe(agentId);
         }
-
-        if (_subscribers.Count > 0)
-        {
-            _logger.LogDebug(
-                "Policy change notification for {PolicyId} broadcast to {Count} agents",
-                policyId, _subscribers.Count);
-        }
     }
 
     /// <summary>
@@ -113,12 +269,15 @@ public class PolicySyncStreamService
 }
 
 /// <summary>
-/// Represents a policy change event to be streamed to connected agents.
+/// A versioned revocation filter change. Snapshots carry the serialized
+/// <see cref="MfaSrv.Core.Collections.CuckooFilter"/>; deltas carry the key hashes
+/// added and removed since <c>Version - 1</c>.
 /// </summary>
-public record PolicyChangeNotification
+public record RevocationFilterUpdate
 {
-    public required string PolicyId { get; init; }
-    public required string PolicyJson { get; init; }
-    public bool Deleted { get; init; }
-    public DateTimeOffset UpdatedAt { get; init; }
+    public required ulong Version { get; init; }
+    public bool IsSnapshot { get; init; }
+    public byte[]? Filter { get; init; }
+    public IReadOnlyList<ulong> Added { get; init; } = Array.Empty<ulong>();
+    public IReadOnlyList<ulong> Removed { get; init; } = Array.Empty<ulong>();
 }
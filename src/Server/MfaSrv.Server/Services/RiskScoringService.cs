@@ -0,0 +1,389 @@
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Collections;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// Computes the risk score that <c>RiskScore</c> policy rules compare against, from features
+/// kept in memory as logon and failure events stream in. No database query is made per event.
+///
+/// Per user, over a sliding window of <see cref="RiskSettings.WindowMinutes"/> split into
+/// <see cref="RiskSettings.Slices"/> slices, it counts failed MFA verifications, logons from
+/// workstations new to the user and off-hours logons, and estimates the number of distinct
+/// source IPs. Counts live in one count-min sketch per slice, so their memory is fixed however
+/// many user names are seen (including the made-up ones of a password spray). Source IPs are
+/// a <see cref="PackedHyperLogLog"/> of 8 bytes per user and slice, for at most
+/// <see cref="RiskSettings.MaxTrackedUsers"/> users active in the window. Each user's
+/// workstations are remembered for <see cref="RiskSettings.WorkstationHistoryDays"/> in four
+/// rotating <see cref="CuckooFilter"/>s; the first workstation seen for a user is not "new".
+///
+/// State is per server instance and not persisted, so it restarts empty. Recording and scoring
+/// take a few microseconds under one lock and allocate nothing once a user is tracked.
+/// </summary>
+public class RiskScoringService
+{
+    private const int HistoryQuarters = 4;
+    private const ulong FailureFeature = 1;
+    private const ulong OffHoursFeature = 2;
+    private const ulong NewWorkstationFeature = 3;
+    private const ulong UserMarker = 0;
+
+    private readonly RiskSettings _settings;
+    private readonly object _lock = new();
+    private readonly int _slices;
+    private readonly long _sliceTicks;
+    private readonly long _historyTicks;
+    private readonly TimeOnly? _businessStart;
+    private readonly TimeOnly? _businessEnd;
+
+    private readonly CountMinSketch[] _counters;
+    private readonly long[] _counterEpochs;
+    private long _currentEpoch = long.MinValue;
+
+    // Distinct source IPs: user hash -> slot; each slot owns _slices sketches in _ipSketches
+    private readonly Dictionary<ulong, int> _userSlots = new();
+    private readonly Stack<int> _freeSlots = new();
+    private ulong[] _ipSketches;
+    private long[] _userEpochs;
+    private int _nextSlot;
+
+    // Workstation history: [0] is the current quarter, older quarters follow
+    private readonly CuckooFilter?[] _history = new CuckooFilter?[HistoryQuarters];
+    private long _historyEpoch = long.MinValue;
+
+    public RiskScoringService(IOptions<RiskSettings> settings)
+    {
+        _settings = settings.Value;
+        _slices = Math.Max(1, _settings.Slices);
+        _sliceTicks = Math.Max(1, TimeSpan.FromMinutes(Math.Max(1, _settings.WindowMinutes)).Ticks / _slices);
+        _historyTicks = TimeSpan.FromDays(Math.Max(1, _settings.WorkstationHistoryDays)).Ticks / HistoryQuarters;
+
+        _counters = new CountMinSketch[_slices];
+        _counterEpochs = new long[_slices];
+        for (var i = 0; i < _slices; i++)
+        {
+            _counters[i] = new CountMinSketch(_settings.SketchWidth, _settings.SketchDepth);
+            _counterEpochs[i] = long.MinValue;
+        }
+
+        var initialUsers = Math.Clamp(_settings.MaxTrackedUsers, 1, 1024);
+        _ipSketches = new ulong[initialUsers * _slices];
+        _userEpochs = new long[initialUsers];
+
+        var hours = _settings.BusinessHours.Split('-');
+        if (hours.Length == 2 && TimeOnly.TryParse(hours[0].Trim(), out var start) && TimeOnly.TryParse(hours[1].Trim(), out var end))
+        {
+            _businessStart = start;
+            _businessEnd = end;
+        }
+    }
+
+    /// <summary>
+    /// Users whose source IPs are currently tracked.
+    /// </summary>
+    public int TrackedUsers
+    {
+        get { lock (_lock) return _userSlots.Count; }
+    }
+
+    /// <summary>
+    /// Approximate memory held by sketches, user slots and workstation history.
+    /// </summary>
+    public long MemoryBytes
+    {
+        get
+        {
+            lock (_lock)
+            {
+                var bytes = _counters.Sum(c => c.MemoryBytes)
+                    + (long)_ipSketches.Length * sizeof(ulong)
+                    + (long)_userEpochs.Length * sizeof(long)
+                    + (long)_userSlots.Count * 24; // dictionary entry: hash, next, key, value
+                foreach (var filter in _history)
+                {
+                    if (filter != null)
+                        bytes += (long)filter.Capacity * 2 * 10 / 9; // 16-bit slots at 90% load
+                }
+                return bytes;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Records a logon attempt and returns the user's features and score including it.
+    /// </summary>
+    public RiskFeatures RecordLogon(string userKey, string? sourceIp, string? workstation, DateTimeOffset timestamp)
+    {
+        var user = CuckooFilter.Hash(userKey);
+        var epoch = Epoch(timestamp);
+
+        RiskFeatures features;
+        lock (_lock)
+        {
+            Advance(epoch);
+
+            if (!string.IsNullOrEmpty(sourceIp))
+                AddSourceIp(user, CuckooFilter.Hash(sourceIp), epoch);
+
+            var machine = string.IsNullOrEmpty(workstation) ? sourceIp : workstation;
+            if (!string.IsNullOrEmpty(machine) && IsNewWorkstation(user, CuckooFilter.Hash(machine), timestamp))
+                CounterSlice(epoch)?.Add(Key(user, NewWorkstationFeature));
+
+            if (IsOffHours(timestamp))
+                CounterSlice(epoch)?.Add(Key(user, OffHoursFeature));
+
+            features = Features(user, epoch);
+        }
+
+        MetricsService.RiskScore.Observe(features.Score);
+        return features;
+    }
+
+    /// <summary>
+    /// Records a failed MFA verification (wrong code, push denied by the user).
+    /// </summary>
+    public void RecordFailure(string userKey, DateTimeOffset timestamp)
+    {
+        var user = CuckooFilter.Hash(userKey);
+        var epoch = Epoch(timestamp);
+
+        lock (_lock)
+        {
+            Advance(epoch);
+            CounterSlice(epoch)?.Add(Key(user, FailureFeature));
+        }
+    }
+
+    /// <summary>
+    /// Returns the user's features and score at <paramref name="now"/> without recording anything.
+    /// </summary>
+    public RiskFeatures GetFeatures(string userKey, DateTimeOffset now)
+    {
+        var user = CuckooFilter.Hash(userKey);
+        lock (_lock)
+        {
+            return Features(user, Epoch(now));
+        }
+    }
+
+    private long Epoch(DateTimeOffset timestamp) => timestamp.UtcTicks / _sliceTicks;
+
+    private RiskFeatures Features(ulong user, long epoch)
+    {
+        var failures = 0L;
+        var offHours = 0L;
+        var newWorkstations = 0L;
+        for (var e = epoch - _slices + 1; e <= epoch; e++)
+        {
+            var slot = (int)(e % _slices);
+            if (_counterEpochs[slot] != e)
+                continue;
+
+            failures += _counters[slot].Estimate(Key(user, FailureFeature));
+            offHours += _counters[slot].Estimate(Key(user, OffHoursFeature));
+            newWorkstations += _counters[slot].Estimate(Key(user, NewWorkstationFeature));
+        }
+
+        var sourceIps = 0;
+        if (_userSlots.TryGetValue(user, out var userSlot))
+        {
+            var sketch = 0UL;
+            var last = Math.Min(epoch, _userEpochs[userSlot]);
+            for (var e = Math.Max(epoch, _userEpochs[userSlot]) - _slices + 1; e <= last; e++)
+                sketch = PackedHyperLogLog.Merge(sketch, _ipSketches[userSlot * _slices + (int)(e % _slices)]);
+            sourceIps = (int)Math.Round(PackedHyperLogLog.Estimate(sketch));
+        }
+
+        var score = _settings.FailureWeight * failures
+            + _settings.DistinctIpWeight * Math.Max(0, sourceIps - 1)
+            + _settings.NewWorkstationWeight * newWorkstations
+            + _settings.OffHoursWeight * offHours;
+
+        return new RiskFeatures(
+            (int)Math.Min(failures, int.MaxValue),
+            sourceIps,
+            (int)Math.Min(newWorkstations, int.MaxValue),
+            (int)Math.Min(offHours, int.MaxValue),
+            (int)Math.Clamp(score, 0, 100));
+    }
+
+    /// <summary>
+    /// Moves the window forward to <paramref name="epoch"/> and drops users idle for a window.
+    /// </summary>
+    private void Advance(long epoch)
+    {
+        if (epoch <= _currentEpoch)
+            return;
+
+        _currentEpoch = epoch;
+        foreach (var (user, slot) in _userSlots)
+        {
+            if (_userEpochs[slot] <= epoch - _slices)
+            {
+                _userSlots.Remove(user);
+                _freeSlots.Push(slot);
+            }
+        }
+
+        MetricsService.RiskTrackedUsers.Set(_userSlots.Count);
+    }
+
+    /// <summary>
+    /// Sketch for <paramref name="epoch"/>, cleared on first use; null if the epoch has
+    /// already left the window.
+    /// </summary>
+    private CountMinSketch? CounterSlice(long epoch)
+    {
+        var slot = (int)(epoch % _slices);
+        if (_counterEpochs[slot] == epoch)
+            return _counters[slot];
+        if (_counterEpochs[slot] > epoch)
+            return null;
+
+        _counters[slot].Clear();
+        _counterEpochs[slot] = epoch;
+        return _counters[slot];
+    }
+
+    private void AddSourceIp(ulong user, ulong ip, long epoch)
+    {
+        if (!_userSlots.TryGetValue(user, out var slot))
+        {
+            if (!TryAllocateSlot(out slot))
+                return;
+
+            Array.Clear(_ipSketches, slot * _slices, _slices);
+            _userEpochs[slot] = epoch;
+            _userSlots[user] = slot;
+        }
+
+        var userEpoch = _userEpochs[slot];
+        if (epoch > userEpoch)
+        {
+            // Clear the slices this user skipped while idle before reusing them
+            for (var e = Math.Max(userEpoch + 1, epoch - _slices + 1); e <= epoch; e++)
+                _ipSketches[slot * _slices + (int)(e % _slices)] = 0;
+            _userEpochs[slot] = epoch;
+        }
+        else if (epoch <= userEpoch - _slices)
+        {
+            return;
+        }
+
+        ref var sketch = ref _ipSketches[slot * _slices + (int)(epoch % _slices)];
+        sketch = PackedHyperLogLog.Add(sketch, ip);
+    }
+
+    private bool TryAllocateSlot(out int slot)
+    {
+        if (_freeSlots.TryPop(out slot))
+            return true;
+
+        if (_nextSlot == _userEpochs.Length)
+        {
+            if (_nextSlot >= _settings.MaxTrackedUsers)
+            {
+                slot = -1;
+                return false;
+            }
+
+            var capacity = (int)Math.Min(_settings.MaxTrackedUsers, _userEpochs.Length * 2L);
+            Array.Resize(ref _userEpochs, capacity);
+            Array.Resize(ref _ipSketches, capacity * _slices);
+        }
+
+        slot = _nextSlot++;
+        return true;
+    }
+
+    /// <summary>
+    /// True if the user has logged on before, but not from this workstation within the history.
+    /// Every logon refreshes the pair in the current quarter so workstations in use never expire.
+    /// </summary>
+    private bool IsNewWorkstation(ulong user, ulong machine, DateTimeOffset timestamp)
+    {
+        RotateHistory(timestamp.UtcTicks / _historyTicks);
+
+        var knownUser = Remember(Key(user, UserMarker));
+        var knownWorkstation = Remember(Key(user, machine));
+        return knownUser && !knownWorkstation;
+    }
+
+    /// <summary>
+    /// Adds a pair to the current quarter; returns whether any quarter already held it.
+    /// </summary>
+    private bool Remember(ulong pair)
+    {
+        var current = _history[0]!;
+        if (current.Contains(pair))
+            return true;
+
+        var known = false;
+        for (var i = 1; i < HistoryQuarters && !known; i++)
+            known = _history[i]?.Contains(pair) == true;
+
+        current.Add(pair);
+        if (current.IsFull)
+            ShiftHistory(1);
+
+        return known;
+    }
+
+    private void RotateHistory(long quarter)
+    {
+        if (_historyEpoch == long.MinValue)
+        {
+            _historyEpoch = quarter;
+            _history[0] = new CuckooFilter(_settings.WorkstationHistoryCapacity);
+        }
+        else if (quarter > _historyEpoch)
+        {
+            ShiftHistory((int)Math.Min(HistoryQuarters, quarter - _historyEpoch));
+            _historyEpoch = quarter;
+        }
+    }
+
+    private void ShiftHistory(int quarters)
+    {
+        for (var i = HistoryQuarters - 1; i >= 0; i--)
+            _history[i] = i >= quarters ? _history[i - quarters] : null;
+        _history[0] = new CuckooFilter(_settings.WorkstationHistoryCapacity);
+    }
+
+    private bool IsOffHours(DateTimeOffset timestamp)
+    {
+        if (_businessStart is not { } start || _businessEnd is not { } end)
+            return false;
+
+        var local = timestamp.ToLocalTime();
+        if (local.DayOfWeek is DayOfWeek.Saturday or DayOfWeek.Sunday)
+            return true;
+
+        var time = TimeOnly.FromDateTime(local.DateTime);
+        return start <= end
+            ? time < start || time > end
+            : time < start && time > end;
+    }
+
+    // SplitMix64 over the user hash combined with a feature or workstation hash
+    private static ulong Key(ulong user, ulong value)
+    {
+        var x = user ^ (value * 0x9E3779B97F4A7C15UL + 0x632BE59BD9B4E019UL);
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9UL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBUL;
+        x ^= x >> 31;
+        return x;
+    }
+}
+
+/// <summary>
+/// A user's risk features over the current window and the score (0-100) derived from them.
+/// </summary>
+public readonly record struct RiskFeatures(
+    int Failures,
+    int DistinctSourceIps,
+    int NewWorkstations,
+    int OffHoursLogons,
+    int Score);
@@ -1,22 +1,41 @@
+using System.Diagnostics;
 using Microsoft.Extensions.Hosting;
 using Microsoft.Extensions.DependencyInjection;
 using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
 using MfaSrv.Core.Interfaces;
+using MfaSrv.Server.Data;
 
 namespace MfaSrv.Server.Services;
 
+/// <summary>
+/// Marks expired sessions as expired and deletes sessions past
+/// <see cref="SessionSettings.RetentionDays"/>. Runs on the leader only. Work is done in
+/// batches of <see cref="SessionSettings.CleanupBatchSize"/>, each one set-based statement in
+/// its own fenced transaction, with a pause between batches so a large backlog (e.g. after a
+/// long weekend) never holds the database for long.
+/// </summary>
 public class SessionCleanupService : BackgroundService
 {
     private readonly IServiceScopeFactory _scopeFactory;
+    private readonly SessionSettings _settings;
     private readonly ILogger<SessionCleanupService> _logger;
     private readonly SetupService _setupService;
+    private readonly LeaderElectionService _leaderElection;
     private static readonly TimeSpan Interval = TimeSpan.FromMinutes(5);
 
-    public SessionCleanupService(IServiceScopeFactory scopeFactory, ILogger<SessionCleanupService> logger, SetupService setupService)
+    public SessionCleanupService(
+        IServiceScopeFactory scopeFactory,
+        IOptions<SessionSettings> settings,
+        ILogger<SessionCleanupService> logger,
+        SetupService setupService,
+        LeaderElectionService leaderElection)
     {
         _scopeFactory = scopeFactory;
+        _settings = settings.Value;
         _logger = logger;
         _setupService = setupService;
+        _leaderElection = leaderElection;
     }
 
     protected override async Task ExecuteAsync(CancellationToken stoppingToken)
@@ -31,9 +50,12 @@ public class SessionCleanupService : BackgroundService
         {
             try
             {
-                using var scope = _scopeFactory.CreateScope();
-                var sessionManager = scope.ServiceProvider.GetRequiredService<ISessionManager>();
-                await sessionManager.CleanupExpiredSessionsAsync(stoppingToken);
+                if (_leaderElection.IsLeader)
+                    await CleanupAsync(stoppingToken);
+            }
+            catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+            {
+                break;
             }
             catch (Exception ex)
             {
@@ -43,4 +65,56 @@ public class SessionCleanupService : BackgroundService
             await Task.Delay(Interval, stoppingToken);
         }
     }
+
+    /// <summary>
+    /// One cleanup pass: expire, then purge, each until no full batch is left.
+    /// </summary>
+    public async Task CleanupAsync(CancellationToken ct)
+    {
+        await RunBatchesAsync("Expired", (sessions, size, c) => sessions.ExpireSessionsAsync(size, c), ct);
+
+        if (_settings.RetentionDays > 0)
+        {
+            var cutoff = DateTimeOffset.UtcNow.AddDays(-_settings.RetentionDays);
+            await RunBatchesAsync("Purged", (sessions, size, c) => sessions.PurgeSessionsAsync(cutoff, size, c), ct);
+        }
+    }
+
+    private async Task RunBatchesAsync(
+        string action, Func<ISessionManager, int, CancellationToken, Task<int>> batch, CancellationToken ct)
+    {
+        var batchSize = Math.Max(1, _settings.CleanupBatchSize);
+        var total = 0;
+        var batches = 0;
+        var stopwatch = Stopwatch.StartNew();
+
+        while (true)
+        {
+            var count = 0;
+
+            // A scope per batch: nothing stays tracked, and each batch is fenced on its own
+            using (var scope = _scopeFactory.CreateScope())
+            {
+                var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+                var sessions = scope.ServiceProvider.GetRequiredService<ISessionManager>();
+                if (!await _leaderElection.RunFencedAsync(db, async c => count = await batch(sessions, batchSize, c), ct))
+                    break;
+            }
+
+            total += count;
+            batches++;
+            if (count < batchSize)
+                break;
+
+            await Task.Delay(_settings.CleanupBatchDelayMs, ct);
+        }
+
+        if (total > 0)
+        {
+            _logger.LogInformation(
+                "{Action} {Count} sessions in {Batches} batches over {Elapsed} ms ({Rate:F0}/s)",
+                action, total, batches, stopwatch.ElapsedMilliseconds,
+                total / Math.Max(stopwatch.Elapsed.TotalSeconds, 0.001));
+        }
+    }
 }
@@ -1,6 +1,7 @@
 using System.Security.Cryptography;
 using Microsoft.EntityFrameworkCore;
 using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
 using MfaSrv.Core.Entities;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.Interfaces;
@@ -10,15 +11,51 @@ namespace MfaSrv.Server.Services;
 
 public class SessionManager : ISessionManager
 {
+    // Compiled once per process: the evaluation path skips LINQ translation and plan-cache lookup
+    private static readonly Func<MfaSrvDbContext, string, string, DateTimeOffset, CancellationToken, Task<MfaSession?>> ActiveSessionQuery =
+        EF.CompileAsyncQuery((MfaSrvDbContext db, string userId, string sourceIp, DateTimeOffset now, CancellationToken ct) =>
+            db.MfaSessions
+                .AsNoTracking()
+                .Where(s => s.UserId == userId
+                    && s.SourceIp == sourceIp
+                    && s.Status == SessionStatus.Active
+                    && s.ExpiresAt > now)
+                .OrderByDescending(s => s.CreatedAt)
+                .FirstOrDefault());
+
+    private static readonly Func<MfaSrvDbContext, string, CancellationToken, Task<MfaSession?>> SessionByIdQuery =
+        EF.CompileAsyncQuery((MfaSrvDbContext db, string sessionId, CancellationToken ct) =>
+            db.MfaSessions
+                .AsNoTracking()
+                .FirstOrDefault(s => s.Id == sessionId && s.Status == SessionStatus.Active));
+
     private readonly MfaSrvDbContext _db;
     private readonly ITokenService _tokenService;
+    private readonly SessionRevocationService _revocations;
+    private readonly DashboardStatisticsService _statistics;
+    private readonly AgentChannelService _agentChannels;
+    private readonly ActiveSessionCache _activeSessions;
+    private readonly SessionSettings _settings;
     private readonly ILogger<SessionManager> _logger;
     private static readonly TimeSpan DefaultTtl = TimeSpan.FromHours(8);
 
-    public SessionManager(MfaSrvDbContext db, ITokenService tokenService, ILogger<SessionManager> logger)
+    public SessionManager(
+        MfaSrvDbContext db,
+        ITokenService tokenService,
+        SessionRevocationService revocations,
+        DashboardStatisticsService statistics,
+        AgentChannelService agentChannels,
+        ActiveSessionCache activeSessions,
+        IOptions<SessionSettings> settings,
+        ILogger<SessionManager> logger)
     {
         _db = db;
         _tokenService = tokenService;
+        _revocations = revocations;
+        _statistics = statistics;
+        _agentChannels = agentChannels;
+        _activeSessions = activeSessions;
+        _settings = settings.Value;
         _logger = logger;
     }
 
@@ -43,6 +80,29 @@ public class SessionManager : ISessionManager
 
         _db.MfaSessions.Add(session);
         await _db.SaveChangesAsync(ct);
+        _activeSessions.Created(session);
+        _statistics.SessionCreated(expiry);
+
+        if (_agentChannels.ConnectedCount > 0)
+        {
+            // Agents cache sessions by logon name, not by user ID
+            var userName = await _db.Users
+                .Where(u => u.Id == userId)
+                .Select(u => u.SamAccountName)
+                .FirstOrDefaultAsync(ct);
+
+            if (!string.IsNullOrEmpty(userName))
+            {
+                _agentChannels.NotifySessionChange(new SessionChangeNotification
+                {
+                    SessionId = sessionId,
+                    UserName = userName,
+                    SourceIp = sourceIp,
+                    ExpiresAt = expiry,
+                    VerifiedMethod = session.VerifiedMethod.ToString()
+                });
+            }
+        }
 
         _logger.LogInformation("Created MFA session {SessionId} for user {UserId}, expires at {Expiry}",
             sessionId, userId, expiry);
@@ -50,6 +110,12 @@ public class SessionManager : ISessionManager
         return session;
     }
 
+    /// <summary>
+    /// Validates a session token. The signature and expiry are checked from the token itself;
+    /// when stateless validation is enabled and the session is not in the revocation set, the
+    /// result is built from the token payload (Id, UserId, ExpiresAt) without a database read.
+    /// Revocation-set hits and an unsynchronized set fall back to the authoritative database check.
+    /// </summary>
     public async Task<MfaSession?> ValidateSessionAsync(string sessionToken, CancellationToken ct = default)
     {
         byte[] tokenBytes;
@@ -65,8 +131,23 @@ public class SessionManager : ISessionManager
         var payload = _tokenService.ValidateSessionToken(tokenBytes);
         if (payload == null) return null;
 
-        var session = await _db.MfaSessions
-            .FirstOrDefaultAsync(s => s.Id == payload.SessionId && s.Status == SessionStatus.Active, ct);
+        if (_settings.StatelessValidation
+            && _revocations.IsSynchronized
+            && !_revocations.IsRevoked(payload.SessionId))
+        {
+            MetricsService.SessionValidationsTotal.WithLabels("stateless").Inc();
+            return new MfaSession
+            {
+                Id = payload.SessionId,
+                UserId = payload.UserId,
+                Status = SessionStatus.Active,
+                ExpiresAt = payload.Expiry
+            };
+        }
+
+        MetricsService.SessionValidationsTotal.WithLabels("database").Inc();
+
+        var session = await SessionByIdQuery(_db, payload.SessionId, ct);
 
         if (session == null || session.ExpiresAt < DateTimeOffset.UtcNow)
             return null;
@@ -78,15 +159,25 @@ public class SessionManager : ISessionManager
         return session;
     }
 
+    /// <summary>
+    /// Newest active session of a user from a source IP. Answered from
+    /// <see cref="ActiveSessionCache"/>; the database is read only on a miss.
+    /// </summary>
     public async Task<MfaSession?> FindActiveSessionAsync(string userId, string sourceIp, CancellationToken ct = default)
     {
-        return await _db.MfaSessions
-            .Where(s => s.UserId == userId
-                && s.SourceIp == sourceIp
-                && s.Status == SessionStatus.Active
-                && s.ExpiresAt > DateTimeOffset.UtcNow)
-            .OrderByDescending(s => s.CreatedAt)
-            .FirstOrDefaultAsync(ct);
+        var now = DateTimeOffset.UtcNow;
+        if (_activeSessions.TryGet(userId, sourceIp, now, _revocations.IsRevoked, out var cached))
+        {
+            MetricsService.SessionLookupsTotal.WithLabels("cache").Inc();
+            return cached;
+        }
+
+        MetricsService.SessionLookupsTotal.WithLabels("database").Inc();
+
+        var generation = _activeSessions.Generation;
+        var session = await ActiveSessionQuery(_db, userId, sourceIp, now, ct);
+        _activeSessions.Store(userId, sourceIp, session, generation, now);
+        return session;
     }
 
     public async Task RevokeSessionAsync(string sessionId, CancellationToken ct = default)
@@ -94,26 +185,70 @@ public class SessionManager : ISessionManager
         var session = await _db.MfaSessions.FindAsync(new object[] { sessionId }, ct);
         if (session != null)
         {
+            var wasActive = session.Status == SessionStatus.Active;
             session.Status = SessionStatus.Revoked;
             await _db.SaveChangesAsync(ct);
+            _activeSessions.Revoked(session);
+            _revocations.MarkRevoked(session.Id, session.ExpiresAt);
+            if (wasActive)
+                _statistics.SessionEnded(session.ExpiresAt);
+            _agentChannels.NotifySessionChange(new SessionChangeNotification
+            {
+                SessionId = session.Id,
+                ExpiresAt = session.ExpiresAt,
+                Revoked = true
+            });
             _logger.LogInformation("Revoked session {SessionId}", sessionId);
         }
     }
 
-    public async Task CleanupExpiredSessionsAsync(CancellationToken ct = default)
+    /// <summary>
+    /// Marks up to <paramref name="maxCount"/> expired active sessions as expired with one
+    /// set-based UPDATE. Returns the number marked; fewer than <paramref name="maxCount"/>
+    /// means none are left.
+    /// </summary>
+    public async Task<int> ExpireSessionsAsync(int maxCount, CancellationToken ct = default)
     {
         var now = DateTimeOffset.UtcNow;
-        var expired = await _db.MfaSessions
+        var expired = _db.MfaSessions
             .Where(s => s.Status == SessionStatus.Active && s.ExpiresAt < now)
-            .ToListAsync(ct);
-
-        foreach (var session in expired)
-            session.Status = SessionStatus.Expired;
+            .Take(maxCount);
 
-        if (expired.Count > 0)
+        int count;
+        if (_db.Database.IsRelational())
         {
+            count = await expired.ExecuteUpdateAsync(u => u.SetProperty(s => s.Status, SessionStatus.Expired), ct);
+        }
+        else
+        {
+            // Providers without bulk updates (the in-memory test database)
+            var sessions = await expired.ToListAsync(ct);
+            foreach (var session in sessions)
+                session.Status = SessionStatus.Expired;
             await _db.SaveChangesAsync(ct);
-            _logger.LogInformation("Cleaned up {Count} expired sessions", expired.Count);
+            count = sessions.Count;
         }
+
+        MetricsService.SessionsExpiredTotal.Inc(count);
+        return count;
+    }
+
+    /// <summary>
+    /// Deletes up to <paramref name="maxCount"/> expired or revoked sessions whose expiry lies
+    /// before <paramref name="endedBefore"/>. Returns the number deleted.
+    /// </summary>
+    public async Task<int> PurgeSessionsAsync(DateTimeOffset endedBefore, int maxCount, CancellationToken ct = default)
+    {
+        var ended = _db.MfaSessions
+            .Where(s => s.Status != SessionStatus.Active && s.ExpiresAt < endedBefore)
+            .Take(maxCount);
+
+        if (_db.Database.IsRelational())
+            return await ended.ExecuteDeleteAsync(ct);
+
+        var sessions = await ended.ToListAsync(ct);
+        _db.MfaSessions.RemoveRange(sessions);
+        await _db.SaveChangesAsync(ct);
+        return sessions.Count;
     }
 }
@@ -0,0 +1,231 @@
+using System.Collections.Concurrent;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Hosting;
+using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Collections;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server.Data;
+
+namespace MfaSrv.Server.Services;
+
+/// <summary>
+/// In-memory set of revoked, not-yet-expired session IDs used by the stateless
+/// session validation fast path in <see cref="SessionManager"/>.
+///
+/// Local revocations are added immediately. Revocations made by other server instances
+/// reach this set through a periodic refresh from the shared database, so the set
+/// converges within <see cref="SessionSettings.RevocationSyncIntervalSeconds"/>.
+/// Until the first refresh completes the set is not trusted and validation falls back
+/// to the database.
+///
+/// The set is mirrored into a versioned <see cref="CuckooFilter"/> that DC Agents receive
+/// on the policy sync stream (snapshot on connect, then add/remove deltas), so agents can
+/// reject revoked cached sessions without a per-logon round trip.
+/// </summary>
+public class SessionRevocationService : BackgroundService
+{
+    private const int MinFilterCapacity = 1024;
+
+    private readonly ConcurrentDictionary<string, DateTimeOffset> _revoked = new();
+    private readonly IServiceScopeFactory _scopeFactory;
+    private readonly PolicySyncStreamService _policySyncStream;
+    private readonly SessionSettings _settings;
+    private readonly SetupService _setupService;
+    private readonly ILogger<SessionRevocationService> _logger;
+    private readonly object _filterLock = new();
+    private CuckooFilter _filter = new(MinFilterCapacity);
+    private ulong _filterVersion;
+    private volatile bool _isSynchronized;
+
+    public SessionRevocationService(
+        IServiceScopeFactory scopeFactory,
+        PolicySyncStreamService policySyncStream,
+        IOptions<SessionSettings> settings,
+        SetupService setupService,
+        ILogger<SessionRevocationService> logger)
+    {
+        _scopeFactory = scopeFactory;
+        _policySyncStream = policySyncStream;
+        _settings = settings.Value;
+        _setupService = setupService;
+        _logger = logger;
+    }
+
+    /// <summary>
+    /// True once the set has been loaded from the database at least once.
+    /// </summary>
+    public bool IsSynchronized => _isSynchronized;
+
+    public int Count => _revoked.Count;
+
+    public bool IsRevoked(string sessionId) => _revoked.ContainsKey(sessionId);
+
+    /// <summary>
+    /// Records a revocation. The entry is kept until the session would have expired anyway.
+    /// </summary>
+    public void MarkRevoked(string sessionId, DateTimeOffset expiresAt)
+    {
+        if (_revoked.TryAdd(sessionId, expiresAt))
+            PublishFilterChanges(new[] { sessionId }, Array.Empty<string>());
+        else
+            _revoked[sessionId] = expiresAt;
+    }
+
+    /// <summary>
+    /// Current filter version.
+    /// </summary>
+    public ulong FilterVersion
+    {
+        get { lock (_filterLock) return _filterVersion; }
+    }
+
+    /// <summary>
+    /// Returns the full revocation filter for an agent that is (re)connecting.
+    /// Deltas published afterwards carry higher versions.
+    /// </summary>
+    public RevocationFilterUpdate GetFilterSnapshot()
+    {
+        lock (_filterLock)
+        {
+            return new RevocationFilterUpdate
+            {
+                Version = _filterVersion,
+                IsSnapshot = true,
+                Filter = _filter.ToBytes()
+            };
+        }
+    }
+
+    protected override async Task ExecuteAsync(CancellationToken stoppingToken)
+    {
+        if (_setupService.IsSetupRequired())
+        {
+            _logger.LogInformation("Session revocation sync paused - awaiting initial setup");
+            return;
+        }
+
+        var interval = TimeSpan.FromSeconds(Math.Max(1, _settings.RevocationSyncIntervalSeconds));
+
+        while (!stoppingToken.IsCancellationRequested)
+        {
+            try
+            {
+                await RefreshAsync(stoppingToken);
+            }
+            catch (OperationCanceledException) when (stoppingToken.IsCancellationRequested)
+            {
+                break;
+            }
+            catch (Exception ex)
+            {
+                _logger.LogError(ex, "Error refreshing session revocation set");
+            }
+
+            await Task.Delay(interval, stoppingToken);
+        }
+    }
+
+    /// <summary>
+    /// Merges revoked sessions from the database into the set and prunes expired entries.
+    /// </summary>
+    public async Task RefreshAsync(CancellationToken ct = default)
+    {
+        using var scope = _scopeFactory.CreateScope();
+        var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+
+        var now = DateTimeOffset.UtcNow;
+        var revoked = await db.MfaSessions
+            .AsNoTracking()
+            .Where(s => s.Status == SessionStatus.Revoked && s.ExpiresAt > now)
+            .Select(s => new { s.Id, s.ExpiresAt })
+            .ToListAsync(ct);
+
+        var added = new List<string>();
+        foreach (var session in revoked)
+        {
+            if (_revoked.TryAdd(session.Id, session.ExpiresAt))
+                added.Add(session.Id);
+        }
+
+        var removed = new List<string>();
+        foreach (var (sessionId, expiresAt) in _revoked)
+        {
+            if (expiresAt <= now && _revoked.TryRemove(sessionId, out _))
+                removed.Add(sessionId);
+        }
+
+        if (added.Count > 0 || removed.Count > 0)
+            PublishFilterChanges(added, removed);
+
+        if (!_isSynchronized)
+        {
+            _isSynchronized = true;
+            _logger.LogInformation("Session revocation set loaded: {Count} revoked sessions", _revoked.Count);
+        }
+    }
+
+    /// <summary>
+    /// Applies set changes to the filter and broadcasts them as one delta. Falls back to a
+    /// rebuilt snapshot when the filter runs out of room or has become mostly empty.
+    /// Publishing under the lock keeps versions in order on every agent channel.
+    /// </summary>
+    private void PublishFilterChanges(IReadOnlyList<string> added, IReadOnlyList<string> removed)
+    {
+        lock (_filterLock)
+        {
+            var removedHashes = new List<ulong>(removed.Count);
+            foreach (var sessionId in removed)
+            {
+                var hash = CuckooFilter.Hash(sessionId);
+                if (_filter.Remove(hash))
+                    removedHashes.Add(hash);
+            }
+
+            var addedHashes = new List<ulong>(added.Count);
+            var rebuild = false;
+            foreach (var sessionId in added)
+            {
+                var hash = CuckooFilter.Hash(sessionId);
+                if (!_filter.Add(hash))
+                {
+                    rebuild = true;
+                    break;
+                }
+                addedHashes.Add(hash);
+            }
+
+            rebuild |= _filter.IsFull
+                || (_filter.Capacity > MinFilterCapacity && _filter.Count < _filter.Capacity / 8);
+
+            _filterVersion++;
+
+            if (rebuild)
+            {
+                var filter = new CuckooFilter(Math.Max(MinFilterCapacity, _revoked.Count * 2));
+                foreach (var sessionId in _revoked.Keys)
+                    filter.Add(sessionId);
+                _filter = filter;
+
+                _logger.LogInformation(
+                    "Rebuilt session revocation filter: {Count} entries, capacity {Capacity}, version {Version}",
+                    filter.Count, filter.Capacity, _filterVersion);
+
+                _policySyncStream.NotifyRevocationFilterChange(new RevocationFilterUpdate
+                {
+                    Version = _filterVersion,
+                    IsSnapshot = true,
+                    Filter = filter.ToBytes()
+                });
+                return;
+            }
+
+            _policySyncStream.NotifyRevocationFilterChange(new RevocationFilterUpdate
+            {
+                Version = _filterVersion,
+                Added = addedHashes,
+                Removed = removedHashes
+            });
+        }
+    }
+}
@@ -26,12 +26,18 @@ public class UserSyncService : IUserSyncService
     private readonly MfaSrvDbContext _db;
     private readonly LdapSettings _settings;
     private readonly ILogger<UserSyncService> _logger;
+    private readonly DirectorySnapshotService _directorySnapshots;
 
-    public UserSyncService(MfaSrvDbContext db, IOptions<LdapSettings> settings, ILogger<UserSyncService> logger)
+    public UserSyncService(
+        MfaSrvDbContext db,
+        IOptions<LdapSettings> settings,
+        ILogger<UserSyncService> logger,
+        DirectorySnapshotService directorySnapshots)
     {
         _db = db;
         _settings = settings.Value;
         _logger = logger;
+        _directorySnapshots = directorySnapshots;
     }
 
     public async Task SyncUsersAsync(CancellationToken ct = default)
@@ -119,6 +125,16 @@ public class UserSyncService : IUserSyncService
             _logger.LogError(ex, "LDAP user sync failed");
             throw;
         }
+
+        try
+        {
+            // DC Agents in local evaluation mode evaluate against a copy of the directory
+            await _directorySnapshots.PublishAsync(_db, ct);
+        }
+        catch (Exception ex) when (ex is not OperationCanceledException)
+        {
+            _logger.LogWarning(ex, "Failed to publish the directory snapshot to DC Agents");
+        }
     }
 
     public async Task SyncGroupsAsync(CancellationToken ct = default)
@@ -0,0 +1,38 @@
+namespace MfaSrv.Server;
+
+/// <summary>
+/// Configuration for MFA session validation and revocation.
+/// Bound from the "Sessions" section of appsettings.json.
+/// </summary>
+public class SessionSettings
+{
+    /// <summary>
+    /// Trust the HMAC signature and expiry embedded in a session token and skip the database
+    /// lookup unless the session is present in the in-memory revocation set.
+    /// When false, every validation reads the session row from the database.
+    /// </summary>
+    public bool StatelessValidation { get; set; } = true;
+
+    /// <summary>
+    /// How often (in seconds) the revocation set is refreshed from the database, so that
+    /// revocations made on other server instances are picked up.
+    /// </summary>
+    public int RevocationSyncIntervalSeconds { get; set; } = 5;
+
+    /// <summary>
+    /// Rows updated or deleted per cleanup statement. Each batch is its own short
+    /// transaction, so logons are never blocked behind a whole backlog.
+    /// </summary>
+    public int CleanupBatchSize { get; set; } = 1000;
+
+    /// <summary>
+    /// Pause (in milliseconds) between cleanup batches, leaving the database to auth writes.
+    /// </summary>
+    public int CleanupBatchDelayMs { get; set; } = 20;
+
+    /// <summary>
+    /// Days an expired or revoked session row is kept before it is deleted; 0 keeps them
+    /// forever. The audit log still records the session's creation and revocation.
+    /// </summary>
+    public int RetentionDays { get; set; } = 30;
+}
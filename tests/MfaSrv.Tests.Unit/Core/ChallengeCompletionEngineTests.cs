@@ -0,0 +1,65 @@
+using FluentAssertions;
+using MfaSrv.Core.Challenges;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.ValueObjects;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Core;
+
+public class ChallengeCompletionEngineTests
+{
+    private readonly ChallengeCompletionEngine _engine = new();
+
+    private static AsyncVerificationStatus Outcome(ChallengeStatus status) => new() { Status = status };
+
+    [Fact]
+    public async Task Complete_WakesAllWaitersAndCallbacks()
+    {
+        var waiters = Enumerable.Range(0, 100)
+            .Select(_ => _engine.WaitAsync("c1", TimeSpan.FromSeconds(10)))
+            .ToList();
+        var callback = new TaskCompletionSource<ChallengeStatus>();
+        _engine.OnCompleted("c1", outcome => callback.TrySetResult(outcome.Status));
+
+        waiters.Should().OnlyContain(w => !w.IsCompleted);
+        _engine.PendingCount.Should().Be(1);
+
+        _engine.Complete("c1", Outcome(ChallengeStatus.Approved)).Should().BeTrue();
+
+        (await Task.WhenAll(waiters)).Should().OnlyContain(o => o!.Status == ChallengeStatus.Approved);
+        (await callback.Task.WaitAsync(TimeSpan.FromSeconds(10))).Should().Be(ChallengeStatus.Approved);
+    }
+
+    [Fact]
+    public async Task Complete_FirstOutcomeWins_LateWaitersSeeIt()
+    {
+        _engine.Complete("c1", Outcome(ChallengeStatus.Denied)).Should().BeTrue();
+        _engine.Complete("c1", Outcome(ChallengeStatus.Approved)).Should().BeFalse();
+
+        (await _engine.WaitAsync("c1", TimeSpan.Zero))!.Status.Should().Be(ChallengeStatus.Denied);
+        _engine.TryGetOutcome("c1", out var outcome).Should().BeTrue();
+        outcome.Status.Should().Be(ChallengeStatus.Denied);
+        _engine.TryGetOutcome("c2", out _).Should().BeFalse();
+    }
+
+    [Fact]
+    public async Task WaitAsync_Unresolved_ReturnsNullAfterTimeout()
+    {
+        (await _engine.WaitAsync("c1", TimeSpan.FromMilliseconds(20))).Should().BeNull();
+
+        var act = () => _engine.Complete("c1", Outcome(ChallengeStatus.Issued));
+        act.Should().Throw<ArgumentException>();
+    }
+
+    [Fact]
+    public void Prune_DropsOutcomesAfterRetentionAndAbandonedWaits()
+    {
+        _engine.Complete("done", Outcome(ChallengeStatus.Approved));
+        _ = _engine.WaitAsync("abandoned", TimeSpan.FromMilliseconds(1));
+
+        _engine.Prune(DateTimeOffset.UtcNow).Should().Be(0);
+        _engine.Prune(DateTimeOffset.UtcNow + _engine.Retention + TimeSpan.FromSeconds(1)).Should().Be(1);
+        _engine.Prune(DateTimeOffset.UtcNow + ChallengeCompletionEngine.MaxPendingAge + TimeSpan.FromSeconds(1)).Should().Be(1);
+        _engine.Count.Should().Be(0);
+    }
+}
@@ -0,0 +1,154 @@
+using FluentAssertions;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Policies;
+using MfaSrv.Core.ValueObjects;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Core;
+
+public class CompiledPolicySetTests
+{
+    private static Policy CreatePolicy(
+        string id,
+        int priority,
+        PolicyActionType action,
+        params PolicyRule[] rules)
+    {
+        var policy = new Policy { Id = id, Name = id, Priority = priority };
+        if (rules.Length > 0)
+            policy.RuleGroups.Add(new PolicyRuleGroup { Rules = rules.ToList() });
+        policy.Actions.Add(new PolicyAction { ActionType = action });
+        return policy;
+    }
+
+    private static PolicyRule Rule(PolicyRuleType type, string op, string value, bool negate = false) =>
+        new() { RuleType = type, Operator = op, Value = value, Negate = negate };
+
+    private static AuthenticationContext Context(
+        string user = "alice",
+        AuthProtocol protocol = AuthProtocol.Kerberos,
+        string? ou = null,
+        DateTimeOffset? timestamp = null,
+        params string[] groups) => new()
+    {
+        UserId = user,
+        UserName = user,
+        Protocol = protocol,
+        UserOu = ou,
+        UserGroups = groups,
+        Timestamp = timestamp ?? DateTimeOffset.UtcNow
+    };
+
+    [Fact]
+    public void Evaluate_FirstMatchByPriority_ReturnsItsDecision()
+    {
+        var set = CompiledPolicySet.Compile(new[]
+        {
+            CreatePolicy("b-allow", 2, PolicyActionType.Allow, Rule(PolicyRuleType.SourceUser, "Equals", "alice")),
+            CreatePolicy("a-deny", 1, PolicyActionType.Deny, Rule(PolicyRuleType.SourceGroup, "Equals", "Contractors")),
+            CreatePolicy("c-tie", 1, PolicyActionType.RequireMfa, Rule(PolicyRuleType.SourceUser, "Equals", "alice"))
+        });
+
+        set.Evaluate(Context(groups: "contractors")).MatchedPolicyId.Should().Be("a-deny");
+        set.Evaluate(Context()).MatchedPolicyId.Should().Be("c-tie");
+
+        var none = set.Evaluate(Context(user: "bob"));
+        none.Decision.Should().Be(AuthDecision.Allow);
+        none.MatchedPolicyId.Should().BeNull();
+    }
+
+    [Fact]
+    public void Compile_SkipsDisabledPoliciesAndPoliciesWithoutRulesOrActions()
+    {
+        var disabled = CreatePolicy("disabled", 1, PolicyActionType.Deny, Rule(PolicyRuleType.SourceUser, "Equals", "alice"));
+        disabled.IsEnabled = false;
+        var noActions = CreatePolicy("no-actions", 2, PolicyActionType.Deny, Rule(PolicyRuleType.SourceUser, "Equals", "alice"));
+        noActions.Actions.Clear();
+        var noRules = CreatePolicy("no-rules", 3, PolicyActionType.Deny);
+
+        var set = CompiledPolicySet.Compile(new[] { disabled, noActions, noRules });
+
+        set.Count.Should().Be(0);
+        set.UsesRiskScore.Should().BeFalse();
+        set.Evaluate(Context()).Decision.Should().Be(AuthDecision.Allow);
+    }
+
+    [Fact]
+    public void Evaluate_RegexOuAndProtocolRules()
+    {
+        var set = CompiledPolicySet.Compile(new[]
+        {
+            CreatePolicy("p", 1, PolicyActionType.RequireMfa,
+                Rule(PolicyRuleType.SourceUser, "Regex", "^adm-"),
+                Rule(PolicyRuleType.SourceOu, "Contains", "OU=Admins"),
+                Rule(PolicyRuleType.AuthProtocol, "Equals", "ntlm", negate: true))
+        });
+
+        set.Evaluate(Context("ADM-alice", AuthProtocol.Kerberos, "OU=Admins,DC=corp,DC=local"))
+            .Decision.Should().Be(AuthDecision.RequireMfa);
+        set.Evaluate(Context("adm-alice", AuthProtocol.Ntlm, "OU=Admins,DC=corp,DC=local"))
+            .Decision.Should().Be(AuthDecision.Allow);
+        set.Evaluate(Context("adm-alice", AuthProtocol.Kerberos))
+            .Decision.Should().Be(AuthDecision.Allow);
+    }
+
+    [Fact]
+    public void Evaluate_InvalidRegex_NeverMatches()
+    {
+        var set = CompiledPolicySet.Compile(new[]
+        {
+            CreatePolicy("p", 1, PolicyActionType.Deny, Rule(PolicyRuleType.SourceUser, "Regex", "(unclosed"))
+        });
+
+        set.Evaluate(Context("(unclosed")).Decision.Should().Be(AuthDecision.Allow);
+    }
+
+    [Fact]
+    public void Evaluate_TimeWindow_UsesContextTimestampInLocalTime()
+    {
+        var set = CompiledPolicySet.Compile(new[]
+        {
+            CreatePolicy("day", 1, PolicyActionType.Allow, Rule(PolicyRuleType.TimeWindow, "Equals", "09:00-17:00")),
+            CreatePolicy("night", 2, PolicyActionType.Deny, Rule(PolicyRuleType.TimeWindow, "Equals", "22:00-06:00"))
+        });
+        var today = DateTime.Today;
+
+        set.Evaluate(Context(timestamp: new DateTimeOffset(today.AddHours(10)))).MatchedPolicyId.Should().Be("day");
+        set.Evaluate(Context(timestamp: new DateTimeOffset(today.AddHours(23)))).MatchedPolicyId.Should().Be("night");
+        set.Evaluate(Context(timestamp: new DateTimeOffset(today.AddHours(20)))).MatchedPolicyId.Should().BeNull();
+    }
+
+    [Theory]
+    [InlineData("> 50", 51, true)]
+    [InlineData("> 50", 50, false)]
+    [InlineData(">= 50", 50, true)]
+    [InlineData("< 20", 19, true)]
+    [InlineData("<= 20", 21, false)]
+    [InlineData("= 0", 0, true)]
+    [InlineData("60", 60, true)]
+    [InlineData("60", 59, false)]
+    [InlineData("high", 100, false)]
+    public void Evaluate_RiskScoreRule_ComparesContextScore(string value, int score, bool matches)
+    {
+        var set = CompiledPolicySet.Compile(new[]
+        {
+            CreatePolicy("risky", 1, PolicyActionType.RequireMfa, Rule(PolicyRuleType.RiskScore, "Equals", value))
+        });
+
+        set.UsesRiskScore.Should().BeTrue();
+        (set.Evaluate(Context() with { RiskScore = score }).MatchedPolicyId == "risky").Should().Be(matches);
+        set.Evaluate(Context()).MatchedPolicyId.Should().BeNull("contexts without a score never match");
+    }
+
+        [Theory]
+    [InlineData("CN=Alice,OU=Sales,DC=corp,DC=local", "OU=Sales,DC=corp,DC=local")]
+    [InlineData(@"CN=Smith\, John,OU=Sales,DC=corp,DC=local", "OU=Sales,DC=corp,DC=local")]
+    [InlineData("DC=local", null)]
+    [InlineData("", null)]
+    [InlineData(null, null)]
+    public void DirectoryNames_ParentContainer(string? dn, string? expected)
+    {
+        DirectoryNames.ParentContainer(dn).Should().Be(expected);
+    }
+}
@@ -0,0 +1,51 @@
+using FluentAssertions;
+using MfaSrv.Core.Collections;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Core;
+
+public class CountMinSketchTests
+{
+    [Fact]
+    public void Estimate_NeverUndercounts_AndRarelyOvercountsWithinCapacity()
+    {
+        var sketch = new CountMinSketch(65536, 4);
+        var counts = new Dictionary<ulong, int>();
+        var random = new Random(42);
+
+        for (var i = 0; i < 200_000; i++)
+        {
+            var key = CuckooFilter.Hash($"user-{random.Next(20_000)}");
+            sketch.Add(key);
+            counts[key] = counts.GetValueOrDefault(key) + 1;
+        }
+
+        counts.Should().OnlyContain(kv => sketch.Estimate(kv.Key) >= kv.Value);
+        counts.Count(kv => sketch.Estimate(kv.Key) != kv.Value).Should().BeLessThan(counts.Count / 100);
+    }
+
+    [Fact]
+    public void Add_ReturnsNewEstimate_SaturatesAtMaxValue()
+    {
+        var sketch = new CountMinSketch(16, 2);
+        var key = CuckooFilter.Hash("alice");
+
+        sketch.Add(key).Should().Be(1);
+        sketch.Add(key, 4).Should().Be(5);
+        sketch.Add(key, 100_000).Should().Be(ushort.MaxValue);
+        sketch.Estimate(CuckooFilter.Hash("bob")).Should().BeLessThanOrEqualTo(ushort.MaxValue);
+    }
+
+    [Fact]
+    public void Clear_ResetsAllCounts()
+    {
+        var sketch = new CountMinSketch(1000, 3);
+        sketch.Add(CuckooFilter.Hash("alice"), 3);
+
+        sketch.Clear();
+
+        sketch.Estimate(CuckooFilter.Hash("alice")).Should().Be(0);
+        sketch.Width.Should().Be(1024);
+        sketch.MemoryBytes.Should().Be(1024 * 3 * sizeof(ushort));
+    }
+}
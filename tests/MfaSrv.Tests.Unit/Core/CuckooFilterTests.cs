@@ -0,0 +1,98 @@
+using FluentAssertions;
+using MfaSrv.Core.Collections;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Core;
+
+public class CuckooFilterTests
+{
+    [Fact]
+    public void Contains_AddedKeys_NoFalseNegatives()
+    {
+        var filter = new CuckooFilter(10_000);
+        var keys = Enumerable.Range(0, 10_000).Select(_ => Guid.NewGuid().ToString()).ToList();
+
+        foreach (var key in keys)
+            filter.Add(key).Should().BeTrue();
+
+        filter.IsFull.Should().BeFalse();
+        filter.Count.Should().Be(keys.Count);
+        keys.Should().OnlyContain(k => filter.Contains(k));
+    }
+
+    [Fact]
+    public void Contains_UnknownKeys_FalsePositiveRateBelowOnePerThousand()
+    {
+        var filter = new CuckooFilter(10_000);
+        for (var i = 0; i < 10_000; i++)
+            filter.Add(Guid.NewGuid().ToString());
+
+        var falsePositives = Enumerable.Range(0, 100_000)
+            .Count(_ => filter.Contains(Guid.NewGuid().ToString()));
+
+        falsePositives.Should().BeLessThan(100);
+    }
+
+    [Fact]
+    public void Remove_AddedKey_NoLongerContained()
+    {
+        var filter = new CuckooFilter(100);
+        filter.Add("session-1");
+        filter.Add("session-2");
+
+        filter.Remove("session-1").Should().BeTrue();
+
+        filter.Contains("session-1").Should().BeFalse();
+        filter.Contains("session-2").Should().BeTrue();
+        filter.Count.Should().Be(1);
+    }
+
+    [Fact]
+    public void Add_BeyondCapacity_ReportsFullWithoutLosingKeys()
+    {
+        var filter = new CuckooFilter(64);
+        var added = new List<string>();
+
+        for (var i = 0; i < 1_000; i++)
+        {
+            var key = $"session-{i}";
+            if (!filter.Add(key))
+                break;
+            added.Add(key);
+        }
+
+        filter.IsFull.Should().BeTrue();
+        added.Should().OnlyContain(k => filter.Contains(k));
+    }
+
+    [Fact]
+    public void FromBytes_RoundTrip_PreservesMembership()
+    {
+        var filter = new CuckooFilter(1_000);
+        for (var i = 0; i < 500; i++)
+            filter.Add($"session-{i}");
+
+        var restored = CuckooFilter.FromBytes(filter.ToBytes());
+
+        restored.Count.Should().Be(500);
+        Enumerable.Range(0, 500).Should().OnlyContain(i => restored.Contains($"session-{i}"));
+    }
+
+    [Fact]
+    public void FromBytes_Truncated_Throws()
+    {
+        var bytes = new CuckooFilter(100).ToBytes();
+
+        var act = () => CuckooFilter.FromBytes(bytes.AsSpan(0, bytes.Length - 1));
+
+        act.Should().Throw<FormatException>();
+    }
+
+    [Fact]
+    public void Hash_IsPinned()
+    {
+        // Server and agents of different builds must agree on key hashes
+        CuckooFilter.Hash(string.Empty).Should().Be(0xF52A15E9A9B5E89BUL);
+        CuckooFilter.Hash("session-1").Should().NotBe(CuckooFilter.Hash("session-2"));
+    }
+}
@@ -0,0 +1,100 @@
+using FluentAssertions;
+using MfaSrv.Core.Collections;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Core;
+
+public class HashRingTests
+{
+    private static string[] Nodes(int count) =>
+        Enumerable.Range(0, count).Select(i => $"http://dc{i}:5090").ToArray();
+
+    [Fact]
+    public void GetOwners_ReturnsDistinctNodes_BoundedByNodeCount()
+    {
+        var ring = new HashRing(Nodes(3));
+
+        for (var i = 0; i < 1000; i++)
+        {
+            var key = CuckooFilter.Hash($"user{i}");
+            ring.GetOwners(key, 2).Should().HaveCount(2).And.OnlyHaveUniqueItems();
+            ring.GetOwners(key, 5).Should().HaveCount(3).And.OnlyHaveUniqueItems();
+        }
+
+        new HashRing(Array.Empty<string>()).GetOwners(42, 2).Should().BeEmpty();
+    }
+
+    [Fact]
+    public void GetOwners_SameNodesInAnyOrder_Agree()
+    {
+        var nodes = Nodes(6);
+        var ring = new HashRing(nodes);
+        var shuffled = new HashRing(nodes.Reverse().Append(nodes[0]));
+
+        for (var i = 0; i < 1000; i++)
+        {
+            var key = CuckooFilter.Hash($"user{i}");
+            shuffled.GetOwners(key, 2).Should().Equal(ring.GetOwners(key, 2));
+        }
+    }
+
+    [Fact]
+    public void IsOwner_MatchesGetOwners()
+    {
+        var nodes = Nodes(5);
+        var ring = new HashRing(nodes);
+
+        for (var i = 0; i < 1000; i++)
+        {
+            var key = CuckooFilter.Hash($"user{i}");
+            var owners = ring.GetOwners(key, 2);
+            nodes.Where(n => ring.IsOwner(key, 2, n)).Should().BeEquivalentTo(owners);
+        }
+
+        ring.IsOwner(CuckooFilter.Hash("user0"), 5, "http://unknown:5090").Should().BeFalse();
+    }
+
+    [Fact]
+    public void AddingNode_MovesAboutOneNthOfKeys_OnlyToNewNode()
+    {
+        var before = new HashRing(Nodes(9));
+        var after = new HashRing(Nodes(10));
+        const int keys = 50_000;
+        var moved = 0;
+
+        for (var i = 0; i < keys; i++)
+        {
+            var key = CuckooFilter.Hash($"user{i}");
+            var oldOwner = before.GetOwners(key, 1)[0];
+            var newOwner = after.GetOwners(key, 1)[0];
+            if (oldOwner == newOwner)
+                continue;
+
+            newOwner.Should().Be("http://dc9:5090");
+            moved++;
+        }
+
+        ((double)moved / keys).Should().BeInRange(0.05, 0.15);
+    }
+
+    [Fact]
+    public void GetOwners_SpreadsKeysEvenly()
+    {
+        var ring = new HashRing(Nodes(8));
+        const int keys = 80_000;
+        var primaries = new Dictionary<string, int>();
+        var replicas = new Dictionary<string, int>();
+
+        for (var i = 0; i < keys; i++)
+        {
+            var owners = ring.GetOwners(CuckooFilter.Hash($"user{i}"), 2);
+            primaries[owners[0]] = primaries.GetValueOrDefault(owners[0]) + 1;
+            foreach (var owner in owners)
+                replicas[owner] = replicas.GetValueOrDefault(owner) + 1;
+        }
+
+        primaries.Values.Max().Should().BeLessThan(keys / 8 * 13 / 10);
+        primaries.Values.Min().Should().BeGreaterThan(keys / 8 * 7 / 10);
+        replicas.Values.Max().Should().BeLessThan(keys * 2 / 8 * 12 / 10);
+    }
+}
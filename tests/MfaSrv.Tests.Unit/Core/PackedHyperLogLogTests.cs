@@ -0,0 +1,51 @@
+using FluentAssertions;
+using MfaSrv.Core.Collections;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Core;
+
+public class PackedHyperLogLogTests
+{
+    private static ulong Sketch(string prefix, int count)
+    {
+        var sketch = 0UL;
+        for (var i = 0; i < count; i++)
+            sketch = PackedHyperLogLog.Add(sketch, CuckooFilter.Hash($"{prefix}{i}"));
+        return sketch;
+    }
+
+    [Fact]
+    public void Estimate_SmallCounts_AreCloseToExact()
+    {
+        PackedHyperLogLog.Estimate(0).Should().Be(0);
+
+        for (var n = 1; n <= 5; n++)
+        {
+            var meanError = Enumerable.Range(0, 500)
+                .Average(trial => Math.Abs(Math.Round(PackedHyperLogLog.Estimate(Sketch($"{trial}-10.0.0.", n))) - n));
+            meanError.Should().BeLessThan(1.5, $"{n} distinct values");
+        }
+    }
+
+    [Fact]
+    public void Add_Duplicates_DoNotChangeTheSketch()
+    {
+        var sketch = Sketch("10.0.0.", 3);
+
+        PackedHyperLogLog.Add(sketch, CuckooFilter.Hash("10.0.0.1")).Should().Be(sketch);
+    }
+
+    [Fact]
+    public void Merge_EstimatesTheUnion()
+    {
+        var a = Sketch("10.0.0.", 3);
+        var b = Sketch("10.0.0.", 5); // includes the first 3
+
+        var merged = PackedHyperLogLog.Merge(a, b);
+
+        merged.Should().Be(b);
+        PackedHyperLogLog.Merge(merged, 0).Should().Be(merged);
+        PackedHyperLogLog.Merge(Sketch("a", 1000), Sketch("b", 1000)).Should()
+            .Match<ulong>(s => PackedHyperLogLog.Estimate(s) > 1000 && PackedHyperLogLog.Estimate(s) < 4000);
+    }
+}
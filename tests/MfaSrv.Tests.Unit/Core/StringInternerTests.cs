@@ -0,0 +1,62 @@
+using FluentAssertions;
+using MfaSrv.Core.Collections;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Core;
+
+public class StringInternerTests
+{
+    [Fact]
+    public void Acquire_SameString_ReturnsSameId()
+    {
+        var interner = new StringInterner();
+
+        var id = interner.Acquire("alice");
+
+        interner.Acquire(new string("alice")).Should().Be(id);
+        interner.Acquire("bob").Should().NotBe(id);
+        interner[id].Should().Be("alice");
+        interner.Count.Should().Be(2);
+    }
+
+    [Fact]
+    public void Acquire_CaseInsensitiveComparer_KeepsFirstSpelling()
+    {
+        var interner = new StringInterner(StringComparer.OrdinalIgnoreCase);
+
+        var id = interner.Acquire("JSmith");
+
+        interner.Acquire("jsmith").Should().Be(id);
+        interner[id].Should().Be("JSmith");
+        interner.TryGetId("JSMITH", out var found).Should().BeTrue();
+        found.Should().Be(id);
+    }
+
+    [Fact]
+    public void Release_LastReference_ForgetsStringAndReusesId()
+    {
+        var interner = new StringInterner();
+        var id = interner.Acquire("alice");
+        interner.Acquire("alice");
+
+        interner.Release(id);
+        interner.TryGetId("alice", out _).Should().BeTrue();
+
+        interner.Release(id);
+        interner.TryGetId("alice", out _).Should().BeFalse();
+        interner.Count.Should().Be(0);
+
+        interner.Acquire("carol").Should().Be(id);
+    }
+
+    [Fact]
+    public void Acquire_ManyStrings_GrowsAndKeepsIdsStable()
+    {
+        var interner = new StringInterner();
+        var ids = Enumerable.Range(0, 1000).Select(i => interner.Acquire($"user{i}")).ToList();
+
+        ids.Should().OnlyHaveUniqueItems();
+        for (var i = 0; i < 1000; i++)
+            interner[ids[i]].Should().Be($"user{i}");
+    }
+}
@@ -104,6 +104,48 @@ public class TotpGeneratorTests
         TotpGenerator.Validate(secret, code, now, toleranceSteps: 1).Should().BeTrue();
     }
 
+    [Theory]
+    [InlineData(59L, "94287082")]
+    [InlineData(1111111109L, "07081804")]
+    [InlineData(1234567890L, "89005924")]
+    [InlineData(20000000000L, "65353130")]
+    public void ComputeTotp_MatchesRfc6238Sha1Vectors(long unixSeconds, string expected)
+    {
+        var secret = System.Text.Encoding.ASCII.GetBytes("12345678901234567890");
+
+        TotpGenerator.ComputeTotp(secret, DateTimeOffset.FromUnixTimeSeconds(unixSeconds), digits: 8)
+            .Should().Be(expected);
+    }
+
+    [Fact]
+    public void TotpKey_Match_ReturnsLatestMatchingStep()
+    {
+        var secret = TotpGenerator.GenerateSecret();
+        using var key = TotpKey.Create(secret);
+        const long step = 50_000_000;
+
+        var previous = key.ComputeCode(step - 1).ToString("D6");
+        key.Match(previous, step, toleranceSteps: 1).Should().Be(step - 1);
+        key.Match(previous, step + 2, toleranceSteps: 1).Should().Be(-1);
+        key.Match("12a456", step, toleranceSteps: 1).Should().Be(-1);
+    }
+
+    [Fact]
+    public void TotpKey_LongSecret_MatchesHmacSha1()
+    {
+        var secret = TotpGenerator.GenerateSecret(100);
+        using var key = TotpKey.Create(secret);
+        using var hmac = new System.Security.Cryptography.HMACSHA1(secret);
+
+        var counter = new byte[8];
+        System.Buffers.Binary.BinaryPrimitives.WriteInt64BigEndian(counter, 123456);
+        var hash = hmac.ComputeHash(counter);
+        var offset = hash[^1] & 0x0F;
+        var expected = (System.Buffers.Binary.BinaryPrimitives.ReadInt32BigEndian(hash.AsSpan(offset)) & 0x7FFFFFFF) % 1_000_000;
+
+        key.ComputeCode(123456).Should().Be(expected);
+    }
+
     [Fact]
     public void GenerateProvisioningUri_ReturnsValidOtpauthUri()
     {
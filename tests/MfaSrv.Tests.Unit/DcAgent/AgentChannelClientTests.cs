@@ -0,0 +1,118 @@
+using Xunit;
+using FluentAssertions;
+using Google.Protobuf.WellKnownTypes;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.ValueObjects;
+using MfaSrv.DcAgent;
+using MfaSrv.DcAgent.Services;
+using MfaSrv.Protocol;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
+
+namespace MfaSrv.Tests.Unit.DcAgent;
+
+public class AgentChannelClientTests : IAsyncLifetime
+{
+    private SqliteCacheStore _store = null!;
+    private SessionCacheService _cache = null!;
+    private AgentChannelClient _client = null!;
+
+    public async Task InitializeAsync()
+    {
+        _store = new SqliteCacheStore(":memory:", NullLogger<SqliteCacheStore>.Instance);
+        await _store.InitializeAsync();
+        _cache = new SessionCacheService(NullLogger<SessionCacheService>.Instance, _store);
+
+        var settings = Options.Create(new DcAgentSettings { CentralServerUrl = "https://localhost:5081" });
+        _client = new AgentChannelClient(
+            new FailoverManager(settings, NullLogger<FailoverManager>.Instance),
+            _cache,
+            new SessionPartitioner(
+                Options.Create(new SessionPartitioningSettings()), settings, NullLogger<SessionPartitioner>.Instance),
+            settings,
+            NullLogger<AgentChannelClient>.Instance);
+    }
+
+    public Task DisposeAsync()
+    {
+        _client.Dispose();
+        _store.Dispose();
+        return Task.CompletedTask;
+    }
+
+    [Fact]
+    public void ApplySessionEvent_Created_CachesSession()
+    {
+        var expiresAt = DateTimeOffset.UtcNow.AddHours(8);
+
+        _client.ApplySessionEvent(new SessionEvent
+        {
+            SessionId = "sess-1",
+            UserName = "jsmith",
+            SourceIp = "10.0.0.5",
+            ExpiresAt = Timestamp.FromDateTimeOffset(expiresAt),
+            VerifiedMethod = "Totp"
+        });
+
+        var session = _cache.FindSession("jsmith", "10.0.0.5");
+        session.Should().NotBeNull();
+        session!.SessionId.Should().Be("sess-1");
+        session.ExpiresAt.Should().Be(expiresAt);
+    }
+
+    [Fact]
+    public void ApplySessionEvent_Revoked_RevokesCachedSession()
+    {
+        _client.ApplySessionEvent(new SessionEvent
+        {
+            SessionId = "sess-1",
+            UserName = "jsmith",
+            SourceIp = "10.0.0.5",
+            ExpiresAt = Timestamp.FromDateTimeOffset(DateTimeOffset.UtcNow.AddHours(8))
+        });
+
+        _client.ApplySessionEvent(new SessionEvent { SessionId = "sess-1", Revoked = true });
+
+        _cache.FindSession("jsmith", "10.0.0.5").Should().BeNull();
+    }
+
+    [Fact]
+    public void ReportLocalDecision_ChannelDown_QueuesUntilFull()
+    {
+        var query = new AuthQueryMessage { UserName = "jsmith", Domain = "CORP", SourceIp = "10.0.0.5" };
+        var deny = new PolicyEvaluationResult { Decision = AuthDecision.Deny, MatchedPolicyName = "block-contractors" };
+
+        for (var i = 0; i < AgentChannelClient.LocalDecisionQueueCapacity; i++)
+            _client.ReportLocalDecision(query, deny, DateTimeOffset.UtcNow).Should().BeTrue();
+
+        _client.ReportLocalDecision(query, deny, DateTimeOffset.UtcNow).Should().BeFalse();
+        _client.PendingLocalDecisions.Should().Be(AgentChannelClient.LocalDecisionQueueCapacity);
+    }
+
+    [Fact]
+    public void ReconnectDelay_NeverBelowBackoffAndAtMostHalfAgain()
+    {
+        var backoff = TimeSpan.FromSeconds(5);
+
+        var delays = Enumerable.Range(0, 1000).Select(_ => AgentChannelClient.ReconnectDelay(backoff)).ToList();
+
+        delays.Should().OnlyContain(delay => delay >= backoff && delay < backoff * 1.5);
+        delays.Distinct().Should().HaveCountGreaterThan(1);
+    }
+
+    [Fact]
+    public async Task EvaluateAsync_NotConnected_ReturnsNullForUnaryFallback()
+    {
+        _client.IsConnected.Should().BeFalse();
+
+        var response = await _client.EvaluateAsync(new AuthQueryMessage
+        {
+            UserName = "jsmith",
+            Domain = "CORP",
+            SourceIp = "10.0.0.5",
+            Protocol = AuthProtocol.Kerberos
+        }, CancellationToken.None);
+
+        response.Should().BeNull();
+    }
+}
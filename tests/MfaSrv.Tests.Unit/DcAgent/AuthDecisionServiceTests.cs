@@ -1,9 +1,12 @@
+using System.Text.Json;
 using Xunit;
 using FluentAssertions;
+using MfaSrv.Core.Entities;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.ValueObjects;
 using MfaSrv.DcAgent;
 using MfaSrv.DcAgent.Services;
+using MfaSrv.Protocol;
 using Microsoft.Extensions.Logging.Abstractions;
 using Microsoft.Extensions.Options;
 
@@ -17,7 +20,7 @@ public class AuthDecisionServiceTests
     /// so we can test failover mode logic.
     /// </summary>
     private static (AuthDecisionService Service, SessionCacheService SessionCache, PolicyCacheService PolicyCache, FailoverManager FailoverMgr)
-        CreateServices(string failoverMode = "FailOpen")
+        CreateServices(string failoverMode = "FailOpen", DirectoryCacheService? directory = null, SprayDetectionSettings? spray = null)
     {
         var store = CreateInMemorySqliteStore().GetAwaiter().GetResult();
 
@@ -29,17 +32,36 @@ public class AuthDecisionServiceTests
         {
             FailoverMode = failoverMode,
             SessionTtlMinutes = 480,
-            CentralServerUrl = "https://localhost:5081"
+            CentralServerUrl = "https://localhost:5081",
+            LocalEvaluation = directory != null
         });
 
         var failoverMgr = new FailoverManager(
             settings,
             NullLogger<FailoverManager>.Instance);
 
+        var partitioner = new SessionPartitioner(
+            Options.Create(new SessionPartitioningSettings()),
+            settings,
+            NullLogger<SessionPartitioner>.Instance);
+
+        var agentChannel = new AgentChannelClient(
+            failoverMgr,
+            sessionCache,
+            partitioner,
+            settings,
+            NullLogger<AgentChannelClient>.Instance);
+
         var service = new AuthDecisionService(
             sessionCache,
+            partitioner,
             policyCache,
+            directory ?? new DirectoryCacheService(NullLogger<DirectoryCacheService>.Instance),
+            new SprayDetectionService(
+                Options.Create(spray ?? new SprayDetectionSettings()),
+                NullLogger<SprayDetectionService>.Instance),
             failoverMgr,
+            agentChannel,
             settings,
             NullLogger<AuthDecisionService>.Instance);
 
@@ -325,4 +347,166 @@ public class AuthDecisionServiceTests
         // Expired session should not count, falls to FailClose
         result.Decision.Should().Be(AuthDecision.Deny);
     }
+
+    private static DirectoryCacheService CreateDirectory()
+    {
+        var directory = new DirectoryCacheService(NullLogger<DirectoryCacheService>.Instance);
+        var chunk = new DirectoryChunk { Version = "v1", Index = 0, Count = 1 };
+        chunk.Groups.Add("Contractors");
+        chunk.Ous.Add("OU=Staff,DC=corp,DC=local");
+        chunk.Users.Add(new DirectoryUser { UserName = "contractor", Ou = 1, Groups = { 0 } });
+        chunk.Users.Add(new DirectoryUser { UserName = "employee", Ou = 1 });
+        directory.ApplyChunk(chunk);
+        return directory;
+    }
+
+    private static CachedPolicy SyncedPolicy(string id, PolicyActionType action, FailoverMode failoverMode, PolicyRule rule)
+    {
+        var policy = new Policy { Id = id, Name = id, Priority = 1, FailoverMode = failoverMode };
+        policy.RuleGroups.Add(new PolicyRuleGroup { Rules = { rule } });
+        policy.Actions.Add(new PolicyAction { ActionType = action });
+
+        return new CachedPolicy
+        {
+            PolicyId = id,
+            Name = id,
+            PolicyJson = JsonSerializer.Serialize(policy, new JsonSerializerOptions { PropertyNamingPolicy = JsonNamingPolicy.CamelCase }),
+            FailoverMode = failoverMode,
+            Priority = 1,
+            IsEnabled = true,
+            UpdatedAt = DateTimeOffset.UtcNow
+        };
+    }
+
+    private static AuthQueryMessage Query(string userName, string sourceIp = "10.0.0.1") => new()
+    {
+        UserName = userName,
+        Domain = "CORP",
+        SourceIp = sourceIp,
+        Protocol = AuthProtocol.Kerberos
+    };
+
+    [Fact]
+    public async Task EvaluateAsync_LocalEvaluation_DeniesByReplicatedGroup()
+    {
+        var (service, _, policyCache, _) = CreateServices("FailOpen", CreateDirectory());
+        policyCache.ApplySnapshot("e1", 1, new[]
+        {
+            SyncedPolicy("deny-contractors", PolicyActionType.Deny, FailoverMode.FailOpen,
+                new PolicyRule { RuleType = PolicyRuleType.SourceGroup, Operator = "Equals", Value = "contractors" })
+        });
+
+        var denied = await service.EvaluateAsync(Query("contractor"));
+        denied.Decision.Should().Be(AuthDecision.Deny);
+        denied.Reason.Should().Contain("Local evaluation");
+
+        var allowed = await service.EvaluateAsync(Query("employee"));
+        allowed.Decision.Should().Be(AuthDecision.Allow);
+        allowed.Reason.Should().Contain("Local evaluation").And.Contain("No matching policy");
+    }
+
+    [Fact]
+    public async Task EvaluateAsync_LocalEvaluation_RequireMfa_UsesMatchedPolicyFailoverMode()
+    {
+        var (service, _, policyCache, _) = CreateServices("FailOpen", CreateDirectory());
+        policyCache.ApplySnapshot("e1", 1, new[]
+        {
+            SyncedPolicy("mfa-staff", PolicyActionType.RequireMfa, FailoverMode.FailClose,
+                new PolicyRule { RuleType = PolicyRuleType.SourceOu, Operator = "Contains", Value = "OU=Staff" })
+        });
+
+        // MFA is needed and the server is down: the matched policy's FailClose applies
+        var result = await service.EvaluateAsync(Query("employee"));
+
+        result.Decision.Should().Be(AuthDecision.Deny);
+        result.Reason.Should().Contain("Fail-close");
+    }
+
+    [Fact]
+    public async Task EvaluateAsync_LocalEvaluation_NoPolicySnapshotYet_FallsBack()
+    {
+        var (service, _, _, _) = CreateServices("FailClose", CreateDirectory());
+
+        var result = await service.EvaluateAsync(Query("employee"));
+
+        result.Decision.Should().Be(AuthDecision.Deny);
+        result.Reason.Should().Contain("Fail-close");
+    }
+
+    [Fact]
+    public async Task EvaluateAsync_LocalEvaluation_RiskScoreRule_DefersToServer()
+    {
+        var (service, _, policyCache, _) = CreateServices("FailClose", CreateDirectory());
+        policyCache.ApplySnapshot("e1", 1, new[]
+        {
+            SyncedPolicy("deny-contractors", PolicyActionType.Deny, FailoverMode.FailOpen,
+                new PolicyRule { RuleType = PolicyRuleType.SourceGroup, Operator = "Equals", Value = "contractors" }),
+            SyncedPolicy("risky", PolicyActionType.RequireMfa, FailoverMode.FailOpen,
+                new PolicyRule { RuleType = PolicyRuleType.RiskScore, Value = "> 50" })
+        });
+
+        // Only the server knows risk scores, so nothing is decided locally
+        var result = await service.EvaluateAsync(Query("employee"));
+
+        result.Reason.Should().NotContain("Local evaluation");
+    }
+
+    [Fact]
+    public async Task EvaluateAsync_UserFlood_DenyAction_DeniesLocally()
+    {
+        var (service, _, _, _) = CreateServices("FailOpen",
+            spray: new SprayDetectionSettings { Action = "Deny", MaxLogonsPerUser = 3 });
+
+        for (var i = 0; i < 3; i++)
+            (await service.EvaluateAsync(Query("ceo"))).Decision.Should().Be(AuthDecision.Allow);
+
+        var result = await service.EvaluateAsync(Query("ceo"));
+
+        result.Decision.Should().Be(AuthDecision.Deny);
+        result.Reason.Should().Contain("spray detection").And.Contain("UserFlood");
+
+        (await service.EvaluateAsync(Query("alice"))).Decision.Should().Be(AuthDecision.Allow);
+    }
+
+    [Fact]
+    public async Task EvaluateAsync_UserFlood_DenyAction_SessionStillAllows()
+    {
+        var (service, sessionCache, _, _) = CreateServices("FailOpen",
+            spray: new SprayDetectionSettings { Action = "Deny", MaxLogonsPerUser = 2 });
+
+        await service.EvaluateAsync(Query("ceo"));
+        await service.EvaluateAsync(Query("ceo"));
+        (await service.EvaluateAsync(Query("ceo"))).Decision.Should().Be(AuthDecision.Deny);
+
+        // A flood against the user must not lock out the user once they have completed MFA
+        sessionCache.AddOrUpdateSession(new CachedSession
+        {
+            SessionId = "sess-ceo",
+            UserId = "ceo",
+            UserName = "ceo",
+            SourceIp = "10.0.0.1",
+            ExpiresAt = DateTimeOffset.UtcNow.AddHours(1),
+            VerifiedMethod = "TOTP",
+            Revoked = false
+        });
+
+        var result = await service.EvaluateAsync(Query("ceo"));
+        result.Decision.Should().Be(AuthDecision.Allow);
+        result.SessionToken.Should().Be("sess-ceo");
+    }
+
+    [Fact]
+    public async Task EvaluateAsync_UserFlood_ThrottleAction_DelaysThenEvaluates()
+    {
+        var (service, _, _, _) = CreateServices("FailOpen",
+            spray: new SprayDetectionSettings { Action = "Throttle", MaxLogonsPerUser = 1, ThrottleDelayMs = 200 });
+
+        await service.EvaluateAsync(Query("ceo"));
+        var stopwatch = System.Diagnostics.Stopwatch.StartNew();
+        var result = await service.EvaluateAsync(Query("ceo"));
+
+        stopwatch.ElapsedMilliseconds.Should().BeGreaterOrEqualTo(150);
+        result.Decision.Should().Be(AuthDecision.Allow);
+        result.Reason.Should().Contain("Fail-open");
+    }
 }
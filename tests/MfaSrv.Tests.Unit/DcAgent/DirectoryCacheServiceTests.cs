@@ -0,0 +1,75 @@
+using FluentAssertions;
+using Microsoft.Extensions.Logging.Abstractions;
+using MfaSrv.DcAgent.Services;
+using MfaSrv.Protocol;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.DcAgent;
+
+public class DirectoryCacheServiceTests
+{
+    private readonly DirectoryCacheService _cache = new(NullLogger<DirectoryCacheService>.Instance);
+
+    private static DirectoryChunk Chunk(string version, int index, int count, params string[] users)
+    {
+        var chunk = new DirectoryChunk { Version = version, Index = index, Count = count };
+        if (index == 0)
+        {
+            chunk.Groups.Add("Staff");
+            chunk.Ous.Add("OU=Staff,DC=corp,DC=local");
+        }
+        foreach (var user in users)
+            chunk.Users.Add(new DirectoryUser { UserName = user, Ou = 1, Groups = { 0 } });
+        return chunk;
+    }
+
+    [Fact]
+    public void ApplyChunk_SwapsInOnlyAfterLastChunk()
+    {
+        _cache.ApplyChunk(Chunk("v1", 0, 2, "alice")).Should().BeTrue();
+        _cache.IsLoaded.Should().BeFalse();
+
+        _cache.ApplyChunk(Chunk("v1", 1, 2, "bob")).Should().BeTrue();
+
+        _cache.Version.Should().Be("v1");
+        _cache.UserCount.Should().Be(2);
+        _cache.TryGetUser("bob", out var groups, out var ou).Should().BeTrue();
+        groups.Should().Equal("Staff");
+        ou.Should().Be("OU=Staff,DC=corp,DC=local");
+    }
+
+    [Fact]
+    public void ApplyChunk_OutOfOrderOrMixedVersions_DiscardsPartialSnapshot()
+    {
+        _cache.ApplyChunk(Chunk("v1", 1, 2, "bob")).Should().BeFalse();
+
+        _cache.ApplyChunk(Chunk("v1", 0, 2, "alice")).Should().BeTrue();
+        _cache.ApplyChunk(Chunk("v2", 1, 2, "bob")).Should().BeFalse();
+
+        // The partial v1 snapshot is gone, so its next chunk no longer fits either
+        _cache.ApplyChunk(Chunk("v1", 1, 2, "bob")).Should().BeFalse();
+        _cache.IsLoaded.Should().BeFalse();
+    }
+
+    [Fact]
+    public void ApplyChunk_CurrentVersion_IsIgnored_NewVersionReplacesIt()
+    {
+        _cache.ApplyChunk(Chunk("v1", 0, 1, "alice")).Should().BeTrue();
+        _cache.ApplyChunk(Chunk("v1", 0, 1, "bob")).Should().BeTrue();
+        _cache.TryGetUser("bob", out _, out _).Should().BeFalse();
+
+        _cache.ApplyChunk(Chunk("v2", 0, 1, "bob")).Should().BeTrue();
+        _cache.TryGetUser("bob", out _, out _).Should().BeTrue();
+        _cache.TryGetUser("alice", out var groups, out var ou).Should().BeFalse();
+        groups.Should().BeEmpty();
+        ou.Should().BeNull();
+    }
+
+    [Fact]
+    public void TryGetUser_IsCaseSensitiveLikeTheServer()
+    {
+        _cache.ApplyChunk(Chunk("v1", 0, 1, "alice"));
+
+        _cache.TryGetUser("Alice", out _, out _).Should().BeFalse();
+    }
+}
@@ -0,0 +1,104 @@
+using System.Buffers;
+using System.Text;
+using System.Text.Json;
+using Xunit;
+using FluentAssertions;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.ValueObjects;
+
+namespace MfaSrv.Tests.Unit.DcAgent;
+
+public class NamedPipeJsonContextTests
+{
+    // Query exactly as built by BuildQueryJson in the native LSA DLL
+    private static readonly byte[] NativeQuery = Encoding.UTF8.GetBytes(
+        "{\"userName\":\"jsmith\",\"domain\":\"CONTOSO\",\"sourceIp\":\"10.0.0.5\",\"workstation\":\"WS001\",\"protocol\":1}");
+
+    [Fact]
+    public void Deserialize_NativeQuery_ParsesAllFields()
+    {
+        var query = JsonSerializer.Deserialize(NativeQuery, NamedPipeJsonContext.Default.AuthQueryMessage);
+
+        query.Should().NotBeNull();
+        query!.UserName.Should().Be("jsmith");
+        query.Domain.Should().Be("CONTOSO");
+        query.SourceIp.Should().Be("10.0.0.5");
+        query.Workstation.Should().Be("WS001");
+        query.Protocol.Should().Be(AuthProtocol.Ntlm);
+    }
+
+    [Fact]
+    public void Deserialize_PascalCaseQuery_IsCaseInsensitive()
+    {
+        var json = Encoding.UTF8.GetBytes("{\"UserName\":\"jsmith\",\"Domain\":\"CONTOSO\",\"Protocol\":2}");
+
+        var query = JsonSerializer.Deserialize(json, NamedPipeJsonContext.Default.AuthQueryMessage);
+
+        query!.UserName.Should().Be("jsmith");
+        query.Protocol.Should().Be(AuthProtocol.Ldap);
+    }
+
+    [Fact]
+    public void Serialize_Response_UsesCamelCaseAndNumericDecision()
+    {
+        var response = new AuthResponseMessage
+        {
+            Decision = AuthDecision.Deny,
+            Reason = "blocked",
+            TimeoutMs = 500
+        };
+
+        var json = JsonSerializer.Serialize(response, NamedPipeJsonContext.Default.AuthResponseMessage);
+
+        json.Should().Contain("\"decision\":2");
+        json.Should().Contain("\"reason\":\"blocked\"");
+        json.Should().Contain("\"timeoutMs\":500");
+    }
+
+    /// <summary>
+    /// Allocation benchmark for one pipe round trip (deserialize query + serialize response).
+    /// Compares the source-generated path against the previous reflection path that built
+    /// fresh JsonSerializerOptions and intermediate strings per message.
+    /// </summary>
+    [Fact]
+    public void RoundTrip_SourceGenerated_AllocatesLessThanReflectionPath()
+    {
+        const int iterations = 1000;
+        var response = new AuthResponseMessage { Decision = AuthDecision.Allow, Reason = "Cached MFA session valid" };
+        var output = new ArrayBufferWriter<byte>(1024);
+        using var writer = new Utf8JsonWriter(output);
+
+        void SourceGenerated()
+        {
+            JsonSerializer.Deserialize(NativeQuery, NamedPipeJsonContext.Default.AuthQueryMessage);
+            output.Clear();
+            writer.Reset(output);
+            JsonSerializer.Serialize(writer, response, NamedPipeJsonContext.Default.AuthResponseMessage);
+        }
+
+        void Reflection()
+        {
+            var json = Encoding.UTF8.GetString(NativeQuery);
+            JsonSerializer.Deserialize<AuthQueryMessage>(json, new JsonSerializerOptions { PropertyNameCaseInsensitive = true });
+            var responseJson = JsonSerializer.Serialize(response, new JsonSerializerOptions { PropertyNamingPolicy = JsonNamingPolicy.CamelCase });
+            Encoding.UTF8.GetBytes(responseJson);
+        }
+
+        var sourceGenBytes = MeasureAllocatedBytesPerCall(SourceGenerated, iterations);
+        var reflectionBytes = MeasureAllocatedBytesPerCall(Reflection, iterations);
+
+        sourceGenBytes.Should().BeLessThan(reflectionBytes / 2,
+            "source-generated round trip allocated {0} B/query vs {1} B/query for the reflection path",
+            sourceGenBytes, reflectionBytes);
+    }
+
+    private static long MeasureAllocatedBytesPerCall(Action action, int iterations)
+    {
+        // Warm up metadata caches so only steady-state allocations are measured
+        for (var i = 0; i < 10; i++) action();
+
+        var before = GC.GetAllocatedBytesForCurrentThread();
+        for (var i = 0; i < iterations; i++) action();
+        return (GC.GetAllocatedBytesForCurrentThread() - before) / iterations;
+    }
+}
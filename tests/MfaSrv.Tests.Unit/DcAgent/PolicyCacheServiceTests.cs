@@ -0,0 +1,72 @@
+using Xunit;
+using FluentAssertions;
+using MfaSrv.DcAgent.Services;
+using Microsoft.Extensions.Logging.Abstractions;
+
+namespace MfaSrv.Tests.Unit.DcAgent;
+
+public class PolicyCacheServiceTests : IAsyncLifetime
+{
+    private SqliteCacheStore _store = null!;
+    private PolicyCacheService _cache = null!;
+
+    public async Task InitializeAsync()
+    {
+        _store = new SqliteCacheStore(":memory:", NullLogger<SqliteCacheStore>.Instance);
+        await _store.InitializeAsync();
+        _cache = new PolicyCacheService(NullLogger<PolicyCacheService>.Instance, _store);
+    }
+
+    public Task DisposeAsync()
+    {
+        _store.Dispose();
+        return Task.CompletedTask;
+    }
+
+    private static CachedPolicy Policy(string id, string json = "{}") => new()
+    {
+        PolicyId = id,
+        Name = id,
+        PolicyJson = json,
+        IsEnabled = true
+    };
+
+    [Fact]
+    public void ApplySnapshot_ReplacesPolicySet_AndDropsPoliciesMissingFromIt()
+    {
+        _cache.UpdatePolicy(Policy("deleted-while-offline"));
+        _cache.UpdatePolicy(Policy("p1"));
+
+        _cache.ApplySnapshot("epoch-1", 7, new[] { Policy("p1"), Policy("p2") });
+
+        _cache.GetPolicies().Select(p => p.PolicyId).Should().BeEquivalentTo("p1", "p2");
+        _cache.PolicyEpoch.Should().Be("epoch-1");
+        _cache.PolicyVersion.Should().Be(7);
+    }
+
+    [Fact]
+    public void ApplyChange_NextVersion_AppliesAndAdvances()
+    {
+        _cache.ApplySnapshot("epoch-1", 7, new[] { Policy("p1") });
+
+        _cache.ApplyChange("epoch-1", 8, "p2", Policy("p2")).Should().BeTrue();
+        _cache.ApplyChange("epoch-1", 9, "p1", null).Should().BeTrue();
+
+        _cache.GetPolicies().Select(p => p.PolicyId).Should().Equal("p2");
+        _cache.PolicyVersion.Should().Be(9);
+    }
+
+    [Fact]
+    public void ApplyChange_DuplicateIgnored_GapOrOtherEpochRejected()
+    {
+        _cache.ApplySnapshot("epoch-1", 7, new[] { Policy("p1", "{\"v\":2}") });
+
+        _cache.ApplyChange("epoch-1", 7, "p1", Policy("p1", "{\"v\":1}")).Should().BeTrue();
+        _cache.GetPolicies().Single().PolicyJson.Should().Be("{\"v\":2}");
+
+        _cache.ApplyChange("epoch-1", 9, "p3", Policy("p3")).Should().BeFalse();
+        _cache.ApplyChange("epoch-2", 8, "p3", Policy("p3")).Should().BeFalse();
+        _cache.PolicyVersion.Should().Be(7);
+        _cache.PolicyCount.Should().Be(1);
+    }
+}
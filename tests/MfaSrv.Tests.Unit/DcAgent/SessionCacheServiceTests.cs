@@ -0,0 +1,98 @@
+using Xunit;
+using FluentAssertions;
+using MfaSrv.Core.Collections;
+using MfaSrv.DcAgent.Services;
+using Microsoft.Extensions.Logging.Abstractions;
+
+namespace MfaSrv.Tests.Unit.DcAgent;
+
+public class SessionCacheServiceTests : IAsyncLifetime
+{
+    private SqliteCacheStore _store = null!;
+    private SessionCacheService _cache = null!;
+
+    public async Task InitializeAsync()
+    {
+        _store = new SqliteCacheStore(":memory:", NullLogger<SqliteCacheStore>.Instance);
+        await _store.InitializeAsync();
+        _cache = new SessionCacheService(NullLogger<SessionCacheService>.Instance, _store);
+    }
+
+    public Task DisposeAsync()
+    {
+        _store.Dispose();
+        return Task.CompletedTask;
+    }
+
+    private void AddSession(string sessionId, string userName = "jsmith")
+    {
+        _cache.AddOrUpdateSession(new CachedSession
+        {
+            SessionId = sessionId,
+            UserId = userName,
+            UserName = userName,
+            SourceIp = "10.0.0.5",
+            ExpiresAt = DateTimeOffset.UtcNow.AddHours(1),
+            VerifiedMethod = "server"
+        });
+    }
+
+    [Fact]
+    public void FindSession_SessionInRevocationSnapshot_NotReturned()
+    {
+        AddSession("sess-1");
+        var filter = new CuckooFilter(100);
+        filter.Add("sess-1");
+
+        _cache.ApplyRevocationFilterSnapshot(1, filter.ToBytes());
+
+        _cache.FindSession("jsmith", "10.0.0.5").Should().BeNull();
+        _cache.RevocationFilterVersion.Should().Be(1);
+    }
+
+    [Fact]
+    public void ApplyRevocationFilterDelta_NextVersion_RevokesCachedSession()
+    {
+        AddSession("sess-1");
+        _cache.ApplyRevocationFilterSnapshot(5, new CuckooFilter(100).ToBytes());
+        _cache.FindSession("jsmith", "10.0.0.5").Should().NotBeNull();
+
+        var applied = _cache.ApplyRevocationFilterDelta(6, new[] { CuckooFilter.Hash("sess-1") }, Array.Empty<ulong>());
+
+        applied.Should().BeTrue();
+        _cache.FindSession("jsmith", "10.0.0.5").Should().BeNull();
+        _cache.GetAllSessions().Single().Revoked.Should().BeTrue();
+    }
+
+    [Fact]
+    public void ApplyRevocationFilterDelta_RemovalAfterRevoke_SessionStaysRevoked()
+    {
+        AddSession("sess-1");
+        _cache.ApplyRevocationFilterSnapshot(1, new CuckooFilter(100).ToBytes());
+        var hash = CuckooFilter.Hash("sess-1");
+
+        _cache.ApplyRevocationFilterDelta(2, new[] { hash }, Array.Empty<ulong>());
+        _cache.ApplyRevocationFilterDelta(3, Array.Empty<ulong>(), new[] { hash });
+
+        _cache.FindSession("jsmith", "10.0.0.5").Should().BeNull();
+    }
+
+    [Fact]
+    public void ApplyRevocationFilterDelta_VersionGap_RequestsResync()
+    {
+        _cache.ApplyRevocationFilterSnapshot(1, new CuckooFilter(100).ToBytes());
+
+        _cache.ApplyRevocationFilterDelta(3, new[] { CuckooFilter.Hash("sess-1") }, Array.Empty<ulong>())
+            .Should().BeFalse();
+        _cache.ApplyRevocationFilterDelta(1, Array.Empty<ulong>(), Array.Empty<ulong>())
+            .Should().BeTrue("already-applied versions are ignored");
+        _cache.RevocationFilterVersion.Should().Be(1);
+    }
+
+    [Fact]
+    public void ApplyRevocationFilterDelta_BeforeSnapshot_RequestsResync()
+    {
+        _cache.ApplyRevocationFilterDelta(1, Array.Empty<ulong>(), Array.Empty<ulong>())
+            .Should().BeFalse();
+    }
+}
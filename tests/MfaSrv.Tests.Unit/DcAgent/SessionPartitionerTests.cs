@@ -0,0 +1,143 @@
+using FluentAssertions;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
+using MfaSrv.DcAgent;
+using MfaSrv.DcAgent.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.DcAgent;
+
+/// <summary>
+/// Simulates a multi-site deployment with one partitioner per agent, configured the way each
+/// agent's appsettings would be, and checks that they agree on owners.
+/// </summary>
+public class SessionPartitionerTests
+{
+    private const int Users = 20_000;
+
+    private static string[][] Sites(int sites, int agentsPerSite) =>
+        Enumerable.Range(0, sites)
+            .Select(s => Enumerable.Range(0, agentsPerSite).Select(i => $"http://dc{s}-{i}:5090").ToArray())
+            .ToArray();
+
+    private static SessionPartitioner Create(string[][] sites, int site, string self, int replicas = 2)
+    {
+        var peerSites = new Dictionary<string, string[]>();
+        for (var s = 0; s < sites.Length; s++)
+        {
+            if (s != site)
+                peerSites[$"site{s}"] = sites[s];
+        }
+
+        return new SessionPartitioner(
+            Options.Create(new SessionPartitioningSettings
+            {
+                Enabled = true,
+                SelfUrl = self,
+                Site = $"site{site}",
+                PeerSites = peerSites,
+                Replicas = replicas
+            }),
+            Options.Create(new DcAgentSettings
+            {
+                GossipPeers = sites.SelectMany(s => s).Where(a => a != self).ToArray()
+            }),
+            NullLogger<SessionPartitioner>.Instance);
+    }
+
+    private static Dictionary<string, SessionPartitioner> CreateAll(string[][] sites, int replicas = 2) =>
+        sites.SelectMany((agents, site) => agents.Select(agent => (agent, site)))
+            .ToDictionary(a => a.agent, a => Create(sites, a.site, a.agent, replicas));
+
+    [Fact]
+    public void Disabled_OwnsEverything()
+    {
+        var partitioner = new SessionPartitioner(
+            Options.Create(new SessionPartitioningSettings()),
+            Options.Create(new DcAgentSettings { GossipPeers = new[] { "http://dc1:5090" } }),
+            NullLogger<SessionPartitioner>.Instance);
+
+        partitioner.IsEnabled.Should().BeFalse();
+        partitioner.IsLocalOwner("alice").Should().BeTrue();
+        partitioner.IsOwnedBy("http://dc1:5090", "alice").Should().BeTrue();
+        partitioner.GetLocalOwners("alice").Should().BeEmpty();
+    }
+
+    [Fact]
+    public async Task EnabledWithoutSelfUrl_FallsBackToHoldingEverything()
+    {
+        var partitioner = new SessionPartitioner(
+            Options.Create(new SessionPartitioningSettings { Enabled = true }),
+            Options.Create(new DcAgentSettings { GossipPeers = new[] { "http://dc1:5090" } }),
+            NullLogger<SessionPartitioner>.Instance);
+
+        partitioner.IsEnabled.Should().BeFalse();
+        partitioner.IsLocalOwner("alice").Should().BeTrue();
+        (await partitioner.FindRemoteSessionAsync("alice", "10.0.0.1")).Should().BeNull();
+    }
+
+    [Fact]
+    public void EveryUser_HasReplicasOwnersInEverySite()
+    {
+        var sites = Sites(3, 4);
+        var agents = CreateAll(sites);
+
+        for (var u = 0; u < 2000; u++)
+        {
+            var user = $"user{u}";
+            foreach (var site in sites)
+                site.Count(a => agents[a].IsLocalOwner(user)).Should().Be(2);
+        }
+    }
+
+    [Fact]
+    public void Agents_AgreeOnOwners_CaseInsensitively()
+    {
+        var sites = Sites(3, 4);
+        var agents = CreateAll(sites);
+
+        for (var u = 0; u < 500; u++)
+        {
+            var user = $"User{u}";
+            foreach (var (url, agent) in agents)
+            {
+                foreach (var peer in agents.Keys.Where(p => p != url))
+                    agent.IsOwnedBy(peer, user).Should().Be(agents[peer].IsLocalOwner(user.ToLowerInvariant()));
+
+                // Lookups stay in the site and reach an owner in one hop
+                foreach (var owner in agent.GetLocalOwners(user))
+                {
+                    agents[owner].IsLocalOwner(user).Should().BeTrue();
+                    sites.Single(s => s.Contains(url)).Should().Contain(owner);
+                }
+            }
+        }
+    }
+
+    [Fact]
+    public void SessionsPerAgent_ShrinkAsAgentsAreAdded()
+    {
+        // Full replication: every agent holds all Users sessions
+        foreach (var agentsPerSite in new[] { 4, 8 })
+        {
+            var agents = CreateAll(Sites(3, agentsPerSite));
+            var held = agents.Values
+                .Select(a => Enumerable.Range(0, Users).Count(u => a.IsLocalOwner($"user{u}")))
+                .ToArray();
+
+            var expected = Users * 2 / agentsPerSite;
+            held.Average().Should().BeApproximately(expected, 1);
+            held.Max().Should().BeLessThan(expected * 13 / 10);
+        }
+    }
+
+    [Fact]
+    public void UnknownPeer_IsSentEverything()
+    {
+        var sites = Sites(1, 4);
+        var agent = Create(sites, 0, sites[0][0]);
+
+        agent.IsOwnedBy("http://legacy:5090", "alice").Should().BeTrue();
+        agent.IsOwnedBy(string.Empty, "alice").Should().BeTrue();
+    }
+}
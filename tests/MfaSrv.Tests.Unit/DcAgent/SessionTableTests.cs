@@ -0,0 +1,155 @@
+using FluentAssertions;
+using MfaSrv.DcAgent.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.DcAgent;
+
+public class SessionTableTests
+{
+    private static readonly DateTimeOffset Now = new(2026, 3, 2, 10, 0, 0, TimeSpan.Zero);
+    private static readonly Func<ulong, bool> NotRevoked = _ => false;
+
+    private static CachedSession Session(
+        string? sessionId = null, string userName = "jsmith", string sourceIp = "10.0.0.5",
+        string method = "Totp", DateTimeOffset? expiresAt = null) => new()
+    {
+        SessionId = sessionId ?? Guid.NewGuid().ToString(),
+        UserId = userName,
+        UserName = userName,
+        SourceIp = sourceIp,
+        ExpiresAt = expiresAt ?? Now.AddHours(8),
+        VerifiedMethod = method
+    };
+
+    [Fact]
+    public void Upsert_ServerFormats_ReadBackUnchanged()
+    {
+        var table = new SessionTable();
+        var session = Session(method: "server");
+
+        var read = table.Get(table.Upsert(session));
+
+        read.Should().BeEquivalentTo(session);
+    }
+
+    [Fact]
+    public void Upsert_OtherFormats_StoredAsText()
+    {
+        var table = new SessionTable();
+        var session = Session("sess-1", sourceIp: "fe80::1%3");
+
+        var read = table.Get(table.Upsert(session));
+
+        read!.SessionId.Should().Be("sess-1");
+        read.SourceIp.Should().Be("fe80::1%3");
+        table.TryFind("sess-1", out _).Should().BeTrue();
+        table.TryFindByUser("jsmith", "fe80::1%3", Now, NotRevoked, out _).Should().BeTrue();
+    }
+
+    [Fact]
+    public void Upsert_MethodNames_NormalizedToEnum()
+    {
+        var table = new SessionTable();
+
+        table.Get(table.Upsert(Session(method: "TOTP")))!.VerifiedMethod.Should().Be("Totp");
+        table.Get(table.Upsert(Session(method: "fortitoken")))!.VerifiedMethod.Should().Be("FortiToken");
+        table.Get(table.Upsert(Session(method: "carrier-pigeon")))!.VerifiedMethod.Should().Be("unknown");
+    }
+
+    [Fact]
+    public void TryFindByUser_MatchesUserCaseInsensitivelyAndIpAsAddress()
+    {
+        var table = new SessionTable();
+        var handle = table.Upsert(Session(userName: "JSmith"));
+
+        table.TryFindByUser("jsmith", "10.0.0.5", Now, NotRevoked, out var found).Should().BeTrue();
+        found.Should().Be(handle);
+        table.TryFindByUser("jsmith", "::ffff:10.0.0.5", Now, NotRevoked, out _).Should().BeTrue();
+        table.TryFindByUser("jsmith", null, Now, NotRevoked, out _).Should().BeTrue();
+        table.TryFindByUser("jsmith", "10.0.0.6", Now, NotRevoked, out _).Should().BeFalse();
+        table.TryFindByUser("bob", "10.0.0.5", Now, NotRevoked, out _).Should().BeFalse();
+    }
+
+    [Fact]
+    public void TryFindByUser_SkipsExpiredRevokedAndFilteredSessions()
+    {
+        var table = new SessionTable();
+        table.Upsert(Session(expiresAt: Now.AddMinutes(-1)));
+        var revoked = table.Upsert(Session());
+        table.SetRevoked(revoked);
+        var filtered = Session();
+        table.Upsert(filtered);
+        var valid = table.Upsert(Session(sourceIp: "10.0.0.9"));
+
+        var filteredHash = MfaSrv.Core.Collections.CuckooFilter.Hash(filtered.SessionId);
+        table.TryFindByUser("jsmith", "10.0.0.5", Now, h => h == filteredHash, out _).Should().BeFalse();
+        table.TryFindByUser("jsmith", null, Now, h => h == filteredHash, out var found).Should().BeTrue();
+        found.Should().Be(valid);
+    }
+
+    [Fact]
+    public void Upsert_SameId_ReplacesSessionAndInvalidatesOldHandle()
+    {
+        var table = new SessionTable();
+        var id = Guid.NewGuid().ToString();
+        var first = table.Upsert(Session(id));
+
+        var second = table.Upsert(Session(id, sourceIp: "10.0.0.9"));
+
+        table.Count.Should().Be(1);
+        table.Get(first).Should().BeNull();
+        table.Get(second)!.SourceIp.Should().Be("10.0.0.9");
+    }
+
+    [Fact]
+    public void Remove_ReusedSlot_OldHandleStaysStale()
+    {
+        var table = new SessionTable();
+        var removed = table.Upsert(Session("sess-1"));
+        table.Remove(removed).Should().BeTrue();
+
+        var reused = table.Upsert(Session("sess-2", userName: "bob"));
+
+        reused.Slot.Should().Be(removed.Slot);
+        table.IsValid(removed).Should().BeFalse();
+        table.Get(removed).Should().BeNull();
+        table.Remove(removed).Should().BeFalse();
+        table.TryFind("sess-1", out _).Should().BeFalse();
+        table.TryFindByUser("jsmith", null, Now, NotRevoked, out _).Should().BeFalse();
+    }
+
+    [Fact]
+    public void Remove_MiddleOfUserChain_KeepsOtherSessionsFindable()
+    {
+        var table = new SessionTable();
+        var a = table.Upsert(Session(sourceIp: "10.0.0.1"));
+        var b = table.Upsert(Session(sourceIp: "10.0.0.2"));
+        var c = table.Upsert(Session(sourceIp: "10.0.0.3"));
+
+        table.Remove(b);
+
+        table.TryFindByUser("jsmith", "10.0.0.1", Now, NotRevoked, out var foundA).Should().BeTrue();
+        foundA.Should().Be(a);
+        table.TryFindByUser("jsmith", "10.0.0.3", Now, NotRevoked, out var foundC).Should().BeTrue();
+        foundC.Should().Be(c);
+        table.TryFindByUser("jsmith", "10.0.0.2", Now, NotRevoked, out _).Should().BeFalse();
+    }
+
+    [Fact]
+    public void Upsert_100kSessions_StaysCompactAndFindsEverySession()
+    {
+        const int count = 100_000;
+        var table = new SessionTable();
+        for (var i = 0; i < count; i++)
+            table.Upsert(Session(userName: $"user{i % 50_000}", sourceIp: $"10.{i >> 16}.{(i >> 8) & 255}.{i & 255}"));
+
+        // Slot arrays (with doubling headroom), indexes and 50k interned user names
+        (table.MemoryBytes / count).Should().BeLessThan(300);
+
+        for (var i = 0; i < count; i += 997)
+        {
+            table.TryFindByUser($"user{i % 50_000}", $"10.{i >> 16}.{(i >> 8) & 255}.{i & 255}", Now, NotRevoked, out _)
+                .Should().BeTrue();
+        }
+    }
+}
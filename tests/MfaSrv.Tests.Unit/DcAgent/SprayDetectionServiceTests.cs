@@ -0,0 +1,126 @@
+using FluentAssertions;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
+using MfaSrv.DcAgent;
+using MfaSrv.DcAgent.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.DcAgent;
+
+public class SprayDetectionServiceTests
+{
+    private static readonly DateTimeOffset Start = new(2026, 3, 2, 10, 0, 0, TimeSpan.Zero);
+
+    private static SprayDetectionService Create(Action<SprayDetectionSettings>? configure = null)
+    {
+        var settings = new SprayDetectionSettings
+        {
+            WindowSeconds = 300,
+            Slices = 5,
+            SketchWidth = 4096,
+            MaxLogonsPerUser = 20,
+            BlockSeconds = 600
+        };
+        configure?.Invoke(settings);
+        return new SprayDetectionService(Options.Create(settings), NullLogger<SprayDetectionService>.Instance);
+    }
+
+    [Fact]
+    public void Record_FloodAgainstOneUser_FlagsUser()
+    {
+        var detector = Create();
+
+        for (var i = 0; i < 20; i++)
+            detector.Record("ceo", Start.AddSeconds(i)).Should().Be(SprayFlag.None);
+
+        detector.Record("ceo", Start.AddSeconds(20)).Should().Be(SprayFlag.UserFlood);
+        detector.Record("alice", Start.AddSeconds(21)).Should().Be(SprayFlag.None);
+    }
+
+    [Fact]
+    public void Record_UserNameCase_CountsAsOneUser()
+    {
+        var detector = Create();
+
+        for (var i = 0; i < 20; i++)
+            detector.Record(i % 2 == 0 ? "ceo" : "CEO", Start.AddSeconds(i));
+
+        detector.Record("Ceo", Start.AddSeconds(20)).Should().Be(SprayFlag.UserFlood);
+    }
+
+    [Fact]
+    public void Record_FlaggedUser_StaysBlockedAfterWindowUntilBlockExpires()
+    {
+        var detector = Create();
+        for (var i = 0; i <= 20; i++)
+            detector.Record("ceo", Start.AddSeconds(i));
+
+        // The window has moved past every counted attempt, but the block still holds
+        detector.Record("ceo", Start.AddSeconds(400)).Should().Be(SprayFlag.UserFlood);
+        detector.FlaggedCount.Should().Be(1);
+
+        detector.Record("ceo", Start.AddSeconds(620)).Should().Be(SprayFlag.None);
+        detector.FlaggedCount.Should().Be(0);
+    }
+
+    [Fact]
+    public void Record_OldAttemptsLeaveWindow()
+    {
+        var detector = Create();
+        for (var i = 0; i < 20; i++)
+            detector.Record("ceo", Start.AddSeconds(i));
+
+        // Twenty more attempts after the first twenty have aged out: never more than twenty in one window
+        for (var i = 0; i < 20; i++)
+            detector.Record("ceo", Start.AddSeconds(400 + i)).Should().Be(SprayFlag.None);
+    }
+
+    [Fact]
+    public void Record_Disabled_NeverFlags()
+    {
+        var detector = Create(s => s.Enabled = false);
+
+        for (var i = 0; i < 100; i++)
+            detector.Record("ceo", Start).Should().Be(SprayFlag.None);
+
+        detector.MemoryBytes.Should().Be(0);
+    }
+
+    [Fact]
+    public void Record_FlaggedTableFull_StillFlagsWhileOverLimit()
+    {
+        var detector = Create(s => s.MaxFlagged = 1);
+        for (var i = 0; i <= 20; i++)
+            detector.Record("ceo", Start);
+
+        for (var i = 0; i <= 20; i++)
+            detector.Record("cfo", Start).Should().Be(i < 20 ? SprayFlag.None : SprayFlag.UserFlood);
+
+        detector.FlaggedCount.Should().Be(1);
+    }
+
+    [Fact]
+    public void Record_AttemptsOverManyUsers_UsesFixedMemory()
+    {
+        var detector = Create(s =>
+        {
+            s.SketchWidth = 131072;
+            s.MaxLogonsPerUser = 300;
+        });
+        var memory = detector.MemoryBytes;
+        var flagged = 0;
+
+        // 10000 made-up users tried a few times each: none exceeds the limit
+        for (var user = 0; user < 10000; user++)
+        {
+            for (var attempt = 0; attempt < 3; attempt++)
+            {
+                if (detector.Record($"user{user}", Start.AddMilliseconds(user)) != SprayFlag.None)
+                    flagged++;
+            }
+        }
+
+        flagged.Should().Be(0);
+        detector.MemoryBytes.Should().Be(memory);
+    }
+}
@@ -0,0 +1,144 @@
+using System.IO.MemoryMappedFiles;
+using System.Text;
+using FluentAssertions;
+using MfaSrv.EndpointAgent.Services;
+using Microsoft.Extensions.Logging.Abstractions;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.EndpointAgent;
+
+/// <summary>
+/// The writer's layout, checked at the offsets <c>SessionTable.h</c> reads.
+/// </summary>
+public class SharedSessionTableTests : IDisposable
+{
+    // MFASRV_SESSION_TABLE_HEADER
+    private const int MagicOffset = 0;
+    private const int VersionOffset = 4;
+    private const int SequenceOffset = 8;
+    private const int SlotCountOffset = 16;
+    private const int UsedCountOffset = 20;
+
+    // MFASRV_SESSION_SLOT
+    private const int ExpiresOffset = 0;
+    private const int UserNameOffset = 8;
+    private const int UserNameBytes = 120;
+
+    private readonly MemoryMappedFile _mapping = MemoryMappedFile.CreateNew(null, SharedSessionTable.TableSize);
+    private readonly MemoryMappedViewAccessor _view;
+    private readonly SharedSessionTable _table;
+
+    public SharedSessionTableTests()
+    {
+        _view = _mapping.CreateViewAccessor();
+        _table = new SharedSessionTable(_view, NullLogger<SharedSessionTable>.Instance);
+    }
+
+    public void Dispose()
+    {
+        _table.Dispose();
+        _view.Dispose();
+        _mapping.Dispose();
+    }
+
+    private static CachedEndpointSession Session(
+        string userName = "jsmith", string? workstation = null, DateTimeOffset? expiresAt = null, bool revoked = false) => new()
+    {
+        SessionId = Guid.NewGuid().ToString(),
+        UserName = userName,
+        Domain = "CORP",
+        Workstation = workstation ?? Environment.MachineName,
+        ExpiresAt = expiresAt ?? DateTimeOffset.UtcNow.AddHours(8),
+        VerifiedMethod = "Totp",
+        Revoked = revoked
+    };
+
+    private static long SlotOffset(int slot) => 64 + slot * 128L;
+
+    private string ReadSlotName(int slot)
+    {
+        var bytes = new byte[UserNameBytes];
+        _view.ReadArray(SlotOffset(slot) + UserNameOffset, bytes, 0, bytes.Length);
+        return Encoding.UTF8.GetString(bytes, 0, Array.IndexOf(bytes, (byte)0));
+    }
+
+    [Fact]
+    public void Layout_MatchesNativeStructs()
+    {
+        SharedSessionTable.HeaderSize.Should().Be(64);
+        SharedSessionTable.SlotSize.Should().Be(128);
+        SharedSessionTable.SlotCount.Should().Be(64);
+        SharedSessionTable.MaxUserNameBytes.Should().Be(UserNameBytes - 1);
+        SharedSessionTable.TableSize.Should().Be(64 + 64 * 128);
+    }
+
+    [Fact]
+    public void Constructor_WritesHeader()
+    {
+        _view.ReadUInt32(MagicOffset).Should().Be(0x5453464D);
+        _view.ReadUInt32(VersionOffset).Should().Be(1);
+        _view.ReadInt64(SequenceOffset).Should().Be(0);
+        _view.ReadUInt32(SlotCountOffset).Should().Be(64);
+        _view.ReadUInt32(UsedCountOffset).Should().Be(0);
+    }
+
+    [Fact]
+    public void Publish_WritesExpiryAndLowerCasedName()
+    {
+        var expiresAt = new DateTimeOffset(2030, 1, 2, 3, 4, 5, TimeSpan.Zero);
+
+        _table.Publish(new[] { Session("JSmith", expiresAt: expiresAt) });
+
+        _view.ReadUInt32(UsedCountOffset).Should().Be(1);
+        _view.ReadInt64(SlotOffset(0) + ExpiresOffset).Should().Be(expiresAt.ToFileTime());
+        ReadSlotName(0).Should().Be("jsmith");
+        _view.ReadByte(SlotOffset(0) + UserNameOffset + UserNameBytes - 1).Should().Be(0);
+    }
+
+    [Fact]
+    public void Publish_SkipsSessionsTheReaderMustNotSee()
+    {
+        _table.Publish(new[]
+        {
+            Session("expired", expiresAt: DateTimeOffset.UtcNow.AddMinutes(-1)),
+            Session("revoked", revoked: true),
+            Session("elsewhere", workstation: "OTHER-PC"),
+            Session(new string('a', SharedSessionTable.MaxUserNameBytes + 1)),
+            Session("alice")
+        });
+
+        _view.ReadUInt32(UsedCountOffset).Should().Be(1);
+        ReadSlotName(0).Should().Be("alice");
+    }
+
+    [Fact]
+    public void Publish_ShorterList_ClearsLeftoverNameBytes()
+    {
+        _table.Publish(new[] { Session("administrator") });
+        _table.Publish(new[] { Session("bob") });
+
+        _view.ReadUInt32(UsedCountOffset).Should().Be(1);
+        ReadSlotName(0).Should().Be("bob");
+        _view.ReadByte(SlotOffset(0) + UserNameOffset + 3).Should().Be(0);
+    }
+
+    [Fact]
+    public void Publish_SequenceOddWhileWritingAndEvenAfter()
+    {
+        var during = new List<long>();
+        IEnumerable<CachedEndpointSession> Sessions()
+        {
+            during.Add(_view.ReadInt64(SequenceOffset));
+            yield return Session("alice");
+            during.Add(_view.ReadInt64(SequenceOffset));
+        }
+
+        _table.Publish(Sessions());
+        var afterFirst = _view.ReadInt64(SequenceOffset);
+        _table.Publish(Sessions());
+
+        during.Should().Equal(1, 1, 3, 3);
+        afterFirst.Should().Be(2);
+        _view.ReadInt64(SequenceOffset).Should().Be(4);
+    }
+}
@@ -0,0 +1,49 @@
+using System.Collections.Concurrent;
+using System.Net;
+using System.Net.Http.Json;
+
+namespace MfaSrv.Tests.Unit.Helpers;
+
+/// <summary>
+/// Local stand-in for the FortiAuthenticator push API, used as the HttpClient handler of
+/// FortiAuthClient. Push requests get sequential session IDs ("session-1", ...); their status
+/// is "pending" until set with <see cref="SetStatus"/>.
+/// </summary>
+public class FakeFortiAuthenticator : HttpMessageHandler
+{
+    private readonly ConcurrentDictionary<string, string> _statuses = new();
+    private int _sessions;
+    private int _statusRequests;
+
+    public int StatusRequests => Volatile.Read(ref _statusRequests);
+
+    public void SetStatus(string sessionId, string status) => _statuses[sessionId] = status;
+
+    protected override Task<HttpResponseMessage> SendAsync(HttpRequestMessage request, CancellationToken cancellationToken)
+    {
+        var path = request.RequestUri!.AbsolutePath;
+
+        if (request.Method == HttpMethod.Post && path == "/api/v1/pushauth/")
+        {
+            var sessionId = $"session-{Interlocked.Increment(ref _sessions)}";
+            _statuses[sessionId] = "pending";
+            return Task.FromResult(Json(new { session_id = sessionId }));
+        }
+
+        if (request.Method == HttpMethod.Get && path.StartsWith("/api/v1/pushauth/"))
+        {
+            Interlocked.Increment(ref _statusRequests);
+            var sessionId = path["/api/v1/pushauth/".Length..].TrimEnd('/');
+            return Task.FromResult(_statuses.TryGetValue(sessionId, out var status)
+                ? Json(new { status })
+                : new HttpResponseMessage(HttpStatusCode.NotFound));
+        }
+
+        return Task.FromResult(new HttpResponseMessage(HttpStatusCode.NotFound));
+    }
+
+    private static HttpResponseMessage Json(object body) => new(HttpStatusCode.OK)
+    {
+        Content = JsonContent.Create(body)
+    };
+}
@@ -0,0 +1,49 @@
+using System.Collections.Concurrent;
+using System.Net;
+
+namespace MfaSrv.Tests.Unit.Helpers;
+
+/// <summary>
+/// Local stand-in for an HTTP SMS gateway, used as the HttpClient handler of SmsGatewayClient.
+/// Each request takes <see cref="Latency"/>; the first <see cref="FailFirst"/> requests are
+/// answered with 503. Tracks the peak number of requests in flight.
+/// </summary>
+public class FakeSmsGateway : HttpMessageHandler
+{
+    private readonly ConcurrentQueue<string> _bodies = new();
+    private int _requests;
+    private int _inFlight;
+    private int _peakInFlight;
+
+    public TimeSpan Latency { get; set; } = TimeSpan.FromMilliseconds(5);
+    public int FailFirst { get; set; }
+
+    public int Requests => Volatile.Read(ref _requests);
+    public int PeakInFlight => Volatile.Read(ref _peakInFlight);
+    public IReadOnlyCollection<string> Bodies => _bodies.ToArray();
+
+    protected override async Task<HttpResponseMessage> SendAsync(HttpRequestMessage request, CancellationToken cancellationToken)
+    {
+        var number = Interlocked.Increment(ref _requests);
+        var inFlight = Interlocked.Increment(ref _inFlight);
+        int peak;
+        while (inFlight > (peak = Volatile.Read(ref _peakInFlight))
+               && Interlocked.CompareExchange(ref _peakInFlight, inFlight, peak) != peak)
+        {
+        }
+
+        try
+        {
+            await Task.Delay(Latency, cancellationToken);
+            if (number <= FailFirst)
+                return new HttpResponseMessage(HttpStatusCode.ServiceUnavailable);
+
+            _bodies.Enqueue(await request.Content!.ReadAsStringAsync(cancellationToken));
+            return new HttpResponseMessage(HttpStatusCode.OK);
+        }
+        finally
+        {
+            Interlocked.Decrement(ref _inFlight);
+        }
+    }
+}
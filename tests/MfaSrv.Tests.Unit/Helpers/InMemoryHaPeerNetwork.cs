@@ -0,0 +1,50 @@
+using System.Collections.Concurrent;
+using MfaSrv.Protocol.Ha;
+using MfaSrv.Server.Services;
+
+namespace MfaSrv.Tests.Unit.Helpers;
+
+/// <summary>
+/// Routes leader election heartbeats between <see cref="LeaderElectionService"/> instances in
+/// one process. Peers are addressed by name; a disconnected peer neither sends nor answers.
+/// </summary>
+public class InMemoryHaPeerNetwork
+{
+    private readonly ConcurrentDictionary<string, LeaderElectionService> _instances = new();
+    private readonly ConcurrentDictionary<string, bool> _disconnected = new();
+
+    public void Register(string name, LeaderElectionService instance) => _instances[name] = instance;
+
+    public void Disconnect(string name) => _disconnected[name] = true;
+
+    /// <summary>
+    /// Transport used by the instance registered as <paramref name="name"/>.
+    /// </summary>
+    public IHaPeerTransport TransportFor(string name) => new Transport(this, name);
+
+    private sealed class Transport : IHaPeerTransport
+    {
+        private readonly InMemoryHaPeerNetwork _network;
+        private readonly string _self;
+
+        public Transport(InMemoryHaPeerNetwork network, string self)
+        {
+            _network = network;
+            _self = self;
+        }
+
+        public async Task<PeerHeartbeat?> HeartbeatAsync(string peerUrl, PeerHeartbeat heartbeat, TimeSpan timeout, CancellationToken ct)
+        {
+            if (_network._disconnected.ContainsKey(_self)
+                || _network._disconnected.ContainsKey(peerUrl)
+                || !_network._instances.TryGetValue(peerUrl, out var peer))
+            {
+                // An unreachable peer looks like a timeout to the sender
+                await Task.Delay(timeout, ct);
+                return null;
+            }
+
+            return peer.HandlePeerHeartbeat(heartbeat.Clone());
+        }
+    }
+}
@@ -0,0 +1,27 @@
+using System.Collections.Concurrent;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.ValueObjects;
+
+namespace MfaSrv.Tests.Unit.Helpers;
+
+/// <summary>
+/// <see cref="IOutboundDeliveryQueue"/> that records enqueued messages instead of sending them.
+/// Set <see cref="Full"/> to simulate a full queue.
+/// </summary>
+public class RecordingDeliveryQueue : IOutboundDeliveryQueue
+{
+    private readonly ConcurrentQueue<OutboundMessage> _messages = new();
+
+    public bool Full { get; set; }
+
+    public IReadOnlyList<OutboundMessage> Messages => _messages.ToArray();
+
+    public bool TryEnqueue(OutboundMessage message)
+    {
+        if (Full)
+            return false;
+
+        _messages.Enqueue(message);
+        return true;
+    }
+}
@@ -1,7 +1,10 @@
+using System.Security.Cryptography;
+using System.Text;
 using Xunit;
 using FluentAssertions;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.ValueObjects;
+using MfaSrv.Cryptography;
 using MfaSrv.Provider.Email;
 using MfaSrv.Tests.Unit.Helpers;
 using Microsoft.Extensions.Logging.Abstractions;
@@ -11,7 +14,7 @@ namespace MfaSrv.Tests.Unit.Providers;
 
 public class EmailMfaProviderTests
 {
-    private static EmailMfaProvider CreateProvider(EmailSettings? settings = null)
+    private static EmailMfaProvider CreateProvider(EmailSettings? settings = null, RecordingDeliveryQueue? delivery = null)
     {
         var emailSettings = settings ?? new EmailSettings
         {
@@ -29,6 +32,7 @@ public class EmailMfaProviderTests
         return new EmailMfaProvider(
             Options.Create(emailSettings),
             emailSender,
+            delivery ?? new RecordingDeliveryQueue(),
             new InMemoryChallengeStore(),
             NullLogger<EmailMfaProvider>.Instance);
     }
@@ -122,4 +126,51 @@ public class EmailMfaProviderTests
         result.Success.Should().BeFalse();
         result.Error.Should().Contain("not found");
     }
+
+    private static ChallengeContext IssueContext(string email)
+    {
+        var key = RandomNumberGenerator.GetBytes(32);
+        var (encrypted, nonce) = AesGcmEncryption.Encrypt(Encoding.UTF8.GetBytes(email), key);
+        return new ChallengeContext
+        {
+            UserId = "user1",
+            EnrollmentId = "enroll1",
+            EncryptedSecret = encrypted,
+            SecretNonce = nonce,
+            EncryptionKey = key
+        };
+    }
+
+    [Fact]
+    public async Task IssueChallenge_QueuesCodeForDelivery_AndCodeVerifies()
+    {
+        var delivery = new RecordingDeliveryQueue();
+        var provider = CreateProvider(delivery: delivery);
+
+        var result = await provider.IssueChallengeAsync(IssueContext("user@example.com"));
+
+        result.Success.Should().BeTrue();
+        var message = delivery.Messages.Should().ContainSingle().Subject;
+        message.Channel.Should().Be(DeliveryChannel.Email);
+        message.Recipient.Should().Be("user@example.com");
+        message.ChallengeId.Should().Be(result.ChallengeId);
+        message.ExpiresAt.Should().Be(result.ExpiresAt);
+
+        var code = message.Body["Code: ".Length..];
+        var verify = await provider.VerifyAsync(new VerificationContext { ChallengeId = result.ChallengeId!, UserId = "user1" }, code);
+        verify.Success.Should().BeTrue();
+    }
+
+    [Fact]
+    public async Task IssueChallenge_QueueFull_FailsAndDiscardsChallenge()
+    {
+        var delivery = new RecordingDeliveryQueue { Full = true };
+        var provider = CreateProvider(delivery: delivery);
+
+        var result = await provider.IssueChallengeAsync(IssueContext("user@example.com"));
+
+        result.Success.Should().BeFalse();
+        result.Status.Should().Be(ChallengeStatus.Failed);
+        delivery.Messages.Should().BeEmpty();
+    }
 }
@@ -1,6 +1,7 @@
 using System.Text;
 using Xunit;
 using FluentAssertions;
+using MfaSrv.Core.Challenges;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.ValueObjects;
 using MfaSrv.Provider.FortiToken;
@@ -12,11 +13,15 @@ namespace MfaSrv.Tests.Unit.Providers;
 
 public class FortiTokenMfaProviderTests
 {
+    private readonly InMemoryChallengeStore _store = new();
+    private readonly ChallengeCompletionEngine _completions = new();
+    private FortiPushPoller _poller = null!;
+
     /// <summary>
     /// Creates a FortiTokenMfaProvider in dev mode (empty FortiAuthUrl).
     /// Dev mode auto-approves all API calls, allowing us to test provider logic.
     /// </summary>
-    private static FortiTokenMfaProvider CreateProvider(FortiTokenSettings? settings = null)
+    private FortiTokenMfaProvider CreateProvider(FortiTokenSettings? settings = null, HttpMessageHandler? handler = null)
     {
         var fortiSettings = settings ?? new FortiTokenSettings
         {
@@ -26,16 +31,25 @@ public class FortiTokenMfaProviderTests
             UsePushNotification = false
         };
 
-        var httpClient = new HttpClient();
+        var httpClient = handler != null ? new HttpClient(handler) : new HttpClient();
         var fortiClient = new FortiAuthClient(
             httpClient,
             Options.Create(fortiSettings),
             NullLogger<FortiAuthClient>.Instance);
 
+        _poller = new FortiPushPoller(
+            fortiClient,
+            _completions,
+            _store,
+            Options.Create(fortiSettings),
+            NullLogger<FortiPushPoller>.Instance);
+
         return new FortiTokenMfaProvider(
             fortiClient,
             Options.Create(fortiSettings),
-            new InMemoryChallengeStore(),
+            _store,
+            _poller,
+            _completions,
             NullLogger<FortiTokenMfaProvider>.Instance);
     }
 
@@ -289,9 +303,52 @@ public class FortiTokenMfaProviderTests
         var challenge = await provider.IssueChallengeAsync(ctx);
         challenge.Success.Should().BeTrue();
 
-        // In dev mode, push status check auto-returns "approved"
+        // In dev mode, push status check auto-returns "approved" on the next sweep
+        (await _poller.PollOnceAsync()).Should().Be(1);
         var status = await provider.CheckAsyncStatusAsync(challenge.ChallengeId!);
 
         status.Status.Should().Be(ChallengeStatus.Approved);
     }
+
+    [Fact]
+    public async Task PushChallenges_StatusChecksDoNotPoll_SweepWakesWaiters()
+    {
+        var fortiAuth = new FakeFortiAuthenticator();
+        var provider = CreateProvider(new FortiTokenSettings
+        {
+            FortiAuthUrl = "https://fortiauth.test",
+            UsePushNotification = true,
+            ChallengeExpiryMinutes = 5,
+            MaxAttempts = 3
+        }, fortiAuth);
+
+        var ctx = new ChallengeContext
+        {
+            UserId = "user1",
+            EnrollmentId = "enroll1",
+            EncryptedSecret = Encoding.UTF8.GetBytes("testuser:FTK200ABC123")
+        };
+        var approved = await provider.IssueChallengeAsync(ctx);
+        var denied = await provider.IssueChallengeAsync(ctx);
+
+        for (var i = 0; i < 50; i++)
+            (await provider.CheckAsyncStatusAsync(approved.ChallengeId!)).Status.Should().Be(ChallengeStatus.Issued);
+        fortiAuth.StatusRequests.Should().Be(0);
+
+        var waiter = _completions.WaitAsync(approved.ChallengeId!, TimeSpan.FromSeconds(10));
+
+        (await _poller.PollOnceAsync()).Should().Be(0);
+        fortiAuth.StatusRequests.Should().Be(2);
+
+        fortiAuth.SetStatus("session-1", "approved");
+        fortiAuth.SetStatus("session-2", "denied");
+        (await _poller.PollOnceAsync()).Should().Be(2);
+
+        (await waiter)!.Status.Should().Be(ChallengeStatus.Approved);
+        (await provider.CheckAsyncStatusAsync(denied.ChallengeId!)).Status.Should().Be(ChallengeStatus.Denied);
+        _poller.PendingCount.Should().Be(0);
+
+        (await _poller.PollOnceAsync()).Should().Be(0);
+        fortiAuth.StatusRequests.Should().Be(4);
+    }
 }
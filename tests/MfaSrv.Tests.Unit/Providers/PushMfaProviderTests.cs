@@ -2,6 +2,7 @@ using System.Text;
 using System.Text.Json;
 using Xunit;
 using FluentAssertions;
+using MfaSrv.Core.Challenges;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.ValueObjects;
 using MfaSrv.Provider.Push;
@@ -13,7 +14,10 @@ namespace MfaSrv.Tests.Unit.Providers;
 
 public class PushMfaProviderTests
 {
-    private static PushMfaProvider CreateProvider(PushSettings? settings = null)
+    private readonly ChallengeCompletionEngine _completions = new();
+    private readonly RecordingDeliveryQueue _delivery = new();
+
+    private PushMfaProvider CreateProvider(PushSettings? settings = null)
     {
         var pushSettings = settings ?? new PushSettings
         {
@@ -22,15 +26,11 @@ public class PushMfaProviderTests
             FcmSendUrl = "https://fcm.googleapis.com/fcm/send"
         };
 
-        var pushClient = new PushNotificationClient(
-            new HttpClient(),
-            Options.Create(pushSettings),
-            NullLogger<PushNotificationClient>.Instance);
-
         return new PushMfaProvider(
-            pushClient,
+            _delivery,
             Options.Create(pushSettings),
             new InMemoryChallengeStore(),
+            _completions,
             NullLogger<PushMfaProvider>.Instance);
     }
 
@@ -366,6 +366,28 @@ public class PushMfaProviderTests
         status.Status.Should().Be(ChallengeStatus.Approved);
     }
 
+    [Fact]
+    public async Task VerifyAsync_Approve_WakesWaiterAndRepeatedChecksAgree()
+    {
+        var provider = CreateProvider();
+
+        var challenge = await provider.IssueChallengeAsync(new ChallengeContext
+        {
+            UserId = "user1",
+            EnrollmentId = "enroll1",
+            EncryptedSecret = Encoding.UTF8.GetBytes(JsonSerializer.Serialize(new { deviceToken = "test-device" }))
+        });
+
+        var waiter = _completions.WaitAsync(challenge.ChallengeId!, TimeSpan.FromSeconds(10));
+        waiter.IsCompleted.Should().BeFalse();
+
+        await provider.VerifyAsync(new VerificationContext { ChallengeId = challenge.ChallengeId!, UserId = "user1" }, "APPROVE");
+
+        (await waiter)!.Status.Should().Be(ChallengeStatus.Approved);
+        (await provider.CheckAsyncStatusAsync(challenge.ChallengeId!)).Status.Should().Be(ChallengeStatus.Approved);
+        (await provider.CheckAsyncStatusAsync(challenge.ChallengeId!)).Status.Should().Be(ChallengeStatus.Approved);
+    }
+
     [Fact]
     public async Task CheckAsyncStatus_UnknownChallenge_ReturnsFailed()
     {
@@ -376,4 +398,41 @@ public class PushMfaProviderTests
         status.Status.Should().Be(ChallengeStatus.Failed);
         status.Error.Should().Contain("not found");
     }
+
+    [Fact]
+    public async Task IssueChallengeAsync_QueuesPushForDevice()
+    {
+        var provider = CreateProvider();
+
+        var challenge = await provider.IssueChallengeAsync(new ChallengeContext
+        {
+            UserId = "user1",
+            EnrollmentId = "enroll1",
+            EncryptedSecret = Encoding.UTF8.GetBytes(JsonSerializer.Serialize(new { deviceToken = "test-device" })),
+            TargetResource = "RDP Server"
+        });
+
+        var message = _delivery.Messages.Should().ContainSingle().Subject;
+        message.Channel.Should().Be(DeliveryChannel.Push);
+        message.Recipient.Should().Be("test-device");
+        message.ChallengeId.Should().Be(challenge.ChallengeId);
+        message.Body.Should().Contain("RDP Server");
+    }
+
+    [Fact]
+    public async Task IssueChallengeAsync_QueueFull_ReturnsFailed()
+    {
+        _delivery.Full = true;
+        var provider = CreateProvider();
+
+        var challenge = await provider.IssueChallengeAsync(new ChallengeContext
+        {
+            UserId = "user1",
+            EnrollmentId = "enroll1",
+            EncryptedSecret = Encoding.UTF8.GetBytes(JsonSerializer.Serialize(new { deviceToken = "test-device" }))
+        });
+
+        challenge.Success.Should().BeFalse();
+        challenge.Status.Should().Be(ChallengeStatus.Failed);
+    }
 }
@@ -1,7 +1,10 @@
+using System.Security.Cryptography;
+using System.Text;
 using Xunit;
 using FluentAssertions;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.ValueObjects;
+using MfaSrv.Cryptography;
 using MfaSrv.Provider.Sms;
 using MfaSrv.Tests.Unit.Helpers;
 using Microsoft.Extensions.Logging.Abstractions;
@@ -11,7 +14,7 @@ namespace MfaSrv.Tests.Unit.Providers;
 
 public class SmsMfaProviderTests
 {
-    private static SmsMfaProvider CreateProvider(SmsSettings? settings = null)
+    private static SmsMfaProvider CreateProvider(SmsSettings? settings = null, RecordingDeliveryQueue? delivery = null)
     {
         var smsSettings = settings ?? new SmsSettings
         {
@@ -29,6 +32,7 @@ public class SmsMfaProviderTests
         return new SmsMfaProvider(
             Options.Create(smsSettings),
             smsClient,
+            delivery ?? new RecordingDeliveryQueue(),
             new InMemoryChallengeStore(),
             NullLogger<SmsMfaProvider>.Instance);
     }
@@ -122,4 +126,51 @@ public class SmsMfaProviderTests
         result.Success.Should().BeFalse();
         result.Error.Should().Contain("not found");
     }
+
+    private static ChallengeContext IssueContext(string phone)
+    {
+        var key = RandomNumberGenerator.GetBytes(32);
+        var (encrypted, nonce) = AesGcmEncryption.Encrypt(Encoding.UTF8.GetBytes(phone), key);
+        return new ChallengeContext
+        {
+            UserId = "user1",
+            EnrollmentId = "enroll1",
+            EncryptedSecret = encrypted,
+            SecretNonce = nonce,
+            EncryptionKey = key
+        };
+    }
+
+    [Fact]
+    public async Task IssueChallenge_QueuesCodeForDelivery_AndCodeVerifies()
+    {
+        var delivery = new RecordingDeliveryQueue();
+        var provider = CreateProvider(delivery: delivery);
+
+        var result = await provider.IssueChallengeAsync(IssueContext("+15551234567"));
+
+        result.Success.Should().BeTrue();
+        var message = delivery.Messages.Should().ContainSingle().Subject;
+        message.Channel.Should().Be(DeliveryChannel.Sms);
+        message.Recipient.Should().Be("+15551234567");
+        message.ChallengeId.Should().Be(result.ChallengeId);
+        message.ExpiresAt.Should().Be(result.ExpiresAt);
+
+        var code = message.Body["Code: ".Length..];
+        var verify = await provider.VerifyAsync(new VerificationContext { ChallengeId = result.ChallengeId!, UserId = "user1" }, code);
+        verify.Success.Should().BeTrue();
+    }
+
+    [Fact]
+    public async Task IssueChallenge_QueueFull_FailsAndDiscardsChallenge()
+    {
+        var delivery = new RecordingDeliveryQueue { Full = true };
+        var provider = CreateProvider(delivery: delivery);
+
+        var result = await provider.IssueChallengeAsync(IssueContext("+15551234567"));
+
+        result.Success.Should().BeFalse();
+        result.Status.Should().Be(ChallengeStatus.Failed);
+        delivery.Messages.Should().BeEmpty();
+    }
 }
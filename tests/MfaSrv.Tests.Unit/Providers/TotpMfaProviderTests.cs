@@ -0,0 +1,92 @@
+using FluentAssertions;
+using MfaSrv.Core.ValueObjects;
+using MfaSrv.Cryptography;
+using MfaSrv.Provider.Totp;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Providers;
+
+public class TotpMfaProviderTests
+{
+    private readonly byte[] _secret = TotpGenerator.GenerateSecret();
+    private readonly byte[] _encryptionKey = AesGcmEncryption.GenerateKey();
+    private readonly TotpValidationEngine _engine = new();
+
+    private VerificationContext CreateContext(string enrollmentId = "enrollment-1")
+    {
+        var (encrypted, nonce) = AesGcmEncryption.Encrypt(_secret, _encryptionKey);
+        return new VerificationContext
+        {
+            ChallengeId = Guid.NewGuid().ToString(),
+            UserId = "user-1",
+            EnrollmentId = enrollmentId,
+            EncryptedSecret = encrypted,
+            SecretNonce = nonce,
+            EncryptionKey = _encryptionKey
+        };
+    }
+
+    [Fact]
+    public async Task VerifyAsync_ValidCode_Succeeds()
+    {
+        var provider = new TotpMfaProvider(_engine);
+        var code = TotpGenerator.ComputeTotp(_secret, DateTimeOffset.UtcNow);
+
+        var result = await provider.VerifyAsync(CreateContext(), code);
+
+        result.Success.Should().BeTrue();
+    }
+
+    [Fact]
+    public async Task VerifyAsync_SameCodeTwice_RejectsReplay()
+    {
+        var provider = new TotpMfaProvider(_engine);
+        var code = TotpGenerator.ComputeTotp(_secret, DateTimeOffset.UtcNow);
+
+        (await provider.VerifyAsync(CreateContext(), code)).Success.Should().BeTrue();
+        var replay = await provider.VerifyAsync(CreateContext(), code);
+
+        replay.Success.Should().BeFalse();
+        replay.Error.Should().Be("Code has already been used");
+    }
+
+    [Fact]
+    public async Task VerifyAsync_WrongCodeOrMissingKey_Fails()
+    {
+        var provider = new TotpMfaProvider(_engine);
+        var code = TotpGenerator.ComputeTotp(_secret, DateTimeOffset.UtcNow);
+        var wrong = code == "000000" ? "000001" : "000000";
+
+        (await provider.VerifyAsync(CreateContext(), wrong)).Success.Should().BeFalse();
+        (await provider.VerifyAsync(CreateContext() with { EncryptionKey = null }, code)).Success.Should().BeFalse();
+    }
+
+    [Fact]
+    public void Engine_OlderStepAfterNewer_IsReplay()
+    {
+        var now = DateTimeOffset.UtcNow;
+        var context = CreateContext();
+        var current = TotpGenerator.ComputeTotp(_secret, now);
+        var previous = TotpGenerator.ComputeTotp(_secret, now.AddSeconds(-30));
+
+        _engine.Validate("enrollment-1", context.EncryptedSecret!, context.SecretNonce!, _encryptionKey, current, now)
+            .Should().Be(TotpValidationResult.Valid);
+        _engine.Validate("enrollment-1", context.EncryptedSecret!, context.SecretNonce!, _encryptionKey, previous, now)
+            .Should().Be(TotpValidationResult.Replayed);
+    }
+
+    [Fact]
+    public void Engine_PurgeExpired_ForgetsIdleEnrollments()
+    {
+        var now = DateTimeOffset.UtcNow;
+        var context = CreateContext();
+        var code = TotpGenerator.ComputeTotp(_secret, now);
+
+        _engine.Validate("enrollment-1", context.EncryptedSecret!, context.SecretNonce!, _encryptionKey, code, now);
+        _engine.Count.Should().Be(1);
+
+        _engine.PurgeExpired(now.AddMinutes(1)).Should().Be(0, "the key is still within its TTL");
+        _engine.PurgeExpired(now.Add(TotpValidationEngine.DefaultKeyTtl).AddSeconds(1)).Should().Be(1);
+        _engine.Count.Should().Be(0);
+    }
+}
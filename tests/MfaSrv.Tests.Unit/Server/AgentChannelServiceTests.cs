@@ -0,0 +1,42 @@
+using FluentAssertions;
+using Microsoft.Extensions.Logging.Abstractions;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class AgentChannelServiceTests
+{
+    private readonly AgentChannelService _service = new(NullLogger<AgentChannelService>.Instance);
+
+    [Fact]
+    public void NotifySessionChange_DeliversToEveryOpenChannel()
+    {
+        var first = _service.Subscribe("agent-1");
+        var second = _service.Subscribe("agent-2");
+
+        _service.NotifySessionChange(new SessionChangeNotification { SessionId = "sess-1", Revoked = true });
+
+        first.Reader.TryRead(out var a).Should().BeTrue();
+        second.Reader.TryRead(out var b).Should().BeTrue();
+        a!.SessionId.Should().Be("sess-1");
+        b!.Revoked.Should().BeTrue();
+    }
+
+    [Fact]
+    public void Subscribe_Reconnect_ReplacesAndCompletesOldChannel()
+    {
+        var old = _service.Subscribe("agent-1");
+        var current = _service.Subscribe("agent-1");
+
+        old.Reader.Completion.IsCompleted.Should().BeTrue();
+        _service.ConnectedCount.Should().Be(1);
+
+        // The stale stream closing must not remove the reconnected one
+        _service.Unsubscribe("agent-1", old).Should().BeFalse();
+        _service.ConnectedCount.Should().Be(1);
+
+        _service.Unsubscribe("agent-1", current).Should().BeTrue();
+        _service.ConnectedCount.Should().Be(0);
+    }
+}
@@ -0,0 +1,169 @@
+using FluentAssertions;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Configuration;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server;
+using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class AuditLogWriterTests : IDisposable
+{
+    private readonly string _dbName = Guid.NewGuid().ToString();
+    private readonly ServiceProvider _serviceProvider;
+    private readonly MfaSrvDbContext _db;
+
+    public AuditLogWriterTests()
+    {
+        var services = new ServiceCollection();
+        services.AddDbContext<MfaSrvDbContext>(o => o.UseInMemoryDatabase(_dbName));
+        _serviceProvider = services.BuildServiceProvider();
+
+        _db = new MfaSrvDbContext(new DbContextOptionsBuilder<MfaSrvDbContext>()
+            .UseInMemoryDatabase(_dbName)
+            .Options);
+    }
+
+    private AuditLogWriter CreateWriter(AuditSettings settings) => new(
+        _serviceProvider.GetRequiredService<IServiceScopeFactory>(),
+        Options.Create(settings),
+        NullLogger<AuditLogWriter>.Instance);
+
+    private AuditLogService CreateService(AuditLogWriter writer, AuditWriteMode mode) => new(
+        _db,
+        writer,
+        new DashboardStatisticsService(
+            _serviceProvider.GetRequiredService<IServiceScopeFactory>(),
+            CreateSetupService(),
+            NullLogger<DashboardStatisticsService>.Instance),
+        Options.Create(new AuditSettings { Mode = mode }),
+        NullLogger<AuditLogService>.Instance);
+
+    private static SetupService CreateSetupService()
+    {
+        var config = new ConfigurationBuilder()
+            .AddInMemoryCollection(new Dictionary<string, string?>
+            {
+                ["Ldap:Server"] = "configured.example.com",
+                ["Ldap:BindDn"] = "CN=configured",
+                ["MfaSrv:EncryptionKey"] = Convert.ToBase64String(new byte[32])
+            })
+            .Build();
+        var env = new Microsoft.Extensions.Hosting.Internal.HostingEnvironment { ContentRootPath = Path.GetTempPath() };
+        return new SetupService(config, env, NullLogger<SetupService>.Instance);
+    }
+
+    private static AuditLogEntry Entry(AuditEventType eventType) => new()
+    {
+        EventType = eventType,
+        UserId = "user-1",
+        Timestamp = DateTimeOffset.UtcNow
+    };
+
+    [Fact]
+    public async Task LogAsync_Batched_DefersWriteUntilFlush()
+    {
+        var writer = CreateWriter(new AuditSettings());
+        var service = CreateService(writer, AuditWriteMode.Batched);
+
+        await service.LogAsync(AuditEventType.AuthenticationAttempt, "user-1", "10.0.0.5", null, null);
+        await service.LogAsync(AuditEventType.SessionCreated, "user-1", "10.0.0.5", null, null);
+
+        (await _db.AuditLog.CountAsync()).Should().Be(0);
+        writer.QueueDepth.Should().Be(2);
+
+        await writer.FlushAsync();
+
+        (await _db.AuditLog.CountAsync()).Should().Be(2);
+        writer.QueueDepth.Should().Be(0);
+    }
+
+    [Fact]
+    public async Task LogAsync_Synchronous_WritesImmediately()
+    {
+        var writer = CreateWriter(new AuditSettings());
+        var service = CreateService(writer, AuditWriteMode.Synchronous);
+
+        await service.LogAsync(AuditEventType.PolicyCreated, "admin", null, null, "policy-1");
+
+        (await _db.AuditLog.CountAsync()).Should().Be(1);
+        writer.QueueDepth.Should().Be(0);
+    }
+
+    [Fact]
+    public async Task LogForwardedAsync_Synchronous_KeepsNodeTimestampsAndSetsSuccess()
+    {
+        var writer = CreateWriter(new AuditSettings());
+        var service = CreateService(writer, AuditWriteMode.Synchronous);
+        var happenedAt = DateTimeOffset.UtcNow.AddMinutes(-3);
+
+        await service.LogForwardedAsync(new[]
+        {
+            new AuditLogEntry { EventType = AuditEventType.PolicyEvaluated, UserId = "alice", Timestamp = happenedAt },
+            new AuditLogEntry { EventType = AuditEventType.SessionCreated, UserId = "bob", Timestamp = happenedAt }
+        });
+
+        var stored = await _db.AuditLog.OrderBy(e => e.UserId).ToListAsync();
+        stored.Should().HaveCount(2);
+        stored.Should().OnlyContain(e => e.Timestamp == happenedAt);
+        stored[0].Success.Should().BeFalse();
+        stored[1].Success.Should().BeTrue();
+    }
+
+    [Fact]
+    public void TryEnqueue_AboveSamplingThreshold_SamplesRoutineEventsOnly()
+    {
+        var writer = CreateWriter(new AuditSettings
+        {
+            QueueCapacity = 10,
+            SamplingThresholdPercent = 50,
+            SamplingRate = 1000
+        });
+
+        for (var i = 0; i < 5; i++)
+            writer.TryEnqueue(Entry(AuditEventType.AuthenticationAttempt)).Should().BeTrue();
+
+        // Queue is at the threshold: routine events are sampled, security events still queue
+        writer.TryEnqueue(Entry(AuditEventType.AuthenticationAttempt)).Should().BeFalse();
+        writer.TryEnqueue(Entry(AuditEventType.MfaChallengeFailed)).Should().BeTrue();
+        writer.QueueDepth.Should().Be(6);
+    }
+
+    [Fact]
+    public void TryEnqueue_QueueFull_DropsWithoutBlocking()
+    {
+        var writer = CreateWriter(new AuditSettings { QueueCapacity = 3, SamplingThresholdPercent = 100 });
+
+        for (var i = 0; i < 3; i++)
+            writer.TryEnqueue(Entry(AuditEventType.PolicyUpdated)).Should().BeTrue();
+
+        writer.TryEnqueue(Entry(AuditEventType.PolicyUpdated)).Should().BeFalse();
+        writer.QueueDepth.Should().Be(3);
+    }
+
+    [Fact]
+    public async Task FlushAsync_MoreThanBatchSize_WritesAllEntries()
+    {
+        var writer = CreateWriter(new AuditSettings { BatchSize = 4 });
+
+        for (var i = 0; i < 10; i++)
+            writer.TryEnqueue(Entry(AuditEventType.SessionCreated));
+
+        await writer.FlushAsync();
+
+        (await _db.AuditLog.CountAsync()).Should().Be(10);
+    }
+
+    public void Dispose()
+    {
+        _db.Database.EnsureDeleted();
+        _db.Dispose();
+        _serviceProvider.Dispose();
+    }
+}
@@ -0,0 +1,187 @@
+using FluentAssertions;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Logging.Abstractions;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class AuditStoreTests : IDisposable
+{
+    // 2024-01-15 00:00 UTC
+    private static readonly DateTimeOffset Day = new(2024, 1, 15, 0, 0, 0, TimeSpan.Zero);
+
+    private readonly MfaSrvDbContext _db;
+    private readonly AuditStore _store;
+
+    public AuditStoreTests()
+    {
+        var options = new DbContextOptionsBuilder<MfaSrvDbContext>()
+            .UseInMemoryDatabase(Guid.NewGuid().ToString())
+            .Options;
+
+        _db = new MfaSrvDbContext(options);
+        _store = new AuditStore(_db, NullLogger<AuditStore>.Instance);
+    }
+
+    private void AddEvents(AuditEventType eventType, DateTimeOffset timestamp, int count, bool success = false)
+    {
+        for (var i = 0; i < count; i++)
+        {
+            _db.AuditLog.Add(new AuditLogEntry
+            {
+                EventType = eventType,
+                UserId = "user-1",
+                Success = success,
+                Timestamp = timestamp
+            });
+        }
+        _db.SaveChanges();
+    }
+
+    [Fact]
+    public async Task SealCompletedSegments_SealsOnlyClosedHours()
+    {
+        AddEvents(AuditEventType.AuthenticationAttempt, Day.AddHours(1).AddMinutes(10), 3);
+        AddEvents(AuditEventType.MfaChallengeVerified, Day.AddHours(2).AddMinutes(5), 2, success: true);
+        AddEvents(AuditEventType.AuthenticationAttempt, Day.AddHours(3).AddMinutes(1), 1);
+
+        // 03:01 is inside the grace period for the 02:00 hour, so only 01:00 can be sealed
+        var sealedCount = await _store.SealCompletedSegmentsAsync(Day.AddHours(3).AddMinutes(1));
+
+        sealedCount.Should().Be(1);
+        var rollup = await _db.AuditHourlyRollups.SingleAsync();
+        rollup.Hour.Should().Be(AuditStore.HourOf(Day.AddHours(1)));
+        rollup.EventType.Should().Be(AuditEventType.AuthenticationAttempt);
+        rollup.Count.Should().Be(3);
+
+        // Later pass picks up where the previous one stopped
+        sealedCount = await _store.SealCompletedSegmentsAsync(Day.AddHours(3).AddMinutes(5));
+        sealedCount.Should().Be(1);
+        (await _db.AuditSegments.CountAsync()).Should().Be(2);
+    }
+
+    [Fact]
+    public async Task SealNextSegment_SealsOneHourPerCall()
+    {
+        AddEvents(AuditEventType.AuthenticationAttempt, Day.AddMinutes(10), 2);
+        AddEvents(AuditEventType.AuthenticationAttempt, Day.AddHours(1).AddMinutes(10), 1);
+        var now = Day.AddHours(2).AddMinutes(5);
+
+        (await _store.SealNextSegmentAsync(now)).Should().BeTrue();
+        (await _db.AuditSegments.SingleAsync()).Hour.Should().Be(AuditStore.HourOf(Day));
+
+        (await _store.SealNextSegmentAsync(now)).Should().BeTrue();
+        (await _store.SealNextSegmentAsync(now)).Should().BeFalse("the 02:00 hour is still open");
+        (await _db.AuditSegments.CountAsync()).Should().Be(2);
+    }
+
+    [Fact]
+    public async Task SealCompletedSegments_EmptyHours_StillSealed()
+    {
+        AddEvents(AuditEventType.PolicyEvaluated, Day, 1);
+        AddEvents(AuditEventType.PolicyEvaluated, Day.AddHours(4), 1);
+
+        await _store.SealCompletedSegmentsAsync(Day.AddHours(5).AddMinutes(5));
+
+        (await _db.AuditSegments.CountAsync()).Should().Be(5);
+        (await _db.AuditSegments.Where(s => s.EventCount == 0).CountAsync()).Should().Be(3);
+    }
+
+    [Fact]
+    public async Task GetCountsAsync_UnalignedRange_MatchesRawCount()
+    {
+        for (var hour = 0; hour < 6; hour++)
+        {
+            AddEvents(AuditEventType.AuthenticationAttempt, Day.AddHours(hour).AddMinutes(15), 2);
+            AddEvents(AuditEventType.AuthenticationAttempt, Day.AddHours(hour).AddMinutes(45), 1);
+            AddEvents(AuditEventType.MfaChallengeVerified, Day.AddHours(hour).AddMinutes(50), 1, success: true);
+        }
+        await _store.SealCompletedSegmentsAsync(Day.AddHours(4).AddMinutes(5));
+
+        // 00:30 .. 05:20 spans a partial sealed hour, sealed hours and the unsealed tail
+        var from = Day.AddMinutes(30);
+        var to = Day.AddHours(5).AddMinutes(20);
+
+        var counts = await _store.GetCountsAsync(from, to);
+
+        var expectedAuth = await _db.AuditLog.CountAsync(e =>
+            e.Timestamp >= from && e.Timestamp <= to && e.EventType == AuditEventType.AuthenticationAttempt);
+        var expectedVerified = await _db.AuditLog.CountAsync(e =>
+            e.Timestamp >= from && e.Timestamp <= to && e.EventType == AuditEventType.MfaChallengeVerified);
+
+        counts[(AuditEventType.AuthenticationAttempt, false)].Should().Be(expectedAuth);
+        counts[(AuditEventType.MfaChallengeVerified, true)].Should().Be(expectedVerified);
+    }
+
+    [Fact]
+    public async Task GetCountsAsync_UsesRollupsForSealedHours()
+    {
+        AddEvents(AuditEventType.AuthenticationAttempt, Day.AddHours(1).AddMinutes(10), 3);
+        await _store.SealCompletedSegmentsAsync(Day.AddHours(2).AddMinutes(5));
+
+        // Raw rows for a sealed hour are no longer read
+        _db.AuditLog.RemoveRange(_db.AuditLog);
+        await _db.SaveChangesAsync();
+
+        var counts = await _store.GetCountsAsync(Day.AddHours(1), Day.AddHours(2));
+
+        counts[(AuditEventType.AuthenticationAttempt, false)].Should().Be(3);
+    }
+
+    [Fact]
+    public async Task AppendAsync_EntriesForSealedHours_AddedToRollups()
+    {
+        AddEvents(AuditEventType.AuthenticationAttempt, Day.AddHours(1).AddMinutes(10), 3);
+        await _store.SealCompletedSegmentsAsync(Day.AddHours(3).AddMinutes(5));
+
+        // A delayed batch for the sealed 01:00 hour, and a forwarded event older than any segment
+        await AuditStore.AppendAsync(_db, new[]
+        {
+            new AuditLogEntry { EventType = AuditEventType.AuthenticationAttempt, UserId = "user-1", Timestamp = Day.AddHours(1).AddMinutes(59) },
+            new AuditLogEntry { EventType = AuditEventType.MfaChallengeVerified, UserId = "user-1", Success = true, Timestamp = Day.AddHours(1).AddMinutes(20) },
+            new AuditLogEntry { EventType = AuditEventType.AuthenticationAttempt, UserId = "user-1", Timestamp = Day.AddMinutes(30) },
+            new AuditLogEntry { EventType = AuditEventType.AuthenticationAttempt, UserId = "user-1", Timestamp = Day.AddHours(3).AddMinutes(1) }
+        });
+
+        var counts = await _store.GetCountsAsync(Day, Day.AddHours(2));
+        counts[(AuditEventType.AuthenticationAttempt, false)].Should().Be(5);
+        counts[(AuditEventType.MfaChallengeVerified, true)].Should().Be(1);
+
+        (await _db.AuditSegments.SingleAsync(s => s.Hour == AuditStore.HourOf(Day.AddHours(1)))).EventCount.Should().Be(5);
+        (await _db.AuditSegments.SingleAsync(s => s.Hour == AuditStore.HourOf(Day))).EventCount.Should().Be(1);
+        (await _db.AuditHourlyRollups.AnyAsync(r => r.Hour == AuditStore.HourOf(Day.AddHours(3)))).Should().BeFalse(
+            "the open hour is still counted from the raw log");
+    }
+
+    [Fact]
+    public async Task GetHourlySeriesAsync_CombinesSealedAndUnsealedHours()
+    {
+        AddEvents(AuditEventType.MfaChallengeIssued, Day.AddHours(1).AddMinutes(10), 2);
+        AddEvents(AuditEventType.MfaChallengeIssued, Day.AddHours(2).AddMinutes(10), 4);
+        await _store.SealCompletedSegmentsAsync(Day.AddHours(2).AddMinutes(30));
+
+        var series = await _store.GetHourlySeriesAsync(Day.AddHours(1), Day.AddHours(2).AddMinutes(30));
+
+        series.Should().HaveCount(2);
+        series.Single(r => r.Hour == AuditStore.HourOf(Day.AddHours(1))).Count.Should().Be(2);
+        series.Single(r => r.Hour == AuditStore.HourOf(Day.AddHours(2))).Count.Should().Be(4);
+    }
+
+    [Fact]
+    public void HourOf_StartOf_RoundTrip()
+    {
+        var hour = AuditStore.HourOf(Day.AddHours(7).AddMinutes(59));
+
+        AuditStore.StartOf(hour).Should().Be(Day.AddHours(7));
+    }
+
+    public void Dispose()
+    {
+        _db.Database.EnsureDeleted();
+        _db.Dispose();
+    }
+}
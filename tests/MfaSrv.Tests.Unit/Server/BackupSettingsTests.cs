@@ -14,6 +14,10 @@ public class BackupSettingsTests
         settings.BackupIntervalHours.Should().Be(6);
         settings.RetentionCount.Should().Be(10);
         settings.Enabled.Should().BeTrue();
+        settings.PagesPerStep.Should().Be(256);
+        settings.StepDelayMs.Should().Be(5);
+        settings.MaxBytesPerSecond.Should().Be(32L * 1024 * 1024);
+        settings.UseWalJournal.Should().BeTrue();
     }
 
     [Fact]
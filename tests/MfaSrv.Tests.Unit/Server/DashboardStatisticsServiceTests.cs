@@ -0,0 +1,176 @@
+using FluentAssertions;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Configuration;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging.Abstractions;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class DashboardStatisticsServiceTests : IDisposable
+{
+    private readonly string _dbName = Guid.NewGuid().ToString();
+    private readonly ServiceProvider _serviceProvider;
+    private readonly MfaSrvDbContext _db;
+
+    public DashboardStatisticsServiceTests()
+    {
+        var services = new ServiceCollection();
+        services.AddLogging();
+        services.AddDbContext<MfaSrvDbContext>(o => o.UseInMemoryDatabase(_dbName));
+        services.AddScoped<AuditStore>();
+        _serviceProvider = services.BuildServiceProvider();
+
+        _db = new MfaSrvDbContext(new DbContextOptionsBuilder<MfaSrvDbContext>()
+            .UseInMemoryDatabase(_dbName)
+            .Options);
+    }
+
+    private DashboardStatisticsService CreateService() => new(
+        _serviceProvider.GetRequiredService<IServiceScopeFactory>(),
+        CreateSetupService(),
+        NullLogger<DashboardStatisticsService>.Instance);
+
+    private static SetupService CreateSetupService()
+    {
+        var config = new ConfigurationBuilder()
+            .AddInMemoryCollection(new Dictionary<string, string?>
+            {
+                ["Ldap:Server"] = "configured.example.com",
+                ["Ldap:BindDn"] = "CN=configured",
+                ["MfaSrv:EncryptionKey"] = Convert.ToBase64String(new byte[32])
+            })
+            .Build();
+        var env = new Microsoft.Extensions.Hosting.Internal.HostingEnvironment { ContentRootPath = Path.GetTempPath() };
+        return new SetupService(config, env, NullLogger<SetupService>.Instance);
+    }
+
+    private static AuditLogEntry Entry(AuditEventType eventType, DateTimeOffset timestamp, bool success = false) => new()
+    {
+        EventType = eventType,
+        UserId = "user-1",
+        Success = success,
+        Timestamp = timestamp
+    };
+
+    [Fact]
+    public void RecordAuditEvent_CountedUntilItLeavesTheWindow()
+    {
+        var service = CreateService();
+        var now = DateTimeOffset.UtcNow;
+
+        service.RecordAuditEvent(Entry(AuditEventType.MfaChallengeIssued, now));
+        service.RecordAuditEvent(Entry(AuditEventType.MfaChallengeVerified, now, success: true));
+        service.RecordAuditEvent(Entry(AuditEventType.AuthenticationAttempt, now));
+
+        var stats = service.GetSnapshot(now);
+        stats.Count(AuditEventType.MfaChallengeIssued).Should().Be(1);
+        stats.Count(AuditEventType.MfaChallengeVerified, success: true).Should().Be(1);
+        stats.Count(AuditEventType.AuthenticationAttempt, success: false).Should().Be(1);
+
+        service.GetSnapshot(now.AddHours(23)).Count(AuditEventType.MfaChallengeIssued).Should().Be(1);
+        service.GetSnapshot(now.AddHours(24).AddMinutes(1)).Last24Hours.Should().BeEmpty();
+    }
+
+    [Fact]
+    public void RecordAuditEvent_OlderThanWindow_Ignored()
+    {
+        var service = CreateService();
+        var now = DateTimeOffset.UtcNow;
+
+        service.RecordAuditEvent(Entry(AuditEventType.MfaChallengeFailed, now.AddHours(-25)));
+        service.RecordAuditEvent(Entry(AuditEventType.MfaChallengeFailed, now.AddHours(-23)));
+
+        service.GetSnapshot(now).Count(AuditEventType.MfaChallengeFailed).Should().Be(1);
+    }
+
+    [Fact]
+    public void RecordAuditEvent_KeepsTenMostRecent()
+    {
+        var service = CreateService();
+        var now = DateTimeOffset.UtcNow;
+
+        for (var i = 0; i < 15; i++)
+            service.RecordAuditEvent(Entry(AuditEventType.PolicyEvaluated, now.AddSeconds(i)));
+
+        var recent = service.GetSnapshot(now).RecentEvents;
+        recent.Should().HaveCount(10);
+        recent[0].Timestamp.Should().Be(now.AddSeconds(14));
+    }
+
+    [Fact]
+    public void Sessions_DropOutAfterExpiry()
+    {
+        var service = CreateService();
+        var now = DateTimeOffset.UtcNow;
+
+        service.SessionCreated(now.AddMinutes(5));
+        service.SessionCreated(now.AddHours(8));
+        service.GetSnapshot(now).ActiveSessions.Should().Be(2);
+
+        service.GetSnapshot(now.AddMinutes(10)).ActiveSessions.Should().Be(1);
+
+        // Ending a session that already expired does not double count
+        service.SessionEnded(now.AddMinutes(5));
+        service.SessionEnded(now.AddHours(8));
+        service.GetSnapshot(now.AddMinutes(10)).ActiveSessions.Should().Be(0);
+    }
+
+    [Fact]
+    public async Task InitializeAsync_LoadsExistingDataWithoutDoubleCounting()
+    {
+        var now = DateTimeOffset.UtcNow;
+        _db.AuditLog.AddRange(
+            Entry(AuditEventType.AuthenticationAttempt, now.AddHours(-30)),
+            Entry(AuditEventType.AuthenticationAttempt, now.AddHours(-3)),
+            Entry(AuditEventType.AuthenticationAttempt, now.AddMinutes(-1)),
+            Entry(AuditEventType.MfaChallengeVerified, now.AddMinutes(-1), success: true));
+        _db.MfaSessions.AddRange(
+            new MfaSession { UserId = "user-1", CreatedAt = now.AddHours(-1), ExpiresAt = now.AddHours(7) },
+            new MfaSession { UserId = "user-2", CreatedAt = now.AddHours(-9), ExpiresAt = now.AddHours(-1) },
+            new MfaSession { UserId = "user-3", Status = SessionStatus.Revoked, CreatedAt = now.AddHours(-1), ExpiresAt = now.AddHours(7) });
+        _db.Users.AddRange(new User { MfaEnabled = true }, new User());
+        _db.Policies.AddRange(new Policy(), new Policy { IsEnabled = false });
+        _db.AgentRegistrations.Add(new AgentRegistration { Status = AgentStatus.Online });
+        _db.MfaEnrollments.AddRange(
+            new MfaEnrollment { Method = MfaMethod.Totp, Status = EnrollmentStatus.Active },
+            new MfaEnrollment { Method = MfaMethod.Totp, Status = EnrollmentStatus.Pending });
+        await _db.SaveChangesAsync();
+
+        var service = CreateService();
+
+        // Logged after startup: reaches the service through the hook and the database
+        var live = Entry(AuditEventType.AuthenticationAttempt, DateTimeOffset.UtcNow);
+        _db.AuditLog.Add(live);
+        await _db.SaveChangesAsync();
+        service.RecordAuditEvent(live);
+
+        await service.InitializeAsync();
+        var stats = service.GetSnapshot();
+
+        service.IsInitialized.Should().BeTrue();
+        stats.Count(AuditEventType.AuthenticationAttempt).Should().Be(3);
+        stats.Count(AuditEventType.MfaChallengeVerified).Should().Be(1);
+        stats.ActiveSessions.Should().Be(1);
+        stats.RecentEvents.Should().HaveCount(5);
+        stats.RecentEvents[0].Should().BeSameAs(live);
+        stats.Entities.TotalUsers.Should().Be(2);
+        stats.Entities.MfaEnabledUsers.Should().Be(1);
+        stats.Entities.ActivePolicies.Should().Be(1);
+        stats.Entities.TotalPolicies.Should().Be(2);
+        stats.Entities.OnlineAgents.Should().Be(1);
+        stats.Entities.EnrollmentsByMethod.Should().ContainSingle()
+            .Which.Should().Be(new KeyValuePair<MfaMethod, int>(MfaMethod.Totp, 1));
+    }
+
+    public void Dispose()
+    {
+        _db.Database.EnsureDeleted();
+        _db.Dispose();
+        _serviceProvider.Dispose();
+    }
+}
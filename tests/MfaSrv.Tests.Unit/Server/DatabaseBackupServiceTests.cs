@@ -0,0 +1,194 @@
+using System.Diagnostics;
+using FluentAssertions;
+using Microsoft.Data.Sqlite;
+using Microsoft.Extensions.Configuration;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
+using MfaSrv.Server;
+using MfaSrv.Server.Services;
+using MfaSrv.Tests.Unit.Helpers;
+using Moq;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class DatabaseBackupServiceTests : IDisposable
+{
+    private const int InitialRows = 2000;
+
+    private readonly string _testDir;
+    private readonly string _connectionString;
+
+    public DatabaseBackupServiceTests()
+    {
+        _testDir = Path.Combine(Path.GetTempPath(), $"mfasrv_test_{Guid.NewGuid():N}");
+        Directory.CreateDirectory(_testDir);
+        _connectionString = $"Data Source={Path.Combine(_testDir, "test.db")};Pooling=False";
+    }
+
+    private DatabaseBackupService CreateService(BackupSettings settings)
+    {
+        var config = new ConfigurationBuilder()
+            .AddInMemoryCollection(new Dictionary<string, string?>
+            {
+                ["ConnectionStrings:DefaultConnection"] = _connectionString,
+                ["Ldap:Server"] = "configured.example.com",
+                ["Ldap:BindDn"] = "CN=configured",
+                ["MfaSrv:EncryptionKey"] = Convert.ToBase64String(new byte[32])
+            })
+            .Build();
+        var env = new Microsoft.Extensions.Hosting.Internal.HostingEnvironment { ContentRootPath = Path.GetTempPath() };
+        var setupService = new SetupService(config, env, NullLogger<SetupService>.Instance);
+
+        var leaderElection = new LeaderElectionService(
+            new ServiceCollection().BuildServiceProvider().GetRequiredService<IServiceScopeFactory>(),
+            Options.Create(new HaSettings { Enabled = false, InstanceId = "test" }),
+            NullLogger<LeaderElectionService>.Instance,
+            setupService,
+            new InMemoryHaPeerNetwork().TransportFor("test"));
+
+        settings.BackupDirectory = Path.Combine(_testDir, "backups");
+
+        return new DatabaseBackupService(
+            config,
+            Mock.Of<IOptionsMonitor<BackupSettings>>(m => m.CurrentValue == settings),
+            NullLogger<DatabaseBackupService>.Instance,
+            setupService,
+            leaderElection);
+    }
+
+    private async Task SeedAsync(string journalMode)
+    {
+        await using var connection = new SqliteConnection(_connectionString);
+        await connection.OpenAsync();
+
+        await using var command = connection.CreateCommand();
+        command.CommandText = $"PRAGMA journal_mode={journalMode}; CREATE TABLE Sessions (Id INTEGER PRIMARY KEY, Payload BLOB NOT NULL);";
+        await command.ExecuteNonQueryAsync();
+
+        await using var transaction = connection.BeginTransaction();
+        command.Transaction = transaction;
+        command.CommandText = "INSERT INTO Sessions (Payload) VALUES (randomblob(1024))";
+        for (var i = 0; i < InitialRows; i++)
+            await command.ExecuteNonQueryAsync();
+        transaction.Commit();
+    }
+
+    /// <summary>
+    /// Inserts rows one at a time until cancelled, the way the auth path writes sessions.
+    /// Returns the number of rows written and the slowest insert.
+    /// </summary>
+    private async Task<(int Writes, TimeSpan MaxLatency)> WriteUntilCancelledAsync(CancellationToken ct)
+    {
+        await using var connection = new SqliteConnection(_connectionString);
+        await connection.OpenAsync();
+        await using var command = connection.CreateCommand();
+        command.CommandText = "INSERT INTO Sessions (Payload) VALUES (randomblob(1024))";
+
+        var writes = 0;
+        var maxLatency = TimeSpan.Zero;
+        while (!ct.IsCancellationRequested)
+        {
+            var stopwatch = Stopwatch.StartNew();
+            await command.ExecuteNonQueryAsync();
+            if (stopwatch.Elapsed > maxLatency)
+                maxLatency = stopwatch.Elapsed;
+            writes++;
+            await Task.Delay(1);
+        }
+        return (writes, maxLatency);
+    }
+
+    private static async Task<(long Rows, string JournalMode, string Integrity)> InspectAsync(string path)
+    {
+        await using var connection = new SqliteConnection($"Data Source={path};Mode=ReadOnly;Pooling=False");
+        await connection.OpenAsync();
+        await using var command = connection.CreateCommand();
+
+        command.CommandText = "SELECT count(*) FROM Sessions";
+        var rows = (long)(await command.ExecuteScalarAsync())!;
+        command.CommandText = "PRAGMA journal_mode";
+        var journalMode = (string)(await command.ExecuteScalarAsync())!;
+        command.CommandText = "PRAGMA integrity_check";
+        var integrity = (string)(await command.ExecuteScalarAsync())!;
+        return (rows, journalMode, integrity);
+    }
+
+    [Fact]
+    public async Task PerformBackupAsync_WalDatabase_CopiesSnapshotWhileWritesContinue()
+    {
+        await SeedAsync("WAL");
+        var service = CreateService(new BackupSettings { PagesPerStep = 8, StepDelayMs = 1, MaxBytesPerSecond = 0 });
+
+        using var cts = new CancellationTokenSource();
+        var writer = WriteUntilCancelledAsync(cts.Token);
+        var backupPath = await service.PerformBackupAsync();
+        cts.Cancel();
+        var (writes, maxLatency) = await writer;
+
+        var backup = await InspectAsync(backupPath);
+        backup.Integrity.Should().Be("ok");
+        backup.Rows.Should().BeGreaterThanOrEqualTo(InitialRows);
+        backup.JournalMode.Should().Be("delete");
+        File.Exists(backupPath + ".partial").Should().BeFalse();
+
+        writes.Should().BeGreaterThan(0, "writers must make progress while the backup runs");
+        maxLatency.Should().BeLessThan(TimeSpan.FromSeconds(1));
+    }
+
+    [Fact]
+    public async Task PerformBackupAsync_RollbackJournalWithConcurrentWrites_Completes()
+    {
+        await SeedAsync("DELETE");
+        var service = CreateService(new BackupSettings { PagesPerStep = 8, StepDelayMs = 1, MaxBytesPerSecond = 0 });
+
+        using var cts = new CancellationTokenSource();
+        var writer = WriteUntilCancelledAsync(cts.Token);
+        var backupPath = await service.PerformBackupAsync();
+        cts.Cancel();
+        await writer;
+
+        var backup = await InspectAsync(backupPath);
+        backup.Integrity.Should().Be("ok");
+        backup.Rows.Should().BeGreaterThanOrEqualTo(InitialRows);
+    }
+
+    [Fact]
+    public async Task PerformBackupAsync_WithIoBudget_PacesTheCopy()
+    {
+        await SeedAsync("WAL");
+        // About 2 MB at 8 MB/s: a quarter of a second at least
+        var service = CreateService(new BackupSettings { PagesPerStep = 64, StepDelayMs = 0, MaxBytesPerSecond = 8L * 1024 * 1024 });
+
+        var stopwatch = Stopwatch.StartNew();
+        var backupPath = await service.PerformBackupAsync();
+
+        stopwatch.Elapsed.Should().BeGreaterThan(TimeSpan.FromMilliseconds(200));
+        (await InspectAsync(backupPath)).Rows.Should().Be(InitialRows);
+    }
+
+    [Fact]
+    public void StepPause_HonorsMinimumDelayAndByteBudget()
+    {
+        var settings = new BackupSettings { StepDelayMs = 5, MaxBytesPerSecond = 1024 * 1024 };
+
+        // 1 MB at 1 MB/s takes a second; 100 ms were spent copying
+        DatabaseBackupService.StepPause(1024 * 1024, TimeSpan.FromMilliseconds(100), settings)
+            .Should().Be(TimeSpan.FromMilliseconds(900));
+
+        // Within budget: only the minimum delay
+        DatabaseBackupService.StepPause(1024, TimeSpan.FromMilliseconds(100), settings)
+            .Should().Be(TimeSpan.FromMilliseconds(5));
+
+        settings.MaxBytesPerSecond = 0;
+        DatabaseBackupService.StepPause(1024 * 1024 * 1024, TimeSpan.Zero, settings)
+            .Should().Be(TimeSpan.FromMilliseconds(5));
+    }
+
+    public void Dispose()
+    {
+        try { Directory.Delete(_testDir, true); }
+        catch { /* best effort cleanup */ }
+    }
+}
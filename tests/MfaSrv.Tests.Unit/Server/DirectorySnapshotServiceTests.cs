@@ -0,0 +1,91 @@
+using FluentAssertions;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Logging.Abstractions;
+using MfaSrv.Core.Entities;
+using MfaSrv.DcAgent.Services;
+using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class DirectorySnapshotServiceTests : IDisposable
+{
+    private readonly MfaSrvDbContext _db = new(new DbContextOptionsBuilder<MfaSrvDbContext>()
+        .UseInMemoryDatabase(Guid.NewGuid().ToString())
+        .Options);
+
+    private User AddUser(string samAccountName, string dn, params string[] groups)
+    {
+        var user = new User { SamAccountName = samAccountName, DistinguishedName = dn };
+        foreach (var group in groups)
+            user.GroupMemberships.Add(new UserGroupMembership { UserId = user.Id, GroupName = group });
+        _db.Users.Add(user);
+        _db.SaveChanges();
+        return user;
+    }
+
+    [Fact]
+    public async Task BuildAsync_RoundTripsThroughAgentDirectoryCache()
+    {
+        AddUser("alice", "CN=Alice,OU=Admins,DC=corp,DC=local", "Domain Admins", "Staff");
+        AddUser("bob", @"CN=Smith\, Bob,OU=Sales,DC=corp,DC=local", "Staff");
+        AddUser("carol", "CN=Carol,OU=Sales,DC=corp,DC=local");
+
+        var chunks = await DirectorySnapshotService.BuildAsync(_db);
+
+        chunks.Should().ContainSingle();
+        chunks[0].Directory.Groups.Should().Equal("Domain Admins", "Staff");
+        chunks[0].Directory.Ous.Should().HaveCount(2);
+
+        var cache = new DirectoryCacheService(NullLogger<DirectoryCacheService>.Instance);
+        cache.ApplyChunk(chunks[0].Directory).Should().BeTrue();
+
+        cache.UserCount.Should().Be(3);
+        cache.TryGetUser("alice", out var groups, out var ou).Should().BeTrue();
+        groups.Should().Equal("Domain Admins", "Staff");
+        ou.Should().Be("OU=Admins,DC=corp,DC=local");
+
+        cache.TryGetUser("bob", out groups, out ou).Should().BeTrue();
+        groups.Should().Equal("Staff");
+        ou.Should().Be("OU=Sales,DC=corp,DC=local");
+
+        cache.TryGetUser("carol", out groups, out _).Should().BeTrue();
+        groups.Should().BeEmpty();
+    }
+
+    [Fact]
+    public async Task BuildAsync_VersionDependsOnlyOnContent()
+    {
+        AddUser("bob", "CN=Bob,OU=Sales,DC=corp,DC=local", "Staff");
+        var user = AddUser("alice", "CN=Alice,OU=Admins,DC=corp,DC=local", "Staff");
+
+        var first = (await DirectorySnapshotService.BuildAsync(_db))[0].Directory.Version;
+        var second = (await DirectorySnapshotService.BuildAsync(_db))[0].Directory.Version;
+        second.Should().Be(first);
+
+        _db.UserGroupMemberships.Add(new UserGroupMembership { UserId = user.Id, GroupName = "Domain Admins" });
+        await _db.SaveChangesAsync();
+
+        var changed = (await DirectorySnapshotService.BuildAsync(_db))[0].Directory.Version;
+        changed.Should().NotBe(first);
+    }
+
+    [Fact]
+    public async Task BuildAsync_LargeDirectory_SplitsIntoChunks()
+    {
+        for (var i = 0; i < DirectorySnapshotService.UsersPerChunk + 10; i++)
+            _db.Users.Add(new User { SamAccountName = $"user{i:D5}", DistinguishedName = $"CN=User{i},OU=Staff,DC=corp,DC=local" });
+        await _db.SaveChangesAsync();
+
+        var chunks = await DirectorySnapshotService.BuildAsync(_db);
+
+        chunks.Should().HaveCount(2);
+        chunks.Select(c => c.Directory.Index).Should().Equal(0, 1);
+        chunks.Should().OnlyContain(c => c.Directory.Count == 2 && c.Directory.Version == chunks[0].Directory.Version);
+        chunks[1].Directory.Users.Should().HaveCount(10);
+        chunks[1].Directory.Ous.Should().BeEmpty();
+    }
+
+    public void Dispose() => _db.Dispose();
+}
@@ -0,0 +1,64 @@
+using FluentAssertions;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Enums;
+using MfaSrv.Server;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class EvaluationAuditForwarderTests
+{
+    private static readonly string Secret = Convert.ToBase64String(Enumerable.Range(1, 32).Select(i => (byte)i).ToArray());
+
+    private static EvaluationAuditForwarder Create(bool evaluationNode = true, string secret = "")
+    {
+        var settings = Options.Create(new HaSettings { EvaluationNode = evaluationNode, PeerSecret = secret });
+        return new EvaluationAuditForwarder(settings, new PeerAuthenticator(settings));
+    }
+
+    [Fact]
+    public void IsEnabled_OnlyOnEvaluationNodesWithPeerSecret()
+    {
+        Create(secret: Secret).IsEnabled.Should().BeTrue();
+        Create().IsEnabled.Should().BeFalse();
+        Create(evaluationNode: false, secret: Secret).IsEnabled.Should().BeFalse();
+    }
+
+    [Fact]
+    public async Task ReadBatchAsync_ReturnsQueuedEventsInBatches()
+    {
+        var forwarder = Create(secret: Secret);
+        var happenedAt = new DateTimeOffset(2026, 3, 1, 12, 0, 0, TimeSpan.Zero);
+
+        for (var i = 0; i < EvaluationAuditForwarder.MaxBatchSize + 1; i++)
+        {
+            forwarder.TryEnqueue(AuditEventType.PolicyEvaluated, $"user{i}", "10.0.0.1", null, "Decision: Allow", happenedAt)
+                .Should().BeTrue();
+        }
+
+        var first = await forwarder.ReadBatchAsync(default);
+        first.Should().HaveCount(EvaluationAuditForwarder.MaxBatchSize);
+        first[0].UserId.Should().Be("user0");
+        first[0].EventType.Should().Be((int)AuditEventType.PolicyEvaluated);
+        first[0].TargetResource.Should().BeEmpty();
+        first[0].Timestamp.ToDateTimeOffset().Should().Be(happenedAt);
+
+        var second = await forwarder.ReadBatchAsync(default);
+        second.Should().ContainSingle().Which.UserId.Should().Be($"user{EvaluationAuditForwarder.MaxBatchSize}");
+        forwarder.QueueDepth.Should().Be(0);
+    }
+
+    [Fact]
+    public void TryEnqueue_QueueFull_DropsWithoutBlocking()
+    {
+        var forwarder = Create(secret: Secret);
+
+        for (var i = 0; i < EvaluationAuditForwarder.QueueCapacity; i++)
+            forwarder.TryEnqueue(AuditEventType.PolicyEvaluated, "alice", null, null, null, DateTimeOffset.UtcNow);
+
+        forwarder.TryEnqueue(AuditEventType.PolicyEvaluated, "alice", null, null, null, DateTimeOffset.UtcNow)
+            .Should().BeFalse();
+        forwarder.QueueDepth.Should().Be(EvaluationAuditForwarder.QueueCapacity);
+    }
+}
@@ -0,0 +1,225 @@
+using FluentAssertions;
+using Google.Protobuf;
+using Google.Protobuf.WellKnownTypes;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Collections;
+using MfaSrv.Protocol;
+using MfaSrv.Server;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class EvaluationReplicaTests
+{
+    private static readonly DateTimeOffset Now = new(2026, 3, 1, 12, 0, 0, TimeSpan.Zero);
+
+    private readonly EvaluationReplica _replica = new(
+        Options.Create(new HaSettings { EvaluationNode = true, InstanceId = "eval-1" }),
+        NullLogger<EvaluationReplica>.Instance);
+
+    private static PolicyEntry Entry(string id) =>
+        new() { PolicyId = id, PolicyJson = PolicyJson(id) };
+
+    private static string PolicyJson(string id) =>
+        $$"""
+        {"id":"{{id}}","name":"{{id}}","isEnabled":true,"priority":1,
+         "ruleGroups":[{"rules":[{"ruleType":"SourceUser","operator":"Equals","value":"alice"}]}],
+         "actions":[{"actionType":"Deny"}]}
+        """;
+
+    private static SessionEvent Session(string id, string user, string ip = "10.0.0.1", int minutes = 60, bool revoked = false) =>
+        new()
+        {
+            SessionId = id,
+            UserName = user,
+            SourceIp = ip,
+            ExpiresAt = Timestamp.FromDateTimeOffset(Now.AddMinutes(minutes)),
+            Revoked = revoked
+        };
+
+    private static RevocationFilterUpdate FilterSnapshot(ulong version, params string[] revoked)
+    {
+        var filter = new CuckooFilter(100);
+        foreach (var id in revoked)
+            filter.Add(CuckooFilter.Hash(id));
+        return new RevocationFilterUpdate { Version = version, Snapshot = true, Filter = ByteString.CopyFrom(filter.ToBytes()) };
+    }
+
+    private void MakeReady()
+    {
+        _replica.ApplyPolicySnapshot("e1", 1, new[] { Entry("p1") });
+        _replica.ApplyDirectoryChunk(new DirectoryChunk { Version = "d1", Index = 0, Count = 1 });
+        _replica.BeginSessionSnapshot();
+        _replica.CompleteSessionSnapshot();
+        _replica.ApplyRevocationFilter(FilterSnapshot(1));
+        _replica.RecordPolicyStreamContact(Now);
+        _replica.RecordSessionStreamContact(Now);
+    }
+
+    [Fact]
+    public void IsReady_RequiresPoliciesDirectorySessionsAndRevocationFilter()
+    {
+        _replica.IsEnabled.Should().BeTrue();
+        _replica.IsReadyAt(Now).Should().BeFalse();
+
+        _replica.RecordPolicyStreamContact(Now);
+        _replica.RecordSessionStreamContact(Now);
+        _replica.ApplyPolicySnapshot("e1", 1, new[] { Entry("p1") });
+        _replica.ApplyDirectoryChunk(new DirectoryChunk { Version = "d1", Index = 0, Count = 1 });
+        _replica.BeginSessionSnapshot();
+        _replica.CompleteSessionSnapshot();
+        _replica.IsReadyAt(Now).Should().BeFalse();
+
+        _replica.ApplyRevocationFilter(FilterSnapshot(1)).Should().BeTrue();
+        _replica.IsReadyAt(Now).Should().BeTrue();
+    }
+
+    [Fact]
+    public void IsReady_FalseOnceEitherStreamIsSilentForMaxStaleness()
+    {
+        MakeReady();
+        var later = Now + _replica.MaxStaleness + TimeSpan.FromSeconds(1);
+
+        _replica.MaxStaleness.Should().Be(TimeSpan.FromSeconds(15));
+        _replica.IsReadyAt(Now + _replica.MaxStaleness).Should().BeTrue();
+        _replica.IsReadyAt(later).Should().BeFalse("the state is frozen once the leader stops talking");
+
+        _replica.RecordPolicyStreamContact(later);
+        _replica.IsReadyAt(later).Should().BeFalse("the session stream is still silent");
+
+        _replica.RecordSessionStreamContact(later);
+        _replica.IsReadyAt(later).Should().BeTrue();
+    }
+
+    [Fact]
+    public void ApplyPolicyChange_ConsecutiveVersions_UpdateCompiledSet()
+    {
+        _replica.ApplyPolicySnapshot("e1", 3, new[] { Entry("p1") });
+        _replica.Policies.Count.Should().Be(1);
+
+        _replica.ApplyPolicyChange("e1", 4, "p2", PolicyJson("p2")).Should().BeTrue();
+        _replica.ApplyPolicyChange("e1", 5, "p1", null).Should().BeTrue();
+
+        _replica.PolicyVersion.Should().Be(5);
+        _replica.Policies.Count.Should().Be(1);
+    }
+
+    [Fact]
+    public void ApplyPolicyChange_GapOrOtherEpoch_RequiresResync_AndReplayIsIgnored()
+    {
+        _replica.ApplyPolicySnapshot("e1", 3, new[] { Entry("p1") });
+
+        _replica.ApplyPolicyChange("e1", 5, "p2", PolicyJson("p2")).Should().BeFalse();
+        _replica.ApplyPolicyChange("e2", 4, "p2", PolicyJson("p2")).Should().BeFalse();
+        _replica.ApplyPolicyChange("e1", 3, "p1", null).Should().BeTrue();
+
+        _replica.PolicyVersion.Should().Be(3);
+        _replica.Policies.Count.Should().Be(1);
+    }
+
+    [Fact]
+    public void ApplyDirectoryChunk_SwapsInDirectoryAfterLastChunk()
+    {
+        _replica.ApplyDirectoryChunk(new DirectoryChunk
+        {
+            Version = "d1", Index = 0, Count = 2,
+            Groups = { "Admins", "Staff" },
+            Ous = { "OU=IT,DC=corp" },
+            Users = { new DirectoryUser { UserName = "alice", Ou = 1, Groups = { 0, 1 } } }
+        }).Should().BeTrue();
+        _replica.TryGetUser("alice", out _, out _).Should().BeFalse();
+
+        _replica.ApplyDirectoryChunk(new DirectoryChunk
+        {
+            Version = "d1", Index = 1, Count = 2,
+            Users = { new DirectoryUser { UserName = "bob", Groups = { 1 } } }
+        }).Should().BeTrue();
+
+        _replica.DirectoryVersion.Should().Be("d1");
+        _replica.TryGetUser("alice", out var groups, out var ou).Should().BeTrue();
+        groups.Should().Equal("Admins", "Staff");
+        ou.Should().Be("OU=IT,DC=corp");
+        _replica.TryGetUser("bob", out groups, out ou).Should().BeTrue();
+        groups.Should().Equal("Staff");
+        ou.Should().BeNull();
+    }
+
+    [Fact]
+    public void ApplyDirectoryChunk_OutOfOrder_RequiresResync()
+    {
+        _replica.ApplyDirectoryChunk(new DirectoryChunk { Version = "d1", Index = 1, Count = 2 }).Should().BeFalse();
+
+        _replica.ApplyDirectoryChunk(new DirectoryChunk { Version = "d1", Index = 0, Count = 3 }).Should().BeTrue();
+        _replica.ApplyDirectoryChunk(new DirectoryChunk { Version = "d2", Index = 1, Count = 3 }).Should().BeFalse();
+        _replica.DirectoryVersion.Should().BeNull();
+    }
+
+    [Fact]
+    public void SessionSnapshot_KeepsServingOldSessionsUntilComplete()
+    {
+        MakeReady();
+        _replica.ApplySessionEvent(Session("s1", "alice"));
+
+        _replica.BeginSessionSnapshot();
+        _replica.ApplySessionEvent(Session("s2", "bob"));
+        _replica.FindSession("alice", "10.0.0.1", Now).Should().Be("s1");
+        _replica.FindSession("bob", "10.0.0.1", Now).Should().BeNull();
+
+        _replica.CompleteSessionSnapshot();
+        _replica.FindSession("alice", "10.0.0.1", Now).Should().BeNull();
+        _replica.FindSession("bob", "10.0.0.1", Now).Should().Be("s2");
+        _replica.SessionCount.Should().Be(1);
+    }
+
+    [Fact]
+    public void FindSession_ReturnsNewestMatch_AndSkipsExpiredRevokedAndOtherIps()
+    {
+        MakeReady();
+        _replica.ApplySessionEvent(Session("old", "alice"));
+        _replica.ApplySessionEvent(Session("new", "alice"));
+        _replica.ApplySessionEvent(Session("other-ip", "alice", ip: "10.0.0.2"));
+        _replica.ApplySessionEvent(Session("expired", "carol", minutes: -1));
+
+        _replica.FindSession("alice", "10.0.0.1", Now).Should().Be("new");
+        _replica.FindSession("carol", "10.0.0.1", Now).Should().BeNull();
+        _replica.SessionCount.Should().Be(3);
+
+        _replica.ApplySessionEvent(Session("new", "alice", revoked: true));
+        _replica.FindSession("alice", "10.0.0.1", Now).Should().Be("old");
+
+        _replica.ApplyRevocationFilter(FilterSnapshot(2, "old")).Should().BeTrue();
+        _replica.FindSession("alice", "10.0.0.1", Now).Should().BeNull();
+    }
+
+    [Fact]
+    public void ApplyRevocationFilter_DeltaMustFollowCurrentVersion()
+    {
+        _replica.ApplyRevocationFilter(new RevocationFilterUpdate { Version = 1 }).Should().BeFalse();
+
+        MakeReady();
+        _replica.ApplySessionEvent(Session("s1", "alice"));
+
+        _replica.ApplyRevocationFilter(new RevocationFilterUpdate { Version = 3, Added = { CuckooFilter.Hash("s1") } })
+            .Should().BeFalse();
+        _replica.FindSession("alice", "10.0.0.1", Now).Should().Be("s1");
+
+        _replica.ApplyRevocationFilter(new RevocationFilterUpdate { Version = 2, Added = { CuckooFilter.Hash("s1") } })
+            .Should().BeTrue();
+        _replica.RevocationFilterVersion.Should().Be(2);
+        _replica.FindSession("alice", "10.0.0.1", Now).Should().BeNull();
+    }
+
+    [Fact]
+    public void Disabled_WhenNotAnEvaluationNode()
+    {
+        var replica = new EvaluationReplica(
+            Options.Create(new HaSettings { InstanceId = "primary" }),
+            NullLogger<EvaluationReplica>.Instance);
+
+        replica.IsEnabled.Should().BeFalse();
+        replica.IsReady.Should().BeFalse();
+        replica.Policies.Count.Should().Be(0);
+    }
+}
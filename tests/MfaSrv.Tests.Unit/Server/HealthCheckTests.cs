@@ -10,6 +10,7 @@ using MfaSrv.Core.Enums;
 using MfaSrv.Server;
 using MfaSrv.Server.Data;
 using MfaSrv.Server.Services;
+using MfaSrv.Tests.Unit.Helpers;
 using Xunit;
 
 namespace MfaSrv.Tests.Unit.Server;
@@ -48,7 +49,8 @@ public class HealthCheckTests : IDisposable
             _serviceProvider.GetRequiredService<IServiceScopeFactory>(),
             Options.Create(new HaSettings { Enabled = false, InstanceId = "test" }),
             NullLogger<LeaderElectionService>.Instance,
-            setupService);
+            setupService,
+            new InMemoryHaPeerNetwork().TransportFor("test"));
     }
 
     private MfaSrvHealthCheck CreateHealthCheck()
@@ -63,7 +65,10 @@ public class HealthCheckTests : IDisposable
     {
         return new MfaSrvReadinessCheck(
             _serviceProvider.GetRequiredService<IServiceScopeFactory>(),
-            _leaderService);
+            _leaderService,
+            new EvaluationReplica(
+                Options.Create(new HaSettings { InstanceId = "test" }),
+                NullLogger<EvaluationReplica>.Instance));
     }
 
     private MfaSrvDbContext GetScopedDb()
@@ -5,9 +5,11 @@ using Microsoft.Extensions.DependencyInjection;
 using Microsoft.Extensions.Hosting;
 using Microsoft.Extensions.Logging.Abstractions;
 using Microsoft.Extensions.Options;
+using MfaSrv.Protocol.Ha;
 using MfaSrv.Server;
 using MfaSrv.Server.Data;
 using MfaSrv.Server.Services;
+using MfaSrv.Tests.Unit.Helpers;
 using Xunit;
 
 namespace MfaSrv.Tests.Unit.Server;
@@ -58,7 +60,66 @@ public class LeaderElectionServiceTests : IDisposable
             _serviceProvider.GetRequiredService<IServiceScopeFactory>(),
             Options.Create(haSettings),
             NullLogger<LeaderElectionService>.Instance,
-            CreateSetupService());
+            CreateSetupService(),
+            new InMemoryHaPeerNetwork().TransportFor(haSettings.InstanceId));
+    }
+
+    private ServiceProvider CreateProvider()
+    {
+        var services = new ServiceCollection();
+        services.AddDbContext<MfaSrvDbContext>(options => options.UseInMemoryDatabase(_dbName));
+        return services.BuildServiceProvider();
+    }
+
+    /// <summary>
+    /// One member of a two-instance HA pair on the shared database, with a 30 s lease so
+    /// that only heartbeats can explain a sub-second failover.
+    /// </summary>
+    private LeaderElectionService CreatePeer(string name, string peer, ServiceProvider provider, InMemoryHaPeerNetwork network)
+    {
+        var service = new LeaderElectionService(
+            provider.GetRequiredService<IServiceScopeFactory>(),
+            Options.Create(new HaSettings
+            {
+                Enabled = true,
+                InstanceId = name,
+                LeaseDurationSeconds = 30,
+                LeaseRenewIntervalSeconds = 10,
+                Peers = new[] { peer },
+                HeartbeatIntervalMs = 100,
+                PeerFailureTimeoutMs = 400
+            }),
+            NullLogger<LeaderElectionService>.Instance,
+            CreateSetupService(),
+            network.TransportFor(name));
+        network.Register(name, service);
+        return service;
+    }
+
+    private static async Task<TimeSpan> WaitUntilAsync(Func<bool> condition, TimeSpan timeout)
+    {
+        var stopwatch = System.Diagnostics.Stopwatch.StartNew();
+        while (!condition() && stopwatch.Elapsed < timeout)
+            await Task.Delay(10);
+        return stopwatch.Elapsed;
+    }
+
+    /// <summary>
+    /// Starts a pair with "a" as leader and "b" as standby that has seen "a" lead.
+    /// </summary>
+    private async Task<(LeaderElectionService A, LeaderElectionService B)> StartPairAsync(
+        ServiceProvider providerA, ServiceProvider providerB, InMemoryHaPeerNetwork network)
+    {
+        var a = CreatePeer("a", "b", providerA, network);
+        var b = CreatePeer("b", "a", providerB, network);
+
+        await a.StartAsync(CancellationToken.None);
+        (await WaitUntilAsync(() => a.IsLeader, TimeSpan.FromSeconds(5))).Should().BeLessThan(TimeSpan.FromSeconds(5));
+        await b.StartAsync(CancellationToken.None);
+        await Task.Delay(300);
+
+        b.IsLeader.Should().BeFalse();
+        return (a, b);
     }
 
     [Fact]
@@ -254,6 +315,175 @@ public class LeaderElectionServiceTests : IDisposable
         // This is expected behavior for single-instance mode.
     }
 
+    [Fact]
+    public async Task Failover_LeaderCrashes_StandbyTakesOverWithinHeartbeatTimeout()
+    {
+        var network = new InMemoryHaPeerNetwork();
+        var providerA = CreateProvider();
+        using var providerB = CreateProvider();
+        var (a, b) = await StartPairAsync(providerA, providerB, network);
+        var tokenA = a.FencingToken;
+
+        // Crash: "a" stops answering and can no longer reach the database or release its lease
+        network.Disconnect("a");
+        providerA.Dispose();
+
+        var failover = await WaitUntilAsync(() => b.IsLeader, TimeSpan.FromSeconds(10));
+
+        b.IsLeader.Should().BeTrue();
+        failover.Should().BeLessThan(TimeSpan.FromSeconds(2), "the 30 s lease must not be waited out");
+        b.FencingToken.Should().BeGreaterThan(tokenA!.Value);
+
+        await b.StopAsync(CancellationToken.None);
+        await a.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task Failover_LeaderShutsDown_StandbyTakesOverImmediately()
+    {
+        var network = new InMemoryHaPeerNetwork();
+        using var providerA = CreateProvider();
+        using var providerB = CreateProvider();
+        var (a, b) = await StartPairAsync(providerA, providerB, network);
+
+        var stopwatch = System.Diagnostics.Stopwatch.StartNew();
+        await a.StopAsync(CancellationToken.None);
+        await WaitUntilAsync(() => b.IsLeader, TimeSpan.FromSeconds(10));
+
+        b.IsLeader.Should().BeTrue();
+        stopwatch.Elapsed.Should().BeLessThan(TimeSpan.FromSeconds(1));
+
+        await b.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task PeerLinkDown_StandbyTakesOverOnce_OldLeaderIsFenced()
+    {
+        var network = new InMemoryHaPeerNetwork();
+        using var providerA = CreateProvider();
+        using var providerB = CreateProvider();
+        var (a, b) = await StartPairAsync(providerA, providerB, network);
+
+        // Both still reach the database; only the link between them is down
+        network.Disconnect("b");
+        await WaitUntilAsync(() => b.IsLeader, TimeSpan.FromSeconds(10));
+        b.IsLeader.Should().BeTrue();
+
+        using (var scope = providerA.CreateScope())
+        {
+            var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+            (await a.RunFencedAsync(db, _ => Task.CompletedTask)).Should().BeFalse();
+        }
+
+        await Task.Delay(1000);
+        a.IsLeader.Should().BeFalse();
+        b.IsLeader.Should().BeTrue("the old leader never saw the new one alive and must not preempt it");
+
+        await b.StopAsync(CancellationToken.None);
+        await a.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task RunFencedAsync_AfterTakeover_RefusesWriteAndStepsDown()
+    {
+        var svc = CreateService();
+        await svc.StartAsync(CancellationToken.None);
+        await WaitUntilAsync(() => svc.IsLeader, TimeSpan.FromSeconds(5));
+
+        using (var scope = _serviceProvider.CreateScope())
+        {
+            var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+            (await svc.RunFencedAsync(db, _ => Task.CompletedTask)).Should().BeTrue();
+
+            // Another instance takes over while this one is, say, paused
+            var lease = await db.LeaderLeases.SingleAsync();
+            lease.HolderId = "other-instance";
+            lease.FencingToken++;
+            await db.SaveChangesAsync();
+        }
+
+        using (var scope = _serviceProvider.CreateScope())
+        {
+            var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+            var written = false;
+
+            (await svc.RunFencedAsync(db, _ => { written = true; return Task.CompletedTask; })).Should().BeFalse();
+
+            written.Should().BeFalse();
+            svc.IsLeader.Should().BeFalse();
+            svc.FencingToken.Should().BeNull();
+        }
+
+        await svc.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task PeerClaimsNewerToken_LeaseUnchanged_RemainsLeader()
+    {
+        var svc = CreateService();
+        await svc.StartAsync(CancellationToken.None);
+        await WaitUntilAsync(() => svc.IsLeader, TimeSpan.FromSeconds(5));
+        var token = svc.FencingToken!.Value;
+
+        svc.HandlePeerHeartbeat(new PeerHeartbeat { InstanceId = "intruder", IsLeader = true, FencingToken = token + 5 });
+        await Task.Delay(300);
+
+        svc.IsLeader.Should().BeTrue("the lease row still names this instance");
+        svc.FencingToken.Should().Be(token);
+
+        await svc.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task PeerClaimsNewerToken_LeaseTakenOver_StepsDown()
+    {
+        var svc = CreateService();
+        await svc.StartAsync(CancellationToken.None);
+        await WaitUntilAsync(() => svc.IsLeader, TimeSpan.FromSeconds(5));
+
+        long newToken;
+        using (var scope = _serviceProvider.CreateScope())
+        {
+            var db = scope.ServiceProvider.GetRequiredService<MfaSrvDbContext>();
+            var lease = await db.LeaderLeases.SingleAsync();
+            lease.HolderId = "other-instance";
+            newToken = ++lease.FencingToken;
+            await db.SaveChangesAsync();
+        }
+
+        svc.HandlePeerHeartbeat(new PeerHeartbeat { InstanceId = "other-instance", IsLeader = true, FencingToken = newToken });
+        var elapsed = await WaitUntilAsync(() => !svc.IsLeader, TimeSpan.FromSeconds(5));
+
+        svc.IsLeader.Should().BeFalse();
+        elapsed.Should().BeLessThan(TimeSpan.FromSeconds(2), "the heartbeat wakes the election loop before the renew interval");
+
+        await svc.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task ExecuteAsync_EachAcquisition_IncrementsFencingToken()
+    {
+        var first = CreateService();
+        await first.StartAsync(CancellationToken.None);
+        await WaitUntilAsync(() => first.IsLeader, TimeSpan.FromSeconds(5));
+        var firstToken = first.FencingToken;
+        await first.StopAsync(CancellationToken.None);
+
+        var second = CreateService(new HaSettings
+        {
+            Enabled = true,
+            InstanceId = "test-instance-2",
+            LeaseDurationSeconds = 30,
+            LeaseRenewIntervalSeconds = 10
+        });
+        await second.StartAsync(CancellationToken.None);
+        await WaitUntilAsync(() => second.IsLeader, TimeSpan.FromSeconds(5));
+
+        firstToken.Should().Be(1);
+        second.FencingToken.Should().Be(2);
+        await second.StopAsync(CancellationToken.None);
+    }
+
     [Fact]
     public void LeaderLease_Entity_HasCorrectDefaults()
     {
@@ -270,6 +500,8 @@ public class LeaderElectionServiceTests : IDisposable
         settings.InstanceId.Should().BeEmpty();
         settings.LeaseDurationSeconds.Should().Be(30);
         settings.LeaseRenewIntervalSeconds.Should().Be(10);
+        settings.Peers.Should().BeEmpty();
+        settings.PeerFailureTimeoutMs.Should().BeLessThan(1000);
     }
 
     public void Dispose()
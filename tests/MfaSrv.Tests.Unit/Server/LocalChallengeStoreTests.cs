@@ -0,0 +1,110 @@
+using FluentAssertions;
+using Microsoft.Extensions.Options;
+using MfaSrv.Server;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class LocalChallengeStoreTests : IDisposable
+{
+    private readonly LocalChallengeStore _store = new(Options.Create(new ChallengeStoreSettings()));
+
+    public sealed record PendingCode(string Code, int Attempts);
+
+    public sealed class PushState
+    {
+        public string Status { get; set; } = "Pending";
+    }
+
+    [Fact]
+    public async Task SetAndGet_ReturnsStoredValue()
+    {
+        await _store.SetAsync("challenge:1", new PendingCode("123456", 0), TimeSpan.FromMinutes(5));
+
+        (await _store.GetAsync<PendingCode>("challenge:1")).Should().Be(new PendingCode("123456", 0));
+        (await _store.GetAsync<PendingCode>("challenge:missing")).Should().BeNull();
+    }
+
+    [Fact]
+    public async Task Get_ReturnsCopiesNotSharedInstances()
+    {
+        var value = new PushState();
+        await _store.SetAsync("challenge:1", value, TimeSpan.FromMinutes(5));
+
+        value.Status = "Approved";
+        var first = await _store.GetAsync<PushState>("challenge:1");
+        first!.Status = "Denied";
+
+        first.Should().NotBeSameAs(value);
+        (await _store.GetAsync<PushState>("challenge:1"))!.Status.Should().Be("Pending");
+    }
+
+    [Fact]
+    public async Task Remove_DeletesEntry()
+    {
+        await _store.SetAsync("challenge:1", new PendingCode("1", 0), TimeSpan.FromMinutes(5));
+        await _store.RemoveAsync("challenge:1");
+
+        (await _store.GetAsync<PendingCode>("challenge:1")).Should().BeNull();
+        _store.Count.Should().Be(0);
+    }
+
+    [Fact]
+    public async Task Get_AfterExpiry_ReturnsNull()
+    {
+        await _store.SetAsync("challenge:1", new PendingCode("1", 0), TimeSpan.FromSeconds(30));
+
+        _store.Get<PendingCode>("challenge:1", DateTimeOffset.UtcNow.AddSeconds(10)).Should().NotBeNull();
+        _store.Get<PendingCode>("challenge:1", DateTimeOffset.UtcNow.AddSeconds(31)).Should().BeNull();
+    }
+
+    [Fact]
+    public async Task ExpireDue_ReclaimsOnlyExpiredEntries()
+    {
+        await _store.SetAsync("short", new PendingCode("1", 0), TimeSpan.FromSeconds(5));
+        await _store.SetAsync("long", new PendingCode("2", 0), TimeSpan.FromMinutes(20));
+
+        _store.ExpireDue(DateTimeOffset.UtcNow.AddSeconds(7)).Should().Be(1);
+        _store.Count.Should().Be(1);
+
+        // Beyond one revolution of the wheel: the long entry is swept only once it is due
+        _store.ExpireDue(DateTimeOffset.UtcNow.AddMinutes(19)).Should().Be(0);
+        _store.ExpireDue(DateTimeOffset.UtcNow.AddMinutes(21)).Should().Be(1);
+        _store.Count.Should().Be(0);
+    }
+
+    [Fact]
+    public async Task Set_ExtendingExpiry_KeepsEntryPastOriginalDeadline()
+    {
+        await _store.SetAsync("challenge:1", new PendingCode("1", 0), TimeSpan.FromSeconds(5));
+        await _store.SetAsync("challenge:1", new PendingCode("1", 1), TimeSpan.FromMinutes(1));
+
+        _store.ExpireDue(DateTimeOffset.UtcNow.AddSeconds(10)).Should().Be(0);
+        _store.Get<PendingCode>("challenge:1", DateTimeOffset.UtcNow.AddSeconds(10))!.Attempts.Should().Be(1);
+    }
+
+    [Fact]
+    public async Task Replication_QueuesChangesAndAppliesOnPeer()
+    {
+        using var source = new LocalChallengeStore(Options.Create(new ChallengeStoreSettings
+        {
+            ReplicationPeers = new[] { "https://peer:5081" }
+        }));
+        using var peer = new LocalChallengeStore(Options.Create(new ChallengeStoreSettings()));
+
+        await source.SetAsync("challenge:1", new PendingCode("654321", 2), TimeSpan.FromMinutes(5));
+        await source.RemoveAsync("challenge:2");
+
+        source.Changes!.TryRead(out var set).Should().BeTrue();
+        source.Changes.TryRead(out var removed).Should().BeTrue();
+        removed!.Removed.Should().BeTrue();
+
+        peer.ApplyReplicated(set!.Key, set.Json, set.ExpiresAt, removed: false);
+
+        (await peer.GetAsync<PendingCode>("challenge:1")).Should().Be(new PendingCode("654321", 2));
+        _store.Changes.Should().BeNull("replication is off without peers");
+    }
+
+    public void Dispose() => _store.Dispose();
+}
@@ -0,0 +1,236 @@
+using FluentAssertions;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Configuration;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
+using Moq;
+using MfaSrv.Core.Challenges;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.ValueObjects;
+using MfaSrv.Server;
+using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class MfaChallengeOrchestratorTests : IDisposable
+{
+    private const string ValidCode = "123456";
+
+    private readonly MfaSrvDbContext _db;
+    private readonly ServiceProvider _serviceProvider;
+    private readonly Mock<IMfaProvider> _provider = new();
+    private readonly MfaProviderRegistry _registry;
+    private readonly EnrollmentCache _enrollments = new();
+    private readonly ChallengeCompletionEngine _completions = new();
+    private readonly RiskScoringService _riskScoring = new(Options.Create(new RiskSettings()));
+    private ChallengeStateStore _challenges;
+    private readonly MfaEnrollment _enrollment;
+
+    public MfaChallengeOrchestratorTests()
+    {
+        var dbName = Guid.NewGuid().ToString();
+        _db = new MfaSrvDbContext(new DbContextOptionsBuilder<MfaSrvDbContext>()
+            .UseInMemoryDatabase(dbName)
+            .Options);
+
+        var services = new ServiceCollection();
+        services.AddDbContext<MfaSrvDbContext>(o => o.UseInMemoryDatabase(dbName));
+        _serviceProvider = services.BuildServiceProvider();
+
+        _provider.SetupGet(p => p.MethodId).Returns("TOTP");
+        _provider.Setup(p => p.IssueChallengeAsync(It.IsAny<ChallengeContext>(), It.IsAny<CancellationToken>()))
+            .ReturnsAsync(() => new ChallengeResult { Success = true, ChallengeId = Guid.NewGuid().ToString() });
+        _provider.Setup(p => p.VerifyAsync(It.IsAny<VerificationContext>(), It.IsAny<string>(), It.IsAny<CancellationToken>()))
+            .ReturnsAsync((VerificationContext _, string response, CancellationToken _) =>
+                new VerificationResult { Success = response == ValidCode });
+        _registry = new MfaProviderRegistry(new[] { _provider.Object });
+
+        _challenges = CreateStore();
+
+        _enrollment = new MfaEnrollment
+        {
+            UserId = "user-1",
+            Method = MfaMethod.Totp,
+            Status = EnrollmentStatus.Active,
+            EncryptedSecret = new byte[] { 1, 2, 3 },
+            SecretNonce = new byte[] { 4, 5, 6 }
+        };
+        _db.MfaEnrollments.Add(_enrollment);
+        _db.SaveChanges();
+    }
+
+    private ChallengeStateStore CreateStore() => new(
+        _serviceProvider.GetRequiredService<IServiceScopeFactory>(),
+        NullLogger<ChallengeStateStore>.Instance);
+
+    private MfaChallengeOrchestrator CreateOrchestrator(ChallengeStateStore? challenges = null) => new(
+        _db,
+        _registry,
+        _enrollments,
+        challenges ?? _challenges,
+        _completions,
+        _riskScoring,
+        new ConfigurationBuilder().Build(),
+        NullLogger<MfaChallengeOrchestrator>.Instance);
+
+    private Task<ChallengeResult> IssueAsync(MfaChallengeOrchestrator orchestrator) =>
+        orchestrator.IssueChallengeAsync("user-1", MfaMethod.Totp,
+            new ChallengeContext { UserId = "user-1", EnrollmentId = string.Empty, SourceIp = "10.0.0.1" });
+
+    [Fact]
+    public void ProviderRegistry_ResolvesByMethod()
+    {
+        _registry.Get(MfaMethod.Totp).Should().BeSameAs(_provider.Object);
+        _registry.Get(MfaMethod.Push).Should().BeNull();
+    }
+
+    [Fact]
+    public async Task IssueAndVerify_WritesStatusAndAttemptsThrough()
+    {
+        var orchestrator = CreateOrchestrator();
+
+        var issued = await IssueAsync(orchestrator);
+        issued.Success.Should().BeTrue();
+        (await _db.MfaChallenges.AsNoTracking().SingleAsync()).Status.Should().Be(ChallengeStatus.Issued);
+
+        var result = await orchestrator.VerifyChallengeAsync(issued.ChallengeId!, ValidCode);
+        result.Success.Should().BeTrue();
+
+        var snapshot = await orchestrator.GetChallengeAsync(issued.ChallengeId!);
+        snapshot!.Status.Should().Be(ChallengeStatus.Approved);
+        snapshot.SourceIp.Should().Be("10.0.0.1");
+
+        var stored = await _db.MfaChallenges.AsNoTracking().SingleAsync();
+        stored.Id.Should().Be(issued.ChallengeId);
+        stored.Status.Should().Be(ChallengeStatus.Approved);
+        stored.AttemptCount.Should().Be(1);
+
+        await _challenges.FlushAsync();
+        (await _db.MfaEnrollments.AsNoTracking().SingleAsync()).LastUsedAt.Should().NotBeNull();
+    }
+
+    [Fact]
+    public async Task Verify_OnSeveralInstances_SharesAttemptsAndOutcome()
+    {
+        var first = CreateOrchestrator();
+        var second = CreateOrchestrator(CreateStore());
+        var issued = await IssueAsync(first);
+
+        // Both instances have the challenge cached as Issued
+        (await second.CheckChallengeStatusAsync(issued.ChallengeId!)).Status.Should().Be(ChallengeStatus.Issued);
+
+        (await first.VerifyChallengeAsync(issued.ChallengeId!, "000000")).Success.Should().BeFalse();
+        (await second.VerifyChallengeAsync(issued.ChallengeId!, "000000")).Success.Should().BeFalse();
+        (await first.VerifyChallengeAsync(issued.ChallengeId!, "000000")).Success.Should().BeFalse();
+
+        var result = await second.VerifyChallengeAsync(issued.ChallengeId!, ValidCode);
+        result.Success.Should().BeFalse("the three attempts are shared, not per instance");
+        (await second.CheckChallengeStatusAsync(issued.ChallengeId!)).Status.Should().Be(ChallengeStatus.Failed);
+        (await first.CheckChallengeStatusAsync(issued.ChallengeId!)).Status.Should().Be(ChallengeStatus.Failed);
+    }
+
+    [Fact]
+    public async Task CheckStatus_SettledOnAnotherInstance_ReportsOutcome()
+    {
+        var first = CreateOrchestrator();
+        var second = CreateOrchestrator(CreateStore());
+        var issued = await IssueAsync(first);
+        (await second.CheckChallengeStatusAsync(issued.ChallengeId!)).Status.Should().Be(ChallengeStatus.Issued);
+
+        (await first.VerifyChallengeAsync(issued.ChallengeId!, ValidCode)).Success.Should().BeTrue();
+
+        (await second.CheckChallengeStatusAsync(issued.ChallengeId!)).Status.Should().Be(ChallengeStatus.Approved);
+        (await second.VerifyChallengeAsync(issued.ChallengeId!, ValidCode)).Success.Should().BeFalse();
+    }
+
+    [Fact]
+    public async Task Verify_ChallengeNotInMemory_LoadedFromDatabase()
+    {
+        var issued = await IssueAsync(CreateOrchestrator());
+
+        // Simulate a restart: new store, same database
+        _challenges = CreateStore();
+        var orchestrator = CreateOrchestrator();
+
+        (await orchestrator.VerifyChallengeAsync(issued.ChallengeId!, ValidCode)).Success.Should().BeTrue();
+        (await orchestrator.VerifyChallengeAsync(issued.ChallengeId!, ValidCode)).Success.Should().BeFalse();
+    }
+
+    [Fact]
+    public async Task Verify_TooManyWrongCodes_FailsChallenge()
+    {
+        var orchestrator = CreateOrchestrator();
+        var issued = await IssueAsync(orchestrator);
+
+        for (var i = 0; i < 3; i++)
+            (await orchestrator.VerifyChallengeAsync(issued.ChallengeId!, "000000")).Success.Should().BeFalse();
+
+        var result = await orchestrator.VerifyChallengeAsync(issued.ChallengeId!, ValidCode);
+        result.Success.Should().BeFalse();
+        (await orchestrator.GetChallengeAsync(issued.ChallengeId!))!.Status.Should().Be(ChallengeStatus.Failed);
+
+        // Only the wrong codes count towards the risk score, not the attempt after lockout
+        _riskScoring.GetFeatures("user-1", DateTimeOffset.UtcNow).Failures.Should().Be(3);
+    }
+
+    [Fact]
+    public async Task EnrollmentCache_ServesCachedUntilInvalidated()
+    {
+        (await _enrollments.GetActiveAsync(_db, "user-1", MfaMethod.Totp)).Should().NotBeNull();
+
+        _enrollment.Status = EnrollmentStatus.Revoked;
+        await _db.SaveChangesAsync();
+        (await _enrollments.GetActiveAsync(_db, "user-1", MfaMethod.Totp)).Should().NotBeNull();
+
+        _enrollments.Invalidate("user-1");
+        (await _enrollments.GetActiveAsync(_db, "user-1", MfaMethod.Totp)).Should().BeNull();
+
+        var issued = await IssueAsync(CreateOrchestrator());
+        issued.Success.Should().BeFalse();
+    }
+
+    [Fact]
+    public async Task Sweep_MarksUnansweredChallengeExpiredAndEvictsIt()
+    {
+        var issued = await IssueAsync(CreateOrchestrator());
+        var later = DateTimeOffset.UtcNow.AddMinutes(10);
+
+        (await _challenges.ExpireUnansweredAsync(_db, later)).Should().Be(1);
+        _challenges.EvictExpired(later).Should().Be(1);
+
+        _challenges.Count.Should().Be(0);
+        (await _db.MfaChallenges.AsNoTracking().SingleAsync(c => c.Id == issued.ChallengeId))
+            .Status.Should().Be(ChallengeStatus.Expired);
+    }
+
+    [Fact]
+    public async Task WaitForStatus_AsyncProvider_ReturnsWhenOutcomePublished()
+    {
+        _provider.SetupGet(p => p.SupportsAsynchronousVerification).Returns(true);
+        _provider.Setup(p => p.CheckAsyncStatusAsync(It.IsAny<string>(), It.IsAny<CancellationToken>()))
+            .ReturnsAsync(new AsyncVerificationStatus { Status = ChallengeStatus.Issued });
+        var orchestrator = CreateOrchestrator();
+        var issued = await IssueAsync(orchestrator);
+
+        (await orchestrator.WaitForChallengeStatusAsync(issued.ChallengeId!, TimeSpan.FromMilliseconds(20)))
+            .Status.Should().Be(ChallengeStatus.Issued);
+
+        var waiting = orchestrator.WaitForChallengeStatusAsync(issued.ChallengeId!, TimeSpan.FromSeconds(10));
+        _completions.Complete(issued.ChallengeId!, new AsyncVerificationStatus { Status = ChallengeStatus.Approved });
+
+        (await waiting).Status.Should().Be(ChallengeStatus.Approved);
+        (await orchestrator.GetChallengeAsync(issued.ChallengeId!))!.Status.Should().Be(ChallengeStatus.Approved);
+    }
+
+    public void Dispose()
+    {
+        _db.Database.EnsureDeleted();
+        _db.Dispose();
+        _serviceProvider.Dispose();
+    }
+}
@@ -0,0 +1,222 @@
+using System.Diagnostics;
+using FluentAssertions;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Challenges;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Core.ValueObjects;
+using MfaSrv.Provider.Sms;
+using MfaSrv.Server;
+using MfaSrv.Server.Services;
+using MfaSrv.Tests.Unit.Helpers;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class OutboundDeliveryServiceTests
+{
+    private readonly ChallengeCompletionEngine _completions = new();
+
+    private OutboundDeliveryService CreateService(DeliverySettings settings, params IOutboundGateway[] gateways) => new(
+        gateways,
+        _completions,
+        Options.Create(settings),
+        NullLogger<OutboundDeliveryService>.Instance);
+
+    private static OutboundMessage Message(DeliveryChannel channel, string challengeId, DateTimeOffset? expiresAt = null) => new()
+    {
+        Channel = channel,
+        Recipient = "+15551234567",
+        Body = "Code: 123456",
+        ChallengeId = challengeId,
+        ExpiresAt = expiresAt ?? DateTimeOffset.UtcNow.AddMinutes(5)
+    };
+
+    [Fact]
+    public async Task TryEnqueue_ReturnsBeforeSlowGatewayCompletes()
+    {
+        var gateway = new TestGateway(DeliveryChannel.Sms) { Latency = TimeSpan.FromSeconds(1) };
+        using var service = CreateService(new DeliverySettings(), gateway);
+        await service.StartAsync(CancellationToken.None);
+
+        var stopwatch = Stopwatch.StartNew();
+        service.TryEnqueue(Message(DeliveryChannel.Sms, "c1")).Should().BeTrue();
+        stopwatch.Elapsed.Should().BeLessThan(TimeSpan.FromMilliseconds(200));
+
+        await gateway.WaitForSentAsync(1);
+        await service.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task FailedSend_IsRetriedUntilDelivered()
+    {
+        var gateway = new TestGateway(DeliveryChannel.Sms) { FailFirst = 2 };
+        using var service = CreateService(new DeliverySettings { RetryBaseDelayMs = 10 }, gateway);
+        await service.StartAsync(CancellationToken.None);
+
+        service.TryEnqueue(Message(DeliveryChannel.Sms, "c1"));
+
+        await gateway.WaitForSentAsync(1);
+        gateway.Attempts.Should().Be(3);
+        await service.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task PushThatFinallyFails_CompletesChallengeAsFailed()
+    {
+        var gateway = new TestGateway(DeliveryChannel.Push) { FailFirst = int.MaxValue };
+        using var service = CreateService(new DeliverySettings { MaxAttempts = 2, RetryBaseDelayMs = 10 }, gateway);
+        await service.StartAsync(CancellationToken.None);
+
+        service.TryEnqueue(Message(DeliveryChannel.Push, "push-1"));
+
+        var outcome = await _completions.WaitAsync("push-1", TimeSpan.FromSeconds(10));
+        outcome!.Status.Should().Be(ChallengeStatus.Failed);
+        gateway.Attempts.Should().Be(2);
+        await service.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task ExpiredMessage_IsDroppedWithoutSending()
+    {
+        var gateway = new TestGateway(DeliveryChannel.Sms);
+        using var service = CreateService(new DeliverySettings(), gateway);
+        await service.StartAsync(CancellationToken.None);
+
+        service.TryEnqueue(Message(DeliveryChannel.Sms, "old", DateTimeOffset.UtcNow.AddSeconds(-1)));
+        service.TryEnqueue(Message(DeliveryChannel.Sms, "new"));
+
+        await gateway.WaitForSentAsync(1);
+        gateway.Sent.Should().ContainSingle().Which.ChallengeId.Should().Be("new");
+        await service.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public void TryEnqueue_FullQueueOrUnknownChannel_ReturnsFalse()
+    {
+        // Not started, so nothing drains the queue
+        using var service = CreateService(new DeliverySettings { QueueCapacity = 2 }, new TestGateway(DeliveryChannel.Sms));
+
+        service.TryEnqueue(Message(DeliveryChannel.Sms, "c1")).Should().BeTrue();
+        service.TryEnqueue(Message(DeliveryChannel.Sms, "c2")).Should().BeTrue();
+        service.TryEnqueue(Message(DeliveryChannel.Sms, "c3")).Should().BeFalse();
+        service.TryEnqueue(Message(DeliveryChannel.Email, "c4")).Should().BeFalse();
+        service.QueueDepth(DeliveryChannel.Sms).Should().Be(2);
+    }
+
+    [Fact]
+    public async Task Burst_IsHeldToGatewayRateAndConcurrency()
+    {
+        var gateway = new TestGateway(DeliveryChannel.Sms);
+        var settings = new DeliverySettings
+        {
+            Sms = new DeliveryGatewaySettings { RatePerSecond = 100, Burst = 10, MaxConcurrency = 4 }
+        };
+        using var service = CreateService(settings, gateway);
+        await service.StartAsync(CancellationToken.None);
+
+        var stopwatch = Stopwatch.StartNew();
+        for (var i = 0; i < 60; i++)
+            service.TryEnqueue(Message(DeliveryChannel.Sms, $"c{i}")).Should().BeTrue();
+
+        await gateway.WaitForSentAsync(60);
+
+        // 10 from the bucket, the other 50 at 100/s
+        stopwatch.Elapsed.Should().BeGreaterThan(TimeSpan.FromMilliseconds(400));
+        gateway.PeakInFlight.Should().BeLessOrEqualTo(4);
+        await service.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public async Task SmsGateway_LogonBurst_AllCodesDeliveredThroughPooledClient()
+    {
+        var fakeGateway = new FakeSmsGateway { FailFirst = 5 };
+        var smsClient = new SmsGatewayClient(
+            new HttpClient(fakeGateway),
+            Options.Create(new SmsSettings { GatewayUrl = "http://sms.test/send", ApiKey = "key" }),
+            NullLogger<SmsGatewayClient>.Instance);
+        var settings = new DeliverySettings
+        {
+            RetryBaseDelayMs = 10,
+            Sms = new DeliveryGatewaySettings { RatePerSecond = 1000, Burst = 1000, MaxConcurrency = 8 }
+        };
+        using var service = CreateService(settings, smsClient);
+        await service.StartAsync(CancellationToken.None);
+
+        for (var i = 0; i < 200; i++)
+            service.TryEnqueue(Message(DeliveryChannel.Sms, $"c{i}") with { Body = $"Code: {i:D6}" }).Should().BeTrue();
+
+        var deadline = DateTime.UtcNow.AddSeconds(20);
+        while (fakeGateway.Bodies.Count < 200 && DateTime.UtcNow < deadline)
+            await Task.Delay(20);
+
+        fakeGateway.Bodies.Should().HaveCount(200);
+        fakeGateway.Requests.Should().Be(205);
+        fakeGateway.PeakInFlight.Should().BeLessOrEqualTo(8);
+        await service.StopAsync(CancellationToken.None);
+    }
+
+    [Fact]
+    public void RetryDelay_GrowsExponentiallyWithJitter()
+    {
+        using var service = CreateService(new DeliverySettings { RetryBaseDelayMs = 100 });
+
+        service.RetryDelay(1).TotalMilliseconds.Should().BeInRange(50, 150);
+        service.RetryDelay(3).TotalMilliseconds.Should().BeInRange(200, 600);
+    }
+
+    private sealed class TestGateway : IOutboundGateway
+    {
+        private readonly List<OutboundMessage> _sent = new();
+        private int _attempts;
+        private int _inFlight;
+        private int _peakInFlight;
+
+        public TestGateway(DeliveryChannel channel) => Channel = channel;
+
+        public DeliveryChannel Channel { get; }
+        public TimeSpan Latency { get; init; } = TimeSpan.FromMilliseconds(1);
+        public int FailFirst { get; init; }
+
+        public int Attempts => Volatile.Read(ref _attempts);
+        public int PeakInFlight => Volatile.Read(ref _peakInFlight);
+
+        public IReadOnlyList<OutboundMessage> Sent
+        {
+            get { lock (_sent) return _sent.ToList(); }
+        }
+
+        public async Task<bool> SendAsync(OutboundMessage message, CancellationToken ct = default)
+        {
+            var attempt = Interlocked.Increment(ref _attempts);
+            var inFlight = Interlocked.Increment(ref _inFlight);
+            lock (_sent)
+                _peakInFlight = Math.Max(_peakInFlight, inFlight);
+
+            try
+            {
+                await Task.Delay(Latency, ct);
+                if (attempt <= FailFirst)
+                    return false;
+
+                lock (_sent)
+                    _sent.Add(message);
+                return true;
+            }
+            finally
+            {
+                Interlocked.Decrement(ref _inFlight);
+            }
+        }
+
+        public async Task WaitForSentAsync(int count)
+        {
+            var deadline = DateTime.UtcNow.AddSeconds(10);
+            while (Sent.Count < count && DateTime.UtcNow < deadline)
+                await Task.Delay(10);
+
+            Sent.Count.Should().BeGreaterOrEqualTo(count);
+        }
+    }
+}
@@ -0,0 +1,106 @@
+using System.Net;
+using FluentAssertions;
+using Google.Protobuf;
+using Microsoft.Extensions.Options;
+using MfaSrv.Protocol.Replication;
+using MfaSrv.Server;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class PeerAuthenticatorTests
+{
+    private static readonly string Secret = Convert.ToBase64String(Enumerable.Range(1, 32).Select(i => (byte)i).ToArray());
+
+    private static PeerAuthenticator Create(string secret = "") =>
+        new(Options.Create(new HaSettings { PeerSecret = secret }));
+
+    private static ReplicateChallengesRequest CreateRequest()
+    {
+        var request = new ReplicateChallengesRequest { SenderInstanceId = "server01" };
+        request.Entries.Add(new ChallengeStoreEntry { Key = "push:1", Value = ByteString.CopyFromUtf8("{\"status\":\"Pending\"}") });
+        return request;
+    }
+
+    [Fact]
+    public void Verify_SignedByPeer_AcceptsOnceThenRefusesReplay()
+    {
+        var sender = Create(Secret);
+        var receiver = Create(Secret);
+        var request = CreateRequest();
+        sender.Sign(request);
+
+        var received = ReplicateChallengesRequest.Parser.ParseFrom(request.ToByteArray());
+        receiver.Verify(received).Should().BeTrue();
+
+        var replayed = ReplicateChallengesRequest.Parser.ParseFrom(request.ToByteArray());
+        receiver.Verify(replayed).Should().BeFalse();
+    }
+
+    [Fact]
+    public void Verify_TamperedOrForged_Refuses()
+    {
+        var sender = Create(Secret);
+        var receiver = Create(Secret);
+
+        var tampered = CreateRequest();
+        sender.Sign(tampered);
+        tampered.Entries[0].Value = ByteString.CopyFromUtf8("{\"status\":\"Approved\"}");
+        receiver.Verify(tampered).Should().BeFalse();
+
+        var forged = CreateRequest();
+        Create(Convert.ToBase64String(new byte[32])).Sign(forged);
+        receiver.Verify(forged).Should().BeFalse();
+
+        receiver.Verify(CreateRequest()).Should().BeFalse("unsigned messages are refused");
+    }
+
+    [Fact]
+    public void Verify_OutsideClockSkew_Refuses()
+    {
+        var authenticator = Create(Secret);
+        var now = DateTimeOffset.UtcNow;
+
+        var old = CreateRequest();
+        authenticator.Sign(old, now - PeerAuthenticator.MaxClockSkew - TimeSpan.FromSeconds(1));
+        authenticator.Verify(old, now).Should().BeFalse();
+
+        var recent = CreateRequest();
+        authenticator.Sign(recent, now - TimeSpan.FromSeconds(5));
+        authenticator.Verify(recent, now).Should().BeTrue();
+    }
+
+    [Fact]
+    public void WithoutSecret_RefusesEverything()
+    {
+        var authenticator = Create();
+        var request = CreateRequest();
+        Create(Secret).Sign(request);
+
+        authenticator.IsConfigured.Should().BeFalse();
+        authenticator.Verify(request).Should().BeFalse();
+        authenticator.Invoking(a => a.Sign(CreateRequest())).Should().Throw<InvalidOperationException>();
+    }
+
+    [Fact]
+    public void ShortSecret_Throws()
+    {
+        var act = () => Create(Convert.ToBase64String(new byte[16]));
+        act.Should().Throw<InvalidOperationException>();
+    }
+
+    [Fact]
+    public async Task IsPeerAddressAsync_MatchesOnlyConfiguredHosts()
+    {
+        var authenticator = Create(Secret);
+        var peers = new[] { "https://10.0.0.5:5081", "https://[fd00::7]:5081" };
+
+        (await authenticator.IsPeerAddressAsync(IPAddress.Parse("10.0.0.5"), peers, default)).Should().BeTrue();
+        (await authenticator.IsPeerAddressAsync(IPAddress.Parse("10.0.0.5").MapToIPv6(), peers, default)).Should().BeTrue();
+        (await authenticator.IsPeerAddressAsync(IPAddress.Parse("fd00::7"), peers, default)).Should().BeTrue();
+        (await authenticator.IsPeerAddressAsync(IPAddress.Parse("10.0.0.6"), peers, default)).Should().BeFalse();
+        (await authenticator.IsPeerAddressAsync(null, peers, default)).Should().BeFalse();
+        (await authenticator.IsPeerAddressAsync(IPAddress.Parse("10.0.0.5"), Array.Empty<string>(), default)).Should().BeFalse();
+    }
+}
@@ -14,6 +14,7 @@ namespace MfaSrv.Tests.Unit.Server;
 public class PolicyEngineTests : IDisposable
 {
     private readonly MfaSrvDbContext _db;
+    private readonly PolicySyncStreamService _policySync = new(Mock.Of<ILogger<PolicySyncStreamService>>());
     private readonly PolicyEngine _engine;
 
     public PolicyEngineTests()
@@ -24,7 +25,7 @@ public class PolicyEngineTests : IDisposable
 
         _db = new MfaSrvDbContext(options);
         var logger = Mock.Of<ILogger<PolicyEngine>>();
-        _engine = new PolicyEngine(_db, logger);
+        _engine = new PolicyEngine(_db, new CompiledPolicyCache(_policySync), logger);
     }
 
     [Fact]
@@ -240,6 +241,28 @@ public class PolicyEngineTests : IDisposable
         result.FailoverMode.Should().Be(FailoverMode.FailClose);
     }
 
+    [Fact]
+    public async Task Evaluate_ReusesCompiledPoliciesUntilPolicyChange()
+    {
+        var policy = CreatePolicy("Admin MFA", priority: 1,
+            ruleType: PolicyRuleType.SourceGroup, ruleValue: "Domain Admins",
+            action: PolicyActionType.RequireMfa);
+        _db.Policies.Add(policy);
+        await _db.SaveChangesAsync();
+
+        var context = CreateAuthContext("admin", groups: new[] { "Domain Admins" });
+        (await _engine.EvaluateAsync(context)).Decision.Should().Be(AuthDecision.RequireMfa);
+
+        // Changed behind the cache's back: the compiled set is still used
+        policy.IsEnabled = false;
+        await _db.SaveChangesAsync();
+        (await _engine.EvaluateAsync(context)).Decision.Should().Be(AuthDecision.RequireMfa);
+
+        // A policy write on this instance advances the sync version and forces a recompile
+        await _policySync.NotifyPolicyChangeAsync(policy.Id, string.Empty, deleted: true, DateTimeOffset.UtcNow);
+        (await _engine.EvaluateAsync(context)).Decision.Should().Be(AuthDecision.Allow);
+    }
+
     private static AuthenticationContext CreateAuthContext(
         string userName,
         string[]? groups = null,
@@ -0,0 +1,111 @@
+using FluentAssertions;
+using Google.Protobuf.WellKnownTypes;
+using Microsoft.Extensions.Logging.Abstractions;
+using MfaSrv.Protocol;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class PolicySyncStreamServiceTests
+{
+    private readonly PolicySyncStreamService _service = new(NullLogger<PolicySyncStreamService>.Instance);
+
+    private Task Change(string policyId, bool deleted = false) =>
+        _service.NotifyPolicyChangeAsync(policyId, $$"""{"id":"{{policyId}}"}""", deleted, DateTimeOffset.UtcNow);
+
+    private static Task<IReadOnlyList<PolicyEntry>> Policies(params string[] ids) =>
+        Task.FromResult<IReadOnlyList<PolicyEntry>>(ids
+            .Select(id => new PolicyEntry { PolicyId = id, PolicyJson = "{}", UpdatedAt = Timestamp.FromDateTimeOffset(DateTimeOffset.UtcNow) })
+            .ToList());
+
+    [Fact]
+    public async Task NotifyPolicyChange_AssignsConsecutiveVersions_AndSharesOneMessage()
+    {
+        var first = _service.Subscribe("dc-1");
+        var second = _service.Subscribe("dc-2");
+
+        await Change("p1");
+        await Change("p2", deleted: true);
+
+        _service.Version.Should().Be(2);
+        first.Reader.TryRead(out var a1).Should().BeTrue();
+        second.Reader.TryRead(out var b1).Should().BeTrue();
+        a1!.Version.Should().Be(1);
+        a1.Epoch.Should().Be(_service.Epoch);
+        b1.Should().BeSameAs(a1);
+
+        first.Reader.TryRead(out var a2).Should().BeTrue();
+        a2!.Version.Should().Be(2);
+        a2.Deleted.Should().BeTrue();
+        a2.PolicyJson.Should().BeEmpty();
+    }
+
+    [Fact]
+    public async Task TryGetChangesSince_SameEpoch_ReturnsOnlyMissedChanges()
+    {
+        for (var i = 1; i <= 5; i++)
+            await Change($"p{i}");
+
+        _service.TryGetChangesSince(_service.Epoch, 3, out var changes).Should().BeTrue();
+        changes.Select(c => c.Version).Should().Equal(4UL, 5UL);
+        changes.Select(c => c.PolicyId).Should().Equal("p4", "p5");
+
+        _service.TryGetChangesSince(_service.Epoch, 5, out changes).Should().BeTrue();
+        changes.Should().BeEmpty();
+    }
+
+    [Fact]
+    public async Task TryGetChangesSince_OtherEpochTooFarBehindOrAhead_RequiresSnapshot()
+    {
+        for (var i = 0; i < PolicySyncStreamService.DeltaLogCapacity + 2; i++)
+            await Change($"p{i % 10}");
+
+        _service.TryGetChangesSince("other-epoch", _service.Version, out _).Should().BeFalse();
+        _service.TryGetChangesSince(_service.Epoch, 1, out _).Should().BeFalse();
+        _service.TryGetChangesSince(_service.Epoch, 2, out var changes).Should().BeTrue();
+        changes.Should().HaveCount(PolicySyncStreamService.DeltaLogCapacity);
+        _service.TryGetChangesSince(_service.Epoch, _service.Version + 1, out _).Should().BeFalse();
+    }
+
+    [Fact]
+    public async Task GetSnapshot_ConcurrentAgents_LoadOncePerVersion()
+    {
+        await Change("p1");
+        var loads = 0;
+        async Task<IReadOnlyList<PolicyEntry>> Load(CancellationToken ct)
+        {
+            Interlocked.Increment(ref loads);
+            await Task.Delay(50, ct);
+            return await Policies("p1", "p2");
+        }
+
+        var snapshots = await Task.WhenAll(Enumerable.Range(0, 50).Select(_ => _service.GetSnapshotAsync(Load)));
+
+        loads.Should().Be(1);
+        snapshots.Should().OnlyContain(s => ReferenceEquals(s, snapshots[0]));
+        snapshots[0].Version.Should().Be(1);
+        snapshots[0].Snapshot.Policies.Select(p => p.PolicyId).Should().Equal("p1", "p2");
+
+        await Change("p3");
+        var next = await _service.GetSnapshotAsync(Load);
+        loads.Should().Be(2);
+        next.Version.Should().Be(2);
+    }
+
+    [Fact]
+    public async Task GetSnapshot_ChangeDuringLoad_IsNotCached()
+    {
+        var loads = 0;
+        var snapshot = await _service.GetSnapshotAsync(async ct =>
+        {
+            if (Interlocked.Increment(ref loads) == 1)
+                await Change("p1");
+            return await Policies("p1");
+        });
+
+        snapshot.Version.Should().Be(0);
+        (await _service.GetSnapshotAsync(_ => { loads++; return Policies("p1"); })).Version.Should().Be(1);
+        loads.Should().Be(2);
+    }
+}
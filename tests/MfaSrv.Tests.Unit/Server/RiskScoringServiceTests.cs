@@ -0,0 +1,126 @@
+using FluentAssertions;
+using Microsoft.Extensions.Options;
+using MfaSrv.Server;
+using MfaSrv.Server.Services;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class RiskScoringServiceTests
+{
+    // A Wednesday morning, local time: inside the default business hours
+    private static readonly DateTimeOffset Morning = new(new DateTime(2026, 10, 14, 10, 0, 0, DateTimeKind.Local));
+
+    private static RiskScoringService CreateService(Action<RiskSettings>? configure = null)
+    {
+        var settings = new RiskSettings();
+        configure?.Invoke(settings);
+        return new RiskScoringService(Options.Create(settings));
+    }
+
+    [Fact]
+    public void RecordLogon_FirstWorkstationIsNotNew_LaterOnesAreCounted()
+    {
+        var service = CreateService();
+
+        var first = service.RecordLogon("alice", "10.0.0.1", "PC-1", Morning);
+        first.Should().Be(new RiskFeatures(0, 1, 0, 0, 0));
+
+        service.RecordLogon("alice", "10.0.0.1", "PC-1", Morning.AddMinutes(1)).Score.Should().Be(0);
+
+        var second = service.RecordLogon("alice", "10.0.0.2", "PC-2", Morning.AddMinutes(2));
+        second.DistinctSourceIps.Should().Be(2);
+        second.NewWorkstations.Should().Be(1);
+        second.Score.Should().Be(25 + 10);
+
+        // Other users are unaffected
+        service.GetFeatures("bob", Morning.AddMinutes(2)).Should().Be(default(RiskFeatures));
+    }
+
+    [Fact]
+    public void RecordLogon_WithoutWorkstation_UsesSourceIp()
+    {
+        var service = CreateService();
+
+        service.RecordLogon("alice", "10.0.0.1", null, Morning);
+        service.RecordLogon("alice", "10.0.0.1", "", Morning.AddMinutes(1)).NewWorkstations.Should().Be(0);
+        service.RecordLogon("alice", "10.0.0.9", null, Morning.AddMinutes(2)).NewWorkstations.Should().Be(1);
+    }
+
+    [Fact]
+    public void RecordFailure_CountsWithinWindowOnly()
+    {
+        var service = CreateService();
+
+        for (var i = 0; i < 3; i++)
+            service.RecordFailure("alice", Morning.AddMinutes(i));
+
+        service.GetFeatures("alice", Morning.AddMinutes(5)).Should().Be(new RiskFeatures(3, 0, 0, 0, 30));
+        service.GetFeatures("alice", Morning.AddMinutes(75)).Failures.Should().Be(0);
+    }
+
+    [Fact]
+    public void RecordLogon_OffHoursAndWeekends_AreCounted()
+    {
+        var service = CreateService(s => s.WindowMinutes = 7 * 24 * 60);
+        var evening = Morning.Date.AddHours(22);
+        var saturday = Morning.Date.AddDays(3).AddHours(12);
+
+        service.RecordLogon("alice", "10.0.0.1", "PC-1", new DateTimeOffset(evening));
+        var features = service.RecordLogon("alice", "10.0.0.1", "PC-1", new DateTimeOffset(saturday));
+
+        features.OffHoursLogons.Should().Be(2);
+        features.Score.Should().Be(10);
+    }
+
+    [Fact]
+    public void Score_IsCappedAt100()
+    {
+        var service = CreateService();
+
+        for (var i = 0; i < 20; i++)
+            service.RecordFailure("alice", Morning);
+
+        service.GetFeatures("alice", Morning).Score.Should().Be(100);
+    }
+
+    [Fact]
+    public void IdleUsers_AreDropped_AndTrackingIsCapped()
+    {
+        var service = CreateService(s => s.MaxTrackedUsers = 2);
+
+        service.RecordLogon("alice", "10.0.0.1", "PC-1", Morning);
+        service.RecordLogon("bob", "10.0.0.2", "PC-2", Morning);
+        service.RecordLogon("carol", "10.0.0.3", "PC-3", Morning).DistinctSourceIps.Should().Be(0);
+        service.TrackedUsers.Should().Be(2);
+
+        service.RecordLogon("carol", "10.0.0.3", "PC-3", Morning.AddHours(2)).DistinctSourceIps.Should().Be(1);
+        service.TrackedUsers.Should().Be(1);
+    }
+
+    [Fact]
+    public void RecordLogon_100kUsers_BoundedMemoryAndNoAllocationsPerEvent()
+    {
+        var service = CreateService();
+        const int users = 100_000;
+        var names = Enumerable.Range(0, users).Select(i => $"user-{i:D6}").ToArray();
+        var workstations = names.Select(n => n + "-PC").ToArray();
+        var ips = Enumerable.Range(0, 256).Select(i => $"10.1.{i / 16}.{i % 16}").ToArray();
+
+        for (var i = 0; i < users; i++)
+            service.RecordLogon(names[i], ips[i & 255], workstations[i], Morning);
+
+        service.TrackedUsers.Should().Be(users);
+        service.MemoryBytes.Should().BeLessThan(32L * 1024 * 1024);
+
+        var allocated = GC.GetAllocatedBytesForCurrentThread();
+        for (var i = 0; i < 50_000; i++)
+        {
+            var user = (i * 7919) % users;
+            service.RecordLogon(names[user], ips[(user + i) & 255], workstations[user], Morning.AddMilliseconds(i));
+            service.RecordFailure(names[user], Morning.AddMilliseconds(i));
+        }
+
+        (GC.GetAllocatedBytesForCurrentThread() - allocated).Should().BeLessThan(1024);
+    }
+}
@@ -0,0 +1,118 @@
+using FluentAssertions;
+using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Configuration;
+using Microsoft.Extensions.DependencyInjection;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
+using MfaSrv.Core.Entities;
+using MfaSrv.Core.Enums;
+using MfaSrv.Core.Interfaces;
+using MfaSrv.Cryptography;
+using MfaSrv.Server;
+using MfaSrv.Server.Data;
+using MfaSrv.Server.Services;
+using MfaSrv.Tests.Unit.Helpers;
+using Xunit;
+
+namespace MfaSrv.Tests.Unit.Server;
+
+public class SessionCleanupServiceTests : IDisposable
+{
+    private readonly string _dbName = Guid.NewGuid().ToString();
+    private readonly ServiceProvider _serviceProvider;
+    private readonly MfaSrvDbContext _db;
+
+    public SessionCleanupServiceTests()
+    {
+        var services = new ServiceCollection();
+        services.AddLogging();
+        services.AddDbContext<MfaSrvDbContext>(o => o.UseInMemoryDatabase(_dbName));
+        services.AddSingleton(CreateSetupService());
+        services.AddSingleton<ITokenService>(new SessionTokenService(new byte[32]));
+        services.AddSingleton<PolicySyncStreamService>();
+        services.AddSingleton<SessionRevocationService>();
+        services.AddSingleton<DashboardStatisticsService>();
+        services.AddSingleton<AgentChannelService>();
+        services.AddSingleton<ActiveSessionCache>();
+        services.AddScoped<ISessionManager, SessionManager>();
+        _serviceProvider = services.BuildServiceProvider();
+
+        _db = new MfaSrvDbContext(new DbContextOptionsBuilder<MfaSrvDbContext>()
+            .UseInMemoryDatabase(_dbName)
+            .Options);
+    }
+
+    private SessionCleanupService CreateService(int retentionDays)
+    {
+        var scopeFactory = _serviceProvider.GetRequiredService<IServiceScopeFactory>();
+        var setupService = _serviceProvider.GetRequiredService<SetupService>();
+        var leaderElection = new LeaderElectionService(
+            scopeFactory,
+            Options.Create(new HaSettings { Enabled = false, InstanceId = "test" }),
+            NullLogger<LeaderElectionService>.Instance,
+            setupService,
+            new InMemoryHaPeerNetwork().TransportFor("test"));
+
+        return new SessionCleanupService(
+            scopeFactory,
+            Options.Create(new SessionSettings { CleanupBatchSize = 100, CleanupBatchDelayMs = 0, RetentionDays = retentionDays }),
+            NullLogger<SessionCleanupService>.Instance,
+            setupService,
+            leaderElection);
+    }
+
+    private static SetupService CreateSetupService()
+    {
+        var config = new ConfigurationBuilder()
+            .AddInMemoryCollection(new Dictionary<string, string?>
+            {
+                ["Ldap:Server"] = "configured.example.com",
+                ["Ldap:BindDn"] = "CN=configured",
+                ["MfaSrv:EncryptionKey"] = Convert.ToBase64String(new byte[32])
+            })
+            .Build();
+        var env = new Microsoft.Extensions.Hosting.Internal.HostingEnvironment { ContentRootPath = Path.GetTempPath() };
+        return new SetupService(config, env, NullLogger<SetupService>.Instance);
+    }
+
+    private async Task SeedAsync()
+    {
+        var now = DateTimeOffset.UtcNow;
+        for (var i = 0; i < 250; i++)
+            _db.MfaSessions.Add(new MfaSession { UserId = $"user-{i}", SourceIp = "10.0.0.1", ExpiresAt = now.AddMinutes(-1 - i) });
+        _db.MfaSessions.Add(new MfaSession { Id = "live", UserId = "user-live", SourceIp = "10.0.0.1", ExpiresAt = now.AddHours(1) });
+        _db.MfaSessions.Add(new MfaSession { Id = "old-revoked", Status = SessionStatus.Revoked, ExpiresAt = now.AddDays(-60) });
+        await _db.SaveChangesAsync();
+    }
+
+    [Fact]
+    public async Task Cleanup_ExpiresWholeBacklogInBatches_AndPurgesPastRetention()
+    {
+        await SeedAsync();
+
+        await CreateService(retentionDays: 30).CleanupAsync(CancellationToken.None);
+
+        var sessions = await _db.MfaSessions.AsNoTracking().ToListAsync();
+        sessions.Count(s => s.Status == SessionStatus.Expired).Should().Be(250);
+        sessions.Single(s => s.Status == SessionStatus.Active).Id.Should().Be("live");
+        sessions.Should().NotContain(s => s.Id == "old-revoked");
+    }
+
+    [Fact]
+    public async Task Cleanup_RetentionZero_KeepsEndedSessions()
+    {
+        await SeedAsync();
+
+        await CreateService(retentionDays: 0).CleanupAsync(CancellationToken.None);
+
+        (await _db.MfaSessions.AsNoTracking().AnyAsync(s => s.Id == "old-revoked")).Should().BeTrue();
+        (await _db.MfaSessions.CountAsync(s => s.Status == SessionStatus.Active)).Should().Be(1);
+    }
+
+    public void Dispose()
+    {
+        _db.Database.EnsureDeleted();
+        _db.Dispose();
+        _serviceProvider.Dispose();
+    }
+}
@@ -1,10 +1,15 @@
 using FluentAssertions;
 using Microsoft.EntityFrameworkCore;
+using Microsoft.Extensions.Configuration;
+using Microsoft.Extensions.DependencyInjection;
 using Microsoft.Extensions.Logging;
+using Microsoft.Extensions.Logging.Abstractions;
+using Microsoft.Extensions.Options;
 using Moq;
 using MfaSrv.Core.Enums;
 using MfaSrv.Core.Interfaces;
 using MfaSrv.Cryptography;
+using MfaSrv.Server;
 using MfaSrv.Server.Data;
 using MfaSrv.Server.Services;
 using Xunit;
@@ -14,25 +19,69 @@ namespace MfaSrv.Tests.Unit.Server;
 public class SessionManagerTests : IDisposable
 {
     private readonly MfaSrvDbContext _db;
+    private readonly ServiceProvider _serviceProvider;
     private readonly SessionManager _manager;
     private readonly SessionTokenService _tokenService;
+    private readonly SessionRevocationService _revocations;
+    private readonly PolicySyncStreamService _policySyncStream;
+    private readonly DashboardStatisticsService _statistics;
+    private readonly AgentChannelService _agentChannels;
+    private readonly ActiveSessionCache _activeSessions = new();
 
     public SessionManagerTests()
     {
+        var dbName = Guid.NewGuid().ToString();
         var options = new DbContextOptionsBuilder<MfaSrvDbContext>()
-            .UseInMemoryDatabase(Guid.NewGuid().ToString())
+            .UseInMemoryDatabase(dbName)
             .Options;
 
         _db = new MfaSrvDbContext(options);
 
+        var services = new ServiceCollection();
+        services.AddDbContext<MfaSrvDbContext>(o => o.UseInMemoryDatabase(dbName));
+        _serviceProvider = services.BuildServiceProvider();
+
         var key = new byte[32];
         System.Security.Cryptography.RandomNumberGenerator.Fill(key);
         _tokenService = new SessionTokenService(key);
 
+        _policySyncStream = new PolicySyncStreamService(NullLogger<PolicySyncStreamService>.Instance);
+        _revocations = new SessionRevocationService(
+            _serviceProvider.GetRequiredService<IServiceScopeFactory>(),
+            _policySyncStream,
+            Options.Create(new SessionSettings()),
+            CreateSetupService(),
+            NullLogger<SessionRevocationService>.Instance);
+
+        _statistics = new DashboardStatisticsService(
+            _serviceProvider.GetRequiredService<IServiceScopeFactory>(),
+            CreateSetupService(),
+            NullLogger<DashboardStatisticsService>.Instance);
+
+        _agentChannels = new AgentChannelService(NullLogger<AgentChannelService>.Instance);
+
         var logger = Mock.Of<ILogger<SessionManager>>();
-        _manager = new SessionManager(_db, _tokenService, logger);
+        _manager = new SessionManager(_db, _tokenService, _revocations, _statistics, _agentChannels, _activeSessions,
+            Options.Create(new SessionSettings()), logger);
     }
 
+    private static SetupService CreateSetupService()
+    {
+        var config = new ConfigurationBuilder()
+            .AddInMemoryCollection(new Dictionary<string, string?>
+            {
+                ["Ldap:Server"] = "configured.example.com",
+                ["Ldap:BindDn"] = "CN=configured",
+                ["MfaSrv:EncryptionKey"] = Convert.ToBase64String(new byte[32])
+            })
+            .Build();
+        var env = new Microsoft.Extensions.Hosting.Internal.HostingEnvironment { ContentRootPath = Path.GetTempPath() };
+        return new SetupService(config, env, NullLogger<SetupService>.Instance);
+    }
+
+    private string CreateToken(MfaSrv.Core.Entities.MfaSession session) =>
+        Convert.ToBase64String(_tokenService.GenerateSessionToken(session.Id, session.UserId, session.ExpiresAt));
+
     [Fact]
     public async Task CreateSession_CreatesAndReturnsSession()
     {
@@ -75,6 +124,67 @@ public class SessionManagerTests : IDisposable
         found.Should().BeNull();
     }
 
+    [Fact]
+    public async Task FindActiveSession_AfterCreate_IsServedFromCache()
+    {
+        var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+
+        // Gone from the database, still known to the write-through cache
+        _db.MfaSessions.Remove(session);
+        await _db.SaveChangesAsync();
+
+        var found = await _manager.FindActiveSessionAsync("user-1", "10.0.0.5");
+        found!.Id.Should().Be(session.Id);
+        found.Should().NotBeSameAs(session, "the cache holds a copy detached from the creating DbContext");
+    }
+
+    [Fact]
+    public async Task FindActiveSession_ColdMiss_LoadsNewestFromDatabaseOnce()
+    {
+        var now = DateTimeOffset.UtcNow;
+        _db.MfaSessions.AddRange(
+            new MfaSrv.Core.Entities.MfaSession { Id = "older", UserId = "user-1", SourceIp = "10.0.0.5", CreatedAt = now.AddMinutes(-10), ExpiresAt = now.AddHours(1) },
+            new MfaSrv.Core.Entities.MfaSession { Id = "newer", UserId = "user-1", SourceIp = "10.0.0.5", CreatedAt = now.AddMinutes(-5), ExpiresAt = now.AddHours(1) },
+            new MfaSrv.Core.Entities.MfaSession { Id = "expired", UserId = "user-1", SourceIp = "10.0.0.5", CreatedAt = now, ExpiresAt = now.AddMinutes(-1) });
+        await _db.SaveChangesAsync();
+
+        (await _manager.FindActiveSessionAsync("user-1", "10.0.0.5"))!.Id.Should().Be("newer");
+        _activeSessions.Count.Should().Be(1);
+
+        _db.MfaSessions.RemoveRange(_db.MfaSessions);
+        await _db.SaveChangesAsync();
+        (await _manager.FindActiveSessionAsync("user-1", "10.0.0.5"))!.Id.Should().Be("newer");
+    }
+
+    [Fact]
+    public async Task FindActiveSession_RevokedOnAnotherInstance_FallsBackToDatabase()
+    {
+        var older = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+        var newer = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+
+        // Another instance revoked the newer session; this one learns it from the revocation set
+        (await _db.MfaSessions.FindAsync(newer.Id))!.Status = SessionStatus.Revoked;
+        await _db.SaveChangesAsync();
+        _revocations.MarkRevoked(newer.Id, newer.ExpiresAt);
+
+        var found = await _manager.FindActiveSessionAsync("user-1", "10.0.0.5");
+        found!.Id.Should().Be(older.Id);
+    }
+
+    [Fact]
+    public async Task FindActiveSession_NoSessionIsCached_UntilOneIsCreated()
+    {
+        (await _manager.FindActiveSessionAsync("user-1", "10.0.0.5")).Should().BeNull();
+
+        // Added behind the cache's back: not seen until the negative entry expires
+        _db.MfaSessions.Add(new MfaSrv.Core.Entities.MfaSession { UserId = "user-1", SourceIp = "10.0.0.5", ExpiresAt = DateTimeOffset.UtcNow.AddHours(1) });
+        await _db.SaveChangesAsync();
+        (await _manager.FindActiveSessionAsync("user-1", "10.0.0.5")).Should().BeNull();
+
+        var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+        (await _manager.FindActiveSessionAsync("user-1", "10.0.0.5"))!.Id.Should().Be(session.Id);
+    }
+
     [Fact]
     public async Task RevokeSession_MarksAsRevoked()
     {
@@ -86,6 +196,39 @@ public class SessionManagerTests : IDisposable
         dbSession!.Status.Should().Be(SessionStatus.Revoked);
     }
 
+    [Fact]
+    public async Task CreateAndRevokeSession_UpdatesDashboardActiveSessions()
+    {
+        var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+        await _manager.CreateSessionAsync("user-2", "10.0.0.6", "");
+        _statistics.GetSnapshot().ActiveSessions.Should().Be(2);
+
+        await _manager.RevokeSessionAsync(session.Id);
+        await _manager.RevokeSessionAsync(session.Id);
+
+        _statistics.GetSnapshot().ActiveSessions.Should().Be(1);
+    }
+
+    [Fact]
+    public async Task CreateAndRevokeSession_PushesSessionEventsToAgentChannels()
+    {
+        _db.Users.Add(new MfaSrv.Core.Entities.User { Id = "user-1", SamAccountName = "jsmith" });
+        await _db.SaveChangesAsync();
+        var channel = _agentChannels.Subscribe("agent-1");
+
+        var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+        await _manager.RevokeSessionAsync(session.Id);
+
+        channel.Reader.TryRead(out var created).Should().BeTrue();
+        created!.SessionId.Should().Be(session.Id);
+        created.UserName.Should().Be("jsmith");
+        created.Revoked.Should().BeFalse();
+
+        channel.Reader.TryRead(out var revoked).Should().BeTrue();
+        revoked!.SessionId.Should().Be(session.Id);
+        revoked.Revoked.Should().BeTrue();
+    }
+
     [Fact]
     public async Task FindActiveSession_RevokedSession_ReturnsNull()
     {
@@ -97,7 +240,7 @@ public class SessionManagerTests : IDisposable
     }
 
     [Fact]
-    public async Task CleanupExpiredSessions_MarksExpiredAsExpired()
+    public async Task ExpireSessions_MarksExpiredAsExpired()
     {
         // Create an already-expired session
         var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "", TimeSpan.FromSeconds(-1));
@@ -107,12 +250,45 @@ public class SessionManagerTests : IDisposable
         dbSession!.ExpiresAt = DateTimeOffset.UtcNow.AddMinutes(-10);
         await _db.SaveChangesAsync();
 
-        await _manager.CleanupExpiredSessionsAsync();
+        (await _manager.ExpireSessionsAsync(100)).Should().Be(1);
 
         dbSession = await _db.MfaSessions.FindAsync(session.Id);
         dbSession!.Status.Should().Be(SessionStatus.Expired);
     }
 
+    [Fact]
+    public async Task ExpireSessions_MarksAtMostOneBatch()
+    {
+        var now = DateTimeOffset.UtcNow;
+        for (var i = 0; i < 5; i++)
+            _db.MfaSessions.Add(new MfaSrv.Core.Entities.MfaSession { UserId = $"user-{i}", SourceIp = "10.0.0.5", ExpiresAt = now.AddMinutes(-i - 1) });
+        _db.MfaSessions.Add(new MfaSrv.Core.Entities.MfaSession { UserId = "user-live", SourceIp = "10.0.0.5", ExpiresAt = now.AddHours(1) });
+        await _db.SaveChangesAsync();
+
+        (await _manager.ExpireSessionsAsync(3)).Should().Be(3);
+        (await _manager.ExpireSessionsAsync(3)).Should().Be(2);
+        (await _manager.ExpireSessionsAsync(3)).Should().Be(0);
+
+        (await _db.MfaSessions.CountAsync(s => s.Status == SessionStatus.Active)).Should().Be(1);
+    }
+
+    [Fact]
+    public async Task PurgeSessions_DeletesOnlyEndedSessionsPastCutoff()
+    {
+        var now = DateTimeOffset.UtcNow;
+        _db.MfaSessions.AddRange(
+            new MfaSrv.Core.Entities.MfaSession { Id = "old-expired", Status = SessionStatus.Expired, ExpiresAt = now.AddDays(-40) },
+            new MfaSrv.Core.Entities.MfaSession { Id = "old-revoked", Status = SessionStatus.Revoked, ExpiresAt = now.AddDays(-35) },
+            new MfaSrv.Core.Entities.MfaSession { Id = "recent-expired", Status = SessionStatus.Expired, ExpiresAt = now.AddDays(-5) },
+            new MfaSrv.Core.Entities.MfaSession { Id = "old-not-yet-marked", Status = SessionStatus.Active, ExpiresAt = now.AddDays(-40) });
+        await _db.SaveChangesAsync();
+
+        (await _manager.PurgeSessionsAsync(now.AddDays(-30), 1000)).Should().Be(2);
+
+        (await _db.MfaSessions.Select(s => s.Id).ToListAsync())
+            .Should().BeEquivalentTo("recent-expired", "old-not-yet-marked");
+    }
+
     [Fact]
     public async Task CreateSession_SessionIsPersisted()
     {
@@ -122,9 +298,90 @@ public class SessionManagerTests : IDisposable
         count.Should().Be(1);
     }
 
+    [Fact]
+    public async Task ValidateSession_BeforeRevocationSync_UsesDatabase()
+    {
+        var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+        var token = CreateToken(session);
+
+        _db.MfaSessions.Remove(session);
+        await _db.SaveChangesAsync();
+
+        // Revocation set not loaded yet -> authoritative DB check, which no longer finds the row
+        var validated = await _manager.ValidateSessionAsync(token);
+        validated.Should().BeNull();
+    }
+
+    [Fact]
+    public async Task ValidateSession_StatelessPath_DoesNotNeedSessionRow()
+    {
+        var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+        var token = CreateToken(session);
+        await _revocations.RefreshAsync();
+
+        _db.MfaSessions.Remove(session);
+        await _db.SaveChangesAsync();
+
+        var validated = await _manager.ValidateSessionAsync(token);
+
+        validated.Should().NotBeNull();
+        validated!.Id.Should().Be(session.Id);
+        validated.UserId.Should().Be("user-1");
+    }
+
+    [Fact]
+    public async Task ValidateSession_RevokedSession_ReturnsNull()
+    {
+        var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+        var token = CreateToken(session);
+        await _revocations.RefreshAsync();
+
+        await _manager.RevokeSessionAsync(session.Id);
+
+        _revocations.IsRevoked(session.Id).Should().BeTrue();
+        (await _manager.ValidateSessionAsync(token)).Should().BeNull();
+    }
+
+    [Fact]
+    public async Task RevocationRefresh_PicksUpRevocationsFromOtherInstances()
+    {
+        var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+
+        // Simulate another server instance revoking the session directly in the shared database
+        var dbSession = await _db.MfaSessions.FindAsync(session.Id);
+        dbSession!.Status = SessionStatus.Revoked;
+        await _db.SaveChangesAsync();
+
+        await _revocations.RefreshAsync();
+
+        _revocations.IsSynchronized.Should().BeTrue();
+        _revocations.IsRevoked(session.Id).Should().BeTrue();
+    }
+
+    [Fact]
+    public async Task RevokeSession_PublishesRevocationFilterDelta()
+    {
+        var session = await _manager.CreateSessionAsync("user-1", "10.0.0.5", "");
+        var channel = _policySyncStream.Subscribe("dc-agent-1");
+        var versionBefore = _revocations.FilterVersion;
+
+        await _manager.RevokeSessionAsync(session.Id);
+
+        channel.Reader.TryRead(out var notification).Should().BeTrue();
+        var update = notification!.RevocationFilter;
+        update.Should().NotBeNull();
+        update!.Snapshot.Should().BeFalse();
+        update.Version.Should().Be(versionBefore + 1);
+        update.Added.Should().Equal(MfaSrv.Core.Collections.CuckooFilter.Hash(session.Id));
+
+        var snapshot = MfaSrv.Core.Collections.CuckooFilter.FromBytes(_revocations.GetFilterSnapshot().Filter!);
+        snapshot.Contains(session.Id).Should().BeTrue();
+    }
+
     public void Dispose()
     {
         _db.Database.EnsureDeleted();
         _db.Dispose();
+        _serviceProvider.Dispose();
     }
 }